@@ -0,0 +1,128 @@
+/*
+    Instance-based DHT22 driver and read schedule. Nothing in here touches
+    the hardware directly, so it builds on the host with a simulated bus.
+*/
+
+#include "dht.h"
+
+void dht_init(dht_handle_t *dht, int gpio, const dht_bus_t *bus)
+{
+    dht->gpio = gpio;
+    dht->bus = bus;
+    dht->temperature_tenths = 0;
+    dht->humidity_tenths = 0;
+    dht->last_status = DHT_TIMEOUT_ERROR;
+    dht->attempted = false;
+    dht->last_attempt_ms = 0;
+    dht->last_ok_ms = 0;
+    dht->reads = 0;
+    dht->reads_ok = 0;
+    dht->timeouts = 0;
+    dht->checksum_errors = 0;
+}
+
+uint32_t dht_now_ms(const dht_handle_t *dht)
+{
+    return dht->bus->now_ms(dht->bus->context);
+}
+
+uint32_t dht_ms_until_ready(const dht_handle_t *dht, uint32_t now_ms)
+{
+    // Unsigned subtraction copes with the clock wrapping
+    uint32_t elapsed = now_ms - dht->last_attempt_ms;
+
+    if (!dht->attempted || elapsed >= DHT_MIN_INTERVAL_MS) {
+        return 0;
+    }
+    return DHT_MIN_INTERVAL_MS - elapsed;
+}
+
+uint32_t dht_reading_age_ms(const dht_handle_t *dht, uint32_t now_ms)
+{
+    return dht->reads_ok > 0 ? now_ms - dht->last_ok_ms : UINT32_MAX;
+}
+
+int dht_read(dht_handle_t *dht)
+{
+    Dht22Edge_t edges[DHT22_MAX_EDGES];
+    uint8_t data[DHT22_DATA_BYTES];
+    uint32_t now_ms = dht_now_ms(dht);
+
+    if (dht_ms_until_ready(dht, now_ms) > 0) {
+        return DHT_TOO_SOON_ERROR;
+    }
+    dht->attempted = true;
+    dht->last_attempt_ms = now_ms;
+    dht->reads++;
+
+    size_t count = dht->bus->read_frame(dht->bus->context, dht->gpio, edges, DHT22_MAX_EDGES);
+    switch (Dht22_DecodeEdges(edges, count, data)) {
+    case Dht22DecodeSuccess:
+        dht->temperature_tenths = Dht22_TemperatureTenths(data);
+        dht->humidity_tenths = Dht22_HumidityTenths(data);
+        dht->last_ok_ms = now_ms;
+        dht->reads_ok++;
+        dht->last_status = DHT_OK;
+        break;
+    case Dht22DecodeBadChecksum:
+        dht->checksum_errors++;
+        dht->last_status = DHT_CHECKSUM_ERROR;
+        break;
+    default:
+        dht->timeouts++;
+        dht->last_status = DHT_TIMEOUT_ERROR;
+        break;
+    }
+    return dht->last_status;
+}
+
+void dht_schedule_init(dht_schedule_t *schedule, dht_handle_t *sensors, size_t count, uint32_t period_ms)
+{
+    if (period_ms < DHT_MIN_INTERVAL_MS) {
+        period_ms = DHT_MIN_INTERVAL_MS;
+    }
+    schedule->sensors = sensors;
+    schedule->count = count;
+    schedule->period_ms = period_ms;
+    schedule->slot_ms = count > 0 ? period_ms / count : period_ms;
+    schedule->next = 0;
+    schedule->next_ms = 0;
+    schedule->started = false;
+}
+
+dht_handle_t *dht_schedule_due(dht_schedule_t *schedule, uint32_t now_ms, uint32_t *wait_ms)
+{
+    if (schedule->count == 0) {
+        *wait_ms = schedule->period_ms;
+        return NULL;
+    }
+    if (!schedule->started) {
+        schedule->next_ms = now_ms;
+        schedule->started = true;
+    }
+
+    // Signed difference, so a due time just behind a wrapped clock still counts as past
+    int32_t until_due = (int32_t) (schedule->next_ms - now_ms);
+    if (until_due > 0) {
+        *wait_ms = (uint32_t) until_due;
+        return NULL;
+    }
+
+    dht_handle_t *dht = &schedule->sensors[schedule->next];
+    uint32_t ready = dht_ms_until_ready(dht, now_ms);
+    if (ready > 0) {
+        *wait_ms = ready;
+        return NULL;
+    }
+
+    // Running late, after a stall or a wait for the sensor, restarts the
+    // rotation from now rather than firing the missed slots back to back,
+    // so reads stay at least half a slot apart
+    if (-until_due > (int32_t) (schedule->slot_ms / 2)) {
+        schedule->next_ms = now_ms;
+    }
+    schedule->next_ms += schedule->slot_ms;
+    schedule->next = (schedule->next + 1) % schedule->count;
+    *wait_ms = 0;
+    return dht;
+}
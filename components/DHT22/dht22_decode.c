@@ -0,0 +1,128 @@
+/**
+ * @file dht22_decode.c
+ * @brief Implementation of the DHT22 edge decoder.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "dht22_decode.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether pEdges[ index ] starts a complete high pulse, and its width.
+ */
+static bool highPulse( const Dht22Edge_t * pEdges,
+                       size_t edgeCount,
+                       size_t index,
+                       uint32_t * pWidth )
+{
+    if( ( ( index + 1U ) >= edgeCount ) ||
+        ( pEdges[ index ].level == 0U ) ||
+        ( pEdges[ index + 1U ].level != 0U ) )
+    {
+        return false;
+    }
+
+    /* Unsigned subtraction copes with the timer wrapping. */
+    *pWidth = pEdges[ index + 1U ].timeUs - pEdges[ index ].timeUs;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+Dht22DecodeStatus_t Dht22_DecodeEdges( const Dht22Edge_t * pEdges,
+                                       size_t edgeCount,
+                                       uint8_t * pData )
+{
+    size_t index;
+    size_t bits;
+    uint32_t width = 0U;
+
+    assert( ( pEdges != NULL ) || ( edgeCount == 0U ) );
+    assert( pData != NULL );
+
+    ( void ) memset( pData, 0, DHT22_DATA_BYTES );
+
+    /* The first high pulse of response length is the sensor's answer. The
+     * host releasing the line is shorter, and a 1 bit can only come after
+     * it. */
+    for( index = 0U; index < edgeCount; index++ )
+    {
+        if( highPulse( pEdges, edgeCount, index, &width ) &&
+            ( width >= DHT22_RESPONSE_HIGH_MIN_US ) &&
+            ( width <= DHT22_RESPONSE_HIGH_MAX_US ) )
+        {
+            break;
+        }
+    }
+
+    if( index == edgeCount )
+    {
+        return Dht22DecodeTooFewBits;
+    }
+
+    /* Bits follow as strictly alternating low and high pulses. A lost edge
+     * merges two pulses, which either runs past the longest bit or leaves
+     * the frame a bit short; both are rejected rather than decoded shifted. */
+    index += 2U;
+
+    for( bits = 0U; bits < DHT22_DATA_BITS; bits++ )
+    {
+        if( !highPulse( pEdges, edgeCount, index, &width ) ||
+            ( width > DHT22_BIT_HIGH_MAX_US ) )
+        {
+            return Dht22DecodeBadTiming;
+        }
+
+        if( width > DHT22_BIT_THRESHOLD_US )
+        {
+            pData[ bits / 8U ] |= ( uint8_t ) ( 0x80U >> ( bits % 8U ) );
+        }
+
+        index += 2U;
+    }
+
+    /* After bit 39 the sensor lets go of the line: at most that last rise. */
+    if( ( index < edgeCount ) &&
+        ( ( pEdges[ index ].level == 0U ) || ( ( index + 1U ) < edgeCount ) ) )
+    {
+        return Dht22DecodeBadTiming;
+    }
+
+    if( pData[ 4 ] != ( uint8_t ) ( pData[ 0 ] + pData[ 1 ] + pData[ 2 ] + pData[ 3 ] ) )
+    {
+        return Dht22DecodeBadChecksum;
+    }
+
+    return Dht22DecodeSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+int16_t Dht22_HumidityTenths( const uint8_t * pData )
+{
+    assert( pData != NULL );
+
+    return ( int16_t ) ( ( ( uint16_t ) pData[ 0 ] << 8 ) | pData[ 1 ] );
+}
+
+/*-----------------------------------------------------------*/
+
+int16_t Dht22_TemperatureTenths( const uint8_t * pData )
+{
+    int16_t magnitude;
+
+    assert( pData != NULL );
+
+    /* Sign and magnitude, not two's complement. */
+    magnitude = ( int16_t ) ( ( ( uint16_t ) ( pData[ 2 ] & 0x7FU ) << 8 ) | pData[ 3 ] );
+
+    return ( ( pData[ 2 ] & 0x80U ) != 0U ) ? ( int16_t ) -magnitude : magnitude;
+}
+
+/*-----------------------------------------------------------*/
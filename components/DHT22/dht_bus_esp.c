@@ -0,0 +1,182 @@
+/*
+    Device buses for the DHT22 driver: RMT edge capture, or polling the pin.
+    Both send the start signal with the GPIO driver and hand back edge
+    timestamps for dht22_decode.
+*/
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "rom/ets_sys.h"
+#include "sdkconfig.h"
+
+#include "dht.h"
+
+#if CONFIG_DHT22_READ_RMT
+#include "driver/rmt.h"
+#include "freertos/ringbuf.h"
+#endif
+
+static const char *TAG = "DHT";
+
+// Host start signal: hold the line low this long, then release it
+#define START_LOW_US 3000
+
+static uint32_t esp_now_ms(void *context)
+{
+    (void) context;
+    return (uint32_t) (esp_timer_get_time() / 1000);
+}
+
+// Drives the start signal's low phase. The pin is left open drain, so
+// driving 1 releases the line to the pull-up while it stays readable.
+static void start_signal(int gpio)
+{
+    gpio_set_direction(gpio, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(gpio, 0);
+    ets_delay_us(START_LOW_US);
+}
+
+#if CONFIG_DHT22_READ_RMT
+
+// The RMT channel counts in 1 us ticks and closes the frame once the line
+// has been idle for IDLE_US, i.e. after the sensor releases it. The reading
+// task blocks on the ring buffer meanwhile instead of spinning. One channel
+// serves every sensor; it is moved to the pin being read.
+
+#define RMT_CHANNEL ((rmt_channel_t) CONFIG_DHT22_RMT_CHANNEL)
+#define IDLE_US 150             // longer than any pulse in a frame
+#define FILTER_TICKS 80         // 1 us at 80 MHz APB; removes glitches
+
+static bool rmt_installed = false;
+static int rmt_gpio = -1;       // pin the channel listens on
+static RingbufHandle_t rmt_ringbuf = NULL;
+
+static bool rmt_attach(int gpio)
+{
+    if (!rmt_installed) {
+        rmt_config_t config = RMT_DEFAULT_CONFIG_RX(gpio, RMT_CHANNEL);
+        config.clk_div = 80;
+        config.rx_config.idle_threshold = IDLE_US;
+        config.rx_config.filter_en = true;
+        config.rx_config.filter_ticks_thresh = FILTER_TICKS;
+
+        if (rmt_config(&config) != ESP_OK ||
+            rmt_driver_install(RMT_CHANNEL, 512, 0) != ESP_OK ||
+            rmt_get_ringbuf_handle(RMT_CHANNEL, &rmt_ringbuf) != ESP_OK) {
+            ESP_LOGE(TAG, "RMT channel %d could not be set up", RMT_CHANNEL);
+            return false;
+        }
+        rmt_installed = true;
+        rmt_gpio = gpio;
+    } else if (rmt_gpio != gpio) {
+        if (rmt_set_gpio(RMT_CHANNEL, RMT_MODE_RX, gpio, false) != ESP_OK) {
+            return false;
+        }
+        rmt_gpio = gpio;
+    }
+    return true;
+}
+
+// RMT items hold (duration, level) pairs; turn them into edge timestamps
+static size_t rmt_to_edges(const rmt_item32_t *items, size_t item_count, Dht22Edge_t *edges, size_t max_edges)
+{
+    uint32_t time = 0;
+    size_t count = 0;
+
+    for (size_t i = 0; i < item_count && count + 2 <= max_edges; i++) {
+        edges[count].timeUs = time;
+        edges[count++].level = items[i].level0;
+        time += items[i].duration0;
+        if (items[i].duration0 == 0) {
+            break;
+        }
+        edges[count].timeUs = time;
+        edges[count++].level = items[i].level1;
+        time += items[i].duration1;
+        if (items[i].duration1 == 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+static size_t rmt_read_frame(void *context, int gpio, Dht22Edge_t *edges, size_t max_edges)
+{
+    rmt_item32_t *items;
+    size_t length = 0;
+    size_t count;
+
+    (void) context;
+    if (!rmt_attach(gpio)) {
+        return 0;
+    }
+
+    // Capture starts before the line is released
+    start_signal(gpio);
+    rmt_rx_start(RMT_CHANNEL, true);
+    gpio_set_level(gpio, 1);
+
+    // The frame takes under 6 ms; wait at least 20 ms whatever the tick rate
+    items = (rmt_item32_t *) xRingbufferReceive(rmt_ringbuf, &length, pdMS_TO_TICKS(20) + 1);
+    rmt_rx_stop(RMT_CHANNEL);
+    if (items == NULL) {
+        return 0;
+    }
+    count = rmt_to_edges(items, length / sizeof(rmt_item32_t), edges, max_edges);
+    vRingbufferReturnItem(rmt_ringbuf, items);
+    return count;
+}
+
+static const dht_bus_t default_bus = {
+    .context = NULL,
+    .read_frame = rmt_read_frame,
+    .now_ms = esp_now_ms,
+};
+
+#else
+
+// Polls the pin and timestamps every change. Still busy for the whole
+// frame, but an interrupt during the loop only delays one timestamp instead
+// of skewing a count of loop turns taken for microseconds.
+
+#define POLL_IDLE_US 200        // longer than any pulse in a frame
+
+static size_t poll_read_frame(void *context, int gpio, Dht22Edge_t *edges, size_t max_edges)
+{
+    size_t count = 0;
+
+    (void) context;
+    start_signal(gpio);
+    gpio_set_level(gpio, 1);
+
+    int64_t last_change = esp_timer_get_time();
+    int level = 1;
+    while (count < max_edges) {
+        int64_t now = esp_timer_get_time();
+        int current = gpio_get_level(gpio);
+        if (current != level) {
+            level = current;
+            last_change = now;
+            edges[count].timeUs = (uint32_t) now;
+            edges[count++].level = (uint8_t) level;
+        } else if (now - last_change > POLL_IDLE_US) {
+            break;
+        }
+    }
+    return count;
+}
+
+static const dht_bus_t default_bus = {
+    .context = NULL,
+    .read_frame = poll_read_frame,
+    .now_ms = esp_now_ms,
+};
+
+#endif
+
+const dht_bus_t *dht_bus_default(void)
+{
+    return &default_bus;
+}
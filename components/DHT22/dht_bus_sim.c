@@ -0,0 +1,128 @@
+/*
+    Simulated DHT22 bus for host tests and benchmarks. Not part of the
+    device build.
+
+    Each simulated sensor answers a start signal on its pin with a frame
+    for its current reading, with random jitter on every pulse, bit timings
+    that can be set off nominal and edges that can get lost, as on a long
+    or noisy line. Like the real part, it ignores a start signal that
+    comes less than DHT_MIN_INTERVAL_MS after the previous one, and counts
+    it.
+*/
+
+#include "dht.h"
+
+// Nominal widths in microseconds, see dht22_decode.h
+#define RELEASE_US 30
+#define RESPONSE_US 80
+#define BIT_LOW_US 50
+#define ZERO_HIGH_US 27
+#define ONE_HIGH_US 70
+
+// Time a read takes, start signal included
+#define READ_MS 5
+
+static uint32_t next_random(dht_sim_t *sim)
+{
+    // xorshift32; the seed must not be 0
+    uint32_t x = sim->seed ? sim->seed : 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->seed = x;
+    return x;
+}
+
+static uint32_t width(dht_sim_t *sim, const dht_sim_sensor_t *sensor, uint32_t nominal)
+{
+    if (sensor->jitter_us == 0) {
+        return nominal;
+    }
+    return nominal + next_random(sim) % (2 * sensor->jitter_us + 1) - sensor->jitter_us;
+}
+
+static size_t add_edge(dht_sim_t *sim, const dht_sim_sensor_t *sensor,
+                       Dht22Edge_t *edges, size_t count, size_t max_edges, uint32_t time, uint8_t level)
+{
+    if (sensor->drop_permille > 0 && next_random(sim) % 1000 < sensor->drop_permille) {
+        return count;
+    }
+    if (count < max_edges) {
+        edges[count].timeUs = time;
+        edges[count].level = level;
+        count++;
+    }
+    return count;
+}
+
+static size_t sim_read_frame(void *context, int gpio, Dht22Edge_t *edges, size_t max_edges)
+{
+    dht_sim_t *sim = context;
+    dht_sim_sensor_t *sensor = NULL;
+    uint8_t data[DHT22_DATA_BYTES];
+    size_t count = 0;
+
+    for (size_t i = 0; i < sim->count; i++) {
+        if (sim->sensors[i].gpio == gpio) {
+            sensor = &sim->sensors[i];
+        }
+    }
+
+    uint32_t start_ms = sim->now_ms;
+    sim->now_ms += READ_MS;
+    if (sensor == NULL || sensor->absent) {
+        return 0;
+    }
+    bool too_soon = sensor->started && start_ms - sensor->last_start_ms < DHT_MIN_INTERVAL_MS;
+    sensor->started = true;
+    sensor->last_start_ms = start_ms;
+    if (too_soon) {
+        sensor->too_soon++;
+        return 0;
+    }
+
+    uint16_t humidity = (uint16_t) sensor->humidity_tenths;
+    uint16_t temperature = sensor->temperature_tenths < 0
+                               ? (uint16_t) (0x8000 | -sensor->temperature_tenths)
+                               : (uint16_t) sensor->temperature_tenths;
+    data[0] = (uint8_t) (humidity >> 8);
+    data[1] = (uint8_t) humidity;
+    data[2] = (uint8_t) (temperature >> 8);
+    data[3] = (uint8_t) temperature;
+    data[4] = (uint8_t) (data[0] + data[1] + data[2] + data[3]);
+
+    uint32_t time = start_ms * 1000U;
+    count = add_edge(sim, sensor, edges, count, max_edges, time, 1);
+    time += width(sim, sensor, RELEASE_US);
+    count = add_edge(sim, sensor, edges, count, max_edges, time, 0);
+    time += width(sim, sensor, RESPONSE_US);
+    count = add_edge(sim, sensor, edges, count, max_edges, time, 1);
+    time += width(sim, sensor, RESPONSE_US);
+    uint32_t zero_high_us = sensor->zero_high_us ? sensor->zero_high_us : ZERO_HIGH_US;
+    uint32_t one_high_us = sensor->one_high_us ? sensor->one_high_us : ONE_HIGH_US;
+    for (uint32_t bit = 0; bit < DHT22_DATA_BITS; bit++) {
+        bool one = (data[bit / 8] & (0x80 >> (bit % 8))) != 0;
+        count = add_edge(sim, sensor, edges, count, max_edges, time, 0);
+        time += width(sim, sensor, BIT_LOW_US);
+        count = add_edge(sim, sensor, edges, count, max_edges, time, 1);
+        time += width(sim, sensor, one ? one_high_us : zero_high_us);
+    }
+    count = add_edge(sim, sensor, edges, count, max_edges, time, 0);
+    time += width(sim, sensor, BIT_LOW_US);
+    count = add_edge(sim, sensor, edges, count, max_edges, time, 1);
+
+    sensor->frames++;
+    return count;
+}
+
+static uint32_t sim_now_ms(void *context)
+{
+    return ((dht_sim_t *) context)->now_ms;
+}
+
+void dht_bus_sim_init(dht_bus_t *bus, dht_sim_t *sim)
+{
+    bus->context = sim;
+    bus->read_frame = sim_read_frame;
+    bus->now_ms = sim_now_ms;
+}
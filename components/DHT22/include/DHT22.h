@@ -3,20 +3,23 @@
 */
 
 #include <stdbool.h>
+#include <stdint.h>
 #ifndef DHT22_H_  
 #define DHT22_H_
 
 #define DHT_OK 0
 #define DHT_CHECKSUM_ERROR -1
 #define DHT_TIMEOUT_ERROR -2
+#define DHT_TOO_SOON_ERROR -3
 
 // == function prototypes =======================================
 
 void 	setDHTgpio(int gpio);
 void 	errorHandler(int response);
 int 	readDHT();
+int16_t	getHumidityTenths();
+int16_t	getTemperatureTenths();
 float 	getHumidity();
 float 	getTemperature();
-int 	getSignalLevel( int usTimeOut, bool state );
 
 #endif
@@ -0,0 +1,116 @@
+/*
+    Instance-based DHT22 (AM2302) driver
+
+    Each sensor is a dht_handle_t holding its pin, its last good reading and
+    its error counts, so several sensors can be read without the globals of
+    DHT22.h. The line is driven through a dht_bus_t: on the device one of
+    the backends picked in Kconfig (RMT capture or polling), in host tests a
+    simulated one. A bus is not thread safe; read all the sensors on it from
+    one task.
+*/
+
+#ifndef DHT_H_
+#define DHT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DHT22.h"
+#include "dht22_decode.h"
+
+// The sensor needs this long between the starts of two reads
+#define DHT_MIN_INTERVAL_MS 2000
+
+typedef struct {
+    void *context;
+    // Send the start signal on gpio and capture the sensor's answer as
+    // edges in order. Returns the number of edges stored, 0 if the line
+    // never moved.
+    size_t (*read_frame)(void *context, int gpio, Dht22Edge_t *edges, size_t max_edges);
+    // Milliseconds since any fixed point; may wrap
+    uint32_t (*now_ms)(void *context);
+} dht_bus_t;
+
+typedef struct {
+    int gpio;
+    const dht_bus_t *bus;
+    int16_t temperature_tenths;     // Last good reading
+    int16_t humidity_tenths;
+    int last_status;                // DHT_OK or the error of the last attempt
+    bool attempted;                 // last_attempt_ms is valid
+    uint32_t last_attempt_ms;       // When the line was last driven
+    uint32_t last_ok_ms;            // When the last good reading was taken
+    uint32_t reads;                 // Attempts that drove the line
+    uint32_t reads_ok;
+    uint32_t timeouts;              // No or incomplete answer
+    uint32_t checksum_errors;
+} dht_handle_t;
+
+void dht_init(dht_handle_t *dht, int gpio, const dht_bus_t *bus);
+
+// Read the sensor. Returns DHT_OK, DHT_TIMEOUT_ERROR, DHT_CHECKSUM_ERROR,
+// or DHT_TOO_SOON_ERROR, without touching the line, if it was read less
+// than DHT_MIN_INTERVAL_MS ago. The last good reading is
+// kept when a read fails.
+int dht_read(dht_handle_t *dht);
+
+// Current time on the sensor's bus clock
+uint32_t dht_now_ms(const dht_handle_t *dht);
+
+// Milliseconds until dht_read() may drive the line again, 0 if now
+uint32_t dht_ms_until_ready(const dht_handle_t *dht, uint32_t now_ms);
+
+// Age of the last good reading at now_ms; UINT32_MAX if there is none
+uint32_t dht_reading_age_ms(const dht_handle_t *dht, uint32_t now_ms);
+
+// Reads sensors in turn, one every period_ms / count, so each sensor is read
+// once per period_ms and the reads are spread over it rather than bunched.
+// The period is raised to DHT_MIN_INTERVAL_MS if shorter.
+typedef struct {
+    dht_handle_t *sensors;
+    size_t count;
+    uint32_t period_ms;
+    uint32_t slot_ms;               // Time between two reads of any sensors
+    size_t next;                    // Index of the next sensor to read
+    uint32_t next_ms;               // When it is due
+    bool started;
+} dht_schedule_t;
+
+void dht_schedule_init(dht_schedule_t *schedule, dht_handle_t *sensors, size_t count, uint32_t period_ms);
+
+// The sensor to read at now_ms, or NULL with the milliseconds to wait in
+// wait_ms. A sensor is never handed out before its own minimum interval has
+// passed, even after the caller fell behind.
+dht_handle_t *dht_schedule_due(dht_schedule_t *schedule, uint32_t now_ms, uint32_t *wait_ms);
+
+// Bus for the read method chosen in Kconfig
+const dht_bus_t *dht_bus_default(void);
+
+// Simulated sensors for host tests; see dht_bus_sim.c, which is not part of
+// the device build
+typedef struct {
+    int gpio;
+    int16_t temperature_tenths;
+    int16_t humidity_tenths;
+    uint32_t jitter_us;             // Random error on every pulse width
+    uint16_t zero_high_us;          // High time of a 0 bit; 0 for the nominal 27
+    uint16_t one_high_us;           // High time of a 1 bit; 0 for the nominal 70
+    uint16_t drop_permille;         // Chance of each edge being lost
+    bool absent;                    // Never answers
+    uint32_t frames;                // Frames sent
+    uint32_t too_soon;              // Start signals ignored for coming too soon
+    bool started;                   // last_start_ms is valid
+    uint32_t last_start_ms;
+} dht_sim_sensor_t;
+
+typedef struct {
+    dht_sim_sensor_t *sensors;
+    size_t count;
+    uint32_t now_ms;                // Advanced by the test; a read takes 5 ms
+    uint32_t seed;
+} dht_sim_t;
+
+void dht_bus_sim_init(dht_bus_t *bus, dht_sim_t *sim);
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file dht22_decode.h
+ * @brief Decoder for a DHT22 (AM2302) frame captured as edge timestamps.
+ *
+ * After the host start signal the sensor answers with an 80 us low and an
+ * 80 us high, then sends 40 bits, most significant first. Each bit is a
+ * 50 us low followed by a high whose length gives the value: 26-28 us for
+ * 0, 70 us for 1. The 40 bits are humidity (16), temperature (16, sign and
+ * magnitude) and a checksum (8).
+ *
+ * The decoder only looks at timestamps, so it does not care whether they
+ * came from the RMT peripheral, a GPIO edge interrupt or a test. It anchors
+ * on the sensor's 80 us response high, the first high pulse of that length,
+ * and takes exactly the 40 high pulses after it as the bits; anything else
+ * after the anchor, such as a pulse split or merged by a lost edge, is bad
+ * timing. The bit threshold sits half way between the two nominal widths,
+ * which leaves about 20 us of jitter either side.
+ */
+
+#ifndef DHT22_DECODE_H_
+#define DHT22_DECODE_H_
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Bytes of data in a frame: humidity, temperature, checksum.
+ */
+#define DHT22_DATA_BYTES              ( 5U )
+
+/**
+ * @brief Bits in a frame.
+ */
+#define DHT22_DATA_BITS               ( DHT22_DATA_BYTES * 8U )
+
+/**
+ * @brief Range of the sensor's response high pulse, nominally 80 us.
+ */
+#define DHT22_RESPONSE_HIGH_MIN_US    ( 60U )
+#define DHT22_RESPONSE_HIGH_MAX_US    ( 100U )
+
+/**
+ * @brief High pulses longer than this are 1 bits.
+ */
+#define DHT22_BIT_THRESHOLD_US        ( 48U )
+
+/**
+ * @brief Longest high pulse accepted as a bit.
+ */
+#define DHT22_BIT_HIGH_MAX_US         ( 100U )
+
+/**
+ * @brief Edges a full frame produces, start signal included, with some
+ * slack for a stray edge before the response.
+ */
+#define DHT22_MAX_EDGES               ( 2U * DHT22_DATA_BITS + 8U )
+
+typedef struct Dht22Edge
+{
+    uint32_t timeUs; /**< @brief Time of the edge; may wrap. */
+    uint8_t level;   /**< @brief Line level after the edge. */
+} Dht22Edge_t;
+
+typedef enum Dht22DecodeStatus
+{
+    Dht22DecodeSuccess = 0,
+    Dht22DecodeTooFewBits,  /**< @brief No response pulse in the capture. */
+    Dht22DecodeBadTiming,   /**< @brief Not exactly 40 bits of valid width after the response. */
+    Dht22DecodeBadChecksum
+} Dht22DecodeStatus_t;
+
+/**
+ * @brief Decode the 40 bits of a frame.
+ *
+ * @param[in] pEdges Edges in capture order.
+ * @param[out] pData DHT22_DATA_BYTES bytes; filled even when the checksum
+ * does not match.
+ */
+Dht22DecodeStatus_t Dht22_DecodeEdges( const Dht22Edge_t * pEdges,
+                                       size_t edgeCount,
+                                       uint8_t * pData );
+
+/**
+ * @brief Relative humidity in tenths of a percent.
+ */
+int16_t Dht22_HumidityTenths( const uint8_t * pData );
+
+/**
+ * @brief Temperature in tenths of a degree C.
+ */
+int16_t Dht22_TemperatureTenths( const uint8_t * pData );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef DHT22_DECODE_H_ */
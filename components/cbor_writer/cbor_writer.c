@@ -0,0 +1,200 @@
+/**
+ * @file cbor_writer.c
+ * @brief Implementation of the minimal CBOR encoder.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "cbor_writer.h"
+
+/**
+ * @brief CBOR major types, already shifted into the initial byte.
+ */
+#define MAJOR_UINT      ( 0U << 5 )
+#define MAJOR_NEGINT    ( 1U << 5 )
+#define MAJOR_TEXT      ( 3U << 5 )
+#define MAJOR_ARRAY     ( 4U << 5 )
+#define MAJOR_MAP       ( 5U << 5 )
+#define MAJOR_TAG       ( 6U << 5 )
+#define MAJOR_SIMPLE    ( 7U << 5 )
+
+#define SIMPLE_FALSE    ( 20U )
+#define SIMPLE_TRUE     ( 21U )
+#define SIMPLE_NULL     ( 22U )
+
+#define TAG_DECIMAL_FRACTION    ( 4U )
+
+/*-----------------------------------------------------------*/
+
+static void put( CborWriter_t * pWriter,
+                 const uint8_t * pData,
+                 size_t length )
+{
+    if( pWriter->failed || ( length > ( pWriter->size - pWriter->length ) ) )
+    {
+        pWriter->failed = true;
+        return;
+    }
+
+    ( void ) memcpy( &pWriter->pBuffer[ pWriter->length ], pData, length );
+    pWriter->length += length;
+}
+
+/*-----------------------------------------------------------*/
+
+static void putHead( CborWriter_t * pWriter,
+                     uint8_t major,
+                     uint32_t argument )
+{
+    uint8_t head[ 5 ];
+    size_t length;
+
+    /* Shortest form, as required for preferred serialization. */
+    if( argument < 24U )
+    {
+        head[ 0 ] = ( uint8_t ) ( major | argument );
+        length = 1U;
+    }
+    else if( argument <= UINT8_MAX )
+    {
+        head[ 0 ] = ( uint8_t ) ( major | 24U );
+        head[ 1 ] = ( uint8_t ) argument;
+        length = 2U;
+    }
+    else if( argument <= UINT16_MAX )
+    {
+        head[ 0 ] = ( uint8_t ) ( major | 25U );
+        head[ 1 ] = ( uint8_t ) ( argument >> 8 );
+        head[ 2 ] = ( uint8_t ) argument;
+        length = 3U;
+    }
+    else
+    {
+        head[ 0 ] = ( uint8_t ) ( major | 26U );
+        head[ 1 ] = ( uint8_t ) ( argument >> 24 );
+        head[ 2 ] = ( uint8_t ) ( argument >> 16 );
+        head[ 3 ] = ( uint8_t ) ( argument >> 8 );
+        head[ 4 ] = ( uint8_t ) argument;
+        length = 5U;
+    }
+
+    put( pWriter, head, length );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Init( CborWriter_t * pWriter,
+                      uint8_t * pBuffer,
+                      size_t size )
+{
+    assert( pWriter != NULL );
+    assert( pBuffer != NULL );
+
+    ( void ) memset( pWriter, 0x00, sizeof( CborWriter_t ) );
+    pWriter->pBuffer = pBuffer;
+    pWriter->size = size;
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Resume( CborWriter_t * pWriter,
+                        uint8_t * pBuffer,
+                        size_t size,
+                        size_t length )
+{
+    CborWriter_Init( pWriter, pBuffer, size );
+    pWriter->length = length;
+    pWriter->failed = ( length > size );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Map( CborWriter_t * pWriter,
+                     uint32_t pairs )
+{
+    putHead( pWriter, MAJOR_MAP, pairs );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Array( CborWriter_t * pWriter,
+                       uint32_t items )
+{
+    putHead( pWriter, MAJOR_ARRAY, items );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Text( CborWriter_t * pWriter,
+                      const char * pText )
+{
+    size_t length;
+
+    assert( pText != NULL );
+
+    length = strlen( pText );
+    putHead( pWriter, MAJOR_TEXT, ( uint32_t ) length );
+    put( pWriter, ( const uint8_t * ) pText, length );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Uint( CborWriter_t * pWriter,
+                      uint32_t value )
+{
+    putHead( pWriter, MAJOR_UINT, value );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Int( CborWriter_t * pWriter,
+                     int32_t value )
+{
+    if( value < 0 )
+    {
+        /* Negative integers are encoded as -1 - n. */
+        putHead( pWriter, MAJOR_NEGINT, ( uint32_t ) ( -( value + 1 ) ) );
+    }
+    else
+    {
+        putHead( pWriter, MAJOR_UINT, ( uint32_t ) value );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Decimal( CborWriter_t * pWriter,
+                         int32_t mantissa,
+                         int8_t exponent )
+{
+    putHead( pWriter, MAJOR_TAG, TAG_DECIMAL_FRACTION );
+    putHead( pWriter, MAJOR_ARRAY, 2U );
+    CborWriter_Int( pWriter, exponent );
+    CborWriter_Int( pWriter, mantissa );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Bool( CborWriter_t * pWriter,
+                      bool value )
+{
+    putHead( pWriter, MAJOR_SIMPLE, value ? SIMPLE_TRUE : SIMPLE_FALSE );
+}
+
+/*-----------------------------------------------------------*/
+
+void CborWriter_Null( CborWriter_t * pWriter )
+{
+    putHead( pWriter, MAJOR_SIMPLE, SIMPLE_NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t CborWriter_Finish( CborWriter_t * pWriter )
+{
+    assert( pWriter != NULL );
+
+    return pWriter->failed ? -1 : ( int32_t ) pWriter->length;
+}
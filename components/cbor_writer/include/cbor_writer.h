@@ -0,0 +1,88 @@
+/**
+ * @file cbor_writer.h
+ * @brief Minimal CBOR (RFC 8949) encoder into a caller-provided buffer.
+ *
+ * Only definite-length maps and arrays are produced, so the caller states
+ * the number of entries up front. Like the JSON writer it never allocates
+ * and reports an overflow once, from CborWriter_Finish().
+ */
+
+#ifndef CBOR_WRITER_H_
+#define CBOR_WRITER_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+typedef struct CborWriter
+{
+    uint8_t * pBuffer;
+    size_t size;
+    size_t length;
+    bool failed;
+} CborWriter_t;
+
+void CborWriter_Init( CborWriter_t * pWriter,
+                      uint8_t * pBuffer,
+                      size_t size );
+
+/**
+ * @brief Continue encoding after the first length bytes of pBuffer, which
+ * already hold the start of the item, e.g. a constant prefix.
+ */
+void CborWriter_Resume( CborWriter_t * pWriter,
+                        uint8_t * pBuffer,
+                        size_t size,
+                        size_t length );
+
+/**
+ * @brief Start a map of pairs key/value pairs. Each pair is written as two
+ * items, typically CborWriter_Text() followed by the value.
+ */
+void CborWriter_Map( CborWriter_t * pWriter,
+                     uint32_t pairs );
+
+void CborWriter_Array( CborWriter_t * pWriter,
+                       uint32_t items );
+
+void CborWriter_Text( CborWriter_t * pWriter,
+                      const char * pText );
+
+void CborWriter_Uint( CborWriter_t * pWriter,
+                      uint32_t value );
+
+void CborWriter_Int( CborWriter_t * pWriter,
+                     int32_t value );
+
+/**
+ * @brief Write mantissa * 10^exponent as a decimal fraction (tag 4), which
+ * keeps values such as 23.4 exact, e.g. (234, -1).
+ */
+void CborWriter_Decimal( CborWriter_t * pWriter,
+                         int32_t mantissa,
+                         int8_t exponent );
+
+void CborWriter_Bool( CborWriter_t * pWriter,
+                      bool value );
+
+void CborWriter_Null( CborWriter_t * pWriter );
+
+/**
+ * @return Length of the encoded data, or -1 if it did not fit.
+ */
+int32_t CborWriter_Finish( CborWriter_t * pWriter );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CBOR_WRITER_H_ */
@@ -1,11 +1,287 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_tls.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/ssl.h"
 #include "network_transport.h"
 #include "sdkconfig.h"
 
-TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
+static const char *TAG = "network_transport";
+
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+#define STATS_TIMESTAMP( xName )                                     const int64_t xName = esp_timer_get_time()
+#define STATS_RECORD_SEND( pxCtx, xStartUs, uxRequested, lResult )   prvRecordSend( pxCtx, xStartUs, uxRequested, lResult )
+#define STATS_RECORD_RECV( pxCtx, xStartUs, uxRequested, lResult )   prvRecordRecv( pxCtx, xStartUs, uxRequested, lResult )
+#define STATS_RECORD_CONNECT( pxCtx, xStartUs, xStatus )             prvRecordConnect( pxCtx, xStartUs, xStatus )
+
+static void prvRecordLatency( TlsTransportLatency_t* pxLatency, int64_t xStartUs )
+{
+    uint32_t ulUs = ( uint32_t ) ( esp_timer_get_time() - xStartUs );
+    uint32_t ulBucket = ( ulUs < 2 ) ? 0 : ( 31 - __builtin_clz( ulUs ) );
+
+    if (ulBucket >= TLS_TRANSPORT_LATENCY_BUCKETS)
+    {
+        ulBucket = TLS_TRANSPORT_LATENCY_BUCKETS - 1;
+    }
+    if (pxLatency->usBuckets[ ulBucket ] != UINT16_MAX)
+    {
+        pxLatency->usBuckets[ ulBucket ]++;
+    }
+    if (ulUs > pxLatency->ulMaxUs)
+    {
+        pxLatency->ulMaxUs = ulUs;
+    }
+    pxLatency->ulCount++;
+    pxLatency->ullTotalUs += ulUs;
+}
+
+static void prvRecordSend( NetworkContext_t* pxNetworkContext, int64_t xStartUs,
+    size_t uxRequested, int32_t lResult )
+{
+    TlsTransportStats_t* pxStats = &pxNetworkContext->xStats;
+
+    prvRecordLatency( &pxStats->xSendLatency, xStartUs );
+    pxStats->ulSendCalls++;
+    if (lResult < 0)
+    {
+        pxStats->ulSendErrors++;
+    }
+    else
+    {
+        pxStats->ulBytesSent += ( uint32_t ) lResult;
+        if (( size_t ) lResult < uxRequested)
+        {
+            pxStats->ulSendPartial++;
+        }
+    }
+}
+
+static void prvRecordRecv( NetworkContext_t* pxNetworkContext, int64_t xStartUs,
+    size_t uxRequested, int32_t lResult )
+{
+    TlsTransportStats_t* pxStats = &pxNetworkContext->xStats;
+
+    prvRecordLatency( &pxStats->xRecvLatency, xStartUs );
+    pxStats->ulRecvCalls++;
+    if (lResult == ESP_TLS_ERR_SSL_WANT_WRITE || lResult == ESP_TLS_ERR_SSL_WANT_READ)
+    {
+        pxStats->ulRecvWantRead++;
+    }
+    else if (lResult <= 0)
+    {
+        pxStats->ulRecvErrors++;
+    }
+    else
+    {
+        pxStats->ulBytesReceived += ( uint32_t ) lResult;
+        if (( size_t ) lResult < uxRequested)
+        {
+            pxStats->ulRecvPartial++;
+        }
+    }
+}
+
+static void prvRecordConnect( NetworkContext_t* pxNetworkContext, int64_t xStartUs,
+    TlsTransportStatus_t xStatus )
+{
+    xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
+    prvRecordLatency( &pxNetworkContext->xStats.xConnectLatency, xStartUs );
+    if (xStatus == TLS_TRANSPORT_SUCCESS)
+    {
+        pxNetworkContext->xStats.ulConnects++;
+    }
+    else
+    {
+        pxNetworkContext->xStats.ulConnectFailures++;
+    }
+    xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
+}
+
+#else
+
+#define STATS_TIMESTAMP( xName )
+#define STATS_RECORD_SEND( pxCtx, xStartUs, uxRequested, lResult )
+#define STATS_RECORD_RECV( pxCtx, xStartUs, uxRequested, lResult )
+#define STATS_RECORD_CONNECT( pxCtx, xStartUs, xStatus )
+
+#endif /* CONFIG_CORE_MQTT_TRANSPORT_STATS */
+
+/* Suites mbedtls was built without are left out of the ClientHello. */
+const int pxTlsEcdheEcdsaCipherSuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    0
+};
+
+#if defined( MBEDTLS_ECP_C )
+
+/* mbedtls fails the handshake on a curve it was built without, so each one
+ * is listed only if enabled. After P-256 the order is that of
+ * mbedtls_ecp_grp_id_list(), the default list. */
+const mbedtls_ecp_group_id pxTlsP256Curves[] = {
+#if defined( MBEDTLS_ECP_DP_SECP256R1_ENABLED )
+    MBEDTLS_ECP_DP_SECP256R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP521R1_ENABLED )
+    MBEDTLS_ECP_DP_SECP521R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_BP512R1_ENABLED )
+    MBEDTLS_ECP_DP_BP512R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP384R1_ENABLED )
+    MBEDTLS_ECP_DP_SECP384R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_BP384R1_ENABLED )
+    MBEDTLS_ECP_DP_BP384R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP256K1_ENABLED )
+    MBEDTLS_ECP_DP_SECP256K1,
+#endif
+#if defined( MBEDTLS_ECP_DP_BP256R1_ENABLED )
+    MBEDTLS_ECP_DP_BP256R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP224R1_ENABLED )
+    MBEDTLS_ECP_DP_SECP224R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP224K1_ENABLED )
+    MBEDTLS_ECP_DP_SECP224K1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP192R1_ENABLED )
+    MBEDTLS_ECP_DP_SECP192R1,
+#endif
+#if defined( MBEDTLS_ECP_DP_SECP192K1_ENABLED )
+    MBEDTLS_ECP_DP_SECP192K1,
+#endif
+#if defined( MBEDTLS_ECP_DP_CURVE25519_ENABLED )
+    MBEDTLS_ECP_DP_CURVE25519,
+#endif
+#if defined( MBEDTLS_ECP_DP_CURVE448_ENABLED )
+    MBEDTLS_ECP_DP_CURVE448,
+#endif
+    MBEDTLS_ECP_DP_NONE
+};
+
+#endif /* MBEDTLS_ECP_C */
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+
+/* esp-tls has no per-connection hook into the mbedtls configuration, but it
+ * passes the configuration to the certificate bundle attach callback right
+ * before mbedtls_ssl_setup(). The callback takes no user argument, so the
+ * context being connected is published here while xConfigureSslMutex is held. */
+static NetworkContext_t* pxConfiguringContext = NULL;
+static bool xConfiguringFragmentLength = false;
+static SemaphoreHandle_t xConfigureSslMutex = NULL;
+static StaticSemaphore_t xConfigureSslMutexBuffer;
+static portMUX_TYPE xConfigureSslMutexInitLock = portMUX_INITIALIZER_UNLOCKED;
+
+static unsigned char prvMaxFragmentLengthCode( uint16_t usMaxFragmentLength )
+{
+    switch( usMaxFragmentLength )
+    {
+        case 512:
+            return MBEDTLS_SSL_MAX_FRAG_LEN_512;
+        case 1024:
+            return MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+        case 2048:
+            return MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+        case 4096:
+            return MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+        default:
+            return MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+    }
+}
+
+static esp_err_t prvConfigureSsl( void* pvConf )
+{
+    mbedtls_ssl_config* pxConf = ( mbedtls_ssl_config* ) pvConf;
+    NetworkContext_t* pxNetworkContext = pxConfiguringContext;
+    int lRet;
+
+    /* Using the bundle callback makes esp-tls skip cacert_buf, so the server
+     * root CA has to be installed here. */
+    mbedtls_x509_crt_init( &pxNetworkContext->xServerRootCA );
+    lRet = mbedtls_x509_crt_parse( &pxNetworkContext->xServerRootCA,
+        ( const unsigned char* ) pxNetworkContext->pcServerRootCAPem,
+        strlen( pxNetworkContext->pcServerRootCAPem ) + 1 );
+    if (lRet != 0)
+    {
+        ESP_LOGE(TAG, "Failed to parse server root CA: -0x%x", -lRet);
+        return ESP_ERR_INVALID_ARG;
+    }
+    mbedtls_ssl_conf_ca_chain( pxConf, &pxNetworkContext->xServerRootCA, NULL );
+
+    if (pxNetworkContext->pxCipherSuites != NULL)
+    {
+        mbedtls_ssl_conf_ciphersuites( pxConf, pxNetworkContext->pxCipherSuites );
+    }
+    if (pxNetworkContext->pxCurves != NULL)
+    {
+        mbedtls_ssl_conf_curves( pxConf, pxNetworkContext->pxCurves );
+    }
+
+    if (xConfiguringFragmentLength && pxNetworkContext->usMaxFragmentLength != 0)
+    {
+        unsigned char ucCode = prvMaxFragmentLengthCode( pxNetworkContext->usMaxFragmentLength );
+        if (ucCode == MBEDTLS_SSL_MAX_FRAG_LEN_NONE ||
+            mbedtls_ssl_conf_max_frag_len( pxConf, ucCode ) != 0)
+        {
+            ESP_LOGW(TAG, "Unsupported maximum fragment length %u",
+                pxNetworkContext->usMaxFragmentLength);
+        }
+    }
+
+    return ESP_OK;
+}
+
+static void prvTakeConfigureSslMutex( NetworkContext_t* pxNetworkContext,
+    bool xRequestFragmentLength )
+{
+    portENTER_CRITICAL(&xConfigureSslMutexInitLock);
+    if (xConfigureSslMutex == NULL)
+    {
+        xConfigureSslMutex = xSemaphoreCreateMutexStatic(&xConfigureSslMutexBuffer);
+    }
+    portEXIT_CRITICAL(&xConfigureSslMutexInitLock);
+
+    xSemaphoreTake(xConfigureSslMutex, portMAX_DELAY);
+    pxConfiguringContext = pxNetworkContext;
+    xConfiguringFragmentLength = xRequestFragmentLength;
+}
+
+static void prvGiveConfigureSslMutex( void )
+{
+    pxConfiguringContext = NULL;
+    xSemaphoreGive(xConfigureSslMutex);
+}
+
+#endif /* CONFIG_MBEDTLS_CERTIFICATE_BUNDLE */
+
+static void prvDestroyTls( NetworkContext_t* pxNetworkContext, BaseType_t* pxDestroyFailed )
+{
+    if (pxNetworkContext->pxTls != NULL &&
+        esp_tls_conn_destroy(pxNetworkContext->pxTls) < 0 &&
+        pxDestroyFailed != NULL)
+    {
+        *pxDestroyFailed = pdTRUE;
+    }
+    pxNetworkContext->pxTls = NULL;
+    pxNetworkContext->usNegotiatedFragmentLength = 0;
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    mbedtls_x509_crt_free( &pxNetworkContext->xServerRootCA );
+#endif
+}
+
+static TlsTransportStatus_t prvTlsConnect( NetworkContext_t* pxNetworkContext,
+    bool xRequestFragmentLength )
 {
     TlsTransportStatus_t xRet = TLS_TRANSPORT_SUCCESS;
 
@@ -29,6 +305,24 @@ TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
         .timeout_ms = 3000,
     };
 
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    const bool xConfigureSsl = xRequestFragmentLength ||
+        pxNetworkContext->pxCipherSuites != NULL ||
+        pxNetworkContext->pxCurves != NULL;
+
+    if (xConfigureSsl)
+    {
+        xEspTlsConfig.crt_bundle_attach = prvConfigureSsl;
+        prvTakeConfigureSslMutex( pxNetworkContext, xRequestFragmentLength );
+    }
+#else
+    if (xRequestFragmentLength || pxNetworkContext->pxCipherSuites != NULL ||
+        pxNetworkContext->pxCurves != NULL)
+    {
+        ESP_LOGW(TAG, "Fragment length and cipher suite settings need CONFIG_MBEDTLS_CERTIFICATE_BUNDLE, ignoring them");
+    }
+#endif
+
     esp_tls_t* pxTls = esp_tls_init();
 
     xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
@@ -39,31 +333,129 @@ TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
             pxNetworkContext->xPort, 
             &xEspTlsConfig, pxTls) <= 0)
     {
-        if (pxNetworkContext->pxTls)
+        /* Tell a failed handshake over a connected socket apart from DNS,
+         * TCP and timeout failures, which the TLS settings cannot cause. */
+        int lMbedtlsError = 0;
+        esp_err_t xError = ( pxTls != NULL ) ?
+            esp_tls_get_and_clear_last_error( pxTls->error_handle, &lMbedtlsError, NULL ) : ESP_FAIL;
+
+        prvDestroyTls( pxNetworkContext, NULL );
+        if (xError == ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED)
         {
-            esp_tls_conn_destroy(pxNetworkContext->pxTls);
-            pxNetworkContext->pxTls = NULL;
+            ESP_LOGW(TAG, "TLS handshake failed: -0x%x", -lMbedtlsError);
+            pxNetworkContext->lHandshakeError = lMbedtlsError;
+            xRet = TLS_TRANSPORT_HANDSHAKE_FAILED;
+        }
+        else
+        {
+            xRet = TLS_TRANSPORT_CONNECT_FAILURE;
         }
-        xRet = TLS_TRANSPORT_CONNECT_FAILURE;
+    }
+    else
+    {
+        const mbedtls_ssl_context* pxSsl = esp_tls_get_ssl_context( pxTls );
+        pxNetworkContext->usNegotiatedFragmentLength =
+            ( uint16_t ) mbedtls_ssl_get_input_max_frag_len( pxSsl );
     }
 
     xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
 
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    if (xConfigureSsl)
+    {
+        prvGiveConfigureSslMutex();
+    }
+#endif
+
+    return xRet;
+}
+
+/* Whether a failed handshake may have been the server refusing the Maximum
+ * Fragment Length extension. Certificate and key errors would fail the same
+ * way without it. */
+static bool prvMaybeFragmentLengthRejected( int lMbedtlsError )
+{
+    switch( lMbedtlsError )
+    {
+        case MBEDTLS_ERR_X509_CERT_VERIFY_FAILED:
+        case MBEDTLS_ERR_SSL_CA_CHAIN_REQUIRED:
+        case MBEDTLS_ERR_SSL_PRIVATE_KEY_REQUIRED:
+        case MBEDTLS_ERR_SSL_NO_CLIENT_CERTIFICATE:
+        case MBEDTLS_ERR_SSL_PEER_VERIFY_FAILED:
+            return false;
+        default:
+            return true;
+    }
+}
+
+TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
+{
+    TlsTransportStatus_t xRet;
+    uint32_t ulFreeHeapBefore = esp_get_free_heap_size();
+    uint32_t ulMinFreeHeapBefore = esp_get_minimum_free_heap_size();
+    uint32_t ulMinFreeHeapAfter;
+    bool xNewLow;
+    int64_t xHandshakeStartUs;
+    STATS_TIMESTAMP( xStartUs );
+
+    xHandshakeStartUs = esp_timer_get_time();
+    pxNetworkContext->lHandshakeError = 0;
+    xRet = prvTlsConnect( pxNetworkContext, pxNetworkContext->usMaxFragmentLength != 0 );
+
+    if (xRet == TLS_TRANSPORT_HANDSHAKE_FAILED && pxNetworkContext->usMaxFragmentLength != 0 &&
+        prvMaybeFragmentLengthRejected( pxNetworkContext->lHandshakeError ))
+    {
+        /* Some servers abort the handshake on an extension they do not
+         * implement instead of ignoring it. The TCP connection was made, so
+         * it is worth one more handshake without the extension. */
+        ESP_LOGW(TAG, "TLS handshake requesting %u byte fragments failed, retrying without it",
+            pxNetworkContext->usMaxFragmentLength);
+        xHandshakeStartUs = esp_timer_get_time();
+        xRet = prvTlsConnect( pxNetworkContext, false );
+    }
+
+    /* The heap low-water mark only ever goes down, so it tells the peak use
+     * of this connect only if the connect set a new one. */
+    ulMinFreeHeapAfter = esp_get_minimum_free_heap_size();
+    xNewLow = ( ulMinFreeHeapAfter < ulMinFreeHeapBefore );
+
+    if (xRet == TLS_TRANSPORT_SUCCESS)
+    {
+        if (pxNetworkContext->usMaxFragmentLength != 0 &&
+            pxNetworkContext->usNegotiatedFragmentLength > pxNetworkContext->usMaxFragmentLength)
+        {
+            ESP_LOGW(TAG, "Server did not accept a %u byte maximum fragment length",
+                pxNetworkContext->usMaxFragmentLength);
+        }
+        pxNetworkContext->ulHandshakeUs = ( uint32_t ) ( esp_timer_get_time() - xHandshakeStartUs );
+        ESP_LOGI(TAG, "TLS session %s in %" PRIu32 " ms, %u byte records, %" PRIu32 " bytes of heap held, "
+            "peak %s%" PRIu32 " bytes",
+            mbedtls_ssl_get_ciphersuite( esp_tls_get_ssl_context( pxNetworkContext->pxTls ) ),
+            pxNetworkContext->ulHandshakeUs / 1000,
+            pxNetworkContext->usNegotiatedFragmentLength,
+            ulFreeHeapBefore - esp_get_free_heap_size(),
+            xNewLow ? "" : "at most ",
+            ulFreeHeapBefore - ( xNewLow ? ulMinFreeHeapAfter : ulMinFreeHeapBefore ));
+    }
+
+    STATS_RECORD_CONNECT( pxNetworkContext, xStartUs, xRet );
+
     return xRet;
 }
 
 TlsTransportStatus_t xTlsDisconnect( NetworkContext_t* pxNetworkContext )
 {
     BaseType_t xRet = TLS_TRANSPORT_SUCCESS;
+    BaseType_t xDestroyFailed = pdFALSE;
 
     xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
-    if (pxNetworkContext->pxTls != NULL && 
-        esp_tls_conn_destroy(pxNetworkContext->pxTls) < 0)
+    prvDestroyTls( pxNetworkContext, &xDestroyFailed );
+    xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
+
+    if (xDestroyFailed)
     {
         xRet = TLS_TRANSPORT_DISCONNECT_FAILURE;
     }
-    pxNetworkContext->pxTls = NULL;
-    xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
 
     return xRet;
 }
@@ -81,7 +473,9 @@ int32_t espTlsTransportSend(NetworkContext_t* pxNetworkContext,
     if(pxNetworkContext != NULL && pxNetworkContext->pxTls != NULL)
     {
         xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
+        STATS_TIMESTAMP( xStartUs );
         lBytesSent = esp_tls_conn_write(pxNetworkContext->pxTls, pvData, uxDataLen);
+        STATS_RECORD_SEND( pxNetworkContext, xStartUs, uxDataLen, lBytesSent );
         xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
     }
     else
@@ -103,7 +497,9 @@ int32_t espTlsTransportRecv(NetworkContext_t* pxNetworkContext,
     if(pxNetworkContext != NULL && pxNetworkContext->pxTls != NULL)
     {
         xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
+        STATS_TIMESTAMP( xStartUs );
         lBytesRead = esp_tls_conn_read(pxNetworkContext->pxTls, pvData, uxDataLen);
+        STATS_RECORD_RECV( pxNetworkContext, xStartUs, uxDataLen, lBytesRead );
         xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
     }
     else
@@ -122,3 +518,108 @@ int32_t espTlsTransportRecv(NetworkContext_t* pxNetworkContext,
     }
     return lBytesRead;
 }
+
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+void vTlsTransportGetStats( NetworkContext_t* pxNetworkContext,
+    TlsTransportStats_t* pxSnapshot, bool xReset )
+{
+    xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
+    *pxSnapshot = pxNetworkContext->xStats;
+    if (xReset)
+    {
+        memset(&pxNetworkContext->xStats, 0, sizeof(pxNetworkContext->xStats));
+    }
+    xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
+}
+
+static int32_t prvFormatLatency( const char* pcName, const TlsTransportLatency_t* pxLatency,
+    char* pcBuffer, size_t uxBufferLen )
+{
+    int32_t lLastBucket = TLS_TRANSPORT_LATENCY_BUCKETS - 1;
+    size_t uxLen;
+    int lRet;
+
+    /* Trailing empty buckets are left out to keep the payload short. */
+    while (lLastBucket >= 0 && pxLatency->usBuckets[ lLastBucket ] == 0)
+    {
+        lLastBucket--;
+    }
+
+    lRet = snprintf(pcBuffer, uxBufferLen, "\"%s\":{\"count\":%" PRIu32 ",\"max_us\":%" PRIu32 ",\"avg_us\":%" PRIu32 ",\"log2_us\":[",
+        pcName, pxLatency->ulCount, pxLatency->ulMaxUs,
+        pxLatency->ulCount ? ( uint32_t ) ( pxLatency->ullTotalUs / pxLatency->ulCount ) : 0);
+    if (lRet < 0 || ( size_t ) lRet >= uxBufferLen)
+    {
+        return -1;
+    }
+    uxLen = lRet;
+
+    for (int32_t i = 0; i <= lLastBucket; i++)
+    {
+        lRet = snprintf(pcBuffer + uxLen, uxBufferLen - uxLen, i ? ",%u" : "%u",
+            pxLatency->usBuckets[ i ]);
+        if (lRet < 0 || ( size_t ) lRet >= uxBufferLen - uxLen)
+        {
+            return -1;
+        }
+        uxLen += lRet;
+    }
+
+    lRet = snprintf(pcBuffer + uxLen, uxBufferLen - uxLen, "]}");
+    if (lRet < 0 || ( size_t ) lRet >= uxBufferLen - uxLen)
+    {
+        return -1;
+    }
+
+    return uxLen + lRet;
+}
+
+int32_t lTlsTransportFormatStats( const TlsTransportStats_t* pxStats,
+    char* pcBuffer, size_t uxBufferLen )
+{
+    size_t uxLen;
+    int32_t lRet;
+
+    lRet = snprintf(pcBuffer, uxBufferLen,
+        "{\"send\":{\"calls\":%" PRIu32 ",\"partial\":%" PRIu32 ",\"errors\":%" PRIu32 ",\"bytes\":%" PRIu32 "},"
+        "\"recv\":{\"calls\":%" PRIu32 ",\"want_read\":%" PRIu32 ",\"partial\":%" PRIu32 ",\"errors\":%" PRIu32 ",\"bytes\":%" PRIu32 "},"
+        "\"connect\":{\"ok\":%" PRIu32 ",\"failed\":%" PRIu32 "},",
+        pxStats->ulSendCalls, pxStats->ulSendPartial, pxStats->ulSendErrors, pxStats->ulBytesSent,
+        pxStats->ulRecvCalls, pxStats->ulRecvWantRead, pxStats->ulRecvPartial, pxStats->ulRecvErrors,
+        pxStats->ulBytesReceived, pxStats->ulConnects, pxStats->ulConnectFailures);
+    if (lRet < 0 || ( size_t ) lRet >= uxBufferLen)
+    {
+        return -1;
+    }
+    uxLen = lRet;
+
+    lRet = prvFormatLatency("send_latency", &pxStats->xSendLatency, pcBuffer + uxLen, uxBufferLen - uxLen);
+    if (lRet < 0 || ( size_t ) lRet + 1 >= uxBufferLen - uxLen)
+    {
+        return -1;
+    }
+    uxLen += lRet;
+    pcBuffer[ uxLen++ ] = ',';
+
+    lRet = prvFormatLatency("recv_latency", &pxStats->xRecvLatency, pcBuffer + uxLen, uxBufferLen - uxLen);
+    if (lRet < 0 || ( size_t ) lRet + 1 >= uxBufferLen - uxLen)
+    {
+        return -1;
+    }
+    uxLen += lRet;
+    pcBuffer[ uxLen++ ] = ',';
+
+    lRet = prvFormatLatency("connect_latency", &pxStats->xConnectLatency, pcBuffer + uxLen, uxBufferLen - uxLen);
+    if (lRet < 0 || ( size_t ) lRet + 1 >= uxBufferLen - uxLen)
+    {
+        return -1;
+    }
+    uxLen += lRet;
+    pcBuffer[ uxLen++ ] = '}';
+    pcBuffer[ uxLen ] = '\0';
+
+    return uxLen;
+}
+
+#endif /* CONFIG_CORE_MQTT_TRANSPORT_STATS */
@@ -5,6 +5,9 @@
 #include "freertos/semphr.h"
 #include "transport_interface.h"
 #include "esp_tls.h"
+#include "sdkconfig.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/x509_crt.h"
 
 typedef enum TlsTransportStatus
 {
@@ -19,6 +22,47 @@ typedef enum TlsTransportStatus
     TLS_TRANSPORT_DISCONNECT_FAILURE = -8   /**< Failed to disconnect from server. */
 } TlsTransportStatus_t;
 
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+/**
+* @brief Number of latency histogram buckets. Bucket 0 counts calls that took
+* less than 2 us, bucket i counts [2^i, 2^(i+1)) us and the last bucket also
+* takes everything slower (2^22 us, about 4.2 s, and up).
+*/
+#define TLS_TRANSPORT_LATENCY_BUCKETS    23
+
+typedef struct TlsTransportLatency
+{
+    uint32_t ulCount;                                       /**< @brief Calls recorded. */
+    uint32_t ulMaxUs;                                       /**< @brief Slowest call. */
+    uint64_t ullTotalUs;                                    /**< @brief Sum of all call durations. */
+    uint16_t usBuckets[ TLS_TRANSPORT_LATENCY_BUCKETS ];    /**< @brief Saturating log2 buckets. */
+} TlsTransportLatency_t;
+
+/**
+* @brief Per-connection transport counters, kept in the NetworkContext_t when
+* CONFIG_CORE_MQTT_TRANSPORT_STATS is enabled.
+*/
+typedef struct TlsTransportStats
+{
+    uint32_t ulSendCalls;
+    uint32_t ulSendPartial;         /**< @brief Writes that took fewer bytes than offered. */
+    uint32_t ulSendErrors;
+    uint32_t ulBytesSent;
+    uint32_t ulRecvCalls;
+    uint32_t ulRecvWantRead;        /**< @brief Reads that returned 0 on WANT_READ/WANT_WRITE. */
+    uint32_t ulRecvPartial;         /**< @brief Reads that returned fewer bytes than asked for. */
+    uint32_t ulRecvErrors;
+    uint32_t ulBytesReceived;
+    uint32_t ulConnects;
+    uint32_t ulConnectFailures;
+    TlsTransportLatency_t xSendLatency;
+    TlsTransportLatency_t xRecvLatency;
+    TlsTransportLatency_t xConnectLatency;
+} TlsTransportStats_t;
+
+#endif /* CONFIG_CORE_MQTT_TRANSPORT_STATS */
+
 struct NetworkContext
 {
     SemaphoreHandle_t xTlsContextSemaphore;
@@ -46,8 +90,82 @@ struct NetworkContext
     * @brief Disable server name indication (SNI) for a TLS session.
     */
     BaseType_t disableSni;
+
+    /**
+    * @brief Maximum TLS record payload to request from the server with the
+    * Maximum Fragment Length extension (RFC 6066).
+    *
+    * Valid values are 512, 1024, 2048 and 4096. Set to 0 to leave the
+    * extension out of the ClientHello. If the server aborts the handshake
+    * over it, the handshake is tried once more without it; if the server
+    * ignores it, full-size records are used.
+    */
+    uint16_t usMaxFragmentLength;
+
+    /**
+    * @brief Incoming record payload limit in effect for the current session.
+    * Written by xTlsConnect(); 0 while disconnected.
+    */
+    uint16_t usNegotiatedFragmentLength;
+
+    /**
+    * @brief Cipher suites to offer, as a 0-terminated list of mbedtls
+    * ciphersuite ids in decreasing order of preference. NULL keeps the
+    * mbedtls default order. The list must stay valid while connected.
+    *
+    * pxTlsEcdheEcdsaCipherSuites puts ECDHE-ECDSA first, which together with
+    * a P-256 client key is several times cheaper to handshake than RSA-2048.
+    */
+    const int *pxCipherSuites;
+
+    /**
+    * @brief Curves to offer for ECDHE, terminated by MBEDTLS_ECP_DP_NONE.
+    * NULL keeps the mbedtls default list. Must stay valid while connected.
+    */
+    const mbedtls_ecp_group_id *pxCurves;
+
+    /**
+    * @brief Duration of the last successful TCP connect and TLS handshake in
+    * microseconds. Written by xTlsConnect().
+    */
+    uint32_t ulHandshakeUs;
+
+    /**
+    * @brief mbedtls error of the last failed TLS handshake over a connected
+    * socket, or 0. Written by xTlsConnect().
+    */
+    int lHandshakeError;
+
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+    TlsTransportStats_t xStats;      /**< @brief Updated under xTlsContextSemaphore. */
+#endif
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    /**
+    * @brief Parsed server root CA. Only used when the SSL configuration has
+    * to be adjusted before the handshake (e.g. to request a fragment length).
+    */
+    mbedtls_x509_crt xServerRootCA;
+#endif
 };
 
+/**
+* @brief ECDHE-ECDSA suites first, then ECDHE-RSA for brokers that only have
+* an RSA certificate. For NetworkContext_t::pxCipherSuites.
+*/
+extern const int pxTlsEcdheEcdsaCipherSuites[];
+
+#if defined( MBEDTLS_ECP_C )
+
+/**
+* @brief P-256 first, then the other curves mbedtls was built with in its
+* default order, so brokers without P-256 still connect. For
+* NetworkContext_t::pxCurves.
+*/
+extern const mbedtls_ecp_group_id pxTlsP256Curves[];
+
+#endif /* MBEDTLS_ECP_C */
+
 TlsTransportStatus_t xTlsConnect(NetworkContext_t* pxNetworkContext );
 
 TlsTransportStatus_t xTlsDisconnect( NetworkContext_t* pxNetworkContext );
@@ -58,4 +176,23 @@ int32_t espTlsTransportSend( NetworkContext_t* pxNetworkContext,
 int32_t espTlsTransportRecv( NetworkContext_t* pxNetworkContext,
     void* pvData, size_t uxDataLen );
 
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+/**
+* @brief Copy the statistics of a network context, optionally clearing them.
+*/
+void vTlsTransportGetStats( NetworkContext_t* pxNetworkContext,
+    TlsTransportStats_t* pxSnapshot, bool xReset );
+
+/**
+* @brief Render a statistics snapshot as a JSON object.
+*
+* @return Number of characters written, excluding the terminator, or -1 if
+* the buffer is too small.
+*/
+int32_t lTlsTransportFormatStats( const TlsTransportStats_t* pxStats,
+    char* pcBuffer, size_t uxBufferLen );
+
+#endif /* CONFIG_CORE_MQTT_TRANSPORT_STATS */
+
 #endif /* ESP_TLS_TRANSPORT_H */
\ No newline at end of file
@@ -0,0 +1,192 @@
+/*
+    Phase-angle dimmer core; see dimmer_core.h.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "dimmer_core.h"
+
+// Half-cycles shorter than this are taken for 60 Hz mains, in 1/256 us
+#define DIMMER_60HZ_BELOW_Q8 ((1000000u << 8) / (2 * 55))
+
+bool dimmer_core_init(dimmer_t *dimmer, const dimmer_hal_t *hal, uint8_t channels)
+{
+    if (channels == 0 || channels > DIMMER_CHANNELS_MAX) {
+        return false;
+    }
+    memset(dimmer, 0, sizeof(*dimmer));
+    dimmer->hal = *hal;
+    zc_pll_init(&dimmer->pll);
+    dimmer->delay_us = dimmer_delay_50hz_us;
+    dimmer->channels = channels;
+    dimmer->all_mask = (uint8_t) ((1u << channels) - 1);
+    return true;
+}
+
+// Picks the delay table for a measured half-cycle, in 1/256 us, and
+// returns the factor, in 1/65536, that scales the table to it
+static uint32_t DIMMER_ISR_ATTR delay_table(uint32_t half_q8, const uint16_t **table)
+{
+    if (half_q8 < DIMMER_60HZ_BELOW_Q8) {
+        *table = dimmer_delay_60hz_us;
+        return (half_q8 << 8) / 8333;
+    }
+    *table = dimmer_delay_50hz_us;
+    return (half_q8 << 8) / 10000;
+}
+
+static uint32_t DIMMER_ISR_ATTR scaled(uint32_t delay_us, uint32_t scale)
+{
+    return (delay_us * scale + 0x8000) >> 16;
+}
+
+uint32_t dimmer_core_delay_us(const dimmer_t *dimmer, uint16_t power)
+{
+    const uint16_t *table;
+    uint32_t scale;
+
+    if (power > DIMMER_POWER_FULL) {
+        power = DIMMER_POWER_FULL;
+    }
+    if (dimmer->pll.half_cycle_q8 == 0) {
+        return dimmer->delay_us[power];
+    }
+    scale = delay_table(dimmer->pll.half_cycle_q8, &table);
+    return scaled(table[power], scale);
+}
+
+// Adds channel to the event at at_us, or inserts one there, keeping the
+// events in time order. At most 8 events, so a linear walk is the fastest.
+static void DIMMER_ISR_ATTR add_event(dimmer_t *dimmer, uint32_t at_us, uint8_t channel)
+{
+    dimmer_event_t *events = dimmer->events;
+    uint8_t i = dimmer->event_count;
+
+    while (i > 0 && (int32_t) (events[i - 1].at_us - at_us) > 0) {
+        i--;
+    }
+    if (i > 0 && events[i - 1].at_us == at_us) {
+        events[i - 1].mask |= 1u << channel;
+        return;
+    }
+    for (uint8_t j = dimmer->event_count; j > i; j--) {
+        events[j] = events[j - 1];
+    }
+    events[i].at_us = at_us;
+    events[i].mask = 1u << channel;
+    dimmer->event_count++;
+}
+
+// Schedules the half-cycle from the predicted crossing at crossing_us
+static void DIMMER_ISR_ATTR begin_half_cycle(dimmer_t *dimmer, uint32_t crossing_us)
+{
+    uint32_t scale = delay_table(dimmer->pll.half_cycle_q8, &dimmer->delay_us);
+
+    dimmer->crossing_us = crossing_us;
+    dimmer->release_us = crossing_us + zc_pll_half_cycle_us(&dimmer->pll) - DIMMER_RELEASE_LEAD_US;
+    dimmer->event_count = 0;
+    dimmer->next_event = 0;
+
+    for (uint8_t channel = 0; channel < dimmer->channels; channel++) {
+        uint16_t power = dimmer->power[channel];
+
+        if (power >= DIMMER_POWER_FULL) {
+            // Full power fires right at the crossing
+            add_event(dimmer, crossing_us, channel);
+        } else if (power > 0) {
+            add_event(dimmer, crossing_us + scaled(dimmer->delay_us[power], scale), channel);
+        }
+    }
+}
+
+// Reports a change of lock since was_locked
+static void DIMMER_ISR_ATTR lock_changed(dimmer_t *dimmer, bool was_locked)
+{
+    if (dimmer->pll.locked != was_locked && dimmer->hal.on_lock != NULL) {
+        dimmer->hal.on_lock(dimmer->hal.context, dimmer->pll.locked);
+    }
+}
+
+static void DIMMER_ISR_ATTR fire(dimmer_t *dimmer, uint32_t mask)
+{
+    dimmer->hal.set_gates(dimmer->hal.context, mask, true);
+    dimmer->triggers += __builtin_popcount(mask);
+}
+
+static void DIMMER_ISR_ATTR stop(dimmer_t *dimmer)
+{
+    dimmer->hal.set_gates(dimmer->hal.context, dimmer->all_mask, false);
+    dimmer->running = false;
+}
+
+// Each pass fires every event that is due, or due too soon for an alarm,
+// or ends the half-cycle and schedules the next, until the next thing to
+// do can wait for an alarm. A spurious alarm only sets the alarm again.
+static void DIMMER_ISR_ATTR run(dimmer_t *dimmer)
+{
+    while (dimmer->running) {
+        uint32_t now = dimmer->hal.now_us(dimmer->hal.context);
+        uint8_t next = dimmer->next_event;
+
+        if (!dimmer->enabled) {
+            stop(dimmer);
+            break;
+        }
+
+        uint32_t due = next < dimmer->event_count ? dimmer->events[next].at_us : dimmer->release_us;
+        if ((int32_t) (due - now) > DIMMER_ALARM_GUARD_US) {
+            dimmer->hal.set_alarm(dimmer->hal.context, due);
+            break;
+        }
+
+        if (next < dimmer->event_count) {
+            uint32_t mask = 0;
+
+            while (next < dimmer->event_count && (int32_t) (dimmer->events[next].at_us - now) <= DIMMER_ALARM_GUARD_US) {
+                if ((int32_t) (dimmer->events[next].at_us - now) > 0) {
+                    dimmer->coalesced++;
+                }
+                mask |= dimmer->events[next++].mask;
+            }
+            dimmer->next_event = next;
+            // The TRIACs stay on until their gates are released
+            fire(dimmer, mask);
+        } else {
+            // Release every gate ahead of the crossing, then schedule the
+            // half-cycle after it, unless the lock was lost
+            dimmer->hal.set_gates(dimmer->hal.context, dimmer->all_mask, false);
+            if (!zc_pll_check(&dimmer->pll, now)) {
+                stop(dimmer);
+                lock_changed(dimmer, true);
+                break;
+            }
+            begin_half_cycle(dimmer, zc_pll_nearest(&dimmer->pll, now));
+        }
+    }
+}
+
+void DIMMER_ISR_ATTR dimmer_core_zero_cross(dimmer_t *dimmer)
+{
+    uint32_t now = dimmer->hal.now_us(dimmer->hal.context);
+    bool was_locked = dimmer->pll.locked;
+    bool accepted = zc_pll_edge(&dimmer->pll, now);
+
+    dimmer->zero_crosses++;
+    lock_changed(dimmer, was_locked);
+
+    // A half-cycle under way runs on; an edge only corrects the prediction
+    if (!accepted || dimmer->running || !dimmer->enabled) {
+        return;
+    }
+
+    // Locked with nothing running: start from the crossing just seen
+    dimmer->running = true;
+    begin_half_cycle(dimmer, zc_pll_nearest(&dimmer->pll, now));
+    run(dimmer);
+}
+
+void DIMMER_ISR_ATTR dimmer_core_timer(dimmer_t *dimmer)
+{
+    run(dimmer);
+}
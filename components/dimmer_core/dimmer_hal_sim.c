@@ -0,0 +1,263 @@
+/*
+    Simulated mains and dimmer hardware for host tests and benchmarks. Not
+    part of the device build.
+
+    Time is simulated in microseconds. The mains crosses zero every half
+    period; the detector reports each crossing as an edge with random
+    jitter, may miss one, and may bounce into a second edge shortly after.
+    Noise may add an edge anywhere in the half-cycle that follows.
+    The timer and the gates are plain state. dimmer_sim_run()
+    calls the core's handlers in time order, timing each call with the
+    host clock and tracking the shortest time between two calls, which is
+    all a handler may take. Every gate firing is reported against the true
+    crossing. dimmer_sim_run_direct() runs the firing straight off the
+    edges that the core replaced, on the same mains, as a baseline.
+*/
+
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 199309L
+
+#include <stddef.h>
+#include <time.h>
+
+#include "dimmer_core.h"
+
+static uint32_t next_random(dimmer_sim_t *sim)
+{
+    // xorshift32; the seed must not be 0
+    uint32_t x = sim->seed ? sim->seed : 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->seed = x;
+    return x;
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+// Time of crossing number index, exact for any frequency
+static uint64_t crossing_us(const dimmer_sim_t *sim, uint64_t index)
+{
+    return index * 500000000ull / sim->mains_mhz;
+}
+
+static void queue_edge(dimmer_sim_t *sim, uint64_t edge)
+{
+    uint8_t i = sim->edge_count++;
+
+    while (i > 0 && sim->edges_us[i - 1] > edge) {
+        sim->edges_us[i] = sim->edges_us[i - 1];
+        i--;
+    }
+    sim->edges_us[i] = edge;
+}
+
+// Queues the edges the detector reports for the next crossing
+static void report_crossing(dimmer_sim_t *sim)
+{
+    uint64_t crossing = crossing_us(sim, sim->next_crossing++);
+    uint64_t edge = crossing;
+
+    if (sim->noise_permille > 0 && next_random(sim) % 1000 < sim->noise_permille) {
+        // Clear of the jitter around both crossings, so the edges stay in order
+        uint64_t span = crossing_us(sim, sim->next_crossing) - crossing - 2 * sim->jitter_us - 1;
+        queue_edge(sim, crossing + sim->jitter_us + 1 + next_random(sim) % span);
+    }
+    if (next_random(sim) % 1000 < sim->miss_permille) {
+        return;
+    }
+    if (sim->jitter_us > 0) {
+        edge = edge + next_random(sim) % (2 * sim->jitter_us + 1) - sim->jitter_us;
+    }
+    queue_edge(sim, edge);
+    if (sim->bounce_max_us > 0 && next_random(sim) % 1000 < sim->bounce_permille) {
+        queue_edge(sim, edge + 1 + next_random(sim) % sim->bounce_max_us);
+    }
+}
+
+static void sim_set_gates(void *context, uint32_t mask, bool on)
+{
+    dimmer_sim_t *sim = context;
+    uint32_t fired = on ? mask & ~sim->gates : 0;
+
+    for (uint8_t channel = 0; channel < DIMMER_CHANNELS_MAX; channel++) {
+        if ((fired & (1u << channel)) == 0) {
+            continue;
+        }
+        sim->firings[channel]++;
+        if (sim->on_fire != NULL) {
+            // A firing up to the jitter ahead of a crossing belongs to it.
+            // Crossing times are rounded down, so the index may be one short.
+            uint64_t index = (sim->now_us + sim->jitter_us) * sim->mains_mhz / 500000000ull;
+            if (crossing_us(sim, index + 1) <= sim->now_us + sim->jitter_us) {
+                index++;
+            }
+            sim->on_fire(sim->observer, channel, (int32_t) (sim->now_us - crossing_us(sim, index)));
+        }
+    }
+    sim->gates = on ? sim->gates | mask : sim->gates & ~mask;
+}
+
+static void sim_on_lock(void *context, bool locked)
+{
+    dimmer_sim_t *sim = context;
+
+    sim->lock_changes++;
+    if (sim->on_lock != NULL) {
+        sim->on_lock(sim->observer, locked);
+    }
+}
+
+static void sim_set_alarm(void *context, uint32_t at_us)
+{
+    dimmer_sim_t *sim = context;
+    int32_t ahead = (int32_t) (at_us - (uint32_t) sim->now_us);
+
+    // Like a hardware comparator, the timer never matches a time it has
+    // already passed
+    if (ahead <= 0) {
+        sim->missed_alarms++;
+        sim->timer_armed = false;
+        return;
+    }
+    sim->timer_armed = true;
+    sim->timer_due_us = sim->now_us + (uint64_t) ahead;
+}
+
+static uint32_t sim_now_us(void *context)
+{
+    dimmer_sim_t *sim = context;
+
+    return (uint32_t) sim->now_us;
+}
+
+void dimmer_hal_sim_init(dimmer_hal_t *hal, dimmer_sim_t *sim)
+{
+    hal->context = sim;
+    hal->set_gates = sim_set_gates;
+    hal->set_alarm = sim_set_alarm;
+    hal->now_us = sim_now_us;
+    hal->on_lock = sim_on_lock;
+
+    // The crossing at time 0 is not reported, so edges never come before 0
+    sim->now_us = 0;
+    sim->next_crossing = 1;
+    sim->edge_count = 0;
+    sim->timer_armed = false;
+    sim->gates = 0;
+    sim->last_call_us = 0;
+    sim->min_gap_us = UINT32_MAX;
+}
+
+// Handlers of what runs on the simulated hardware: the core, or the
+// direct firing baseline
+typedef void (*sim_handler_t)(dimmer_sim_t *sim, void *target, bool zero_cross);
+
+static void core_handler(dimmer_sim_t *sim, void *target, bool zero_cross)
+{
+    dimmer_t *dimmer = target;
+
+    if (zero_cross) {
+        dimmer_core_zero_cross(dimmer);
+        if (sim->on_edge != NULL) {
+            sim->on_edge(sim->observer);
+        }
+    } else {
+        dimmer_core_timer(dimmer);
+    }
+}
+
+typedef struct {
+    uint16_t power;
+    const uint16_t *delay_us;
+} direct_firing_t;
+
+// The firing before the PLL: every edge releases the gate and restarts
+// the timer for the table delay, and the gate fires when it runs out
+static void direct_handler(dimmer_sim_t *sim, void *target, bool zero_cross)
+{
+    const direct_firing_t *firing = target;
+
+    if (!zero_cross) {
+        sim_set_gates(sim, 1, true);
+        return;
+    }
+    sim_set_gates(sim, 1, false);
+    sim->timer_armed = false;
+    if (firing->power >= DIMMER_POWER_FULL) {
+        sim_set_gates(sim, 1, true);
+    } else if (firing->power > 0) {
+        sim->timer_armed = true;
+        sim->timer_due_us = sim->now_us + firing->delay_us[firing->power];
+    }
+}
+
+static void run_handler(dimmer_sim_t *sim, sim_handler_t handler, void *target, bool zero_cross)
+{
+    if (sim->isr_calls > 0 && sim->now_us - sim->last_call_us < sim->min_gap_us) {
+        sim->min_gap_us = (uint32_t) (sim->now_us - sim->last_call_us);
+    }
+    sim->last_call_us = sim->now_us;
+
+    uint64_t start = host_ns();
+
+    handler(sim, target, zero_cross);
+
+    uint64_t spent = host_ns() - start;
+    sim->isr_calls++;
+    sim->isr_ns += spent;
+    if (spent > sim->isr_max_ns) {
+        sim->isr_max_ns = spent;
+    }
+}
+
+static void run(dimmer_sim_t *sim, sim_handler_t handler, void *target, uint64_t until_us)
+{
+    while (1) {
+        // The edges of a crossing are queued once those of the one before
+        // have been delivered; an edge can be at most the jitter early
+        while (sim->edge_count == 0 && crossing_us(sim, sim->next_crossing) <= until_us + sim->jitter_us) {
+            report_crossing(sim);
+        }
+
+        bool edge = sim->edge_count > 0 && sim->edges_us[0] <= until_us;
+        bool timer = sim->timer_armed && sim->timer_due_us <= until_us;
+        if (!edge && !timer) {
+            break;
+        }
+        if (edge && (!timer || sim->edges_us[0] <= sim->timer_due_us)) {
+            sim->now_us = sim->edges_us[0];
+            sim->edges_us[0] = sim->edges_us[1];
+            sim->edges_us[1] = sim->edges_us[2];
+            sim->edge_count--;
+            sim->edges++;
+            run_handler(sim, handler, target, true);
+        } else {
+            sim->now_us = sim->timer_due_us;
+            sim->timer_armed = false;
+            run_handler(sim, handler, target, false);
+        }
+    }
+    sim->now_us = until_us;
+}
+
+void dimmer_sim_run(dimmer_sim_t *sim, dimmer_t *dimmer, uint64_t until_us)
+{
+    run(sim, core_handler, dimmer, until_us);
+}
+
+void dimmer_sim_run_direct(dimmer_sim_t *sim, uint16_t power, uint32_t nominal_hz, uint64_t until_us)
+{
+    direct_firing_t firing = {
+        .power = power,
+        .delay_us = nominal_hz < 55 ? dimmer_delay_50hz_us : dimmer_delay_60hz_us,
+    };
+
+    run(sim, direct_handler, &firing, until_us);
+}
@@ -0,0 +1,215 @@
+/*
+    Power-linear firing delays; see dimmer_core.h.
+
+    Generated by tools/gen_phase_table.py. Do not edit.
+*/
+
+#include "dimmer_core.h"
+
+const uint16_t DIMMER_DATA_ATTR dimmer_delay_50hz_us[DIMMER_POWER_STEPS] = {
+    10000, 9465, 9326, 9227, 9149, 9082, 9024, 8972, 8925, 8881,
+    8840, 8802, 8766, 8732, 8699, 8668, 8639, 8610, 8583, 8556,
+    8531, 8506, 8482, 8458, 8436, 8413, 8392, 8371, 8350, 8330,
+    8310, 8291, 8272, 8254, 8235, 8217, 8200, 8183, 8166, 8149,
+    8132, 8116, 8100, 8085, 8069, 8054, 8039, 8024, 8009, 7995,
+    7980, 7966, 7952, 7938, 7925, 7911, 7898, 7885, 7872, 7859,
+    7846, 7833, 7821, 7808, 7796, 7784, 7772, 7760, 7748, 7736,
+    7724, 7713, 7701, 7690, 7678, 7667, 7656, 7645, 7634, 7623,
+    7612, 7602, 7591, 7580, 7570, 7560, 7549, 7539, 7529, 7519,
+    7508, 7498, 7488, 7479, 7469, 7459, 7449, 7440, 7430, 7420,
+    7411, 7401, 7392, 7383, 7373, 7364, 7355, 7346, 7337, 7328,
+    7319, 7310, 7301, 7292, 7283, 7274, 7266, 7257, 7248, 7240,
+    7231, 7223, 7214, 7206, 7197, 7189, 7180, 7172, 7164, 7156,
+    7147, 7139, 7131, 7123, 7115, 7107, 7099, 7091, 7083, 7075,
+    7067, 7059, 7051, 7043, 7036, 7028, 7020, 7013, 7005, 6997,
+    6990, 6982, 6974, 6967, 6959, 6952, 6944, 6937, 6930, 6922,
+    6915, 6907, 6900, 6893, 6886, 6878, 6871, 6864, 6857, 6850,
+    6842, 6835, 6828, 6821, 6814, 6807, 6800, 6793, 6786, 6779,
+    6772, 6765, 6758, 6751, 6744, 6738, 6731, 6724, 6717, 6710,
+    6704, 6697, 6690, 6683, 6677, 6670, 6663, 6657, 6650, 6643,
+    6637, 6630, 6624, 6617, 6611, 6604, 6598, 6591, 6585, 6578,
+    6572, 6565, 6559, 6552, 6546, 6540, 6533, 6527, 6520, 6514,
+    6508, 6502, 6495, 6489, 6483, 6476, 6470, 6464, 6458, 6452,
+    6445, 6439, 6433, 6427, 6421, 6414, 6408, 6402, 6396, 6390,
+    6384, 6378, 6372, 6366, 6360, 6354, 6348, 6342, 6336, 6330,
+    6324, 6318, 6312, 6306, 6300, 6294, 6288, 6282, 6276, 6270,
+    6264, 6259, 6253, 6247, 6241, 6235, 6229, 6223, 6218, 6212,
+    6206, 6200, 6195, 6189, 6183, 6177, 6171, 6166, 6160, 6154,
+    6149, 6143, 6137, 6131, 6126, 6120, 6114, 6109, 6103, 6097,
+    6092, 6086, 6081, 6075, 6069, 6064, 6058, 6053, 6047, 6041,
+    6036, 6030, 6025, 6019, 6014, 6008, 6002, 5997, 5991, 5986,
+    5980, 5975, 5969, 5964, 5958, 5953, 5947, 5942, 5937, 5931,
+    5926, 5920, 5915, 5909, 5904, 5898, 5893, 5888, 5882, 5877,
+    5871, 5866, 5861, 5855, 5850, 5845, 5839, 5834, 5828, 5823,
+    5818, 5812, 5807, 5802, 5796, 5791, 5786, 5780, 5775, 5770,
+    5765, 5759, 5754, 5749, 5743, 5738, 5733, 5728, 5722, 5717,
+    5712, 5706, 5701, 5696, 5691, 5685, 5680, 5675, 5670, 5665,
+    5659, 5654, 5649, 5644, 5638, 5633, 5628, 5623, 5618, 5613,
+    5607, 5602, 5597, 5592, 5587, 5581, 5576, 5571, 5566, 5561,
+    5556, 5550, 5545, 5540, 5535, 5530, 5525, 5520, 5514, 5509,
+    5504, 5499, 5494, 5489, 5484, 5479, 5473, 5468, 5463, 5458,
+    5453, 5448, 5443, 5438, 5433, 5428, 5422, 5417, 5412, 5407,
+    5402, 5397, 5392, 5387, 5382, 5377, 5372, 5367, 5362, 5356,
+    5351, 5346, 5341, 5336, 5331, 5326, 5321, 5316, 5311, 5306,
+    5301, 5296, 5291, 5286, 5281, 5276, 5271, 5266, 5261, 5256,
+    5251, 5245, 5240, 5235, 5230, 5225, 5220, 5215, 5210, 5205,
+    5200, 5195, 5190, 5185, 5180, 5175, 5170, 5165, 5160, 5155,
+    5150, 5145, 5140, 5135, 5130, 5125, 5120, 5115, 5110, 5105,
+    5100, 5095, 5090, 5085, 5080, 5075, 5070, 5065, 5060, 5055,
+    5050, 5045, 5040, 5035, 5030, 5025, 5020, 5015, 5010, 5005,
+    5000, 4995, 4990, 4985, 4980, 4975, 4970, 4965, 4960, 4955,
+    4950, 4945, 4940, 4935, 4930, 4925, 4920, 4915, 4910, 4905,
+    4900, 4895, 4890, 4885, 4880, 4875, 4870, 4865, 4860, 4855,
+    4850, 4845, 4840, 4835, 4830, 4825, 4820, 4815, 4810, 4805,
+    4800, 4795, 4790, 4785, 4780, 4775, 4770, 4765, 4760, 4755,
+    4749, 4744, 4739, 4734, 4729, 4724, 4719, 4714, 4709, 4704,
+    4699, 4694, 4689, 4684, 4679, 4674, 4669, 4664, 4659, 4654,
+    4649, 4644, 4638, 4633, 4628, 4623, 4618, 4613, 4608, 4603,
+    4598, 4593, 4588, 4583, 4578, 4572, 4567, 4562, 4557, 4552,
+    4547, 4542, 4537, 4532, 4527, 4521, 4516, 4511, 4506, 4501,
+    4496, 4491, 4486, 4480, 4475, 4470, 4465, 4460, 4455, 4450,
+    4444, 4439, 4434, 4429, 4424, 4419, 4413, 4408, 4403, 4398,
+    4393, 4387, 4382, 4377, 4372, 4367, 4362, 4356, 4351, 4346,
+    4341, 4335, 4330, 4325, 4320, 4315, 4309, 4304, 4299, 4294,
+    4288, 4283, 4278, 4272, 4267, 4262, 4257, 4251, 4246, 4241,
+    4235, 4230, 4225, 4220, 4214, 4209, 4204, 4198, 4193, 4188,
+    4182, 4177, 4172, 4166, 4161, 4155, 4150, 4145, 4139, 4134,
+    4129, 4123, 4118, 4112, 4107, 4102, 4096, 4091, 4085, 4080,
+    4074, 4069, 4063, 4058, 4053, 4047, 4042, 4036, 4031, 4025,
+    4020, 4014, 4009, 4003, 3998, 3992, 3986, 3981, 3975, 3970,
+    3964, 3959, 3953, 3947, 3942, 3936, 3931, 3925, 3919, 3914,
+    3908, 3903, 3897, 3891, 3886, 3880, 3874, 3869, 3863, 3857,
+    3851, 3846, 3840, 3834, 3829, 3823, 3817, 3811, 3805, 3800,
+    3794, 3788, 3782, 3777, 3771, 3765, 3759, 3753, 3747, 3741,
+    3736, 3730, 3724, 3718, 3712, 3706, 3700, 3694, 3688, 3682,
+    3676, 3670, 3664, 3658, 3652, 3646, 3640, 3634, 3628, 3622,
+    3616, 3610, 3604, 3598, 3592, 3586, 3579, 3573, 3567, 3561,
+    3555, 3548, 3542, 3536, 3530, 3524, 3517, 3511, 3505, 3498,
+    3492, 3486, 3480, 3473, 3467, 3460, 3454, 3448, 3441, 3435,
+    3428, 3422, 3415, 3409, 3402, 3396, 3389, 3383, 3376, 3370,
+    3363, 3357, 3350, 3343, 3337, 3330, 3323, 3317, 3310, 3303,
+    3296, 3290, 3283, 3276, 3269, 3262, 3256, 3249, 3242, 3235,
+    3228, 3221, 3214, 3207, 3200, 3193, 3186, 3179, 3172, 3165,
+    3158, 3150, 3143, 3136, 3129, 3122, 3114, 3107, 3100, 3093,
+    3085, 3078, 3070, 3063, 3056, 3048, 3041, 3033, 3026, 3018,
+    3010, 3003, 2995, 2987, 2980, 2972, 2964, 2957, 2949, 2941,
+    2933, 2925, 2917, 2909, 2901, 2893, 2885, 2877, 2869, 2861,
+    2853, 2844, 2836, 2828, 2820, 2811, 2803, 2794, 2786, 2777,
+    2769, 2760, 2752, 2743, 2734, 2726, 2717, 2708, 2699, 2690,
+    2681, 2672, 2663, 2654, 2645, 2636, 2627, 2617, 2608, 2599,
+    2589, 2580, 2570, 2560, 2551, 2541, 2531, 2521, 2512, 2502,
+    2492, 2481, 2471, 2461, 2451, 2440, 2430, 2420, 2409, 2398,
+    2388, 2377, 2366, 2355, 2344, 2333, 2322, 2310, 2299, 2287,
+    2276, 2264, 2252, 2240, 2228, 2216, 2204, 2192, 2179, 2167,
+    2154, 2141, 2128, 2115, 2102, 2089, 2075, 2062, 2048, 2034,
+    2020, 2005, 1991, 1976, 1961, 1946, 1931, 1915, 1900, 1884,
+    1868, 1851, 1834, 1817, 1800, 1783, 1765, 1746, 1728, 1709,
+    1690, 1670, 1650, 1629, 1608, 1587, 1564, 1542, 1518, 1494,
+    1469, 1444, 1417, 1390, 1361, 1332, 1301, 1268, 1234, 1198,
+    1160, 1119, 1075, 1028, 976, 918, 851, 773, 674, 535,
+    0,
+};
+
+const uint16_t DIMMER_DATA_ATTR dimmer_delay_60hz_us[DIMMER_POWER_STEPS] = {
+    8333, 7833, 7771, 7689, 7624, 7569, 7520, 7477, 7437, 7401,
+    7367, 7335, 7305, 7277, 7249, 7224, 7199, 7175, 7152, 7130,
+    7109, 7088, 7068, 7049, 7030, 7011, 6993, 6976, 6958, 6942,
+    6925, 6909, 6893, 6878, 6863, 6848, 6833, 6819, 6805, 6791,
+    6777, 6764, 6750, 6737, 6724, 6712, 6699, 6687, 6674, 6662,
+    6650, 6639, 6627, 6615, 6604, 6593, 6582, 6571, 6560, 6549,
+    6538, 6528, 6517, 6507, 6497, 6486, 6476, 6466, 6456, 6447,
+    6437, 6427, 6418, 6408, 6399, 6389, 6380, 6371, 6362, 6353,
+    6344, 6335, 6326, 6317, 6308, 6300, 6291, 6282, 6274, 6265,
+    6257, 6249, 6240, 6232, 6224, 6216, 6208, 6200, 6192, 6184,
+    6176, 6168, 6160, 6152, 6145, 6137, 6129, 6122, 6114, 6106,
+    6099, 6092, 6084, 6077, 6069, 6062, 6055, 6047, 6040, 6033,
+    6026, 6019, 6012, 6005, 5998, 5991, 5984, 5977, 5970, 5963,
+    5956, 5949, 5943, 5936, 5929, 5922, 5916, 5909, 5902, 5896,
+    5889, 5883, 5876, 5870, 5863, 5857, 5850, 5844, 5837, 5831,
+    5825, 5818, 5812, 5806, 5799, 5793, 5787, 5781, 5775, 5768,
+    5762, 5756, 5750, 5744, 5738, 5732, 5726, 5720, 5714, 5708,
+    5702, 5696, 5690, 5684, 5678, 5672, 5667, 5661, 5655, 5649,
+    5643, 5638, 5632, 5626, 5620, 5615, 5609, 5603, 5598, 5592,
+    5586, 5581, 5575, 5569, 5564, 5558, 5553, 5547, 5542, 5536,
+    5531, 5525, 5520, 5514, 5509, 5503, 5498, 5493, 5487, 5482,
+    5476, 5471, 5466, 5460, 5455, 5450, 5444, 5439, 5434, 5428,
+    5423, 5418, 5413, 5407, 5402, 5397, 5392, 5387, 5381, 5376,
+    5371, 5366, 5361, 5356, 5351, 5345, 5340, 5335, 5330, 5325,
+    5320, 5315, 5310, 5305, 5300, 5295, 5290, 5285, 5280, 5275,
+    5270, 5265, 5260, 5255, 5250, 5245, 5240, 5235, 5230, 5225,
+    5220, 5215, 5211, 5206, 5201, 5196, 5191, 5186, 5181, 5177,
+    5172, 5167, 5162, 5157, 5152, 5148, 5143, 5138, 5133, 5129,
+    5124, 5119, 5114, 5110, 5105, 5100, 5095, 5091, 5086, 5081,
+    5077, 5072, 5067, 5062, 5058, 5053, 5048, 5044, 5039, 5034,
+    5030, 5025, 5021, 5016, 5011, 5007, 5002, 4997, 4993, 4988,
+    4984, 4979, 4975, 4970, 4965, 4961, 4956, 4952, 4947, 4943,
+    4938, 4934, 4929, 4924, 4920, 4915, 4911, 4906, 4902, 4897,
+    4893, 4888, 4884, 4879, 4875, 4870, 4866, 4862, 4857, 4853,
+    4848, 4844, 4839, 4835, 4830, 4826, 4821, 4817, 4813, 4808,
+    4804, 4799, 4795, 4791, 4786, 4782, 4777, 4773, 4769, 4764,
+    4760, 4755, 4751, 4747, 4742, 4738, 4734, 4729, 4725, 4720,
+    4716, 4712, 4707, 4703, 4699, 4694, 4690, 4686, 4681, 4677,
+    4673, 4668, 4664, 4660, 4655, 4651, 4647, 4643, 4638, 4634,
+    4630, 4625, 4621, 4617, 4613, 4608, 4604, 4600, 4595, 4591,
+    4587, 4583, 4578, 4574, 4570, 4565, 4561, 4557, 4553, 4548,
+    4544, 4540, 4536, 4531, 4527, 4523, 4519, 4514, 4510, 4506,
+    4502, 4498, 4493, 4489, 4485, 4481, 4476, 4472, 4468, 4464,
+    4460, 4455, 4451, 4447, 4443, 4438, 4434, 4430, 4426, 4422,
+    4417, 4413, 4409, 4405, 4401, 4396, 4392, 4388, 4384, 4380,
+    4375, 4371, 4367, 4363, 4359, 4354, 4350, 4346, 4342, 4338,
+    4334, 4329, 4325, 4321, 4317, 4313, 4308, 4304, 4300, 4296,
+    4292, 4288, 4283, 4279, 4275, 4271, 4267, 4263, 4258, 4254,
+    4250, 4246, 4242, 4238, 4233, 4229, 4225, 4221, 4217, 4213,
+    4208, 4204, 4200, 4196, 4192, 4188, 4183, 4179, 4175, 4171,
+    4167, 4162, 4158, 4154, 4150, 4146, 4142, 4137, 4133, 4129,
+    4125, 4121, 4117, 4112, 4108, 4104, 4100, 4096, 4092, 4087,
+    4083, 4079, 4075, 4071, 4067, 4062, 4058, 4054, 4050, 4046,
+    4042, 4037, 4033, 4029, 4025, 4021, 4017, 4012, 4008, 4004,
+    4000, 3996, 3991, 3987, 3983, 3979, 3975, 3970, 3966, 3962,
+    3958, 3954, 3950, 3945, 3941, 3937, 3933, 3929, 3924, 3920,
+    3916, 3912, 3908, 3903, 3899, 3895, 3891, 3886, 3882, 3878,
+    3874, 3870, 3865, 3861, 3857, 3853, 3848, 3844, 3840, 3836,
+    3832, 3827, 3823, 3819, 3815, 3810, 3806, 3802, 3798, 3793,
+    3789, 3785, 3781, 3776, 3772, 3768, 3764, 3759, 3755, 3751,
+    3747, 3742, 3738, 3734, 3729, 3725, 3721, 3717, 3712, 3708,
+    3704, 3699, 3695, 3691, 3686, 3682, 3678, 3674, 3669, 3665,
+    3661, 3656, 3652, 3648, 3643, 3639, 3635, 3630, 3626, 3622,
+    3617, 3613, 3609, 3604, 3600, 3595, 3591, 3587, 3582, 3578,
+    3574, 3569, 3565, 3560, 3556, 3552, 3547, 3543, 3538, 3534,
+    3530, 3525, 3521, 3516, 3512, 3507, 3503, 3499, 3494, 3490,
+    3485, 3481, 3476, 3472, 3467, 3463, 3458, 3454, 3449, 3445,
+    3440, 3436, 3431, 3427, 3422, 3418, 3413, 3409, 3404, 3400,
+    3395, 3391, 3386, 3382, 3377, 3373, 3368, 3363, 3359, 3354,
+    3350, 3345, 3340, 3336, 3331, 3327, 3322, 3317, 3313, 3308,
+    3304, 3299, 3294, 3290, 3285, 3280, 3276, 3271, 3266, 3262,
+    3257, 3252, 3247, 3243, 3238, 3233, 3229, 3224, 3219, 3214,
+    3210, 3205, 3200, 3195, 3190, 3186, 3181, 3176, 3171, 3166,
+    3162, 3157, 3152, 3147, 3142, 3137, 3133, 3128, 3123, 3118,
+    3113, 3108, 3103, 3098, 3093, 3088, 3083, 3078, 3074, 3069,
+    3064, 3059, 3054, 3049, 3044, 3039, 3034, 3029, 3023, 3018,
+    3013, 3008, 3003, 2998, 2993, 2988, 2983, 2978, 2973, 2967,
+    2962, 2957, 2952, 2947, 2942, 2936, 2931, 2926, 2921, 2915,
+    2910, 2905, 2900, 2894, 2889, 2884, 2878, 2873, 2868, 2862,
+    2857, 2852, 2846, 2841, 2835, 2830, 2825, 2819, 2814, 2808,
+    2803, 2797, 2792, 2786, 2781, 2775, 2769, 2764, 2758, 2753,
+    2747, 2741, 2736, 2730, 2724, 2719, 2713, 2707, 2701, 2696,
+    2690, 2684, 2678, 2673, 2667, 2661, 2655, 2649, 2643, 2637,
+    2631, 2625, 2619, 2613, 2607, 2601, 2595, 2589, 2583, 2577,
+    2571, 2565, 2559, 2553, 2546, 2540, 2534, 2528, 2521, 2515,
+    2509, 2502, 2496, 2490, 2483, 2477, 2470, 2464, 2457, 2451,
+    2444, 2438, 2431, 2424, 2418, 2411, 2404, 2398, 2391, 2384,
+    2377, 2370, 2363, 2357, 2350, 2343, 2336, 2329, 2322, 2315,
+    2307, 2300, 2293, 2286, 2279, 2271, 2264, 2257, 2249, 2242,
+    2234, 2227, 2219, 2212, 2204, 2196, 2189, 2181, 2173, 2165,
+    2158, 2150, 2142, 2134, 2126, 2118, 2109, 2101, 2093, 2085,
+    2076, 2068, 2059, 2051, 2042, 2034, 2025, 2016, 2007, 1999,
+    1990, 1981, 1972, 1962, 1953, 1944, 1935, 1925, 1916, 1906,
+    1896, 1887, 1877, 1867, 1857, 1847, 1837, 1827, 1816, 1806,
+    1795, 1784, 1774, 1763, 1752, 1741, 1729, 1718, 1706, 1695,
+    1683, 1671, 1659, 1647, 1634, 1622, 1609, 1596, 1583, 1570,
+    1556, 1543, 1529, 1514, 1500, 1485, 1471, 1455, 1440, 1424,
+    1408, 1392, 1375, 1358, 1340, 1322, 1304, 1285, 1265, 1245,
+    1224, 1203, 1181, 1158, 1134, 1110, 1084, 1057, 1028, 998,
+    967, 933, 896, 857, 813, 765, 709, 644, 562, 500,
+    0,
+};
@@ -0,0 +1,191 @@
+/*
+    Phase-angle dimmer core: decides, for every mains half-cycle, when
+    each TRIAC gate fires in it.
+
+    The core does no I/O of its own. It drives the gates and the alarm of
+    a single free-running hardware timer through a dimmer_hal_t, and is
+    driven by two calls made from the interrupt handlers:
+    dimmer_core_zero_cross() on each zero-cross edge and dimmer_core_timer()
+    when the alarm goes off. On the ESP32 both handlers live in main.c;
+    dimmer_hal_sim.c runs the same core on a host against simulated mains.
+
+    Zero-cross edges only feed a zc_pll_t, which measures the mains
+    frequency and predicts the crossings, so bounce and noise on the
+    detector never reach the gates. Once the loop locks, the half-cycles
+    are run from the timer alone. Ahead of each predicted crossing the
+    timer releases every gate and schedules the half-cycle after it: the
+    channels' firing delays are sorted into a list of events, one per
+    distinct delay, and the alarm is set for the first. Each alarm fires
+    the channels of its event, plus those of any later event due too soon
+    to set an alarm for, and is set for the next one. Alarms are set at
+    absolute times, so the time the handlers take does not add up along
+    the list. If the loop loses its lock, the gates stay off until it
+    locks again.
+
+    Each channel is set to a power in permille of full power. A resistive
+    load fired at angle a into each half-cycle takes
+    1 - a/pi + sin(2a)/2pi of full power, which is far from linear in a,
+    so the delay for each permille is looked up in a table for the nominal
+    mains frequency, 50 or 60 Hz, and scaled to the measured half-cycle.
+    The tables are generated by tools/gen_phase_table.py and
+    kept in DRAM, where the handlers can read them while the flash cache
+    is off.
+
+    The state is shared without locks. The two handlers must run on the
+    same CPU at the same interrupt level, so one never preempts the other.
+    Tasks write the powers and the enabled flag and read the counters;
+    each is an aligned word that the handlers read or write in one access,
+    and only the handlers write the counters. A new power takes effect
+    from the next half-cycle scheduled.
+*/
+
+#ifndef DIMMER_CORE_H_
+#define DIMMER_CORE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "zc_pll.h"
+
+// Code and data used by the interrupt handlers have to be in internal RAM
+// on the ESP32
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#define DIMMER_ISR_ATTR IRAM_ATTR
+#define DIMMER_DATA_ATTR DRAM_ATTR
+#else
+#define DIMMER_ISR_ATTR
+#define DIMMER_DATA_ATTR
+#endif
+
+// Channels are numbered from 0 and passed around in bit masks
+#define DIMMER_CHANNELS_MAX 8
+
+// Full power, in permille
+#define DIMMER_POWER_FULL 1000
+#define DIMMER_POWER_STEPS (DIMMER_POWER_FULL + 1)
+
+// Shortest delay between a zero crossing and a firing, and between a
+// firing and the next zero crossing
+#define DIMMER_MIN_DELAY_US 500
+
+// An event due within this long of the time now is fired at once rather
+// than given an alarm, which could be set after the timer has passed it
+#define DIMMER_ALARM_GUARD_US 20
+
+// Gates are released this long ahead of each predicted crossing, so none
+// is held on into the next half-cycle
+#define DIMMER_RELEASE_LEAD_US (DIMMER_MIN_DELAY_US / 2)
+
+// Firing delay after the zero crossing for each permille of power
+extern const uint16_t dimmer_delay_50hz_us[DIMMER_POWER_STEPS];
+extern const uint16_t dimmer_delay_60hz_us[DIMMER_POWER_STEPS];
+
+// The hardware a dimmer drives. All functions are called from interrupt
+// handlers. Times are in microseconds on the timer, wrapping at 32 bits.
+typedef struct {
+    void *context;
+    // Turns the gates of the channels in mask on or off, leaving the others
+    void (*set_gates)(void *context, uint32_t mask, bool on);
+    // Calls dimmer_core_timer() when the timer reaches at_us, replacing any
+    // pending alarm
+    void (*set_alarm)(void *context, uint32_t at_us);
+    uint32_t (*now_us)(void *context);
+    // Called when the PLL locks onto the mains or loses it, e.g. to wake a
+    // task; may be NULL
+    void (*on_lock)(void *context, bool locked);
+} dimmer_hal_t;
+
+// Channels to fire at a time on the timer
+typedef struct {
+    uint32_t at_us;
+    uint8_t mask;
+} dimmer_event_t;
+
+typedef struct {
+    dimmer_hal_t hal;
+    zc_pll_t pll;
+    const uint16_t *delay_us;                       // Table for the nominal mains frequency
+    uint8_t channels;
+    uint8_t all_mask;                               // A bit for each channel
+    volatile uint16_t power[DIMMER_CHANNELS_MAX];   // Permille of full power
+    volatile bool enabled;
+    // The half-cycle being run from the timer; only the handlers use it
+    bool running;
+    uint32_t crossing_us;                           // Predicted crossing it starts at
+    uint32_t release_us;                            // When its gates are released
+    dimmer_event_t events[DIMMER_CHANNELS_MAX];     // In time order
+    uint8_t event_count;
+    uint8_t next_event;
+    volatile uint32_t zero_crosses;                 // Zero-cross edges seen
+    volatile uint32_t triggers;                     // Gate firings, per channel
+    volatile uint32_t coalesced;                    // Events fired ahead of time with an earlier one
+} dimmer_t;
+
+// Starts disabled with every channel at 0, looking for the mains. Returns
+// false if channels is 0 or more than DIMMER_CHANNELS_MAX.
+bool dimmer_core_init(dimmer_t *dimmer, const dimmer_hal_t *hal, uint8_t channels);
+
+// Call from the zero-cross interrupt handler
+void dimmer_core_zero_cross(dimmer_t *dimmer);
+
+// Call from the timer alarm interrupt handler
+void dimmer_core_timer(dimmer_t *dimmer);
+
+// Delay from the zero crossing to the firing for power, in permille, at
+// the half-cycle last measured
+uint32_t dimmer_core_delay_us(const dimmer_t *dimmer, uint16_t power);
+
+// Simulated mains and hardware for host tests; see dimmer_hal_sim.c, which
+// is not part of the device build
+typedef struct {
+    // Mains, crossing zero at multiples of the half period from time 0
+    uint32_t mains_mhz;             // Frequency in millihertz, e.g. 50000
+    uint32_t jitter_us;             // Random error on every zero-cross edge
+    uint16_t miss_permille;         // Chance of a crossing giving no edge
+    uint16_t bounce_permille;       // Chance of a spurious second edge
+    uint32_t bounce_max_us;         // Within this long of the first one
+    uint16_t noise_permille;        // Chance of a spurious edge anywhere in a half-cycle
+    uint32_t seed;
+    // Called on every gate firing with the time since the true zero
+    // crossing, negative if it fired ahead of it; may be NULL
+    void (*on_fire)(void *observer, uint8_t channel, int32_t delay_us);
+    // Called inside the zero-cross handler, after the core and timed with
+    // it, for work a device handler does besides; may be NULL
+    void (*on_edge)(void *observer);
+    // Called with on_lock from the core; may be NULL
+    void (*on_lock)(void *observer, bool locked);
+    void *observer;
+    // State
+    uint64_t now_us;
+    uint64_t next_crossing;         // Index of the next crossing to report
+    uint64_t edges_us[3];           // Edges not yet delivered, in order
+    uint8_t edge_count;
+    bool timer_armed;
+    uint64_t timer_due_us;
+    uint32_t gates;                 // A bit for each gate that is on
+    // Statistics
+    uint32_t edges;
+    uint32_t firings[DIMMER_CHANNELS_MAX];
+    uint32_t missed_alarms;         // Alarms set for a time already passed
+    uint32_t lock_changes;          // Calls to on_lock
+    uint32_t isr_calls;
+    uint64_t isr_ns;                // Host CPU time spent in the handlers
+    uint64_t isr_max_ns;
+    uint64_t last_call_us;
+    uint32_t min_gap_us;            // Shortest simulated time between two handler calls
+} dimmer_sim_t;
+
+void dimmer_hal_sim_init(dimmer_hal_t *hal, dimmer_sim_t *sim);
+
+// Runs the handlers of dimmer as the simulated mains and timer would, up
+// to until_us of simulated time
+void dimmer_sim_run(dimmer_sim_t *sim, dimmer_t *dimmer, uint64_t until_us);
+
+// Runs channel 0 as it was fired before the PLL, as a baseline: every
+// zero-cross edge releases the gate and restarts the timer for the delay
+// of power in the table of nominal_hz, fixed at build time, and the gate
+// fires when the timer runs out
+void dimmer_sim_run_direct(dimmer_sim_t *sim, uint16_t power, uint32_t nominal_hz, uint64_t until_us);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+    Zero-cross PLL: tracks the mains from the edges of a zero-cross
+    detector and predicts where the crossings fall.
+
+    Every edge is timestamped in microseconds on a free-running clock and
+    passed to zc_pll_edge(). Until locked, the loop looks for
+    ZC_PLL_LOCK_EDGES consecutive half-cycles of about the same length
+    between 43 and 71 Hz, ignoring edges too close to the one before, and
+    locks onto their average; nothing needs to know the mains frequency
+    in advance. Once locked, an edge is matched to the predicted crossing
+    nearest to it. An edge ahead of or too far from its prediction, such
+    as a bounce or noise, is rejected; one that matches corrects the phase
+    and the half-cycle length by a fraction of its error, so the jitter of
+    single edges is averaged out. Crossings with no edge are coasted
+    through on the prediction.
+
+    The lock is dropped after ZC_PLL_MAX_REJECTS rejected edges in a row,
+    e.g. when the frequency changes, or ZC_PLL_MAX_COAST half-cycles
+    without an accepted edge, e.g. when the mains or the detector fail.
+
+    Times are kept to 1/256 us. Edges are expected from one interrupt
+    handler at a time; none of the functions lock.
+*/
+
+#ifndef ZC_PLL_H_
+#define ZC_PLL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Range of half-cycles the loop locks onto, 71 to 43 Hz
+#define ZC_PLL_MIN_HALF_US 7000
+#define ZC_PLL_MAX_HALF_US 11500
+
+// Consecutive half-cycles within 1/8 of each other needed to lock
+#define ZC_PLL_LOCK_EDGES 8
+
+// Half-cycles the loop runs on without an accepted edge before it drops
+// the lock
+#define ZC_PLL_MAX_COAST 8
+
+// Consecutive rejected edges that drop the lock
+#define ZC_PLL_MAX_REJECTS 8
+
+// An edge is accepted within 1/2^ZC_PLL_WINDOW_SHIFT of a half-cycle of its
+// predicted crossing
+#define ZC_PLL_WINDOW_SHIFT 4
+
+// Fractions of an accepted edge's error, as shifts, that correct the phase
+// and the half-cycle length
+#define ZC_PLL_PHASE_SHIFT 3
+#define ZC_PLL_PERIOD_SHIFT 6
+
+typedef struct {
+    bool locked;
+    // Locked: a crossing, at phase_us + phase_frac/256, and the half-cycle
+    uint32_t phase_us;
+    uint32_t phase_frac;
+    uint32_t half_cycle_q8;     // In 1/256 us
+    uint8_t rejects;            // Edges rejected since the last accepted one
+    // Locking: the edges seen so far
+    bool have_edge;
+    uint32_t last_edge_us;
+    uint32_t last_interval_us;
+    uint32_t run_start_us;      // First edge of the run of similar half-cycles
+    uint8_t run;
+    // Statistics
+    uint32_t accepted;
+    uint32_t rejected;
+    uint32_t coasted;           // Crossings with no edge, while locked
+    uint32_t locks;
+    uint32_t unlocks;
+} zc_pll_t;
+
+void zc_pll_init(zc_pll_t *pll);
+
+// Feeds an edge seen at now_us. Returns true if the edge is accepted as a
+// crossing, including the one that completes a lock.
+bool zc_pll_edge(zc_pll_t *pll, uint32_t now_us);
+
+// Drops the lock if no edge has been accepted for ZC_PLL_MAX_COAST
+// half-cycles by now_us. Returns whether the loop is locked.
+bool zc_pll_check(zc_pll_t *pll, uint32_t now_us);
+
+// Predicted crossing nearest to t_us, rounded to the microsecond. Only
+// meaningful while locked, within a few half-cycles of the last accepted
+// edge.
+uint32_t zc_pll_nearest(const zc_pll_t *pll, uint32_t t_us);
+
+// Estimated half-cycle, rounded to the microsecond
+uint32_t zc_pll_half_cycle_us(const zc_pll_t *pll);
+
+// Estimated mains frequency in millihertz, or 0 while not locked
+uint32_t zc_pll_mains_mhz(const zc_pll_t *pll);
+
+#endif
@@ -0,0 +1,167 @@
+/*
+    Zero-cross PLL; see zc_pll.h.
+*/
+
+#include <string.h>
+
+#include "dimmer_core.h"
+#include "zc_pll.h"
+
+void zc_pll_init(zc_pll_t *pll)
+{
+    memset(pll, 0, sizeof(*pll));
+}
+
+// Time from the phase to t, in 1/256 us; t has to be within 2^23 us of it
+static int32_t DIMMER_ISR_ATTR offset_q8(const zc_pll_t *pll, uint32_t t_us)
+{
+    return (int32_t) ((t_us - pll->phase_us) << 8) - (int32_t) pll->phase_frac;
+}
+
+static void DIMMER_ISR_ATTR advance(zc_pll_t *pll, int32_t delta_q8)
+{
+    int32_t frac = (int32_t) pll->phase_frac + delta_q8;
+
+    pll->phase_us += (uint32_t) (frac >> 8);
+    pll->phase_frac = (uint32_t) frac & 0xff;
+}
+
+// Number of half-cycles in offset_q8, rounded to the nearest
+static int32_t DIMMER_ISR_ATTR half_cycles(const zc_pll_t *pll, int32_t offset_q8)
+{
+    int32_t half = (int32_t) pll->half_cycle_q8;
+
+    return offset_q8 >= 0 ? (offset_q8 + half / 2) / half : -((half / 2 - offset_q8) / half);
+}
+
+// Starts looking for a lock again, from an edge at now_us if there is one
+static void DIMMER_ISR_ATTR restart(zc_pll_t *pll, bool edge, uint32_t now_us)
+{
+    if (pll->locked) {
+        pll->locked = false;
+        pll->unlocks++;
+    }
+    pll->have_edge = edge;
+    pll->last_edge_us = now_us;
+    pll->run_start_us = now_us;
+    pll->run = 0;
+}
+
+static bool DIMMER_ISR_ATTR acquire(zc_pll_t *pll, uint32_t now_us)
+{
+    uint32_t interval = now_us - pll->last_edge_us;
+
+    if (!pll->have_edge) {
+        restart(pll, true, now_us);
+        return false;
+    }
+    if (interval < ZC_PLL_MIN_HALF_US) {
+        // A bounce or noise: keep timing from the edge before
+        return false;
+    }
+    if (interval > ZC_PLL_MAX_HALF_US) {
+        restart(pll, true, now_us);
+        return false;
+    }
+
+    uint32_t change = interval > pll->last_interval_us ? interval - pll->last_interval_us
+                                                       : pll->last_interval_us - interval;
+    if (pll->run > 0 && change > pll->last_interval_us / 8) {
+        // Start the run over from the half-cycle just seen
+        pll->run_start_us = pll->last_edge_us;
+        pll->run = 0;
+    }
+    pll->run++;
+    pll->last_interval_us = interval;
+    pll->last_edge_us = now_us;
+    if (pll->run < ZC_PLL_LOCK_EDGES) {
+        return false;
+    }
+
+    // Lock onto the average of the run, at this edge
+    pll->half_cycle_q8 = ((now_us - pll->run_start_us) << 8) / pll->run;
+    pll->phase_us = now_us;
+    pll->phase_frac = 0;
+    pll->rejects = 0;
+    pll->locked = true;
+    pll->locks++;
+    pll->accepted++;
+    return true;
+}
+
+static bool DIMMER_ISR_ATTR reject(zc_pll_t *pll, uint32_t now_us)
+{
+    pll->rejected++;
+    if (++pll->rejects >= ZC_PLL_MAX_REJECTS) {
+        restart(pll, true, now_us);
+    }
+    return false;
+}
+
+bool DIMMER_ISR_ATTR zc_pll_edge(zc_pll_t *pll, uint32_t now_us)
+{
+    if (!pll->locked) {
+        return acquire(pll, now_us);
+    }
+
+    int32_t age = (int32_t) (now_us - pll->phase_us);
+    if (age > ZC_PLL_MAX_COAST * ZC_PLL_MAX_HALF_US || age < -ZC_PLL_MAX_HALF_US) {
+        restart(pll, true, now_us);
+        return false;
+    }
+
+    int32_t half = (int32_t) pll->half_cycle_q8;
+    int32_t offset = offset_q8(pll, now_us);
+    int32_t n = half_cycles(pll, offset);
+    int32_t error = offset - n * half;
+    int32_t window = half >> ZC_PLL_WINDOW_SHIFT;
+
+    // An edge for the crossing already accepted, or far from any
+    // prediction, is not a crossing
+    if (n <= 0 || error > window || error < -window) {
+        return reject(pll, now_us);
+    }
+
+    // Over n half-cycles the error built up n times over
+    int32_t corrected = half + (error / n) / (1 << ZC_PLL_PERIOD_SHIFT);
+    if (corrected < ZC_PLL_MIN_HALF_US << 8) {
+        corrected = ZC_PLL_MIN_HALF_US << 8;
+    } else if (corrected > ZC_PLL_MAX_HALF_US << 8) {
+        corrected = ZC_PLL_MAX_HALF_US << 8;
+    }
+    advance(pll, n * half + error / (1 << ZC_PLL_PHASE_SHIFT));
+    pll->half_cycle_q8 = (uint32_t) corrected;
+    pll->coasted += (uint32_t) (n - 1);
+    pll->rejects = 0;
+    pll->accepted++;
+    return true;
+}
+
+bool DIMMER_ISR_ATTR zc_pll_check(zc_pll_t *pll, uint32_t now_us)
+{
+    int32_t age = (int32_t) (now_us - pll->phase_us);
+
+    if (pll->locked && age > ZC_PLL_MAX_COAST * (int32_t) zc_pll_half_cycle_us(pll)) {
+        restart(pll, false, now_us);
+    }
+    return pll->locked;
+}
+
+uint32_t DIMMER_ISR_ATTR zc_pll_nearest(const zc_pll_t *pll, uint32_t t_us)
+{
+    int32_t n = half_cycles(pll, offset_q8(pll, t_us));
+    int32_t at = (int32_t) pll->phase_frac + n * (int32_t) pll->half_cycle_q8 + 128;
+
+    return pll->phase_us + (uint32_t) (at >> 8);
+}
+
+uint32_t DIMMER_ISR_ATTR zc_pll_half_cycle_us(const zc_pll_t *pll)
+{
+    return (pll->half_cycle_q8 + 128) >> 8;
+}
+
+uint32_t zc_pll_mains_mhz(const zc_pll_t *pll)
+{
+    // 1e6 / (2 * half-cycle) Hz, with the half-cycle in 1/256 us
+    return pll->locked ? (uint32_t) (128000000000ull / pll->half_cycle_q8) : 0;
+}
@@ -0,0 +1,525 @@
+/**
+ * @file endpoint_pool.c
+ * @brief Implementation of the broker endpoint pool.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the endpoint pool. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "ENDPOINT_POOL"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+
+#include "logging_stack.h"
+
+#include "endpoint_pool.h"
+
+/**
+ * @brief Weight of a new sample in the moving averages, as a shift:
+ * avg += ( sample - avg ) / 2^EWMA_SHIFT.
+ */
+#define EWMA_SHIFT    ( 3U )
+
+/*-----------------------------------------------------------*/
+
+static uint32_t ewma( uint32_t average,
+                      uint32_t sample )
+{
+    int32_t delta;
+
+    if( average == 0U )
+    {
+        /* First sample, or an unmeasured endpoint. */
+        return ( sample == 0U ) ? 1U : sample;
+    }
+
+    delta = ( int32_t ) sample - ( int32_t ) average;
+
+    return ( uint32_t ) ( ( int32_t ) average + ( delta / ( int32_t ) ( 1U << EWMA_SHIFT ) ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isHeldOff( const Endpoint_t * pEndpoint,
+                       uint32_t nowMs )
+{
+    /* Wrap-safe comparison of nowMs against holdOffUntilMs. */
+    return ( pEndpoint->health.consecutiveFailures != 0U ) &&
+           ( ( int32_t ) ( pEndpoint->health.holdOffUntilMs - nowMs ) > 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t expectedCostMs( const Endpoint_t * pEndpoint )
+{
+    /* A standby connection saves the connect time of one session only, so
+     * it does not make its endpoint any cheaper to stay on. */
+    return pEndpoint->health.pubAckRttMs + pEndpoint->health.connectRttMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isMeasured( const Endpoint_t * pEndpoint )
+{
+    return ( pEndpoint->health.pubAckRttMs != 0U ) && ( pEndpoint->health.connectRttMs != 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isClearlyCheaper( const Endpoint_t * pCandidate,
+                              const Endpoint_t * pHome )
+{
+    uint32_t homeCostMs = expectedCostMs( pHome );
+    uint32_t gapMs = ( homeCostMs * ENDPOINT_POOL_SWITCH_GAP_PERCENT ) / 100U;
+
+    if( gapMs < ENDPOINT_POOL_SWITCH_MIN_GAP_MS )
+    {
+        gapMs = ENDPOINT_POOL_SWITCH_MIN_GAP_MS;
+    }
+
+    /* Only measurements on both sides count: an endpoint that has not
+     * carried a session yet has no PUBACK time and looks free. */
+    return isMeasured( pCandidate ) && isMeasured( pHome ) &&
+           ( ( expectedCostMs( pCandidate ) + gapMs ) < homeCostMs );
+}
+
+/*-----------------------------------------------------------*/
+
+static void closeConnection( EndpointPool_t * pPool,
+                             Endpoint_t * pEndpoint )
+{
+    if( pEndpoint->connected )
+    {
+        pPool->disconnect( pEndpoint );
+        pEndpoint->connected = false;
+    }
+
+    if( pPool->pActive == pEndpoint )
+    {
+        pPool->pActive = NULL;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void holdOff( EndpointPool_t * pPool,
+                     Endpoint_t * pEndpoint )
+{
+    EndpointHealth_t * pHealth = &pEndpoint->health;
+    uint32_t holdOffMs = ENDPOINT_POOL_BASE_HOLDOFF_MS;
+    uint32_t i;
+
+    pHealth->failures++;
+    pHealth->consecutiveFailures++;
+
+    for( i = 1U; ( i < pHealth->consecutiveFailures ) && ( holdOffMs < ENDPOINT_POOL_MAX_HOLDOFF_MS ); i++ )
+    {
+        holdOffMs *= 2U;
+    }
+
+    if( holdOffMs > ENDPOINT_POOL_MAX_HOLDOFF_MS )
+    {
+        holdOffMs = ENDPOINT_POOL_MAX_HOLDOFF_MS;
+    }
+
+    pHealth->holdOffUntilMs = pPool->getTimeMs() + holdOffMs;
+
+    LogWarn( ( "Endpoint %s:%u failed %u time(s) in a row, holding off for %u ms.",
+               pEndpoint->pHostName,
+               ( unsigned ) pEndpoint->port,
+               ( unsigned ) pHealth->consecutiveFailures,
+               ( unsigned ) holdOffMs ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool openConnection( EndpointPool_t * pPool,
+                            Endpoint_t * pEndpoint )
+{
+    uint32_t startMs = pPool->getTimeMs();
+
+    if( !pPool->connect( pEndpoint ) )
+    {
+        holdOff( pPool, pEndpoint );
+        return false;
+    }
+
+    pEndpoint->connected = true;
+    pEndpoint->connectedAtMs = pPool->getTimeMs();
+    pEndpoint->health.connectRttMs = ewma( pEndpoint->health.connectRttMs,
+                                           pEndpoint->connectedAtMs - startMs );
+    pEndpoint->health.connects++;
+    pEndpoint->health.consecutiveFailures = 0U;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isStandbyUsable( EndpointPool_t * pPool,
+                             Endpoint_t * pEndpoint,
+                             uint32_t nowMs )
+{
+    uint32_t ageMs = nowMs - pEndpoint->connectedAtMs;
+
+    if( ageMs >= ENDPOINT_POOL_WARM_MAX_AGE_MS )
+    {
+        LogInfo( ( "Standby connection to %s:%u is %u ms old, replacing it.",
+                   pEndpoint->pHostName,
+                   ( unsigned ) pEndpoint->port,
+                   ( unsigned ) ageMs ) );
+        return false;
+    }
+
+    /* Brokers close connections that do not send CONNECT in time, and
+     * nothing else is sent on a standby, so only ask whether it is open. */
+    if( ( pPool->keepAlive != NULL ) && !pPool->keepAlive( pEndpoint ) )
+    {
+        LogInfo( ( "Standby connection to %s:%u was closed after %u ms, replacing it.",
+                   pEndpoint->pHostName,
+                   ( unsigned ) pEndpoint->port,
+                   ( unsigned ) ageMs ) );
+        return false;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_Init( EndpointPool_t * pPool,
+                        EndpointConnect_t connect,
+                        EndpointDisconnect_t disconnect,
+                        EndpointKeepAlive_t keepAlive,
+                        EndpointGetTimeMs_t getTimeMs )
+{
+    assert( pPool != NULL );
+    assert( connect != NULL );
+    assert( disconnect != NULL );
+    assert( getTimeMs != NULL );
+
+    ( void ) memset( pPool, 0x00, sizeof( EndpointPool_t ) );
+    pPool->connect = connect;
+    pPool->disconnect = disconnect;
+    pPool->keepAlive = keepAlive;
+    pPool->getTimeMs = getTimeMs;
+}
+
+/*-----------------------------------------------------------*/
+
+Endpoint_t * EndpointPool_Add( EndpointPool_t * pPool,
+                               const char * pHostName,
+                               uint16_t port,
+                               NetworkContext_t * pNetworkContext )
+{
+    Endpoint_t * pEndpoint = NULL;
+
+    assert( pPool != NULL );
+    assert( pHostName != NULL );
+    assert( pNetworkContext != NULL );
+
+    if( pPool->count < ENDPOINT_POOL_MAX_ENDPOINTS )
+    {
+        pEndpoint = &pPool->endpoints[ pPool->count ];
+        ( void ) memset( pEndpoint, 0x00, sizeof( Endpoint_t ) );
+        pEndpoint->pHostName = pHostName;
+        pEndpoint->port = port;
+        pEndpoint->pNetworkContext = pNetworkContext;
+        pPool->count++;
+    }
+    else
+    {
+        LogError( ( "Endpoint pool is full, dropping %s:%u.",
+                    pHostName,
+                    ( unsigned ) port ) );
+    }
+
+    return pEndpoint;
+}
+
+/*-----------------------------------------------------------*/
+
+Endpoint_t * EndpointPool_Select( EndpointPool_t * pPool )
+{
+    Endpoint_t * pBest = NULL;
+    Endpoint_t * pSoonest = NULL;
+    Endpoint_t * pCheaper = NULL;
+    uint32_t nowMs;
+    size_t i;
+
+    assert( pPool != NULL );
+
+    nowMs = pPool->getTimeMs();
+
+    for( i = 0U; i < pPool->count; i++ )
+    {
+        Endpoint_t * pEndpoint = &pPool->endpoints[ i ];
+
+        if( isHeldOff( pEndpoint, nowMs ) )
+        {
+            if( ( pSoonest == NULL ) ||
+                ( ( int32_t ) ( pEndpoint->health.holdOffUntilMs - pSoonest->health.holdOffUntilMs ) < 0 ) )
+            {
+                pSoonest = pEndpoint;
+            }
+
+            continue;
+        }
+
+        if( ( pBest == NULL ) || ( expectedCostMs( pEndpoint ) < expectedCostMs( pBest ) ) )
+        {
+            pBest = pEndpoint;
+        }
+
+        if( ( pPool->pHome != NULL ) &&
+            ( pEndpoint != pPool->pHome ) &&
+            isClearlyCheaper( pEndpoint, pPool->pHome ) &&
+            ( ( pCheaper == NULL ) || ( expectedCostMs( pEndpoint ) < expectedCostMs( pCheaper ) ) ) )
+        {
+            pCheaper = pEndpoint;
+        }
+    }
+
+    if( ( pPool->pHome != NULL ) && !isHeldOff( pPool->pHome, nowMs ) )
+    {
+        /* Stay unless another endpoint is measurably faster. */
+        pBest = ( pCheaper != NULL ) ? pCheaper : pPool->pHome;
+    }
+
+    return ( pBest != NULL ) ? pBest : pSoonest;
+}
+
+/*-----------------------------------------------------------*/
+
+bool EndpointPool_IsAvailable( const EndpointPool_t * pPool,
+                               const Endpoint_t * pEndpoint )
+{
+    assert( pPool != NULL );
+    assert( pEndpoint != NULL );
+
+    return !isHeldOff( pEndpoint, pPool->getTimeMs() );
+}
+
+/*-----------------------------------------------------------*/
+
+bool EndpointPool_Connect( EndpointPool_t * pPool,
+                           Endpoint_t * pEndpoint )
+{
+    assert( pPool != NULL );
+    assert( pEndpoint != NULL );
+
+    if( ( pPool->pActive != NULL ) && ( pPool->pActive != pEndpoint ) )
+    {
+        closeConnection( pPool, pPool->pActive );
+    }
+
+    if( pEndpoint->connected && ( pEndpoint != pPool->pActive ) &&
+        !isStandbyUsable( pPool, pEndpoint, pPool->getTimeMs() ) )
+    {
+        closeConnection( pPool, pEndpoint );
+    }
+
+    if( pEndpoint->connected )
+    {
+        LogInfo( ( "Using standby connection to %s:%u.",
+                   pEndpoint->pHostName,
+                   ( unsigned ) pEndpoint->port ) );
+    }
+    else if( !openConnection( pPool, pEndpoint ) )
+    {
+        return false;
+    }
+    else
+    {
+        LogInfo( ( "Connected to %s:%u, average connect time %u ms.",
+                   pEndpoint->pHostName,
+                   ( unsigned ) pEndpoint->port,
+                   ( unsigned ) pEndpoint->health.connectRttMs ) );
+    }
+
+    if( ( pPool->pHome != NULL ) && ( pPool->pHome != pEndpoint ) )
+    {
+        LogInfo( ( "Moving from %s:%u to %s:%u, expected cost %u ms against %u ms.",
+                   pPool->pHome->pHostName,
+                   ( unsigned ) pPool->pHome->port,
+                   pEndpoint->pHostName,
+                   ( unsigned ) pEndpoint->port,
+                   ( unsigned ) expectedCostMs( pEndpoint ),
+                   ( unsigned ) expectedCostMs( pPool->pHome ) ) );
+    }
+
+    pPool->pActive = pEndpoint;
+    pPool->pHome = pEndpoint;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool EndpointPool_BindSession( EndpointPool_t * pPool,
+                               MQTTContext_t * pContext )
+{
+    Endpoint_t * pActive;
+
+    assert( pPool != NULL );
+    assert( pContext != NULL );
+    assert( pPool->pActive != NULL );
+
+    pActive = pPool->pActive;
+
+    if( pPool->pBound != pActive )
+    {
+        if( pPool->pBound != NULL )
+        {
+            /* Keep the publishes the other broker still owes a PUBACK for,
+             * so a clean session here does not drop them. */
+            ( void ) memcpy( pPool->pBound->outgoingPublishRecords,
+                             pContext->outgoingPublishRecords,
+                             sizeof( pContext->outgoingPublishRecords ) );
+            ( void ) memcpy( pPool->pBound->incomingPublishRecords,
+                             pContext->incomingPublishRecords,
+                             sizeof( pContext->incomingPublishRecords ) );
+        }
+
+        ( void ) memcpy( pContext->outgoingPublishRecords,
+                         pActive->outgoingPublishRecords,
+                         sizeof( pContext->outgoingPublishRecords ) );
+        ( void ) memcpy( pContext->incomingPublishRecords,
+                         pActive->incomingPublishRecords,
+                         sizeof( pContext->incomingPublishRecords ) );
+        pPool->pBound = pActive;
+    }
+
+    return pActive->sessionPresent;
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_SessionOpened( EndpointPool_t * pPool )
+{
+    assert( pPool != NULL );
+    assert( pPool->pActive != NULL );
+
+    pPool->pActive->sessionPresent = true;
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_ForgetSession( EndpointPool_t * pPool,
+                                 Endpoint_t * pEndpoint )
+{
+    assert( pPool != NULL );
+    assert( pEndpoint != NULL );
+    assert( pEndpoint != pPool->pBound );
+
+    ( void ) pPool;
+
+    pEndpoint->sessionPresent = false;
+    ( void ) memset( pEndpoint->outgoingPublishRecords, 0x00, sizeof( pEndpoint->outgoingPublishRecords ) );
+    ( void ) memset( pEndpoint->incomingPublishRecords, 0x00, sizeof( pEndpoint->incomingPublishRecords ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_RecordFailure( EndpointPool_t * pPool,
+                                 Endpoint_t * pEndpoint )
+{
+    assert( pPool != NULL );
+    assert( pEndpoint != NULL );
+
+    closeConnection( pPool, pEndpoint );
+    holdOff( pPool, pEndpoint );
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_RecordPubAck( EndpointPool_t * pPool,
+                                uint32_t rttMs )
+{
+    assert( pPool != NULL );
+
+    if( pPool->pActive != NULL )
+    {
+        pPool->pActive->health.pubAckRttMs = ewma( pPool->pActive->health.pubAckRttMs, rttMs );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_Release( EndpointPool_t * pPool )
+{
+    assert( pPool != NULL );
+
+    if( pPool->pActive != NULL )
+    {
+        closeConnection( pPool, pPool->pActive );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void EndpointPool_WarmStandby( EndpointPool_t * pPool )
+{
+    Endpoint_t * pCandidate = NULL;
+    Endpoint_t * pWarm = NULL;
+    uint32_t nowMs;
+    size_t i;
+
+    assert( pPool != NULL );
+
+    nowMs = pPool->getTimeMs();
+
+    for( i = 0U; i < pPool->count; i++ )
+    {
+        Endpoint_t * pEndpoint = &pPool->endpoints[ i ];
+
+        if( pEndpoint == pPool->pActive )
+        {
+            continue;
+        }
+
+        if( pEndpoint->connected )
+        {
+            if( ( pWarm == NULL ) && isStandbyUsable( pPool, pEndpoint, nowMs ) )
+            {
+                pWarm = pEndpoint;
+            }
+            else
+            {
+                /* Closed, too old, or a second standby: do not hand it to
+                 * the MQTT session. */
+                closeConnection( pPool, pEndpoint );
+            }
+        }
+
+        if( !isHeldOff( pEndpoint, nowMs ) &&
+            ( ( pCandidate == NULL ) || ( expectedCostMs( pEndpoint ) < expectedCostMs( pCandidate ) ) ) )
+        {
+            pCandidate = pEndpoint;
+        }
+    }
+
+    if( ( pWarm != NULL ) && ( pWarm != pCandidate ) && ( pCandidate != NULL ) )
+    {
+        closeConnection( pPool, pWarm );
+        pWarm = NULL;
+    }
+
+    if( ( pWarm == NULL ) && ( pCandidate != NULL ) )
+    {
+        if( openConnection( pPool, pCandidate ) )
+        {
+            LogInfo( ( "Standby connection to %s:%u ready.",
+                       pCandidate->pHostName,
+                       ( unsigned ) pCandidate->port ) );
+        }
+    }
+}
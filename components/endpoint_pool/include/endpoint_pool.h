@@ -0,0 +1,266 @@
+/**
+ * @file endpoint_pool.h
+ * @brief List of broker endpoints with health tracking, latency-based
+ * selection and a pre-connected standby for fast failover.
+ *
+ * The pool does not know how to open a connection; the application supplies
+ * connect and disconnect callbacks and one network context per endpoint.
+ * This keeps the selection logic free of any TLS or RTOS dependency.
+ *
+ * Each broker keeps its own MQTT session, so the pool also keeps the MQTT
+ * state of each endpoint and swaps it into the one MQTT context as the
+ * session moves between brokers.
+ */
+
+#ifndef ENDPOINT_POOL_H_
+#define ENDPOINT_POOL_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* NetworkContext_t and MQTTContext_t declarations. */
+#include "core_mqtt.h"
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Maximum number of endpoints in a pool.
+ */
+#ifndef ENDPOINT_POOL_MAX_ENDPOINTS
+    #define ENDPOINT_POOL_MAX_ENDPOINTS    ( 4U )
+#endif
+
+/**
+ * @brief Time an endpoint is skipped after its first failure. Doubles with
+ * every consecutive failure up to #ENDPOINT_POOL_MAX_HOLDOFF_MS.
+ */
+#ifndef ENDPOINT_POOL_BASE_HOLDOFF_MS
+    #define ENDPOINT_POOL_BASE_HOLDOFF_MS    ( 2000U )
+#endif
+
+/**
+ * @brief Upper bound of the failure hold-off.
+ */
+#ifndef ENDPOINT_POOL_MAX_HOLDOFF_MS
+    #define ENDPOINT_POOL_MAX_HOLDOFF_MS    ( 60000U )
+#endif
+
+/**
+ * @brief Age after which a standby connection is re-established even though
+ * it passes its keep-alive check. Without a keep-alive callback this is all
+ * that catches a broker closing a connection that did not send CONNECT in
+ * time, so it must then be shorter than the broker allows for that.
+ */
+#ifndef ENDPOINT_POOL_WARM_MAX_AGE_MS
+    #define ENDPOINT_POOL_WARM_MAX_AGE_MS    ( 600000U )
+#endif
+
+/**
+ * @brief Smallest gap, relative to the cost of the endpoint in use, by which
+ * another endpoint must be measured faster before the session moves to it.
+ */
+#ifndef ENDPOINT_POOL_SWITCH_GAP_PERCENT
+    #define ENDPOINT_POOL_SWITCH_GAP_PERCENT    ( 25U )
+#endif
+
+/**
+ * @brief Smallest gap in milliseconds by which another endpoint must be
+ * measured faster before the session moves to it, so that jitter on fast
+ * links does not move it either.
+ */
+#ifndef ENDPOINT_POOL_SWITCH_MIN_GAP_MS
+    #define ENDPOINT_POOL_SWITCH_MIN_GAP_MS    ( 50U )
+#endif
+
+/**
+ * @brief Health and latency of one endpoint. Round-trip times are
+ * exponentially weighted moving averages; 0 means not measured yet.
+ */
+typedef struct EndpointHealth
+{
+    uint32_t connectRttMs;        /**< @brief TCP+TLS connection setup time. */
+    uint32_t pubAckRttMs;         /**< @brief PUBLISH to PUBACK time. */
+    uint32_t consecutiveFailures;
+    uint32_t holdOffUntilMs;      /**< @brief Not selected before this time. */
+    uint32_t connects;
+    uint32_t failures;
+} EndpointHealth_t;
+
+/**
+ * @brief One broker endpoint.
+ */
+typedef struct Endpoint
+{
+    const char * pHostName;
+    uint16_t port;
+    NetworkContext_t * pNetworkContext; /**< @brief Owned by the application. */
+    EndpointHealth_t health;
+    bool connected;                     /**< @brief pNetworkContext holds a live connection. */
+    uint32_t connectedAtMs;
+    bool sessionPresent;                /**< @brief An MQTT session was opened here, so CONNECT asks to resume it. */
+
+    /**
+     * @brief MQTT state of the session with this endpoint, saved while
+     * another endpoint holds the MQTT context.
+     */
+    MQTTPubAckInfo_t outgoingPublishRecords[ MQTT_STATE_ARRAY_MAX_COUNT ];
+    MQTTPubAckInfo_t incomingPublishRecords[ MQTT_STATE_ARRAY_MAX_COUNT ];
+} Endpoint_t;
+
+/**
+ * @brief Open a connection to pEndpoint on pEndpoint->pNetworkContext.
+ *
+ * @return true on success.
+ */
+typedef bool ( * EndpointConnect_t )( Endpoint_t * pEndpoint );
+
+/**
+ * @brief Close the connection held by pEndpoint->pNetworkContext.
+ */
+typedef void ( * EndpointDisconnect_t )( Endpoint_t * pEndpoint );
+
+/**
+ * @brief Check that the connection held by pEndpoint->pNetworkContext is
+ * still open, without sending on it or blocking.
+ *
+ * @return false if the broker has closed it.
+ */
+typedef bool ( * EndpointKeepAlive_t )( Endpoint_t * pEndpoint );
+
+/**
+ * @brief Millisecond clock; only differences are used.
+ */
+typedef uint32_t ( * EndpointGetTimeMs_t )( void );
+
+typedef struct EndpointPool
+{
+    Endpoint_t endpoints[ ENDPOINT_POOL_MAX_ENDPOINTS ];
+    size_t count;
+    Endpoint_t * pActive;               /**< @brief Endpoint carrying the MQTT session, if any. */
+    Endpoint_t * pHome;                 /**< @brief Endpoint sessions stay on until it fails or another is measured faster. */
+    Endpoint_t * pBound;                /**< @brief Endpoint whose MQTT state the MQTT context holds. */
+    EndpointConnect_t connect;
+    EndpointDisconnect_t disconnect;
+    EndpointKeepAlive_t keepAlive;      /**< @brief May be NULL. */
+    EndpointGetTimeMs_t getTimeMs;
+} EndpointPool_t;
+
+/**
+ * @brief Initialize an empty pool.
+ *
+ * keepAlive may be NULL, in which case standby connections are only
+ * replaced by age.
+ */
+void EndpointPool_Init( EndpointPool_t * pPool,
+                        EndpointConnect_t connect,
+                        EndpointDisconnect_t disconnect,
+                        EndpointKeepAlive_t keepAlive,
+                        EndpointGetTimeMs_t getTimeMs );
+
+/**
+ * @brief Append an endpoint. Earlier endpoints win ties in selection.
+ *
+ * @return The new endpoint, or NULL if the pool is full.
+ */
+Endpoint_t * EndpointPool_Add( EndpointPool_t * pPool,
+                               const char * pHostName,
+                               uint16_t port,
+                               NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Pick the endpoint to use next.
+ *
+ * The endpoint of the last session is kept unless it is held off after a
+ * failure, or another endpoint has been measured cheaper by the larger of
+ * #ENDPOINT_POOL_SWITCH_GAP_PERCENT and #ENDPOINT_POOL_SWITCH_MIN_GAP_MS.
+ * The cost of an endpoint is its PUBACK round trip plus its connect time,
+ * whether or not a standby connection is open, since a standby saves the
+ * connect time once only.
+ *
+ * Otherwise the available endpoint with the lowest cost wins; unmeasured
+ * ones count only what has been measured so they get tried. If every
+ * endpoint is held off, the one whose hold-off ends first is returned.
+ *
+ * @return NULL only if the pool is empty.
+ */
+Endpoint_t * EndpointPool_Select( EndpointPool_t * pPool );
+
+/**
+ * @brief Check whether pEndpoint is outside its failure hold-off.
+ */
+bool EndpointPool_IsAvailable( const EndpointPool_t * pPool,
+                               const Endpoint_t * pEndpoint );
+
+/**
+ * @brief Make pEndpoint the active endpoint, reusing its standby connection
+ * if it has one that passes its keep-alive check and is younger than
+ * #ENDPOINT_POOL_WARM_MAX_AGE_MS, and opening a new one otherwise.
+ *
+ * @return true if pEndpoint is connected and active.
+ */
+bool EndpointPool_Connect( EndpointPool_t * pPool,
+                           Endpoint_t * pEndpoint );
+
+/**
+ * @brief Load the MQTT state of the active endpoint into pContext, saving
+ * the state pContext held for the endpoint bound before. Call after
+ * EndpointPool_Connect() and before MQTT_Connect().
+ *
+ * Packet identifiers are not swapped, so they stay unique across endpoints.
+ *
+ * @return true if a session was opened on the active endpoint before, so
+ * CONNECT should ask to resume it instead of starting a clean one.
+ */
+bool EndpointPool_BindSession( EndpointPool_t * pPool,
+                               MQTTContext_t * pContext );
+
+/**
+ * @brief Record that the active endpoint accepted CONNECT.
+ */
+void EndpointPool_SessionOpened( EndpointPool_t * pPool );
+
+/**
+ * @brief Give up the session saved for pEndpoint, which must not be bound:
+ * its saved MQTT state is dropped and the next CONNECT there is clean.
+ */
+void EndpointPool_ForgetSession( EndpointPool_t * pPool,
+                                 Endpoint_t * pEndpoint );
+
+/**
+ * @brief Report that the session on pEndpoint failed. Its connection is
+ * closed and it is held off for a while.
+ */
+void EndpointPool_RecordFailure( EndpointPool_t * pPool,
+                                 Endpoint_t * pEndpoint );
+
+/**
+ * @brief Feed a PUBLISH to PUBACK round trip measured on the active endpoint.
+ */
+void EndpointPool_RecordPubAck( EndpointPool_t * pPool,
+                                uint32_t rttMs );
+
+/**
+ * @brief Close the active connection once the session is over.
+ */
+void EndpointPool_Release( EndpointPool_t * pPool );
+
+/**
+ * @brief Keep one connection open to the best endpoint other than the
+ * active one, replacing it when it fails its keep-alive check or gets older
+ * than #ENDPOINT_POOL_WARM_MAX_AGE_MS.
+ */
+void EndpointPool_WarmStandby( EndpointPool_t * pPool );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef ENDPOINT_POOL_H_ */
@@ -0,0 +1,488 @@
+/**
+ * @file fault_transport.c
+ * @brief Implementation of the fault-injecting transport decorator.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the fault transport. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "FAULT_TRANSPORT"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+
+#include "logging_stack.h"
+
+#include "fault_transport.h"
+
+/* Clock for delays and throttling. */
+#include "clock.h"
+
+/**
+ * @brief Length of the burst allowed by the bandwidth cap, in milliseconds
+ * of traffic.
+ */
+#define BANDWIDTH_BURST_MS    ( 100U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decorators in use, looked up by network context.
+ */
+static FaultTransport_t * pInstances[ FAULT_TRANSPORT_MAX_INSTANCES ] = { 0 };
+
+/**
+ * @brief Built-in scenarios. Seeds differ so scenarios do not share a fault
+ * sequence.
+ */
+static const FaultTransportConfig_t scenarios[] =
+{
+    /* pName       seed  latency jitter short  zero   disc  connect bandwidth */
+    { "clean",     1U,   0U,     0U,    0U,    0U,    0U,   0U,     0U     },
+    { "wifi_good", 2U,   5U,     10U,   20U,   10U,   0U,   0U,     0U     },
+    { "wifi_poor", 3U,   40U,    80U,   150U,  80U,   1U,   100U,   20000U },
+    { "congested", 4U,   20U,    200U,  300U,  200U,  0U,   50U,    4000U  },
+    { "flapping",  5U,   10U,    20U,   50U,   20U,   20U,  300U,   0U     },
+};
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextRandom( FaultTransport_t * pFault )
+{
+    /* xorshift32: small, fast and fully determined by the seed. */
+    uint32_t x = pFault->rngState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pFault->rngState = x;
+
+    return x;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool chance( FaultTransport_t * pFault,
+                    uint16_t permille )
+{
+    return ( permille != 0U ) && ( ( nextRandom( pFault ) % 1000U ) < permille );
+}
+
+/*-----------------------------------------------------------*/
+
+static FaultTransport_t * findInstance( const NetworkContext_t * pNetworkContext )
+{
+    FaultTransport_t * pFault = NULL;
+    size_t i;
+
+    for( i = 0; i < FAULT_TRANSPORT_MAX_INSTANCES; i++ )
+    {
+        if( ( pInstances[ i ] != NULL ) &&
+            ( pInstances[ i ]->inner.pNetworkContext == pNetworkContext ) )
+        {
+            pFault = pInstances[ i ];
+            break;
+        }
+    }
+
+    return pFault;
+}
+
+/*-----------------------------------------------------------*/
+
+static void injectDelay( FaultTransport_t * pFault )
+{
+    uint32_t delayMs = pFault->config.latencyMs;
+
+    if( pFault->config.jitterMs != 0U )
+    {
+        delayMs += nextRandom( pFault ) % ( pFault->config.jitterMs + 1U );
+    }
+
+    if( delayMs != 0U )
+    {
+        pFault->stats.delayMs += delayMs;
+        Clock_SleepMs( delayMs );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t throttle( FaultTransport_t * pFault,
+                        size_t bytes )
+{
+    uint32_t rate = pFault->config.bandwidthBytesPerSec;
+    uint32_t burst, now, elapsedMs, waitMs;
+    uint64_t refill;
+
+    if( rate == 0U )
+    {
+        return bytes;
+    }
+
+    burst = ( rate * BANDWIDTH_BURST_MS ) / 1000U;
+    burst = ( burst == 0U ) ? 1U : burst;
+    bytes = ( bytes > burst ) ? burst : bytes;
+
+    now = Clock_GetTimeMs();
+    elapsedMs = now - pFault->lastRefillMs;
+    pFault->lastRefillMs = now;
+
+    /* Refill in 64-bit to avoid overflowing on long idle periods. */
+    refill = ( ( uint64_t ) elapsedMs * rate ) / 1000U;
+    pFault->tokens = ( ( pFault->tokens + refill ) > burst ) ? burst : ( uint32_t ) ( pFault->tokens + refill );
+
+    if( pFault->tokens < bytes )
+    {
+        /* Wait for exactly the missing bytes; the link is busy meanwhile. */
+        waitMs = ( uint32_t ) ( ( ( uint64_t ) ( bytes - pFault->tokens ) * 1000U + rate - 1U ) / rate );
+        pFault->stats.delayMs += waitMs;
+        Clock_SleepMs( waitMs );
+        pFault->lastRefillMs = Clock_GetTimeMs();
+        pFault->tokens = ( uint32_t ) bytes;
+    }
+
+    pFault->tokens -= ( uint32_t ) bytes;
+
+    return bytes;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Apply the per-call impairments shared by send and receive.
+ *
+ * @return Number of bytes to pass to the inner transport, or 0 with
+ * *pResult set when the call is answered without reaching it.
+ */
+static size_t impair( FaultTransport_t * pFault,
+                      size_t bytes,
+                      int32_t * pResult )
+{
+    injectDelay( pFault );
+
+    if( pFault->disconnected == true )
+    {
+        *pResult = -1;
+        return 0U;
+    }
+
+    if( chance( pFault, pFault->config.disconnectPermille ) )
+    {
+        LogWarn( ( "Injecting a disconnect." ) );
+        pFault->stats.disconnects++;
+        pFault->disconnected = true;
+        *pResult = -1;
+        return 0U;
+    }
+
+    if( chance( pFault, pFault->config.zeroReturnPermille ) )
+    {
+        pFault->stats.zeroReturns++;
+        *pResult = 0;
+        return 0U;
+    }
+
+    if( ( bytes > 1U ) && chance( pFault, pFault->config.shortIoPermille ) )
+    {
+        pFault->stats.shortIos++;
+        bytes = 1U + ( nextRandom( pFault ) % ( bytes - 1U ) );
+    }
+
+    return throttle( pFault, bytes );
+}
+
+/*-----------------------------------------------------------*/
+
+bool FaultTransport_Init( FaultTransport_t * pFault,
+                          const TransportInterface_t * pInner,
+                          const FaultTransportConfig_t * pConfig,
+                          TransportInterface_t * pDecorated )
+{
+    size_t i;
+
+    assert( pFault != NULL );
+    assert( pInner != NULL );
+    assert( pConfig != NULL );
+    assert( pDecorated != NULL );
+
+    for( i = 0; i < FAULT_TRANSPORT_MAX_INSTANCES; i++ )
+    {
+        if( pInstances[ i ] == NULL )
+        {
+            break;
+        }
+    }
+
+    if( i == FAULT_TRANSPORT_MAX_INSTANCES )
+    {
+        LogError( ( "No free fault transport slot." ) );
+        return false;
+    }
+
+    ( void ) memset( pFault, 0x00, sizeof( *pFault ) );
+    pFault->inner = *pInner;
+    FaultTransport_SetConfig( pFault, pConfig );
+    pInstances[ i ] = pFault;
+
+    pDecorated->pNetworkContext = pInner->pNetworkContext;
+    pDecorated->send = FaultTransport_Send;
+    pDecorated->recv = FaultTransport_Recv;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultTransport_Deinit( FaultTransport_t * pFault )
+{
+    size_t i;
+
+    for( i = 0; i < FAULT_TRANSPORT_MAX_INSTANCES; i++ )
+    {
+        if( pInstances[ i ] == pFault )
+        {
+            pInstances[ i ] = NULL;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultTransport_Rebind( FaultTransport_t * pFault,
+                            NetworkContext_t * pNetworkContext,
+                            TransportInterface_t * pDecorated )
+{
+    assert( pFault != NULL );
+    assert( pNetworkContext != NULL );
+    assert( pDecorated != NULL );
+
+    pFault->inner.pNetworkContext = pNetworkContext;
+    pDecorated->pNetworkContext = pNetworkContext;
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultTransport_SetConfig( FaultTransport_t * pFault,
+                               const FaultTransportConfig_t * pConfig )
+{
+    assert( pFault != NULL );
+    assert( pConfig != NULL );
+
+    pFault->config = *pConfig;
+    pFault->rngState = ( pConfig->seed != 0U ) ? pConfig->seed : 1U;
+    pFault->tokens = 0U;
+    pFault->lastRefillMs = Clock_GetTimeMs();
+    pFault->disconnected = false;
+    ( void ) memset( &pFault->stats, 0x00, sizeof( pFault->stats ) );
+}
+
+/*-----------------------------------------------------------*/
+
+bool FaultTransport_ShouldFailConnect( FaultTransport_t * pFault )
+{
+    bool fail;
+
+    assert( pFault != NULL );
+
+    injectDelay( pFault );
+    fail = chance( pFault, pFault->config.connectFailPermille );
+
+    if( fail )
+    {
+        pFault->stats.connectFailures++;
+    }
+
+    return fail;
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultTransport_Reconnected( FaultTransport_t * pFault )
+{
+    assert( pFault != NULL );
+
+    pFault->disconnected = false;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t FaultTransport_Send( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend )
+{
+    FaultTransport_t * pFault = findInstance( pNetworkContext );
+    int32_t result = 0;
+    size_t bytes;
+
+    if( pFault == NULL )
+    {
+        return -1;
+    }
+
+    pFault->stats.sendCalls++;
+    bytes = impair( pFault, bytesToSend, &result );
+
+    if( bytes != 0U )
+    {
+        result = pFault->inner.send( pNetworkContext, pBuffer, bytes );
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t FaultTransport_Recv( NetworkContext_t * pNetworkContext,
+                             void * pBuffer,
+                             size_t bytesToRecv )
+{
+    FaultTransport_t * pFault = findInstance( pNetworkContext );
+    int32_t result = 0;
+    size_t bytes;
+
+    if( pFault == NULL )
+    {
+        return -1;
+    }
+
+    pFault->stats.recvCalls++;
+    bytes = impair( pFault, bytesToRecv, &result );
+
+    if( bytes != 0U )
+    {
+        result = pFault->inner.recv( pNetworkContext, pBuffer, bytes );
+
+        /* Only bytes that actually arrived use up the bandwidth budget. */
+        if( ( result >= 0 ) && ( ( size_t ) result < bytes ) && ( pFault->config.bandwidthBytesPerSec != 0U ) )
+        {
+            pFault->tokens += ( uint32_t ) ( bytes - ( size_t ) result );
+        }
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+const FaultTransportConfig_t * FaultTransport_Scenarios( size_t * pCount )
+{
+    assert( pCount != NULL );
+
+    *pCount = sizeof( scenarios ) / sizeof( scenarios[ 0 ] );
+
+    return scenarios;
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultReport_RecordPublish( FaultScenarioReport_t * pReport )
+{
+    assert( pReport != NULL );
+
+    pReport->publishAttempts++;
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultReport_RecordAck( FaultScenarioReport_t * pReport,
+                            uint32_t latencyMs )
+{
+    assert( pReport != NULL );
+
+    pReport->publishAcked++;
+    pReport->latencyMs[ pReport->latencyCount % FAULT_REPORT_LATENCY_SAMPLES ] = latencyMs;
+    pReport->latencyCount++;
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultReport_RecordReconnect( FaultScenarioReport_t * pReport,
+                                  uint32_t durationMs,
+                                  bool success )
+{
+    assert( pReport != NULL );
+
+    if( success )
+    {
+        pReport->reconnects++;
+        pReport->reconnectTotalMs += durationMs;
+
+        if( durationMs > pReport->reconnectMaxMs )
+        {
+            pReport->reconnectMaxMs = durationMs;
+        }
+    }
+    else
+    {
+        pReport->reconnectFailures++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int compareLatency( const void * pA,
+                           const void * pB )
+{
+    uint32_t a = *( const uint32_t * ) pA;
+    uint32_t b = *( const uint32_t * ) pB;
+
+    return ( a > b ) - ( a < b );
+}
+
+/*-----------------------------------------------------------*/
+
+void FaultReport_Log( const FaultScenarioReport_t * pReport,
+                      const FaultTransport_t * pFault )
+{
+    static uint32_t sorted[ FAULT_REPORT_LATENCY_SAMPLES ];
+    size_t count;
+    uint32_t p50 = 0U, p95 = 0U, p99 = 0U;
+
+    assert( pReport != NULL );
+    assert( pFault != NULL );
+
+    count = ( pReport->latencyCount < FAULT_REPORT_LATENCY_SAMPLES ) ?
+            pReport->latencyCount : FAULT_REPORT_LATENCY_SAMPLES;
+
+    if( count > 0U )
+    {
+        ( void ) memcpy( sorted, pReport->latencyMs, count * sizeof( sorted[ 0 ] ) );
+        qsort( sorted, count, sizeof( sorted[ 0 ] ), compareLatency );
+        p50 = sorted[ ( count * 50U ) / 100U ];
+        p95 = sorted[ ( count * 95U ) / 100U ];
+        p99 = sorted[ ( count * 99U ) / 100U ];
+    }
+
+    LogInfo( ( "Scenario %s: %u/%u publishes acked (%u%%), latency p50 %u ms p95 %u ms p99 %u ms.",
+               pFault->config.pName != NULL ? pFault->config.pName : "custom",
+               ( unsigned ) pReport->publishAcked,
+               ( unsigned ) pReport->publishAttempts,
+               ( unsigned ) ( pReport->publishAttempts ? ( pReport->publishAcked * 100U ) / pReport->publishAttempts : 0U ),
+               ( unsigned ) p50,
+               ( unsigned ) p95,
+               ( unsigned ) p99 ) );
+    LogInfo( ( "Scenario %s: %u reconnects (avg %u ms, max %u ms), %u failed.",
+               pFault->config.pName != NULL ? pFault->config.pName : "custom",
+               ( unsigned ) pReport->reconnects,
+               ( unsigned ) ( pReport->reconnects ? pReport->reconnectTotalMs / pReport->reconnects : 0U ),
+               ( unsigned ) pReport->reconnectMaxMs,
+               ( unsigned ) pReport->reconnectFailures ) );
+    LogInfo( ( "Injected: %u short I/O, %u zero returns, %u disconnects, %u connect failures, %u ms delay "
+               "over %u sends and %u receives.",
+               ( unsigned ) pFault->stats.shortIos,
+               ( unsigned ) pFault->stats.zeroReturns,
+               ( unsigned ) pFault->stats.disconnects,
+               ( unsigned ) pFault->stats.connectFailures,
+               ( unsigned ) pFault->stats.delayMs,
+               ( unsigned ) pFault->stats.sendCalls,
+               ( unsigned ) pFault->stats.recvCalls ) );
+}
@@ -0,0 +1,208 @@
+/**
+ * @file fault_transport.h
+ * @brief Transport decorator that injects latency, jitter, short reads and
+ * writes, zero-byte returns, disconnects and bandwidth limits in front of any
+ * TransportInterface_t.
+ *
+ * All decisions come from a seeded xorshift generator, so a scenario replays
+ * identically for a given seed and call sequence.
+ */
+
+#ifndef FAULT_TRANSPORT_H_
+#define FAULT_TRANSPORT_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Transport interface include. */
+#include "transport_interface.h"
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Maximum number of transports that can be decorated at the same time.
+ */
+#ifndef FAULT_TRANSPORT_MAX_INSTANCES
+    #define FAULT_TRANSPORT_MAX_INSTANCES    ( 2U )
+#endif
+
+/**
+ * @brief Number of publish-to-ack latencies kept for the tail percentiles.
+ */
+#ifndef FAULT_REPORT_LATENCY_SAMPLES
+    #define FAULT_REPORT_LATENCY_SAMPLES    ( 128U )
+#endif
+
+/**
+ * @brief Impairments applied by the decorator. Probabilities are in permille
+ * and are drawn independently for every transport call.
+ */
+typedef struct FaultTransportConfig
+{
+    const char * pName;            /**< @brief Scenario name used in reports. */
+    uint32_t seed;                 /**< @brief Seed of the fault generator; 0 is replaced by 1. */
+    uint32_t latencyMs;            /**< @brief Delay added before every call. */
+    uint32_t jitterMs;             /**< @brief Extra uniformly distributed delay, 0 to jitterMs. */
+    uint16_t shortIoPermille;      /**< @brief Calls truncated to a random shorter length. */
+    uint16_t zeroReturnPermille;   /**< @brief Calls that return 0 without reaching the transport. */
+    uint16_t disconnectPermille;   /**< @brief Calls that drop the connection. */
+    uint16_t connectFailPermille;  /**< @brief Connection attempts reported as failed. */
+    uint32_t bandwidthBytesPerSec; /**< @brief Shared send/receive rate cap; 0 for none. */
+} FaultTransportConfig_t;
+
+/**
+ * @brief Counts of what the decorator did.
+ */
+typedef struct FaultTransportStats
+{
+    uint32_t sendCalls;
+    uint32_t recvCalls;
+    uint32_t shortIos;
+    uint32_t zeroReturns;
+    uint32_t disconnects;
+    uint32_t connectFailures;
+    uint32_t delayMs;              /**< @brief Total latency, jitter and throttling added. */
+} FaultTransportStats_t;
+
+/**
+ * @brief State of one decorated transport.
+ */
+typedef struct FaultTransport
+{
+    TransportInterface_t inner;
+    FaultTransportConfig_t config;
+    FaultTransportStats_t stats;
+    uint32_t rngState;
+    uint32_t tokens;               /**< @brief Bytes that may pass before throttling. */
+    uint32_t lastRefillMs;
+    bool disconnected;             /**< @brief Latched by an injected disconnect. */
+} FaultTransport_t;
+
+/**
+ * @brief Outcome counters for a scenario run, filled in by the application.
+ */
+typedef struct FaultScenarioReport
+{
+    uint32_t publishAttempts;
+    uint32_t publishAcked;
+    uint32_t reconnects;
+    uint32_t reconnectFailures;
+    uint32_t reconnectTotalMs;
+    uint32_t reconnectMaxMs;
+    uint32_t latencyCount;         /**< @brief Total acks seen; only the last samples are kept. */
+    uint32_t latencyMs[ FAULT_REPORT_LATENCY_SAMPLES ];
+} FaultScenarioReport_t;
+
+/**
+ * @brief Decorate a transport.
+ *
+ * The decorated interface keeps the inner network context, which is how the
+ * send and receive wrappers find their FaultTransport_t. pInner and
+ * pDecorated may point to the same interface.
+ *
+ * @param[out] pFault Decorator state; must stay valid until FaultTransport_Deinit().
+ * @param[in] pInner Transport to wrap.
+ * @param[in] pConfig Impairments to apply.
+ * @param[out] pDecorated Interface to hand to MQTT_Init().
+ *
+ * @return false if all #FAULT_TRANSPORT_MAX_INSTANCES slots are in use.
+ */
+bool FaultTransport_Init( FaultTransport_t * pFault,
+                          const TransportInterface_t * pInner,
+                          const FaultTransportConfig_t * pConfig,
+                          TransportInterface_t * pDecorated );
+
+/**
+ * @brief Release the slot taken by FaultTransport_Init().
+ */
+void FaultTransport_Deinit( FaultTransport_t * pFault );
+
+/**
+ * @brief Point the decorator at another network context of the same inner
+ * transport, e.g. after failing over to a different broker. pDecorated is
+ * the interface returned by FaultTransport_Init(), or the copy of it the
+ * MQTT context holds.
+ */
+void FaultTransport_Rebind( FaultTransport_t * pFault,
+                            NetworkContext_t * pNetworkContext,
+                            TransportInterface_t * pDecorated );
+
+/**
+ * @brief Switch to another set of impairments and reseed the generator.
+ */
+void FaultTransport_SetConfig( FaultTransport_t * pFault,
+                               const FaultTransportConfig_t * pConfig );
+
+/**
+ * @brief Decide whether the next connection attempt should be failed.
+ *
+ * The transport connect function sits outside TransportInterface_t, so the
+ * caller asks before connecting and treats true as a connect failure.
+ */
+bool FaultTransport_ShouldFailConnect( FaultTransport_t * pFault );
+
+/**
+ * @brief Clear an injected disconnect once the caller has reconnected.
+ */
+void FaultTransport_Reconnected( FaultTransport_t * pFault );
+
+/**
+ * @brief TransportSend_t wrapper installed by FaultTransport_Init().
+ */
+int32_t FaultTransport_Send( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend );
+
+/**
+ * @brief TransportRecv_t wrapper installed by FaultTransport_Init().
+ */
+int32_t FaultTransport_Recv( NetworkContext_t * pNetworkContext,
+                             void * pBuffer,
+                             size_t bytesToRecv );
+
+/**
+ * @brief Built-in scenarios, from a clean link to a flapping one.
+ *
+ * @param[out] pCount Number of entries in the returned array.
+ */
+const FaultTransportConfig_t * FaultTransport_Scenarios( size_t * pCount );
+
+/**
+ * @brief Record a QoS1 publish attempt.
+ */
+void FaultReport_RecordPublish( FaultScenarioReport_t * pReport );
+
+/**
+ * @brief Record the time between a publish and its acknowledgment.
+ */
+void FaultReport_RecordAck( FaultScenarioReport_t * pReport,
+                            uint32_t latencyMs );
+
+/**
+ * @brief Record how long reconnecting after a failed session took and
+ * whether it succeeded.
+ */
+void FaultReport_RecordReconnect( FaultScenarioReport_t * pReport,
+                                  uint32_t durationMs,
+                                  bool success );
+
+/**
+ * @brief Log success rate, reconnect time and latency percentiles of a run
+ * together with what the decorator injected.
+ */
+void FaultReport_Log( const FaultScenarioReport_t * pReport,
+                      const FaultTransport_t * pFault );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef FAULT_TRANSPORT_H_ */
@@ -0,0 +1,118 @@
+/**
+ * @file json_writer.h
+ * @brief Streaming JSON writer into a caller-provided buffer.
+ *
+ * The writer never allocates. Values are appended in document order and
+ * commas are inserted automatically. If the buffer runs out the writer
+ * stops writing and JsonWriter_Finish() reports the overflow, so callers
+ * only need to check once at the end.
+ */
+
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Maximum nesting of objects and arrays.
+ */
+#define JSON_WRITER_MAX_DEPTH    ( 31U )
+
+typedef struct JsonWriter
+{
+    char * pBuffer;
+    size_t size;
+    size_t length;          /**< @brief Bytes written so far, excluding the terminator. */
+    uint32_t hasElements;   /**< @brief Bit n set once the container at depth n has an element. */
+    uint8_t depth;
+    bool failed;            /**< @brief Overflow or unbalanced nesting. */
+} JsonWriter_t;
+
+/**
+ * @brief Start a document in pBuffer.
+ */
+void JsonWriter_Init( JsonWriter_t * pWriter,
+                      char * pBuffer,
+                      size_t size );
+
+/**
+ * @brief Continue a document in pBuffer from a writer saved part way
+ * through it. The first pCheckpoint->length bytes of pBuffer must already
+ * hold what was written up to the checkpoint, so a constant leading part
+ * can be rendered once and only the rest written per document.
+ */
+void JsonWriter_Resume( JsonWriter_t * pWriter,
+                        const JsonWriter_t * pCheckpoint,
+                        char * pBuffer,
+                        size_t size );
+
+/**
+ * @brief Open an object. pKey is the member name inside an object and must
+ * be NULL at the top level or inside an array; the same applies to every
+ * value function below.
+ */
+void JsonWriter_BeginObject( JsonWriter_t * pWriter,
+                             const char * pKey );
+
+void JsonWriter_EndObject( JsonWriter_t * pWriter );
+
+void JsonWriter_BeginArray( JsonWriter_t * pWriter,
+                            const char * pKey );
+
+void JsonWriter_EndArray( JsonWriter_t * pWriter );
+
+/**
+ * @brief Write a string, escaping quotes, backslashes and control characters.
+ */
+void JsonWriter_String( JsonWriter_t * pWriter,
+                        const char * pKey,
+                        const char * pValue );
+
+void JsonWriter_Int( JsonWriter_t * pWriter,
+                     const char * pKey,
+                     int32_t value );
+
+void JsonWriter_Uint( JsonWriter_t * pWriter,
+                      const char * pKey,
+                      uint32_t value );
+
+/**
+ * @brief Write a fixed-point number: value / 10^decimals with exactly
+ * decimals digits after the point, e.g. (2345, 2) -> 23.45.
+ */
+void JsonWriter_Fixed( JsonWriter_t * pWriter,
+                       const char * pKey,
+                       int32_t value,
+                       uint8_t decimals );
+
+void JsonWriter_Bool( JsonWriter_t * pWriter,
+                      const char * pKey,
+                      bool value );
+
+void JsonWriter_Null( JsonWriter_t * pWriter,
+                      const char * pKey );
+
+/**
+ * @brief Terminate the buffer.
+ *
+ * @return Length of the document, or -1 if it did not fit or objects and
+ * arrays were not closed.
+ */
+int32_t JsonWriter_Finish( JsonWriter_t * pWriter );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef JSON_WRITER_H_ */
@@ -0,0 +1,351 @@
+/**
+ * @file json_writer.c
+ * @brief Implementation of the streaming JSON writer.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "json_writer.h"
+
+/*-----------------------------------------------------------*/
+
+static void put( JsonWriter_t * pWriter,
+                 const char * pData,
+                 size_t length )
+{
+    /* Keep one byte for the terminator written by JsonWriter_Finish(). */
+    if( pWriter->failed || ( length >= ( pWriter->size - pWriter->length ) ) )
+    {
+        pWriter->failed = true;
+        return;
+    }
+
+    ( void ) memcpy( &pWriter->pBuffer[ pWriter->length ], pData, length );
+    pWriter->length += length;
+}
+
+/*-----------------------------------------------------------*/
+
+static void putChar( JsonWriter_t * pWriter,
+                     char c )
+{
+    put( pWriter, &c, 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+static void putEscaped( JsonWriter_t * pWriter,
+                        const char * pText )
+{
+    static const char hex[] = "0123456789abcdef";
+    char escape[ 6 ] = { '\\', 'u', '0', '0', '0', '0' };
+    const char * pRun = pText;
+    const char * p;
+
+    putChar( pWriter, '"' );
+
+    for( p = pText; *p != '\0'; p++ )
+    {
+        unsigned char c = ( unsigned char ) *p;
+
+        if( ( c >= 0x20U ) && ( c != '"' ) && ( c != '\\' ) )
+        {
+            continue;
+        }
+
+        /* Copy the plain run before this character in one go. */
+        put( pWriter, pRun, ( size_t ) ( p - pRun ) );
+        pRun = p + 1;
+
+        switch( c )
+        {
+            case '"':
+                put( pWriter, "\\\"", 2U );
+                break;
+
+            case '\\':
+                put( pWriter, "\\\\", 2U );
+                break;
+
+            case '\n':
+                put( pWriter, "\\n", 2U );
+                break;
+
+            case '\r':
+                put( pWriter, "\\r", 2U );
+                break;
+
+            case '\t':
+                put( pWriter, "\\t", 2U );
+                break;
+
+            default:
+                escape[ 4 ] = hex[ c >> 4 ];
+                escape[ 5 ] = hex[ c & 0x0FU ];
+                put( pWriter, escape, sizeof( escape ) );
+                break;
+        }
+    }
+
+    put( pWriter, pRun, ( size_t ) ( p - pRun ) );
+    putChar( pWriter, '"' );
+}
+
+/*-----------------------------------------------------------*/
+
+static void putUnsigned( JsonWriter_t * pWriter,
+                         uint32_t value,
+                         uint8_t minDigits )
+{
+    char digits[ 10 ];
+    size_t count = 0U;
+
+    do
+    {
+        digits[ sizeof( digits ) - 1U - count ] = ( char ) ( '0' + ( value % 10U ) );
+        value /= 10U;
+        count++;
+    } while( ( value != 0U ) || ( count < minDigits ) );
+
+    put( pWriter, &digits[ sizeof( digits ) - count ], count );
+}
+
+/*-----------------------------------------------------------*/
+
+static void beginValue( JsonWriter_t * pWriter,
+                        const char * pKey )
+{
+    uint32_t bit = 1UL << pWriter->depth;
+
+    if( ( pWriter->hasElements & bit ) != 0U )
+    {
+        putChar( pWriter, ',' );
+    }
+
+    pWriter->hasElements |= bit;
+
+    if( pKey != NULL )
+    {
+        putEscaped( pWriter, pKey );
+        putChar( pWriter, ':' );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void openContainer( JsonWriter_t * pWriter,
+                           const char * pKey,
+                           char bracket )
+{
+    beginValue( pWriter, pKey );
+    putChar( pWriter, bracket );
+
+    if( pWriter->depth >= JSON_WRITER_MAX_DEPTH )
+    {
+        pWriter->failed = true;
+        return;
+    }
+
+    pWriter->depth++;
+    pWriter->hasElements &= ~( 1UL << pWriter->depth );
+}
+
+/*-----------------------------------------------------------*/
+
+static void closeContainer( JsonWriter_t * pWriter,
+                            char bracket )
+{
+    if( pWriter->depth == 0U )
+    {
+        pWriter->failed = true;
+        return;
+    }
+
+    pWriter->depth--;
+    putChar( pWriter, bracket );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Init( JsonWriter_t * pWriter,
+                      char * pBuffer,
+                      size_t size )
+{
+    assert( pWriter != NULL );
+    assert( pBuffer != NULL );
+
+    ( void ) memset( pWriter, 0x00, sizeof( JsonWriter_t ) );
+    pWriter->pBuffer = pBuffer;
+    pWriter->size = size;
+    pWriter->failed = ( size == 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Resume( JsonWriter_t * pWriter,
+                        const JsonWriter_t * pCheckpoint,
+                        char * pBuffer,
+                        size_t size )
+{
+    assert( pWriter != NULL );
+    assert( pCheckpoint != NULL );
+    assert( pBuffer != NULL );
+
+    *pWriter = *pCheckpoint;
+    pWriter->pBuffer = pBuffer;
+    pWriter->size = size;
+    pWriter->failed = pCheckpoint->failed || ( pCheckpoint->length >= size );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_BeginObject( JsonWriter_t * pWriter,
+                             const char * pKey )
+{
+    openContainer( pWriter, pKey, '{' );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_EndObject( JsonWriter_t * pWriter )
+{
+    closeContainer( pWriter, '}' );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_BeginArray( JsonWriter_t * pWriter,
+                            const char * pKey )
+{
+    openContainer( pWriter, pKey, '[' );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_EndArray( JsonWriter_t * pWriter )
+{
+    closeContainer( pWriter, ']' );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_String( JsonWriter_t * pWriter,
+                        const char * pKey,
+                        const char * pValue )
+{
+    assert( pValue != NULL );
+
+    beginValue( pWriter, pKey );
+    putEscaped( pWriter, pValue );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Int( JsonWriter_t * pWriter,
+                     const char * pKey,
+                     int32_t value )
+{
+    beginValue( pWriter, pKey );
+
+    if( value < 0 )
+    {
+        putChar( pWriter, '-' );
+    }
+
+    /* Negate in unsigned arithmetic so INT32_MIN does not overflow. */
+    putUnsigned( pWriter, ( value < 0 ) ? ( 0U - ( uint32_t ) value ) : ( uint32_t ) value, 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Uint( JsonWriter_t * pWriter,
+                      const char * pKey,
+                      uint32_t value )
+{
+    beginValue( pWriter, pKey );
+    putUnsigned( pWriter, value, 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Fixed( JsonWriter_t * pWriter,
+                       const char * pKey,
+                       int32_t value,
+                       uint8_t decimals )
+{
+    uint32_t magnitude = ( value < 0 ) ? ( 0U - ( uint32_t ) value ) : ( uint32_t ) value;
+    uint32_t scale = 1U;
+    uint8_t i;
+
+    assert( decimals <= 9U );
+
+    for( i = 0U; i < decimals; i++ )
+    {
+        scale *= 10U;
+    }
+
+    beginValue( pWriter, pKey );
+
+    if( value < 0 )
+    {
+        putChar( pWriter, '-' );
+    }
+
+    putUnsigned( pWriter, magnitude / scale, 1U );
+
+    if( decimals > 0U )
+    {
+        putChar( pWriter, '.' );
+        putUnsigned( pWriter, magnitude % scale, decimals );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Bool( JsonWriter_t * pWriter,
+                      const char * pKey,
+                      bool value )
+{
+    beginValue( pWriter, pKey );
+
+    if( value )
+    {
+        put( pWriter, "true", 4U );
+    }
+    else
+    {
+        put( pWriter, "false", 5U );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void JsonWriter_Null( JsonWriter_t * pWriter,
+                      const char * pKey )
+{
+    beginValue( pWriter, pKey );
+    put( pWriter, "null", 4U );
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t JsonWriter_Finish( JsonWriter_t * pWriter )
+{
+    assert( pWriter != NULL );
+
+    if( pWriter->failed || ( pWriter->depth != 0U ) )
+    {
+        if( pWriter->size > 0U )
+        {
+            pWriter->pBuffer[ 0 ] = '\0';
+        }
+
+        return -1;
+    }
+
+    pWriter->pBuffer[ pWriter->length ] = '\0';
+
+    return ( int32_t ) pWriter->length;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file offline_log.h
+ * @brief Persistent append-only log of messages waiting to be published.
+ *
+ * The storage is split into equal segments, each a multiple of the flash
+ * erase size, used round-robin so every segment is erased equally often.
+ * A segment starts with a header carrying its sequence number and erase
+ * count; records follow back to back:
+ *
+ *     state (4) | length (2) | tag (1) | reserved (1) | crc32 (4) | data, padded to 4
+ *
+ * The CRC covers length, tag and data, so a record torn by a reset is
+ * recognized and skipped. A record is consumed by clearing its state word,
+ * which only turns bits from 1 to 0 and therefore needs no erase: the read
+ * position survives reboots without a separate cursor to rewrite.
+ *
+ * When the log is full the oldest segment is erased to make room and its
+ * pending records are counted as dropped.
+ */
+
+#ifndef OFFLINE_LOG_H_
+#define OFFLINE_LOG_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Bytes of each segment taken by its header.
+ */
+#define OFFLINE_LOG_SEGMENT_HEADER_SIZE    ( 16U )
+
+/**
+ * @brief Bytes of each record taken by its header.
+ */
+#define OFFLINE_LOG_RECORD_HEADER_SIZE     ( 12U )
+
+typedef enum OfflineLogStatus
+{
+    OfflineLogSuccess = 0,
+    OfflineLogEmpty,          /**< @brief No more pending records. */
+    OfflineLogBadParameter,   /**< @brief Record too large for a segment, or bad geometry. */
+    OfflineLogBufferTooSmall, /**< @brief The next record does not fit the caller's buffer. */
+    OfflineLogStorageError    /**< @brief The backend failed a read, write or erase. */
+} OfflineLogStatus_t;
+
+/**
+ * @brief Storage the log lives on. Offsets are relative to the start of the
+ * region; erase is only called on whole segments. Writes must behave like
+ * NOR flash: they can clear bits but never set them.
+ */
+typedef struct OfflineLogBackend
+{
+    void * pContext;
+    uint32_t segmentSize;  /**< @brief Multiple of the erase size. */
+    uint32_t segmentCount; /**< @brief At least 2. */
+    bool ( * read )( void * pContext,
+                     uint32_t offset,
+                     void * pBuffer,
+                     size_t length );
+    bool ( * write )( void * pContext,
+                      uint32_t offset,
+                      const void * pData,
+                      size_t length );
+    bool ( * erase )( void * pContext,
+                      uint32_t offset,
+                      size_t length );
+} OfflineLogBackend_t;
+
+/**
+ * @brief Position in the log.
+ */
+typedef struct OfflineLogCursor
+{
+    uint32_t segment;
+    uint32_t offset;
+} OfflineLogCursor_t;
+
+typedef struct OfflineLog
+{
+    OfflineLogBackend_t backend;
+    uint32_t writeSegment;
+    uint32_t writeOffset;
+    uint32_t writeSequence;  /**< @brief Sequence number of the write segment. */
+    OfflineLogCursor_t read; /**< @brief Oldest pending record, if any. */
+    uint32_t pending;        /**< @brief Records appended and not consumed. */
+    uint32_t dropped;        /**< @brief Pending records lost to segment reuse. */
+    uint32_t maxEraseCount;  /**< @brief Highest erase count of any segment. */
+} OfflineLog_t;
+
+/**
+ * @brief Mount the log, or format the storage if it holds no log.
+ *
+ * Scans every segment once to find the write position, the oldest pending
+ * record and the number of pending records.
+ */
+OfflineLogStatus_t OfflineLog_Init( OfflineLog_t * pLog,
+                                    const OfflineLogBackend_t * pBackend );
+
+/**
+ * @brief Append a record. May erase the oldest segment, dropping the
+ * records in it that were still pending.
+ *
+ * @param[in] tag Application value stored with the record, e.g. its format.
+ */
+OfflineLogStatus_t OfflineLog_Append( OfflineLog_t * pLog,
+                                      const void * pData,
+                                      uint16_t length,
+                                      uint8_t tag );
+
+/**
+ * @brief Start iterating over the pending records, oldest first.
+ */
+void OfflineLog_Begin( const OfflineLog_t * pLog,
+                       OfflineLogCursor_t * pCursor );
+
+/**
+ * @brief Copy the pending record at the cursor and move past it. Records
+ * that are consumed or fail their CRC are skipped.
+ *
+ * Reading does not consume: call OfflineLog_Consume() once the records are
+ * delivered. Iteration only needs the caller's buffer, so memory stays
+ * bounded however long the log is.
+ *
+ * @return OfflineLogEmpty after the newest record.
+ */
+OfflineLogStatus_t OfflineLog_Next( const OfflineLog_t * pLog,
+                                    OfflineLogCursor_t * pCursor,
+                                    void * pBuffer,
+                                    size_t bufferSize,
+                                    uint16_t * pLength,
+                                    uint8_t * pTag );
+
+/**
+ * @brief Mark the count oldest pending records as consumed.
+ */
+OfflineLogStatus_t OfflineLog_Consume( OfflineLog_t * pLog,
+                                       uint32_t count );
+
+/**
+ * @brief Number of pending records.
+ */
+uint32_t OfflineLog_Pending( const OfflineLog_t * pLog );
+
+/**
+ * @brief Pending records lost because the log was full, since Init.
+ */
+uint32_t OfflineLog_Dropped( const OfflineLog_t * pLog );
+
+/**
+ * @brief Highest number of times any segment has been erased.
+ */
+uint32_t OfflineLog_MaxEraseCount( const OfflineLog_t * pLog );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Backend over a raw data partition. Segments are 4 KB flash
+ * sectors. ESP-IDF only.
+ *
+ * @param[in] pLabel Partition label in the partition table.
+ *
+ * @return false if the partition does not exist or has fewer than 2 sectors.
+ */
+bool OfflineLogPartition_Open( OfflineLogBackend_t * pBackend,
+                               const char * pLabel );
+
+/**
+ * @brief Backend over a memory-mapped file, for host tests and benchmarks.
+ * It emulates NOR flash: erase fills with 0xFF and writes AND into the
+ * existing bytes. Not built for the device.
+ *
+ * @return false if the file cannot be created or mapped.
+ */
+bool OfflineLogMmap_Open( OfflineLogBackend_t * pBackend,
+                          const char * pPath,
+                          uint32_t segmentSize,
+                          uint32_t segmentCount );
+
+/**
+ * @brief Unmap and close a backend opened with OfflineLogMmap_Open().
+ */
+void OfflineLogMmap_Close( OfflineLogBackend_t * pBackend );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef OFFLINE_LOG_H_ */
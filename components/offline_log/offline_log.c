@@ -0,0 +1,687 @@
+/**
+ * @file offline_log.c
+ * @brief Implementation of the persistent append-only log.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "offline_log.h"
+
+/**
+ * @brief "OLG1", marks a segment that belongs to the log.
+ */
+#define SEGMENT_MAGIC            ( 0x314C474FUL )
+
+/**
+ * @brief State word of a record not yet consumed; the erased value.
+ */
+#define RECORD_STATE_PENDING     ( 0xFFFFFFFFUL )
+
+/**
+ * @brief State word of a consumed record.
+ */
+#define RECORD_STATE_CONSUMED    ( 0UL )
+
+/**
+ * @brief Length of an erased record header, i.e. the end of a segment.
+ */
+#define RECORD_LENGTH_ERASED     ( 0xFFFFU )
+
+/**
+ * @brief Bytes read at a time when checking the CRC of a record in place.
+ */
+#define CRC_CHUNK_SIZE           ( 64U )
+
+typedef struct SegmentHeader
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t eraseCount;
+    uint32_t crc; /**< @brief CRC32 of the fields above. */
+} SegmentHeader_t;
+
+typedef struct RecordHeader
+{
+    uint32_t state;
+    uint16_t length;
+    uint8_t tag;
+    uint8_t reserved;
+    uint32_t crc; /**< @brief CRC32 of length, tag, reserved and the data. */
+} RecordHeader_t;
+
+/* The on-flash layout must not depend on the compiler's padding. */
+_Static_assert( sizeof( SegmentHeader_t ) == OFFLINE_LOG_SEGMENT_HEADER_SIZE, "Segment header layout" );
+_Static_assert( sizeof( RecordHeader_t ) == OFFLINE_LOG_RECORD_HEADER_SIZE, "Record header layout" );
+
+/**
+ * @brief What is found at a position in a segment.
+ */
+typedef enum RecordKind
+{
+    RecordPending,
+    RecordConsumed,
+    RecordCorrupt, /**< @brief Plausible length, wrong CRC; can be stepped over. */
+    RecordBroken,  /**< @brief Header with an unusable length; nothing after it can be found. */
+    RecordEnd      /**< @brief Erased space or no room for a record; nothing follows. */
+} RecordKind_t;
+
+/*-----------------------------------------------------------*/
+
+/* CRC-32 (IEEE 802.3), reflected, four bits at a time. */
+static const uint32_t crcTable[ 16 ] =
+{
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+    0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+    0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+};
+
+static uint32_t crcUpdate( uint32_t crc,
+                           const void * pData,
+                           size_t length )
+{
+    const uint8_t * pBytes = pData;
+    size_t i;
+
+    for( i = 0; i < length; i++ )
+    {
+        crc = crcTable[ ( crc ^ pBytes[ i ] ) & 0x0FU ] ^ ( crc >> 4 );
+        crc = crcTable[ ( crc ^ ( pBytes[ i ] >> 4 ) ) & 0x0FU ] ^ ( crc >> 4 );
+    }
+
+    return crc;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t recordSize( uint16_t length )
+{
+    return ( OFFLINE_LOG_RECORD_HEADER_SIZE + ( uint32_t ) length + 3U ) & ~3UL;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t address( const OfflineLog_t * pLog,
+                         uint32_t segment,
+                         uint32_t offset )
+{
+    return ( segment * pLog->backend.segmentSize ) + offset;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool readSegmentHeader( const OfflineLog_t * pLog,
+                               uint32_t segment,
+                               SegmentHeader_t * pHeader )
+{
+    bool valid = false;
+
+    if( pLog->backend.read( pLog->backend.pContext,
+                            address( pLog, segment, 0U ),
+                            pHeader,
+                            sizeof( *pHeader ) ) )
+    {
+        valid = ( pHeader->magic == SEGMENT_MAGIC ) &&
+                ( pHeader->crc == ~crcUpdate( 0xFFFFFFFFUL, pHeader, offsetof( SegmentHeader_t, crc ) ) );
+    }
+
+    return valid;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Classify the record at a position.
+ */
+static OfflineLogStatus_t inspectRecord( const OfflineLog_t * pLog,
+                                         uint32_t segment,
+                                         uint32_t offset,
+                                         RecordHeader_t * pHeader,
+                                         RecordKind_t * pKind )
+{
+    static const RecordHeader_t erased =
+    {
+        RECORD_STATE_PENDING, RECORD_LENGTH_ERASED, 0xFFU, 0xFFU, 0xFFFFFFFFUL
+    };
+    uint8_t chunk[ CRC_CHUNK_SIZE ];
+    uint32_t crc;
+    uint32_t done;
+    uint32_t part;
+
+    if( ( offset + OFFLINE_LOG_RECORD_HEADER_SIZE ) > pLog->backend.segmentSize )
+    {
+        *pKind = RecordEnd;
+        return OfflineLogSuccess;
+    }
+
+    if( !pLog->backend.read( pLog->backend.pContext,
+                             address( pLog, segment, offset ),
+                             pHeader,
+                             sizeof( *pHeader ) ) )
+    {
+        return OfflineLogStorageError;
+    }
+
+    if( memcmp( pHeader, &erased, sizeof( erased ) ) == 0 )
+    {
+        *pKind = RecordEnd;
+        return OfflineLogSuccess;
+    }
+
+    if( ( pHeader->length == 0U ) ||
+        ( pHeader->length == RECORD_LENGTH_ERASED ) ||
+        ( ( offset + recordSize( pHeader->length ) ) > pLog->backend.segmentSize ) )
+    {
+        *pKind = RecordBroken;
+        return OfflineLogSuccess;
+    }
+
+    if( pHeader->state != RECORD_STATE_PENDING )
+    {
+        *pKind = RecordConsumed;
+        return OfflineLogSuccess;
+    }
+
+    crc = crcUpdate( 0xFFFFFFFFUL, &pHeader->length, offsetof( RecordHeader_t, crc ) - offsetof( RecordHeader_t, length ) );
+
+    for( done = 0; done < pHeader->length; done += part )
+    {
+        part = pHeader->length - done;
+        part = ( part > sizeof( chunk ) ) ? sizeof( chunk ) : part;
+
+        if( !pLog->backend.read( pLog->backend.pContext,
+                                 address( pLog, segment, offset + OFFLINE_LOG_RECORD_HEADER_SIZE + done ),
+                                 chunk,
+                                 part ) )
+        {
+            return OfflineLogStorageError;
+        }
+
+        crc = crcUpdate( crc, chunk, part );
+    }
+
+    *pKind = ( ~crc == pHeader->crc ) ? RecordPending : RecordCorrupt;
+
+    return OfflineLogSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Move to the start of the next segment in age order.
+ *
+ * @return false if the cursor is in the newest segment.
+ */
+static bool nextSegment( const OfflineLog_t * pLog,
+                         OfflineLogCursor_t * pCursor )
+{
+    SegmentHeader_t header;
+    uint32_t segment = pCursor->segment;
+
+    while( segment != pLog->writeSegment )
+    {
+        segment = ( segment + 1U ) % pLog->backend.segmentCount;
+
+        /* Never-used segments only lie between the newest and the oldest. */
+        if( ( segment == pLog->writeSegment ) || readSegmentHeader( pLog, segment, &header ) )
+        {
+            pCursor->segment = segment;
+            pCursor->offset = OFFLINE_LOG_SEGMENT_HEADER_SIZE;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Advance the cursor to the next pending record, leaving it on the
+ * record.
+ */
+static OfflineLogStatus_t seekPending( const OfflineLog_t * pLog,
+                                       OfflineLogCursor_t * pCursor,
+                                       RecordHeader_t * pHeader )
+{
+    OfflineLogStatus_t status = OfflineLogSuccess;
+    RecordKind_t kind = RecordEnd;
+
+    for( ; ; )
+    {
+        if( ( pCursor->segment == pLog->writeSegment ) && ( pCursor->offset >= pLog->writeOffset ) )
+        {
+            status = OfflineLogEmpty;
+            break;
+        }
+
+        status = inspectRecord( pLog, pCursor->segment, pCursor->offset, pHeader, &kind );
+
+        if( status != OfflineLogSuccess )
+        {
+            break;
+        }
+
+        if( kind == RecordPending )
+        {
+            break;
+        }
+
+        if( ( kind == RecordEnd ) || ( kind == RecordBroken ) )
+        {
+            if( !nextSegment( pLog, pCursor ) )
+            {
+                status = OfflineLogEmpty;
+                break;
+            }
+        }
+        else
+        {
+            pCursor->offset += recordSize( pHeader->length );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the oldest pending record and count the pending records.
+ */
+static OfflineLogStatus_t scanPending( OfflineLog_t * pLog )
+{
+    OfflineLogStatus_t status;
+    OfflineLogCursor_t cursor;
+    RecordHeader_t header;
+    SegmentHeader_t segmentHeader;
+
+    /* The oldest segment is the first one in use after the newest. */
+    cursor.segment = pLog->writeSegment;
+
+    do
+    {
+        cursor.segment = ( cursor.segment + 1U ) % pLog->backend.segmentCount;
+    } while( ( cursor.segment != pLog->writeSegment ) &&
+             !readSegmentHeader( pLog, cursor.segment, &segmentHeader ) );
+
+    cursor.offset = OFFLINE_LOG_SEGMENT_HEADER_SIZE;
+    pLog->pending = 0;
+
+    status = seekPending( pLog, &cursor, &header );
+    pLog->read = cursor;
+
+    while( status == OfflineLogSuccess )
+    {
+        pLog->pending++;
+        cursor.offset += recordSize( header.length );
+        status = seekPending( pLog, &cursor, &header );
+    }
+
+    return ( status == OfflineLogEmpty ) ? OfflineLogSuccess : status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Erase a segment and make it the newest.
+ */
+static OfflineLogStatus_t startSegment( OfflineLog_t * pLog,
+                                        uint32_t segment,
+                                        uint32_t sequence )
+{
+    SegmentHeader_t header;
+    uint32_t eraseCount = 1U;
+
+    if( readSegmentHeader( pLog, segment, &header ) )
+    {
+        eraseCount = header.eraseCount + 1U;
+    }
+
+    header.magic = SEGMENT_MAGIC;
+    header.sequence = sequence;
+    header.eraseCount = eraseCount;
+    header.crc = ~crcUpdate( 0xFFFFFFFFUL, &header, offsetof( SegmentHeader_t, crc ) );
+
+    if( !pLog->backend.erase( pLog->backend.pContext,
+                              address( pLog, segment, 0U ),
+                              pLog->backend.segmentSize ) ||
+        !pLog->backend.write( pLog->backend.pContext,
+                              address( pLog, segment, 0U ),
+                              &header,
+                              sizeof( header ) ) )
+    {
+        return OfflineLogStorageError;
+    }
+
+    pLog->writeSegment = segment;
+    pLog->writeOffset = OFFLINE_LOG_SEGMENT_HEADER_SIZE;
+    pLog->writeSequence = sequence;
+
+    if( eraseCount > pLog->maxEraseCount )
+    {
+        pLog->maxEraseCount = eraseCount;
+    }
+
+    return OfflineLogSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+OfflineLogStatus_t OfflineLog_Init( OfflineLog_t * pLog,
+                                    const OfflineLogBackend_t * pBackend )
+{
+    OfflineLogStatus_t status = OfflineLogSuccess;
+    SegmentHeader_t header;
+    RecordHeader_t record;
+    RecordKind_t kind = RecordEnd;
+    bool found = false;
+    uint32_t segment;
+    uint32_t offset;
+
+    assert( pLog != NULL );
+    assert( pBackend != NULL );
+
+    if( ( pBackend->segmentCount < 2U ) ||
+        ( ( pBackend->segmentSize % 4U ) != 0U ) ||
+        ( pBackend->segmentSize <= ( OFFLINE_LOG_SEGMENT_HEADER_SIZE + OFFLINE_LOG_RECORD_HEADER_SIZE ) ) )
+    {
+        return OfflineLogBadParameter;
+    }
+
+    memset( pLog, 0, sizeof( *pLog ) );
+    pLog->backend = *pBackend;
+
+    /* The newest segment has the highest sequence number; compare with
+     * wrap-around in mind. */
+    for( segment = 0; segment < pBackend->segmentCount; segment++ )
+    {
+        if( readSegmentHeader( pLog, segment, &header ) )
+        {
+            if( !found || ( ( int32_t ) ( header.sequence - pLog->writeSequence ) > 0 ) )
+            {
+                pLog->writeSegment = segment;
+                pLog->writeSequence = header.sequence;
+                found = true;
+            }
+
+            if( header.eraseCount > pLog->maxEraseCount )
+            {
+                pLog->maxEraseCount = header.eraseCount;
+            }
+        }
+    }
+
+    if( !found )
+    {
+        status = startSegment( pLog, 0U, 1U );
+        pLog->read.segment = pLog->writeSegment;
+        pLog->read.offset = pLog->writeOffset;
+
+        return status;
+    }
+
+    /* Find the end of the newest segment. Appends resume after a record with
+     * a bad CRC, but not after a header whose length cannot be trusted. */
+    offset = OFFLINE_LOG_SEGMENT_HEADER_SIZE;
+
+    while( status == OfflineLogSuccess )
+    {
+        status = inspectRecord( pLog, pLog->writeSegment, offset, &record, &kind );
+
+        if( ( status != OfflineLogSuccess ) || ( kind == RecordEnd ) || ( kind == RecordBroken ) )
+        {
+            break;
+        }
+
+        offset += recordSize( record.length );
+    }
+
+    if( status == OfflineLogSuccess )
+    {
+        /* After a torn header, start the next append in a fresh segment. */
+        pLog->writeOffset = ( kind == RecordBroken ) ? pBackend->segmentSize : offset;
+
+        status = scanPending( pLog );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+OfflineLogStatus_t OfflineLog_Append( OfflineLog_t * pLog,
+                                      const void * pData,
+                                      uint16_t length,
+                                      uint8_t tag )
+{
+    OfflineLogStatus_t status = OfflineLogSuccess;
+    RecordHeader_t header;
+    OfflineLogCursor_t oldest;
+    uint32_t size;
+    uint32_t next;
+    uint32_t lost = 0;
+    uint32_t recordAddress;
+
+    assert( pLog != NULL );
+    assert( pData != NULL );
+
+    size = recordSize( length );
+
+    if( ( length == 0U ) || ( length == RECORD_LENGTH_ERASED ) ||
+        ( size > ( pLog->backend.segmentSize - OFFLINE_LOG_SEGMENT_HEADER_SIZE ) ) )
+    {
+        return OfflineLogBadParameter;
+    }
+
+    if( ( pLog->writeOffset + size ) > pLog->backend.segmentSize )
+    {
+        /* Reuse the oldest segment; whatever is pending in it is lost. The
+         * read position is in it if anything in it is pending. */
+        next = ( pLog->writeSegment + 1U ) % pLog->backend.segmentCount;
+        oldest = pLog->read;
+
+        if( ( pLog->pending > 0U ) && ( oldest.segment == next ) )
+        {
+            while( ( ( status = seekPending( pLog, &oldest, &header ) ) == OfflineLogSuccess ) &&
+                   ( oldest.segment == next ) )
+            {
+                lost++;
+                oldest.offset += recordSize( header.length );
+            }
+
+            if( status == OfflineLogEmpty )
+            {
+                status = OfflineLogSuccess;
+            }
+        }
+
+        if( status == OfflineLogSuccess )
+        {
+            status = startSegment( pLog, next, pLog->writeSequence + 1U );
+        }
+
+        if( status != OfflineLogSuccess )
+        {
+            return status;
+        }
+
+        if( oldest.segment != pLog->read.segment )
+        {
+            pLog->dropped += lost;
+            pLog->pending = ( lost < pLog->pending ) ? ( pLog->pending - lost ) : 0U;
+            pLog->read = oldest;
+        }
+    }
+
+    header.state = RECORD_STATE_PENDING;
+    header.length = length;
+    header.tag = tag;
+    header.reserved = 0xFFU;
+    header.crc = ~crcUpdate( crcUpdate( 0xFFFFFFFFUL,
+                                        &header.length,
+                                        offsetof( RecordHeader_t, crc ) - offsetof( RecordHeader_t, length ) ),
+                             pData,
+                             length );
+
+    /* Header first: if the data write is cut short the CRC gives it away,
+     * and the space stays accounted for. */
+    recordAddress = address( pLog, pLog->writeSegment, pLog->writeOffset );
+
+    if( !pLog->backend.write( pLog->backend.pContext, recordAddress, &header, sizeof( header ) ) ||
+        !pLog->backend.write( pLog->backend.pContext,
+                              recordAddress + OFFLINE_LOG_RECORD_HEADER_SIZE,
+                              pData,
+                              length ) )
+    {
+        /* Do not append over a half-written record. */
+        pLog->writeOffset = pLog->backend.segmentSize;
+        return OfflineLogStorageError;
+    }
+
+    if( pLog->pending == 0U )
+    {
+        pLog->read.segment = pLog->writeSegment;
+        pLog->read.offset = pLog->writeOffset;
+    }
+
+    pLog->writeOffset += size;
+    pLog->pending++;
+
+    return OfflineLogSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+void OfflineLog_Begin( const OfflineLog_t * pLog,
+                       OfflineLogCursor_t * pCursor )
+{
+    assert( pLog != NULL );
+    assert( pCursor != NULL );
+
+    *pCursor = pLog->read;
+}
+
+/*-----------------------------------------------------------*/
+
+OfflineLogStatus_t OfflineLog_Next( const OfflineLog_t * pLog,
+                                    OfflineLogCursor_t * pCursor,
+                                    void * pBuffer,
+                                    size_t bufferSize,
+                                    uint16_t * pLength,
+                                    uint8_t * pTag )
+{
+    OfflineLogStatus_t status;
+    RecordHeader_t header;
+
+    assert( pLog != NULL );
+    assert( pCursor != NULL );
+    assert( pBuffer != NULL );
+    assert( pLength != NULL );
+
+    status = seekPending( pLog, pCursor, &header );
+
+    if( status == OfflineLogSuccess )
+    {
+        if( header.length > bufferSize )
+        {
+            status = OfflineLogBufferTooSmall;
+        }
+        else if( !pLog->backend.read( pLog->backend.pContext,
+                                      address( pLog, pCursor->segment, pCursor->offset + OFFLINE_LOG_RECORD_HEADER_SIZE ),
+                                      pBuffer,
+                                      header.length ) )
+        {
+            status = OfflineLogStorageError;
+        }
+        else
+        {
+            *pLength = header.length;
+
+            if( pTag != NULL )
+            {
+                *pTag = header.tag;
+            }
+
+            pCursor->offset += recordSize( header.length );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+OfflineLogStatus_t OfflineLog_Consume( OfflineLog_t * pLog,
+                                       uint32_t count )
+{
+    static const uint32_t consumed = RECORD_STATE_CONSUMED;
+    OfflineLogStatus_t status = OfflineLogSuccess;
+    RecordHeader_t header;
+
+    assert( pLog != NULL );
+
+    for( ; ( count > 0U ) && ( pLog->pending > 0U ); count-- )
+    {
+        status = seekPending( pLog, &pLog->read, &header );
+
+        if( status == OfflineLogSuccess )
+        {
+            /* Clearing bits needs no erase. */
+            if( !pLog->backend.write( pLog->backend.pContext,
+                                      address( pLog, pLog->read.segment, pLog->read.offset ),
+                                      &consumed,
+                                      sizeof( consumed ) ) )
+            {
+                status = OfflineLogStorageError;
+            }
+        }
+
+        if( status == OfflineLogEmpty )
+        {
+            /* Fewer records than counted, e.g. after a storage error. */
+            pLog->pending = 0;
+        }
+
+        if( status != OfflineLogSuccess )
+        {
+            break;
+        }
+
+        pLog->read.offset += recordSize( header.length );
+        pLog->pending--;
+    }
+
+    return ( status == OfflineLogEmpty ) ? OfflineLogSuccess : status;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t OfflineLog_Pending( const OfflineLog_t * pLog )
+{
+    assert( pLog != NULL );
+
+    return pLog->pending;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t OfflineLog_Dropped( const OfflineLog_t * pLog )
+{
+    assert( pLog != NULL );
+
+    return pLog->dropped;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t OfflineLog_MaxEraseCount( const OfflineLog_t * pLog )
+{
+    assert( pLog != NULL );
+
+    return pLog->maxEraseCount;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,175 @@
+/**
+ * @file offline_log_mmap.c
+ * @brief Offline log backend over a memory-mapped file, for host tests and
+ * benchmarks. Not part of the device build.
+ */
+
+/* ftruncate() is POSIX. */
+#define _POSIX_C_SOURCE    200112L
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX includes. */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "offline_log.h"
+
+typedef struct MmapContext
+{
+    int fd;
+    uint8_t * pBase;
+    size_t size;
+} MmapContext_t;
+
+/*-----------------------------------------------------------*/
+
+static bool mmapRead( void * pContext,
+                      uint32_t offset,
+                      void * pBuffer,
+                      size_t length )
+{
+    MmapContext_t * pMmap = pContext;
+
+    if( ( ( size_t ) offset + length ) > pMmap->size )
+    {
+        return false;
+    }
+
+    memcpy( pBuffer, pMmap->pBase + offset, length );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool mmapWrite( void * pContext,
+                       uint32_t offset,
+                       const void * pData,
+                       size_t length )
+{
+    MmapContext_t * pMmap = pContext;
+    const uint8_t * pBytes = pData;
+    size_t i;
+
+    if( ( ( size_t ) offset + length ) > pMmap->size )
+    {
+        return false;
+    }
+
+    /* NOR flash can only clear bits. */
+    for( i = 0; i < length; i++ )
+    {
+        pMmap->pBase[ offset + i ] &= pBytes[ i ];
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool mmapErase( void * pContext,
+                       uint32_t offset,
+                       size_t length )
+{
+    MmapContext_t * pMmap = pContext;
+
+    if( ( ( size_t ) offset + length ) > pMmap->size )
+    {
+        return false;
+    }
+
+    memset( pMmap->pBase + offset, 0xFF, length );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool OfflineLogMmap_Open( OfflineLogBackend_t * pBackend,
+                          const char * pPath,
+                          uint32_t segmentSize,
+                          uint32_t segmentCount )
+{
+    MmapContext_t * pMmap;
+    struct stat info;
+    bool fresh = false;
+    bool opened;
+
+    assert( pBackend != NULL );
+    assert( pPath != NULL );
+
+    pMmap = malloc( sizeof( *pMmap ) );
+
+    if( pMmap == NULL )
+    {
+        return false;
+    }
+
+    pMmap->size = ( size_t ) segmentSize * segmentCount;
+    pMmap->pBase = MAP_FAILED;
+    pMmap->fd = open( pPath, O_RDWR | O_CREAT, 0644 );
+    opened = ( pMmap->fd >= 0 ) && ( fstat( pMmap->fd, &info ) == 0 );
+
+    if( opened )
+    {
+        /* A file of another size is reformatted as blank flash. */
+        fresh = ( ( size_t ) info.st_size != pMmap->size );
+        opened = !fresh || ( ftruncate( pMmap->fd, ( off_t ) pMmap->size ) == 0 );
+    }
+
+    if( opened )
+    {
+        pMmap->pBase = mmap( NULL, pMmap->size, PROT_READ | PROT_WRITE, MAP_SHARED, pMmap->fd, 0 );
+        opened = ( pMmap->pBase != MAP_FAILED );
+    }
+
+    if( !opened )
+    {
+        if( pMmap->fd >= 0 )
+        {
+            ( void ) close( pMmap->fd );
+        }
+
+        free( pMmap );
+
+        return false;
+    }
+
+    if( fresh )
+    {
+        memset( pMmap->pBase, 0xFF, pMmap->size );
+    }
+
+    pBackend->pContext = pMmap;
+    pBackend->segmentSize = segmentSize;
+    pBackend->segmentCount = segmentCount;
+    pBackend->read = mmapRead;
+    pBackend->write = mmapWrite;
+    pBackend->erase = mmapErase;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void OfflineLogMmap_Close( OfflineLogBackend_t * pBackend )
+{
+    MmapContext_t * pMmap;
+
+    assert( pBackend != NULL );
+
+    pMmap = pBackend->pContext;
+
+    ( void ) munmap( pMmap->pBase, pMmap->size );
+    ( void ) close( pMmap->fd );
+    free( pMmap );
+    pBackend->pContext = NULL;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,74 @@
+/**
+ * @file offline_log_partition.c
+ * @brief Offline log backend over a raw ESP-IDF data partition.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+
+/* ESP-IDF includes. */
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#include "offline_log.h"
+
+/*-----------------------------------------------------------*/
+
+static bool partitionRead( void * pContext,
+                           uint32_t offset,
+                           void * pBuffer,
+                           size_t length )
+{
+    return esp_partition_read( pContext, offset, pBuffer, length ) == ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool partitionWrite( void * pContext,
+                            uint32_t offset,
+                            const void * pData,
+                            size_t length )
+{
+    return esp_partition_write( pContext, offset, pData, length ) == ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool partitionErase( void * pContext,
+                            uint32_t offset,
+                            size_t length )
+{
+    return esp_partition_erase_range( pContext, offset, length ) == ESP_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+bool OfflineLogPartition_Open( OfflineLogBackend_t * pBackend,
+                               const char * pLabel )
+{
+    const esp_partition_t * pPartition;
+
+    assert( pBackend != NULL );
+    assert( pLabel != NULL );
+
+    pPartition = esp_partition_find_first( ESP_PARTITION_TYPE_DATA,
+                                           ESP_PARTITION_SUBTYPE_ANY,
+                                           pLabel );
+
+    if( ( pPartition == NULL ) || ( ( pPartition->size / SPI_FLASH_SEC_SIZE ) < 2U ) )
+    {
+        return false;
+    }
+
+    /* One sector per segment keeps the data lost to a rotation small. */
+    pBackend->pContext = ( void * ) pPartition;
+    pBackend->segmentSize = SPI_FLASH_SEC_SIZE;
+    pBackend->segmentCount = pPartition->size / SPI_FLASH_SEC_SIZE;
+    pBackend->read = partitionRead;
+    pBackend->write = partitionWrite;
+    pBackend->erase = partitionErase;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,154 @@
+/**
+ * @file payload_pool.h
+ * @brief Fixed pool of payload buffers for QoS1 publishes awaiting a PUBACK.
+ *
+ * Each slot owns a copy of one payload, so a resend after a reconnect never
+ * depends on the caller's buffer. Free slots are kept on a singly linked
+ * list and used slots are chained in a table indexed by packet ID, so
+ * storing, finding and releasing a payload take constant time. A store into
+ * a full pool is refused and counted; the caller is expected to hold the
+ * payload back until PUBACKs free a slot.
+ *
+ * All memory is supplied by the caller. The pool is not thread safe: it is
+ * meant to be used from the task running the MQTT process loop, where
+ * PUBACKs are delivered.
+ */
+
+#ifndef PAYLOAD_POOL_H_
+#define PAYLOAD_POOL_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Index that marks the end of a list.
+ */
+#define PAYLOAD_POOL_NONE    ( ( uint16_t ) 0xFFFFU )
+
+typedef enum PayloadPoolStatus
+{
+    PayloadPoolSuccess = 0,
+    PayloadPoolExhausted, /**< @brief Every slot holds an unacknowledged payload. */
+    PayloadPoolTooLarge   /**< @brief The payload is larger than a slot. */
+} PayloadPoolStatus_t;
+
+/**
+ * @brief Bookkeeping of one slot.
+ */
+typedef struct PayloadPoolSlot
+{
+    uint16_t packetId; /**< @brief 0 while the slot is free. */
+    uint16_t length;
+    uint16_t next;     /**< @brief Next free slot, or next slot in the same bucket. */
+} PayloadPoolSlot_t;
+
+typedef struct PayloadPool
+{
+    PayloadPoolSlot_t * pSlots;
+    uint8_t * pStorage;
+    uint16_t * pBuckets;
+    size_t slotSize;
+    uint16_t slotCount;
+    uint16_t bucketMask; /**< @brief Bucket count - 1. */
+    uint16_t freeHead;
+    uint16_t used;
+    uint16_t highWater;  /**< @brief Most slots used at once. */
+    uint32_t exhausted;  /**< @brief Stores refused because the pool was full. */
+} PayloadPool_t;
+
+/**
+ * @brief Initialize a pool over caller-provided memory.
+ *
+ * Packet IDs are handed out sequentially, so a packet ID masked to the
+ * bucket count spreads the slots evenly; a bucket count at least equal to
+ * the slot count keeps the chains at one entry in practice.
+ *
+ * @param[in] pSlots slotCount bookkeeping entries.
+ * @param[in] pStorage slotCount * slotSize bytes.
+ * @param[in] slotSize Largest payload a slot holds, at most 65535 bytes.
+ * @param[in] pBuckets bucketCount entries.
+ * @param[in] bucketCount Power of two.
+ *
+ * @return false if bucketCount is not a power of two or slotCount is 0 or
+ * does not fit the 16-bit slot indices.
+ */
+bool PayloadPool_Init( PayloadPool_t * pPool,
+                       PayloadPoolSlot_t * pSlots,
+                       uint32_t slotCount,
+                       void * pStorage,
+                       size_t slotSize,
+                       uint16_t * pBuckets,
+                       uint32_t bucketCount );
+
+/**
+ * @brief Copy a payload into a free slot and key it by packetId.
+ *
+ * @param[in] packetId Non-zero and not already stored.
+ * @param[out] pSlot Index of the slot the payload was copied to.
+ *
+ * @return PayloadPoolExhausted if no slot is free, PayloadPoolTooLarge if
+ * the payload does not fit a slot.
+ */
+PayloadPoolStatus_t PayloadPool_Store( PayloadPool_t * pPool,
+                                       uint16_t packetId,
+                                       const void * pData,
+                                       size_t length,
+                                       uint16_t * pSlot );
+
+/**
+ * @brief Look up the slot holding packetId.
+ *
+ * @return false if no payload is stored under packetId.
+ */
+bool PayloadPool_Find( const PayloadPool_t * pPool,
+                       uint16_t packetId,
+                       uint16_t * pSlot );
+
+/**
+ * @brief Free the slot holding packetId, e.g. when its PUBACK arrives.
+ *
+ * @param[out] pSlot Index of the freed slot; may be NULL.
+ *
+ * @return false if no payload is stored under packetId.
+ */
+bool PayloadPool_Release( PayloadPool_t * pPool,
+                          uint16_t packetId,
+                          uint16_t * pSlot );
+
+/**
+ * @brief Free every slot, e.g. when the broker starts a clean session.
+ */
+void PayloadPool_Reset( PayloadPool_t * pPool );
+
+/**
+ * @brief Payload stored in a slot returned by Store or Find.
+ */
+const uint8_t * PayloadPool_Data( const PayloadPool_t * pPool,
+                                  uint16_t slot );
+
+uint16_t PayloadPool_Length( const PayloadPool_t * pPool,
+                             uint16_t slot );
+
+uint16_t PayloadPool_Available( const PayloadPool_t * pPool );
+
+uint16_t PayloadPool_Capacity( const PayloadPool_t * pPool );
+
+uint16_t PayloadPool_HighWater( const PayloadPool_t * pPool );
+
+uint32_t PayloadPool_Exhausted( const PayloadPool_t * pPool );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef PAYLOAD_POOL_H_ */
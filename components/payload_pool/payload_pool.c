@@ -0,0 +1,257 @@
+/**
+ * @file payload_pool.c
+ * @brief Implementation of the payload pool.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "payload_pool.h"
+
+/*-----------------------------------------------------------*/
+
+static uint16_t * bucketOf( const PayloadPool_t * pPool,
+                            uint16_t packetId )
+{
+    return &pPool->pBuckets[ packetId & pPool->bucketMask ];
+}
+
+/*-----------------------------------------------------------*/
+
+bool PayloadPool_Init( PayloadPool_t * pPool,
+                       PayloadPoolSlot_t * pSlots,
+                       uint32_t slotCount,
+                       void * pStorage,
+                       size_t slotSize,
+                       uint16_t * pBuckets,
+                       uint32_t bucketCount )
+{
+    assert( pPool != NULL );
+    assert( pSlots != NULL );
+    assert( pStorage != NULL );
+    assert( pBuckets != NULL );
+    assert( ( slotSize > 0U ) && ( slotSize <= UINT16_MAX ) );
+
+    if( ( slotCount == 0U ) || ( slotCount >= PAYLOAD_POOL_NONE ) ||
+        ( bucketCount == 0U ) || ( bucketCount > ( UINT16_MAX + 1UL ) ) ||
+        ( ( bucketCount & ( bucketCount - 1U ) ) != 0U ) )
+    {
+        return false;
+    }
+
+    pPool->pSlots = pSlots;
+    pPool->pStorage = ( uint8_t * ) pStorage;
+    pPool->pBuckets = pBuckets;
+    pPool->slotSize = slotSize;
+    pPool->slotCount = ( uint16_t ) slotCount;
+    pPool->bucketMask = ( uint16_t ) ( bucketCount - 1U );
+    pPool->highWater = 0U;
+    pPool->exhausted = 0U;
+    PayloadPool_Reset( pPool );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+PayloadPoolStatus_t PayloadPool_Store( PayloadPool_t * pPool,
+                                       uint16_t packetId,
+                                       const void * pData,
+                                       size_t length,
+                                       uint16_t * pSlot )
+{
+    uint16_t slot;
+    uint16_t * pBucket;
+
+    assert( pPool != NULL );
+    assert( packetId != 0U );
+    assert( ( pData != NULL ) || ( length == 0U ) );
+    assert( pSlot != NULL );
+    assert( !PayloadPool_Find( pPool, packetId, &slot ) );
+
+    if( length > pPool->slotSize )
+    {
+        return PayloadPoolTooLarge;
+    }
+
+    if( pPool->freeHead == PAYLOAD_POOL_NONE )
+    {
+        pPool->exhausted++;
+        return PayloadPoolExhausted;
+    }
+
+    slot = pPool->freeHead;
+    pPool->freeHead = pPool->pSlots[ slot ].next;
+
+    if( length > 0U )
+    {
+        ( void ) memcpy( &pPool->pStorage[ ( size_t ) slot * pPool->slotSize ], pData, length );
+    }
+
+    /* Push onto the front of the packet ID's chain. */
+    pBucket = bucketOf( pPool, packetId );
+    pPool->pSlots[ slot ].packetId = packetId;
+    pPool->pSlots[ slot ].length = ( uint16_t ) length;
+    pPool->pSlots[ slot ].next = *pBucket;
+    *pBucket = slot;
+
+    pPool->used++;
+
+    if( pPool->used > pPool->highWater )
+    {
+        pPool->highWater = pPool->used;
+    }
+
+    *pSlot = slot;
+
+    return PayloadPoolSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+bool PayloadPool_Find( const PayloadPool_t * pPool,
+                       uint16_t packetId,
+                       uint16_t * pSlot )
+{
+    uint16_t slot;
+
+    assert( pPool != NULL );
+    assert( pSlot != NULL );
+
+    for( slot = *bucketOf( pPool, packetId ); slot != PAYLOAD_POOL_NONE; slot = pPool->pSlots[ slot ].next )
+    {
+        if( pPool->pSlots[ slot ].packetId == packetId )
+        {
+            *pSlot = slot;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+bool PayloadPool_Release( PayloadPool_t * pPool,
+                          uint16_t packetId,
+                          uint16_t * pSlot )
+{
+    uint16_t * pLink;
+    uint16_t slot;
+
+    assert( pPool != NULL );
+
+    /* Walk the chain through the link that points at each slot, so the
+     * match can be unlinked without a back pointer. */
+    for( pLink = bucketOf( pPool, packetId ); *pLink != PAYLOAD_POOL_NONE; pLink = &pPool->pSlots[ *pLink ].next )
+    {
+        slot = *pLink;
+
+        if( pPool->pSlots[ slot ].packetId == packetId )
+        {
+            *pLink = pPool->pSlots[ slot ].next;
+
+            pPool->pSlots[ slot ].packetId = 0U;
+            pPool->pSlots[ slot ].length = 0U;
+            pPool->pSlots[ slot ].next = pPool->freeHead;
+            pPool->freeHead = slot;
+            pPool->used--;
+
+            if( pSlot != NULL )
+            {
+                *pSlot = slot;
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+void PayloadPool_Reset( PayloadPool_t * pPool )
+{
+    uint32_t index;
+
+    assert( pPool != NULL );
+
+    for( index = 0; index <= pPool->bucketMask; index++ )
+    {
+        pPool->pBuckets[ index ] = PAYLOAD_POOL_NONE;
+    }
+
+    /* Chain the slots in order, so a fresh pool hands out slot 0 first. */
+    for( index = 0; index < pPool->slotCount; index++ )
+    {
+        pPool->pSlots[ index ].packetId = 0U;
+        pPool->pSlots[ index ].length = 0U;
+        pPool->pSlots[ index ].next = ( uint16_t ) ( index + 1U );
+    }
+
+    pPool->pSlots[ pPool->slotCount - 1U ].next = PAYLOAD_POOL_NONE;
+    pPool->freeHead = 0U;
+    pPool->used = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+const uint8_t * PayloadPool_Data( const PayloadPool_t * pPool,
+                                  uint16_t slot )
+{
+    assert( pPool != NULL );
+    assert( slot < pPool->slotCount );
+
+    return &pPool->pStorage[ ( size_t ) slot * pPool->slotSize ];
+}
+
+/*-----------------------------------------------------------*/
+
+uint16_t PayloadPool_Length( const PayloadPool_t * pPool,
+                             uint16_t slot )
+{
+    assert( pPool != NULL );
+    assert( slot < pPool->slotCount );
+
+    return pPool->pSlots[ slot ].length;
+}
+
+/*-----------------------------------------------------------*/
+
+uint16_t PayloadPool_Available( const PayloadPool_t * pPool )
+{
+    assert( pPool != NULL );
+
+    return ( uint16_t ) ( pPool->slotCount - pPool->used );
+}
+
+/*-----------------------------------------------------------*/
+
+uint16_t PayloadPool_Capacity( const PayloadPool_t * pPool )
+{
+    assert( pPool != NULL );
+
+    return pPool->slotCount;
+}
+
+/*-----------------------------------------------------------*/
+
+uint16_t PayloadPool_HighWater( const PayloadPool_t * pPool )
+{
+    assert( pPool != NULL );
+
+    return pPool->highWater;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t PayloadPool_Exhausted( const PayloadPool_t * pPool )
+{
+    assert( pPool != NULL );
+
+    return pPool->exhausted;
+}
+
+/*-----------------------------------------------------------*/
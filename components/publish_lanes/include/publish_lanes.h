@@ -0,0 +1,114 @@
+/**
+ * @file publish_lanes.h
+ * @brief Strict-priority scheduler over lanes of outgoing QoS1 publishes.
+ *
+ * Lane 0 has the highest priority. Every time a publish can be sent, the
+ * scheduler picks the highest-priority lane that has a message waiting and
+ * room for one more unacknowledged publish. Room is bounded twice: by the
+ * lane's own in-flight limit and by the total number of publishes that can
+ * await a PUBACK (the MQTT state records, or the payload slots holding their
+ * copies).
+ *
+ * The per-lane limits are what keep a backlog of bulk messages from taking
+ * every slot: Init refuses limits under which the lanes below any lane could
+ * fill all slots between them, so a message in a higher lane always finds
+ * one free once its own lane has room.
+ *
+ * The scheduler keeps counts only; the messages stay in the caller's queues.
+ * It is not thread safe: use it from the task running the MQTT process loop,
+ * where PUBACKs are delivered.
+ */
+
+#ifndef PUBLISH_LANES_H_
+#define PUBLISH_LANES_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Most lanes a scheduler can have.
+ */
+#define PUBLISH_LANES_MAX     ( 4U )
+
+/**
+ * @brief Returned by PublishLanes_Select() when no lane may send.
+ */
+#define PUBLISH_LANE_NONE     ( ( uint8_t ) 0xFFU )
+
+typedef struct PublishLanes
+{
+    uint8_t laneCount;
+    uint16_t totalLimit;                      /**< @brief Slots shared by all lanes. */
+    uint16_t totalInFlight;
+    uint16_t limit[ PUBLISH_LANES_MAX ];      /**< @brief Most unacknowledged publishes per lane. */
+    uint16_t inFlight[ PUBLISH_LANES_MAX ];
+    uint32_t sent[ PUBLISH_LANES_MAX ];       /**< @brief Publishes sent, resends excluded. */
+    uint32_t throttled[ PUBLISH_LANES_MAX ];  /**< @brief Selections refused for lack of room. */
+} PublishLanes_t;
+
+/**
+ * @brief Initialize a scheduler.
+ *
+ * @param[in] pLimits laneCount in-flight limits, highest priority first.
+ * @param[in] totalLimit Publishes that can await a PUBACK across all lanes.
+ *
+ * @return false if laneCount is out of range, a limit is 0, or the lanes
+ * below some lane could hold totalLimit publishes between them.
+ */
+bool PublishLanes_Init( PublishLanes_t * pLanes,
+                        const uint16_t * pLimits,
+                        uint8_t laneCount,
+                        uint16_t totalLimit );
+
+/**
+ * @brief Pick the lane to send from next.
+ *
+ * @param[in] readyMask Bit n set if lane n has a message waiting.
+ *
+ * @return The highest-priority ready lane with room, or PUBLISH_LANE_NONE
+ * if every ready lane is at a limit.
+ */
+uint8_t PublishLanes_Select( PublishLanes_t * pLanes,
+                             uint32_t readyMask );
+
+/**
+ * @brief Account for a publish sent from lane.
+ */
+void PublishLanes_Sent( PublishLanes_t * pLanes,
+                        uint8_t lane );
+
+/**
+ * @brief Account for a PUBACK, or a publish abandoned, on lane.
+ */
+void PublishLanes_Acked( PublishLanes_t * pLanes,
+                         uint8_t lane );
+
+/**
+ * @brief Forget every publish in flight, e.g. when the broker starts a
+ * clean session. Statistics are kept.
+ */
+void PublishLanes_Reset( PublishLanes_t * pLanes );
+
+uint16_t PublishLanes_InFlight( const PublishLanes_t * pLanes,
+                                uint8_t lane );
+
+uint32_t PublishLanes_SentCount( const PublishLanes_t * pLanes,
+                                 uint8_t lane );
+
+uint32_t PublishLanes_Throttled( const PublishLanes_t * pLanes,
+                                 uint8_t lane );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef PUBLISH_LANES_H_ */
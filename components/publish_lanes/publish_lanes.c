@@ -0,0 +1,152 @@
+/**
+ * @file publish_lanes.c
+ * @brief Implementation of the publish lane scheduler.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "publish_lanes.h"
+
+/*-----------------------------------------------------------*/
+
+bool PublishLanes_Init( PublishLanes_t * pLanes,
+                        const uint16_t * pLimits,
+                        uint8_t laneCount,
+                        uint16_t totalLimit )
+{
+    uint32_t below = 0U;
+    uint8_t lane;
+
+    assert( pLanes != NULL );
+    assert( pLimits != NULL );
+
+    if( ( laneCount == 0U ) || ( laneCount > PUBLISH_LANES_MAX ) || ( totalLimit == 0U ) )
+    {
+        return false;
+    }
+
+    /* Walk up from the lowest priority: whatever the lanes below a lane can
+     * hold must leave it at least one slot. */
+    for( lane = laneCount; lane > 0U; lane-- )
+    {
+        if( ( pLimits[ lane - 1U ] == 0U ) || ( below >= totalLimit ) )
+        {
+            return false;
+        }
+
+        below += pLimits[ lane - 1U ];
+    }
+
+    memset( pLanes, 0, sizeof( *pLanes ) );
+    pLanes->laneCount = laneCount;
+    pLanes->totalLimit = totalLimit;
+    memcpy( pLanes->limit, pLimits, laneCount * sizeof( pLimits[ 0 ] ) );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+uint8_t PublishLanes_Select( PublishLanes_t * pLanes,
+                             uint32_t readyMask )
+{
+    uint8_t lane;
+
+    assert( pLanes != NULL );
+
+    for( lane = 0U; lane < pLanes->laneCount; lane++ )
+    {
+        if( ( readyMask & ( 1UL << lane ) ) == 0U )
+        {
+            continue;
+        }
+
+        if( ( pLanes->inFlight[ lane ] < pLanes->limit[ lane ] ) &&
+            ( pLanes->totalInFlight < pLanes->totalLimit ) )
+        {
+            return lane;
+        }
+
+        pLanes->throttled[ lane ]++;
+    }
+
+    return PUBLISH_LANE_NONE;
+}
+
+/*-----------------------------------------------------------*/
+
+void PublishLanes_Sent( PublishLanes_t * pLanes,
+                        uint8_t lane )
+{
+    assert( pLanes != NULL );
+    assert( lane < pLanes->laneCount );
+    assert( pLanes->inFlight[ lane ] < pLanes->limit[ lane ] );
+    assert( pLanes->totalInFlight < pLanes->totalLimit );
+
+    pLanes->inFlight[ lane ]++;
+    pLanes->totalInFlight++;
+    pLanes->sent[ lane ]++;
+}
+
+/*-----------------------------------------------------------*/
+
+void PublishLanes_Acked( PublishLanes_t * pLanes,
+                         uint8_t lane )
+{
+    assert( pLanes != NULL );
+    assert( lane < pLanes->laneCount );
+
+    /* A PUBACK for a publish sent before a reset is ignored. */
+    if( pLanes->inFlight[ lane ] > 0U )
+    {
+        pLanes->inFlight[ lane ]--;
+        pLanes->totalInFlight--;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void PublishLanes_Reset( PublishLanes_t * pLanes )
+{
+    assert( pLanes != NULL );
+
+    memset( pLanes->inFlight, 0, sizeof( pLanes->inFlight ) );
+    pLanes->totalInFlight = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+uint16_t PublishLanes_InFlight( const PublishLanes_t * pLanes,
+                                uint8_t lane )
+{
+    assert( pLanes != NULL );
+    assert( lane < pLanes->laneCount );
+
+    return pLanes->inFlight[ lane ];
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t PublishLanes_SentCount( const PublishLanes_t * pLanes,
+                                 uint8_t lane )
+{
+    assert( pLanes != NULL );
+    assert( lane < pLanes->laneCount );
+
+    return pLanes->sent[ lane ];
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t PublishLanes_Throttled( const PublishLanes_t * pLanes,
+                                 uint8_t lane )
+{
+    assert( pLanes != NULL );
+    assert( lane < pLanes->laneCount );
+
+    return pLanes->throttled[ lane ];
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,104 @@
+/**
+ * @file sensor_cache.h
+ * @brief Latest sensor reading, shared between the task that samples and
+ * any number of tasks that want the current value without waiting.
+ *
+ * The sampling task stores the outcome of every read attempt. A failed
+ * attempt updates the status and error counts but keeps the last good
+ * values, so readers always get the freshest validated reading together
+ * with its age and whether the sensor has been failing since.
+ *
+ * The record is guarded by a sequence counter instead of a lock: the
+ * single writer makes it odd while it updates the record, and a reader
+ * copies the record and retries if the counter was odd or moved. Neither
+ * side blocks, so a reader cannot be held up by the sensor and the writer
+ * cannot be held up by a reader. Time comes from a clock supplied at init,
+ * which lets host tests drive it.
+ */
+
+#ifndef SENSOR_CACHE_H_
+#define SENSOR_CACHE_H_
+
+/* Standard includes. */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Milliseconds since any fixed point; may wrap.
+ */
+typedef uint32_t ( * SensorCacheClock_t )( void * pContext );
+
+/**
+ * @brief What a reader gets.
+ */
+typedef struct SensorCacheSnapshot
+{
+    bool valid;                 /**< @brief A good reading has been stored; the values below are set. */
+    int16_t temperatureTenths;
+    int16_t humidityTenths;
+    uint32_t ageMs;             /**< @brief Since the good reading was taken. */
+    int32_t lastStatus;         /**< @brief 0 if the latest attempt succeeded, else the driver's error. */
+    uint32_t consecutiveErrors; /**< @brief Failed attempts since the last good reading. */
+    uint32_t attempts;
+    uint32_t errors;
+} SensorCacheSnapshot_t;
+
+/**
+ * @brief Record as stored by the writer.
+ */
+typedef struct SensorCacheRecord
+{
+    bool valid;
+    int16_t temperatureTenths;
+    int16_t humidityTenths;
+    uint32_t takenMs;
+    int32_t lastStatus;
+    uint32_t consecutiveErrors;
+    uint32_t attempts;
+    uint32_t errors;
+} SensorCacheRecord_t;
+
+typedef struct SensorCache
+{
+    SensorCacheClock_t clock;
+    void * pClockContext;
+    atomic_uint_fast32_t sequence; /**< @brief Odd while the writer updates the record. */
+    SensorCacheRecord_t record;
+} SensorCache_t;
+
+void SensorCache_Init( SensorCache_t * pCache,
+                       SensorCacheClock_t clock,
+                       void * pClockContext );
+
+/**
+ * @brief Store the outcome of a read attempt, taken now. Writer side only.
+ *
+ * @param[in] status 0 for a good reading; the values are ignored otherwise.
+ */
+void SensorCache_Update( SensorCache_t * pCache,
+                         int32_t status,
+                         int16_t temperatureTenths,
+                         int16_t humidityTenths );
+
+/**
+ * @brief Copy the latest state. Returns at once; any task may call it.
+ *
+ * @return pSnapshot->valid.
+ */
+bool SensorCache_Get( SensorCache_t * pCache,
+                      SensorCacheSnapshot_t * pSnapshot );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef SENSOR_CACHE_H_ */
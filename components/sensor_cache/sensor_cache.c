@@ -0,0 +1,103 @@
+/**
+ * @file sensor_cache.c
+ * @brief Implementation of the sensor cache.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "sensor_cache.h"
+
+/*-----------------------------------------------------------*/
+
+void SensorCache_Init( SensorCache_t * pCache,
+                       SensorCacheClock_t clock,
+                       void * pClockContext )
+{
+    assert( pCache != NULL );
+    assert( clock != NULL );
+
+    pCache->clock = clock;
+    pCache->pClockContext = pClockContext;
+    atomic_init( &pCache->sequence, 0U );
+    ( void ) memset( &pCache->record, 0, sizeof( pCache->record ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void SensorCache_Update( SensorCache_t * pCache,
+                         int32_t status,
+                         int16_t temperatureTenths,
+                         int16_t humidityTenths )
+{
+    SensorCacheRecord_t * pRecord;
+    uint32_t sequence;
+    uint32_t now;
+
+    assert( pCache != NULL );
+
+    pRecord = &pCache->record;
+    now = pCache->clock( pCache->pClockContext );
+    sequence = ( uint32_t ) atomic_load_explicit( &pCache->sequence, memory_order_relaxed );
+
+    /* Odd: readers that see this retry. The fence keeps the record writes
+     * from being seen before it. */
+    atomic_store_explicit( &pCache->sequence, sequence + 1U, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+
+    pRecord->attempts++;
+    pRecord->lastStatus = status;
+
+    if( status == 0 )
+    {
+        pRecord->valid = true;
+        pRecord->temperatureTenths = temperatureTenths;
+        pRecord->humidityTenths = humidityTenths;
+        pRecord->takenMs = now;
+        pRecord->consecutiveErrors = 0U;
+    }
+    else
+    {
+        pRecord->errors++;
+        pRecord->consecutiveErrors++;
+    }
+
+    atomic_store_explicit( &pCache->sequence, sequence + 2U, memory_order_release );
+}
+
+/*-----------------------------------------------------------*/
+
+bool SensorCache_Get( SensorCache_t * pCache,
+                      SensorCacheSnapshot_t * pSnapshot )
+{
+    SensorCacheRecord_t record;
+    uint32_t before;
+    uint32_t after;
+
+    assert( pCache != NULL );
+    assert( pSnapshot != NULL );
+
+    /* The writer updates every few seconds and takes well under a
+     * microsecond, so a retry is rare and never repeats for long. */
+    do
+    {
+        before = ( uint32_t ) atomic_load_explicit( &pCache->sequence, memory_order_acquire );
+        ( void ) memcpy( &record, &pCache->record, sizeof( record ) );
+        atomic_thread_fence( memory_order_acquire );
+        after = ( uint32_t ) atomic_load_explicit( &pCache->sequence, memory_order_relaxed );
+    } while( ( ( before & 1U ) != 0U ) || ( before != after ) );
+
+    pSnapshot->valid = record.valid;
+    pSnapshot->temperatureTenths = record.temperatureTenths;
+    pSnapshot->humidityTenths = record.humidityTenths;
+    pSnapshot->ageMs = record.valid ? pCache->clock( pCache->pClockContext ) - record.takenMs : 0U;
+    pSnapshot->lastStatus = record.lastStatus;
+    pSnapshot->consecutiveErrors = record.consecutiveErrors;
+    pSnapshot->attempts = record.attempts;
+    pSnapshot->errors = record.errors;
+
+    return record.valid;
+}
+
+/*-----------------------------------------------------------*/
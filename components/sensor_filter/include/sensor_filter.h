@@ -0,0 +1,139 @@
+/**
+ * @file sensor_filter.h
+ * @brief Turns the raw samples of one sensor channel into reported values,
+ * each tagged with how far it can be trusted.
+ *
+ * A sample goes through two stages. The plausibility gate rejects samples
+ * outside the sensor's range, and samples that moved further from the last
+ * accepted one than the quantity can physically change in the time between
+ * them; a DHT22 frame that passes its checksum can still carry garbage, such
+ * as an all-zero frame or one shifted by a bit. A rejected sample leaves the
+ * filter untouched and the last reported value is repeated. Should the
+ * rejected samples agree with each other for a few samples in a row, the
+ * step is taken to be real and the filter starts over from them.
+ *
+ * Accepted samples enter a window of the last N. In median mode the window
+ * median is reported. In Hampel mode the sample itself is reported unless it
+ * lies more than k scaled median absolute deviations from the window median,
+ * in which case the median is reported instead: single spikes are removed
+ * without the lag a median adds to genuine changes.
+ *
+ * Values are integers in the channel's unit, e.g. tenths of a degree. The
+ * filter keeps no time of its own: the caller passes a millisecond clock
+ * reading with each sample. It is not thread safe.
+ */
+
+#ifndef SENSOR_FILTER_H_
+#define SENSOR_FILTER_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Largest window a filter can have.
+ */
+#define SENSOR_FILTER_WINDOW_MAX    ( 9U )
+
+/**
+ * @brief Trust in a reported value, from best to worst.
+ */
+typedef enum SensorQuality
+{
+    SensorQualityGood = 0, /**< @brief The sample, or a median that agrees with it. */
+    SensorQualityFiltered, /**< @brief The sample was an outlier; the window median is reported. */
+    SensorQualityHeld,     /**< @brief The sample was implausible; the last value is repeated. */
+    SensorQualityFailed    /**< @brief Nothing to report: no sample, or none accepted yet. */
+} SensorQuality_t;
+
+typedef enum SensorFilterMode
+{
+    SensorFilterMedian = 0,
+    SensorFilterHampel
+} SensorFilterMode_t;
+
+typedef struct SensorFilterConfig
+{
+    SensorFilterMode_t mode;
+    uint8_t window;         /**< @brief Samples in the window, odd, 1 to SENSOR_FILTER_WINDOW_MAX. */
+    uint16_t hampelKTenths; /**< @brief Outlier threshold in tenths of a scaled MAD, e.g. 30. */
+    int16_t deadband;       /**< @brief Deviations up to this are never outliers, as noise on a flat signal has a MAD of 0. */
+    int16_t minimum;        /**< @brief Plausible range of a sample. */
+    int16_t maximum;
+    int16_t maxStep;        /**< @brief Change always plausible between two samples. */
+    uint16_t maxRatePerS;   /**< @brief Further change plausible per second between them. */
+    uint8_t reanchorAfter;  /**< @brief Agreeing implausible samples in a row taken as a real step; 0 never. */
+} SensorFilterConfig_t;
+
+typedef struct SensorFilter
+{
+    SensorFilterConfig_t config;
+    int16_t samples[ SENSOR_FILTER_WINDOW_MAX ]; /**< @brief Accepted samples, a ring. */
+    uint8_t count;
+    uint8_t next;
+    int16_t lastSample;       /**< @brief Last accepted sample, valid once count > 0. */
+    uint32_t lastSampleMs;
+    int16_t output;           /**< @brief Last reported value, valid once count > 0. */
+    int16_t pendingSample;    /**< @brief Start of the current run of rejected samples. */
+    uint8_t pendingCount;
+    uint32_t quality[ SensorQualityFailed + 1 ]; /**< @brief Values reported at each quality. */
+} SensorFilter_t;
+
+/**
+ * @brief Initialize a filter.
+ *
+ * @return false if the window is even, 0 or too large, or the range is empty.
+ */
+bool SensorFilter_Init( SensorFilter_t * pFilter,
+                        const SensorFilterConfig_t * pConfig );
+
+/**
+ * @brief Feed a sample read at nowMs.
+ *
+ * @param[out] pValue The value to report; left alone if the quality is
+ * SensorQualityFailed.
+ *
+ * @return Quality of the value to report.
+ */
+SensorQuality_t SensorFilter_Add( SensorFilter_t * pFilter,
+                                  int16_t sample,
+                                  uint32_t nowMs,
+                                  int16_t * pValue );
+
+/**
+ * @brief Account for a read that produced no sample.
+ *
+ * @return SensorQualityFailed.
+ */
+SensorQuality_t SensorFilter_Missed( SensorFilter_t * pFilter );
+
+/**
+ * @brief Drop every sample, e.g. after the sensor was replaced. Statistics
+ * are kept.
+ */
+void SensorFilter_Reset( SensorFilter_t * pFilter );
+
+/**
+ * @brief Values reported at quality so far.
+ */
+uint32_t SensorFilter_Count( const SensorFilter_t * pFilter,
+                             SensorQuality_t quality );
+
+/**
+ * @brief Short lowercase name of quality, as published.
+ */
+const char * SensorFilter_QualityName( SensorQuality_t quality );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef SENSOR_FILTER_H_ */
@@ -0,0 +1,296 @@
+/**
+ * @file sensor_filter.c
+ * @brief Implementation of the sensor filter.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "sensor_filter.h"
+
+/**
+ * @brief MAD to standard deviation of normal noise, times 10000.
+ */
+#define MAD_SCALE_X10000    ( 14826 )
+
+/*-----------------------------------------------------------*/
+
+static int32_t distance( int32_t a,
+                         int32_t b )
+{
+    return ( a > b ) ? ( a - b ) : ( b - a );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Median of count values, sorting them in place. The window is at most nine
+ * samples, where an insertion sort is as fast as anything. */
+static int32_t median( int32_t * pValues,
+                       uint8_t count )
+{
+    uint8_t i;
+    uint8_t j;
+    int32_t value;
+
+    for( i = 1U; i < count; i++ )
+    {
+        value = pValues[ i ];
+
+        for( j = i; ( j > 0U ) && ( pValues[ j - 1U ] > value ); j-- )
+        {
+            pValues[ j ] = pValues[ j - 1U ];
+        }
+
+        pValues[ j ] = value;
+    }
+
+    /* An even count only happens while the window fills. */
+    if( ( count % 2U ) == 0U )
+    {
+        return ( pValues[ ( count / 2U ) - 1U ] + pValues[ count / 2U ] ) / 2;
+    }
+
+    return pValues[ count / 2U ];
+}
+
+/*-----------------------------------------------------------*/
+
+static bool inRange( const SensorFilter_t * pFilter,
+                     int16_t sample )
+{
+    return ( sample >= pFilter->config.minimum ) && ( sample <= pFilter->config.maximum );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool plausible( const SensorFilter_t * pFilter,
+                       int16_t sample,
+                       uint32_t nowMs )
+{
+    int64_t allowed;
+
+    if( !inRange( pFilter, sample ) )
+    {
+        return false;
+    }
+
+    if( pFilter->count == 0U )
+    {
+        return true;
+    }
+
+    /* Unsigned subtraction copes with the clock wrapping. */
+    allowed = pFilter->config.maxStep +
+              ( ( ( int64_t ) pFilter->config.maxRatePerS * ( uint32_t ) ( nowMs - pFilter->lastSampleMs ) ) / 1000 );
+
+    return distance( sample, pFilter->lastSample ) <= allowed;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Follows a run of rejected samples. Returns true once the run is long
+ * enough, and consistent enough, to be a real step. */
+static bool stepConfirmed( SensorFilter_t * pFilter,
+                           int16_t sample )
+{
+    if( !inRange( pFilter, sample ) )
+    {
+        pFilter->pendingCount = 0U;
+        return false;
+    }
+
+    if( ( pFilter->pendingCount > 0U ) &&
+        ( distance( sample, pFilter->pendingSample ) <= pFilter->config.maxStep ) )
+    {
+        pFilter->pendingCount++;
+    }
+    else
+    {
+        pFilter->pendingSample = sample;
+        pFilter->pendingCount = 1U;
+    }
+
+    return ( pFilter->config.reanchorAfter != 0U ) &&
+           ( pFilter->pendingCount >= pFilter->config.reanchorAfter );
+}
+
+/*-----------------------------------------------------------*/
+
+static SensorQuality_t estimate( SensorFilter_t * pFilter,
+                                 int16_t sample )
+{
+    int32_t values[ SENSOR_FILTER_WINDOW_MAX ];
+    int32_t center;
+    int32_t threshold;
+    uint8_t i;
+
+    for( i = 0U; i < pFilter->count; i++ )
+    {
+        values[ i ] = pFilter->samples[ i ];
+    }
+
+    center = median( values, pFilter->count );
+
+    if( pFilter->config.mode == SensorFilterMedian )
+    {
+        pFilter->output = ( int16_t ) center;
+
+        return ( distance( sample, center ) > pFilter->config.deadband ) ? SensorQualityFiltered : SensorQualityGood;
+    }
+
+    /* Too few samples to tell an outlier from a trend. */
+    if( pFilter->count < 3U )
+    {
+        pFilter->output = sample;
+        return SensorQualityGood;
+    }
+
+    for( i = 0U; i < pFilter->count; i++ )
+    {
+        values[ i ] = distance( values[ i ], center );
+    }
+
+    threshold = ( int32_t ) ( ( ( int64_t ) median( values, pFilter->count ) * pFilter->config.hampelKTenths * MAD_SCALE_X10000 ) / 100000 );
+
+    if( threshold < pFilter->config.deadband )
+    {
+        threshold = pFilter->config.deadband;
+    }
+
+    if( distance( sample, center ) > threshold )
+    {
+        pFilter->output = ( int16_t ) center;
+        return SensorQualityFiltered;
+    }
+
+    pFilter->output = sample;
+
+    return SensorQualityGood;
+}
+
+/*-----------------------------------------------------------*/
+
+bool SensorFilter_Init( SensorFilter_t * pFilter,
+                        const SensorFilterConfig_t * pConfig )
+{
+    assert( pFilter != NULL );
+    assert( pConfig != NULL );
+
+    if( ( pConfig->window == 0U ) || ( pConfig->window > SENSOR_FILTER_WINDOW_MAX ) ||
+        ( ( pConfig->window % 2U ) == 0U ) || ( pConfig->minimum > pConfig->maximum ) )
+    {
+        return false;
+    }
+
+    memset( pFilter, 0, sizeof( *pFilter ) );
+    pFilter->config = *pConfig;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+SensorQuality_t SensorFilter_Add( SensorFilter_t * pFilter,
+                                  int16_t sample,
+                                  uint32_t nowMs,
+                                  int16_t * pValue )
+{
+    SensorQuality_t quality;
+
+    assert( pFilter != NULL );
+    assert( pValue != NULL );
+
+    if( !plausible( pFilter, sample, nowMs ) )
+    {
+        if( !stepConfirmed( pFilter, sample ) )
+        {
+            quality = ( pFilter->count > 0U ) ? SensorQualityHeld : SensorQualityFailed;
+            pFilter->quality[ quality ]++;
+
+            if( quality == SensorQualityHeld )
+            {
+                *pValue = pFilter->output;
+            }
+
+            return quality;
+        }
+
+        /* The samples before the step say nothing about the signal now. */
+        pFilter->count = 0U;
+        pFilter->next = 0U;
+    }
+
+    pFilter->pendingCount = 0U;
+    pFilter->lastSample = sample;
+    pFilter->lastSampleMs = nowMs;
+    pFilter->samples[ pFilter->next ] = sample;
+    pFilter->next = ( uint8_t ) ( ( pFilter->next + 1U ) % pFilter->config.window );
+
+    if( pFilter->count < pFilter->config.window )
+    {
+        pFilter->count++;
+    }
+
+    quality = estimate( pFilter, sample );
+    pFilter->quality[ quality ]++;
+    *pValue = pFilter->output;
+
+    return quality;
+}
+
+/*-----------------------------------------------------------*/
+
+SensorQuality_t SensorFilter_Missed( SensorFilter_t * pFilter )
+{
+    assert( pFilter != NULL );
+
+    pFilter->quality[ SensorQualityFailed ]++;
+
+    return SensorQualityFailed;
+}
+
+/*-----------------------------------------------------------*/
+
+void SensorFilter_Reset( SensorFilter_t * pFilter )
+{
+    assert( pFilter != NULL );
+
+    pFilter->count = 0U;
+    pFilter->next = 0U;
+    pFilter->pendingCount = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t SensorFilter_Count( const SensorFilter_t * pFilter,
+                             SensorQuality_t quality )
+{
+    assert( pFilter != NULL );
+    assert( quality <= SensorQualityFailed );
+
+    return pFilter->quality[ quality ];
+}
+
+/*-----------------------------------------------------------*/
+
+const char * SensorFilter_QualityName( SensorQuality_t quality )
+{
+    switch( quality )
+    {
+        case SensorQualityGood:
+            return "good";
+
+        case SensorQualityFiltered:
+            return "filtered";
+
+        case SensorQualityHeld:
+            return "held";
+
+        default:
+            return "failed";
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,96 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of fixed-size
+ * elements.
+ *
+ * One task (or ISR) pushes and one task pops; neither blocks nor takes a
+ * lock. Indices run freely and are masked on access, so the capacity must
+ * be a power of two and every slot is usable. When the ring is full a push
+ * is refused and counted as a drop; the consumer owns the oldest elements
+ * and the producer cannot reclaim them.
+ */
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+/* Standard includes. */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+typedef struct SpscRing
+{
+    uint8_t * pStorage;
+    size_t elementSize;
+    uint32_t mask;              /**< @brief Capacity - 1. */
+    atomic_uint_fast32_t head;  /**< @brief Next slot to write; stored only by the producer. */
+    atomic_uint_fast32_t tail;  /**< @brief Next slot to read; stored only by the consumer. */
+    atomic_uint_fast32_t drops; /**< @brief Pushes refused because the ring was full. */
+    atomic_uint_fast32_t highWater; /**< @brief Largest fill level seen by the producer. */
+} SpscRing_t;
+
+/**
+ * @brief Initialize a ring over caller-provided storage.
+ *
+ * @param[in] pStorage capacity * elementSize bytes.
+ * @param[in] capacity Number of elements; must be a power of two.
+ *
+ * @return false if capacity is not a power of two.
+ */
+bool SpscRing_Init( SpscRing_t * pRing,
+                    void * pStorage,
+                    size_t elementSize,
+                    uint32_t capacity );
+
+/**
+ * @brief Copy one element in. Producer side only.
+ *
+ * @return false if the ring is full; the element is dropped and counted.
+ */
+bool SpscRing_Push( SpscRing_t * pRing,
+                    const void * pElement );
+
+/**
+ * @brief Copy the oldest element out. Consumer side only.
+ *
+ * @return false if the ring is empty.
+ */
+bool SpscRing_Pop( SpscRing_t * pRing,
+                   void * pElement );
+
+/**
+ * @brief Copy up to maxCount of the oldest elements out in one step.
+ * Consumer side only.
+ *
+ * @return Number of elements copied to pElements.
+ */
+size_t SpscRing_PopBatch( SpscRing_t * pRing,
+                          void * pElements,
+                          size_t maxCount );
+
+/**
+ * @brief Elements currently queued. A snapshot: the other side may change
+ * it right away.
+ */
+uint32_t SpscRing_Count( const SpscRing_t * pRing );
+
+uint32_t SpscRing_Capacity( const SpscRing_t * pRing );
+
+uint32_t SpscRing_Drops( const SpscRing_t * pRing );
+
+uint32_t SpscRing_HighWater( const SpscRing_t * pRing );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef SPSC_RING_H_ */
@@ -0,0 +1,158 @@
+/**
+ * @file spsc_ring.c
+ * @brief Implementation of the single-producer/single-consumer ring.
+ *
+ * The producer publishes a slot by storing head with release semantics
+ * after copying the element, and the consumer frees it by storing tail with
+ * release semantics after copying it out; each side loads the other's index
+ * with acquire semantics. Each index has a single writer, so no
+ * read-modify-write is needed on the fast path.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+/*-----------------------------------------------------------*/
+
+static void copyOut( const SpscRing_t * pRing,
+                     uint32_t index,
+                     uint8_t * pDestination,
+                     size_t count )
+{
+    uint32_t first = index & pRing->mask;
+    size_t capacity = ( size_t ) pRing->mask + 1U;
+    size_t beforeWrap = capacity - first;
+
+    if( count <= beforeWrap )
+    {
+        ( void ) memcpy( pDestination, &pRing->pStorage[ first * pRing->elementSize ], count * pRing->elementSize );
+    }
+    else
+    {
+        ( void ) memcpy( pDestination, &pRing->pStorage[ first * pRing->elementSize ], beforeWrap * pRing->elementSize );
+        ( void ) memcpy( &pDestination[ beforeWrap * pRing->elementSize ], pRing->pStorage, ( count - beforeWrap ) * pRing->elementSize );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool SpscRing_Init( SpscRing_t * pRing,
+                    void * pStorage,
+                    size_t elementSize,
+                    uint32_t capacity )
+{
+    assert( pRing != NULL );
+    assert( pStorage != NULL );
+    assert( elementSize > 0U );
+
+    if( ( capacity == 0U ) || ( ( capacity & ( capacity - 1U ) ) != 0U ) )
+    {
+        return false;
+    }
+
+    pRing->pStorage = ( uint8_t * ) pStorage;
+    pRing->elementSize = elementSize;
+    pRing->mask = capacity - 1U;
+    atomic_init( &pRing->head, 0U );
+    atomic_init( &pRing->tail, 0U );
+    atomic_init( &pRing->drops, 0U );
+    atomic_init( &pRing->highWater, 0U );
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool SpscRing_Push( SpscRing_t * pRing,
+                    const void * pElement )
+{
+    uint32_t head = ( uint32_t ) atomic_load_explicit( &pRing->head, memory_order_relaxed );
+    uint32_t tail = ( uint32_t ) atomic_load_explicit( &pRing->tail, memory_order_acquire );
+    uint32_t fill = head - tail;
+
+    if( fill > pRing->mask )
+    {
+        /* Only the producer increments drops, but readers on the other side
+         * must not see a torn value. */
+        atomic_store_explicit( &pRing->drops,
+                               atomic_load_explicit( &pRing->drops, memory_order_relaxed ) + 1U,
+                               memory_order_relaxed );
+        return false;
+    }
+
+    ( void ) memcpy( &pRing->pStorage[ ( head & pRing->mask ) * pRing->elementSize ], pElement, pRing->elementSize );
+    atomic_store_explicit( &pRing->head, head + 1U, memory_order_release );
+
+    if( ( fill + 1U ) > ( uint32_t ) atomic_load_explicit( &pRing->highWater, memory_order_relaxed ) )
+    {
+        atomic_store_explicit( &pRing->highWater, fill + 1U, memory_order_relaxed );
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool SpscRing_Pop( SpscRing_t * pRing,
+                   void * pElement )
+{
+    return SpscRing_PopBatch( pRing, pElement, 1U ) == 1U;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t SpscRing_PopBatch( SpscRing_t * pRing,
+                          void * pElements,
+                          size_t maxCount )
+{
+    uint32_t tail = ( uint32_t ) atomic_load_explicit( &pRing->tail, memory_order_relaxed );
+    uint32_t head = ( uint32_t ) atomic_load_explicit( &pRing->head, memory_order_acquire );
+    size_t count = head - tail;
+
+    if( count > maxCount )
+    {
+        count = maxCount;
+    }
+
+    if( count > 0U )
+    {
+        copyOut( pRing, tail, ( uint8_t * ) pElements, count );
+        atomic_store_explicit( &pRing->tail, tail + ( uint32_t ) count, memory_order_release );
+    }
+
+    return count;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t SpscRing_Count( const SpscRing_t * pRing )
+{
+    uint32_t tail = ( uint32_t ) atomic_load_explicit( &pRing->tail, memory_order_acquire );
+    uint32_t head = ( uint32_t ) atomic_load_explicit( &pRing->head, memory_order_acquire );
+
+    return head - tail;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t SpscRing_Capacity( const SpscRing_t * pRing )
+{
+    return pRing->mask + 1U;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t SpscRing_Drops( const SpscRing_t * pRing )
+{
+    return ( uint32_t ) atomic_load_explicit( &pRing->drops, memory_order_relaxed );
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t SpscRing_HighWater( const SpscRing_t * pRing )
+{
+    return ( uint32_t ) atomic_load_explicit( &pRing->highWater, memory_order_relaxed );
+}
@@ -0,0 +1,131 @@
+/**
+ * @file ts_block.h
+ * @brief Compressed block of time-series samples, after Facebook's Gorilla.
+ *
+ * Every sample has a millisecond timestamp and the same number of integer
+ * channels (fixed-point values such as tenths of a degree). A block is a
+ * 4-byte header followed by a bit stream, most significant bit first:
+ *
+ *     version (1) | channel count (1) | sample count (2, little endian)
+ *
+ * The first timestamp is stored in 32 bits. After it each timestamp is
+ * stored as its delta-of-delta, each channel value as the delta from the
+ * previous sample's value (from 0 for the first sample). Both are zig-zag
+ * mapped to unsigned and written with a prefix code that picks the width:
+ *
+ *     timestamps:  0 | 10 + 7 bits | 110 + 9 bits | 1110 + 12 bits | 1111 + 32 bits
+ *     values:      0 | 10 + 4 bits | 110 + 8 bits | 1110 + 16 bits | 1111 + 32 bits
+ *
+ * A sensor sampled at a steady rate whose readings barely move therefore
+ * costs a few bits per sample. The encoder never allocates; a sample that
+ * does not fit is refused whole, so a full block can still be finished.
+ */
+
+#ifndef TS_BLOCK_H_
+#define TS_BLOCK_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/**
+ * @brief Format version written in the header.
+ */
+#define TS_BLOCK_VERSION         ( 1U )
+
+/**
+ * @brief Bytes of header before the bit stream.
+ */
+#define TS_BLOCK_HEADER_SIZE     ( 4U )
+
+/**
+ * @brief Most channels a block can carry.
+ */
+#define TS_BLOCK_MAX_CHANNELS    ( 8U )
+
+typedef struct TsBlockEncoder
+{
+    uint8_t * pBuffer;
+    size_t size;
+    size_t bitPosition;
+    uint8_t channelCount;
+    uint16_t sampleCount;
+    uint32_t lastTimestamp;
+    int32_t lastDelta;
+    int32_t lastValues[ TS_BLOCK_MAX_CHANNELS ];
+    bool failed;
+} TsBlockEncoder_t;
+
+typedef struct TsBlockDecoder
+{
+    const uint8_t * pBuffer;
+    size_t length;
+    size_t bitPosition;
+    uint8_t channelCount;
+    uint16_t sampleCount;
+    uint16_t decoded;
+    uint32_t lastTimestamp;
+    int32_t lastDelta;
+    int32_t lastValues[ TS_BLOCK_MAX_CHANNELS ];
+} TsBlockDecoder_t;
+
+/**
+ * @brief Start a block in pBuffer.
+ *
+ * @param[in] channelCount Values per sample, 1 to TS_BLOCK_MAX_CHANNELS.
+ */
+void TsBlock_EncoderInit( TsBlockEncoder_t * pEncoder,
+                          uint8_t * pBuffer,
+                          size_t size,
+                          uint8_t channelCount );
+
+/**
+ * @brief Add a sample of channelCount values.
+ *
+ * @return false if the sample does not fit; the block is left unchanged.
+ */
+bool TsBlock_Append( TsBlockEncoder_t * pEncoder,
+                     uint32_t timestamp,
+                     const int32_t * pValues );
+
+/**
+ * @brief Write the sample count into the header.
+ *
+ * @return Length of the block, or -1 if the buffer cannot hold the header.
+ */
+int32_t TsBlock_EncoderFinish( TsBlockEncoder_t * pEncoder );
+
+/**
+ * @brief Read the header of a block.
+ *
+ * @return false if the block is truncated, of another version or has too
+ * many channels.
+ */
+bool TsBlock_DecoderInit( TsBlockDecoder_t * pDecoder,
+                          const uint8_t * pBuffer,
+                          size_t length );
+
+/**
+ * @brief Decode the next sample into pTimestamp and pValues, which must
+ * hold the block's channel count.
+ *
+ * @return false after the last sample, or if the block is truncated.
+ */
+bool TsBlock_Next( TsBlockDecoder_t * pDecoder,
+                   uint32_t * pTimestamp,
+                   int32_t * pValues );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef TS_BLOCK_H_ */
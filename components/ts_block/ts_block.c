@@ -0,0 +1,400 @@
+/**
+ * @file ts_block.c
+ * @brief Implementation of the compressed time-series block.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "ts_block.h"
+
+/**
+ * @brief Payload widths of the four non-zero prefix codes, '10', '110',
+ * '1110' and '1111'.
+ */
+typedef struct BucketWidths
+{
+    uint8_t bits[ 4 ];
+} BucketWidths_t;
+
+static const BucketWidths_t timestampBuckets = { { 7U, 9U, 12U, 32U } };
+static const BucketWidths_t valueBuckets = { { 4U, 8U, 16U, 32U } };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Difference of two 32-bit quantities, modulo 2^32. A delta can need
+ * 33 bits; keeping the low 32 is lossless because the decoder adds it back
+ * modulo 2^32 too.
+ */
+static int32_t difference( int32_t value,
+                           int32_t reference )
+{
+    return ( int32_t ) ( ( uint32_t ) value - ( uint32_t ) reference );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t sum( int32_t value,
+                    int32_t delta )
+{
+    return ( int32_t ) ( ( uint32_t ) value + ( uint32_t ) delta );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t zigzag( int32_t value )
+{
+    return ( ( uint32_t ) value << 1 ) ^ ( uint32_t ) ( value >> 31 );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t unzigzag( uint32_t value )
+{
+    return ( int32_t ) ( value >> 1 ) ^ -( int32_t ) ( value & 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+static void writeBits( TsBlockEncoder_t * pEncoder,
+                       uint32_t value,
+                       uint8_t count )
+{
+    size_t byteIndex;
+    uint8_t bit;
+
+    /* Space was checked by the caller. */
+    while( count > 0U )
+    {
+        count--;
+        bit = ( uint8_t ) ( ( value >> count ) & 1U );
+        byteIndex = pEncoder->bitPosition >> 3;
+
+        if( ( pEncoder->bitPosition & 7U ) == 0U )
+        {
+            pEncoder->pBuffer[ byteIndex ] = 0U;
+        }
+
+        pEncoder->pBuffer[ byteIndex ] |= ( uint8_t ) ( bit << ( 7U - ( pEncoder->bitPosition & 7U ) ) );
+        pEncoder->bitPosition++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool readBits( TsBlockDecoder_t * pDecoder,
+                      uint8_t count,
+                      uint32_t * pValue )
+{
+    uint32_t value = 0U;
+    size_t byteIndex;
+
+    if( ( pDecoder->bitPosition + count ) > ( pDecoder->length * 8U ) )
+    {
+        return false;
+    }
+
+    while( count > 0U )
+    {
+        count--;
+        byteIndex = pDecoder->bitPosition >> 3;
+        value = ( value << 1 ) |
+                ( ( pDecoder->pBuffer[ byteIndex ] >> ( 7U - ( pDecoder->bitPosition & 7U ) ) ) & 1U );
+        pDecoder->bitPosition++;
+    }
+
+    *pValue = value;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Prefixes '10', '110', '1110', '1111' with their lengths. */
+static const uint8_t prefixes[ 4 ] = { 0x2U, 0x6U, 0xEU, 0xFU };
+static const uint8_t prefixLengths[ 4 ] = { 2U, 3U, 4U, 4U };
+
+/**
+ * @brief Bucket of a non-zero value: the first one whose width holds it.
+ */
+static uint8_t bucketOf( const BucketWidths_t * pWidths,
+                         uint32_t value )
+{
+    uint8_t bucket;
+
+    for( bucket = 0; bucket < 3U; bucket++ )
+    {
+        if( value < ( 1UL << pWidths->bits[ bucket ] ) )
+        {
+            break;
+        }
+    }
+
+    return bucket;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t bucketedBits( const BucketWidths_t * pWidths,
+                            uint32_t value )
+{
+    uint8_t bucket;
+
+    if( value == 0U )
+    {
+        return 1U;
+    }
+
+    bucket = bucketOf( pWidths, value );
+
+    return ( size_t ) prefixLengths[ bucket ] + pWidths->bits[ bucket ];
+}
+
+/*-----------------------------------------------------------*/
+
+static void writeBucketed( TsBlockEncoder_t * pEncoder,
+                           const BucketWidths_t * pWidths,
+                           uint32_t value )
+{
+    uint8_t bucket;
+
+    if( value == 0U )
+    {
+        writeBits( pEncoder, 0U, 1U );
+        return;
+    }
+
+    bucket = bucketOf( pWidths, value );
+    writeBits( pEncoder, prefixes[ bucket ], prefixLengths[ bucket ] );
+    writeBits( pEncoder, value, pWidths->bits[ bucket ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool readBucketed( TsBlockDecoder_t * pDecoder,
+                          const BucketWidths_t * pWidths,
+                          uint32_t * pValue )
+{
+    uint32_t bit = 1U;
+    uint8_t ones = 0U;
+
+    /* Count the leading ones of the prefix, at most four. */
+    while( ones < 4U )
+    {
+        if( !readBits( pDecoder, 1U, &bit ) )
+        {
+            return false;
+        }
+
+        if( bit == 0U )
+        {
+            break;
+        }
+
+        ones++;
+    }
+
+    if( ones == 0U )
+    {
+        *pValue = 0U;
+        return true;
+    }
+
+    return readBits( pDecoder, pWidths->bits[ ones - 1U ], pValue );
+}
+
+/*-----------------------------------------------------------*/
+
+void TsBlock_EncoderInit( TsBlockEncoder_t * pEncoder,
+                          uint8_t * pBuffer,
+                          size_t size,
+                          uint8_t channelCount )
+{
+    assert( pEncoder != NULL );
+    assert( pBuffer != NULL );
+    assert( ( channelCount > 0U ) && ( channelCount <= TS_BLOCK_MAX_CHANNELS ) );
+
+    memset( pEncoder, 0, sizeof( *pEncoder ) );
+    pEncoder->pBuffer = pBuffer;
+    pEncoder->size = size;
+    pEncoder->channelCount = channelCount;
+
+    if( size < TS_BLOCK_HEADER_SIZE )
+    {
+        pEncoder->failed = true;
+        return;
+    }
+
+    pBuffer[ 0 ] = TS_BLOCK_VERSION;
+    pBuffer[ 1 ] = channelCount;
+    pEncoder->bitPosition = TS_BLOCK_HEADER_SIZE * 8U;
+}
+
+/*-----------------------------------------------------------*/
+
+bool TsBlock_Append( TsBlockEncoder_t * pEncoder,
+                     uint32_t timestamp,
+                     const int32_t * pValues )
+{
+    uint32_t encoded[ TS_BLOCK_MAX_CHANNELS ];
+    uint32_t timeEncoded = 0U;
+    int32_t delta = 0;
+    size_t bits;
+    uint8_t channel;
+
+    assert( pEncoder != NULL );
+    assert( pValues != NULL );
+
+    if( pEncoder->failed || ( pEncoder->sampleCount == UINT16_MAX ) )
+    {
+        return false;
+    }
+
+    /* Work out the whole sample first so a partial one is never written. */
+    if( pEncoder->sampleCount == 0U )
+    {
+        bits = 32U;
+    }
+    else
+    {
+        /* Unsigned subtraction follows the millisecond counter across a wrap. */
+        delta = ( int32_t ) ( timestamp - pEncoder->lastTimestamp );
+        timeEncoded = zigzag( difference( delta, pEncoder->lastDelta ) );
+        bits = bucketedBits( &timestampBuckets, timeEncoded );
+    }
+
+    for( channel = 0; channel < pEncoder->channelCount; channel++ )
+    {
+        encoded[ channel ] = zigzag( difference( pValues[ channel ], pEncoder->lastValues[ channel ] ) );
+        bits += bucketedBits( &valueBuckets, encoded[ channel ] );
+    }
+
+    if( ( pEncoder->bitPosition + bits ) > ( pEncoder->size * 8U ) )
+    {
+        return false;
+    }
+
+    if( pEncoder->sampleCount == 0U )
+    {
+        writeBits( pEncoder, timestamp, 32U );
+    }
+    else
+    {
+        writeBucketed( pEncoder, &timestampBuckets, timeEncoded );
+        pEncoder->lastDelta = delta;
+    }
+
+    pEncoder->lastTimestamp = timestamp;
+
+    for( channel = 0; channel < pEncoder->channelCount; channel++ )
+    {
+        writeBucketed( pEncoder, &valueBuckets, encoded[ channel ] );
+        pEncoder->lastValues[ channel ] = pValues[ channel ];
+    }
+
+    pEncoder->sampleCount++;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t TsBlock_EncoderFinish( TsBlockEncoder_t * pEncoder )
+{
+    assert( pEncoder != NULL );
+
+    if( pEncoder->failed )
+    {
+        return -1;
+    }
+
+    pEncoder->pBuffer[ 2 ] = ( uint8_t ) ( pEncoder->sampleCount & 0xFFU );
+    pEncoder->pBuffer[ 3 ] = ( uint8_t ) ( pEncoder->sampleCount >> 8 );
+
+    return ( int32_t ) ( ( pEncoder->bitPosition + 7U ) / 8U );
+}
+
+/*-----------------------------------------------------------*/
+
+bool TsBlock_DecoderInit( TsBlockDecoder_t * pDecoder,
+                          const uint8_t * pBuffer,
+                          size_t length )
+{
+    assert( pDecoder != NULL );
+    assert( pBuffer != NULL );
+
+    memset( pDecoder, 0, sizeof( *pDecoder ) );
+
+    if( ( length < TS_BLOCK_HEADER_SIZE ) ||
+        ( pBuffer[ 0 ] != TS_BLOCK_VERSION ) ||
+        ( pBuffer[ 1 ] == 0U ) ||
+        ( pBuffer[ 1 ] > TS_BLOCK_MAX_CHANNELS ) )
+    {
+        return false;
+    }
+
+    pDecoder->pBuffer = pBuffer;
+    pDecoder->length = length;
+    pDecoder->channelCount = pBuffer[ 1 ];
+    pDecoder->sampleCount = ( uint16_t ) ( pBuffer[ 2 ] | ( pBuffer[ 3 ] << 8 ) );
+    pDecoder->bitPosition = TS_BLOCK_HEADER_SIZE * 8U;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+bool TsBlock_Next( TsBlockDecoder_t * pDecoder,
+                   uint32_t * pTimestamp,
+                   int32_t * pValues )
+{
+    uint32_t raw;
+    uint8_t channel;
+
+    assert( pDecoder != NULL );
+    assert( pTimestamp != NULL );
+    assert( pValues != NULL );
+
+    if( pDecoder->decoded >= pDecoder->sampleCount )
+    {
+        return false;
+    }
+
+    if( pDecoder->decoded == 0U )
+    {
+        if( !readBits( pDecoder, 32U, &pDecoder->lastTimestamp ) )
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if( !readBucketed( pDecoder, &timestampBuckets, &raw ) )
+        {
+            return false;
+        }
+
+        pDecoder->lastDelta = sum( pDecoder->lastDelta, unzigzag( raw ) );
+        pDecoder->lastTimestamp += ( uint32_t ) pDecoder->lastDelta;
+    }
+
+    for( channel = 0; channel < pDecoder->channelCount; channel++ )
+    {
+        if( !readBucketed( pDecoder, &valueBuckets, &raw ) )
+        {
+            return false;
+        }
+
+        pDecoder->lastValues[ channel ] = sum( pDecoder->lastValues[ channel ], unzigzag( raw ) );
+        pValues[ channel ] = pDecoder->lastValues[ channel ];
+    }
+
+    *pTimestamp = pDecoder->lastTimestamp;
+    pDecoder->decoded++;
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
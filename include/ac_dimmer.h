@@ -12,25 +12,25 @@
 
 // Constantes para el control del dimmer
 #define MAX_DIMMING_LEVEL 100      // Nivel máximo de dimming (%)
-#define AC_FREQ 60                 // Frecuencia AC (Hz) - ajustar a 50Hz si es necesario
-#define HALF_PERIOD_US (1000000 / (AC_FREQ * 2))  // Duración de medio ciclo en microsegundos
+// La frecuencia de red no se configura: el PLL de cruce por cero la mide
 
-// Estructura para controlador PID
+// Estructura para controlador PID, en punto fijo: las temperaturas van en
+// décimas de grado, como las entrega el sensor, y las ganancias en milésimas
 typedef struct {
-    double kp;             // Constante proporcional
-    double ki;             // Constante integral
-    double kd;             // Constante derivativa
-    double setpoint;       // Temperatura objetivo
-    double input;          // Temperatura actual
-    double output;         // Salida (0-100)
-    double last_error;     // Último error calculado
-    double integral;       // Acumulador integral
-    double derivative;     // Término derivativo
-    double last_input;     // Último valor de entrada
-    double output_min;     // Límite mínimo de salida
-    double output_max;     // Límite máximo de salida
-    double max_safe_temp;  // Temperatura máxima segura
-    uint32_t last_time;    // Último tiempo de cálculo
+    int32_t kp_milli;          // Constante proporcional (% por grado C)
+    int32_t ki_milli;          // Constante integral (% por grado C y segundo)
+    int32_t kd_milli;          // Constante derivativa (% por grado C/s)
+    int16_t setpoint_tenths;   // Temperatura objetivo
+    int16_t input_tenths;      // Temperatura actual
+    int16_t last_error_tenths; // Último error calculado
+    int16_t last_input_tenths; // Último valor de entrada
+    int16_t max_safe_tenths;   // Temperatura máxima segura
+    int32_t output_milli;      // Salida (0-100%) en milésimas de %
+    int64_t integral;          // Acumulador integral en diezmillonésimas de %
+    int32_t derivative_milli;  // Término derivativo en milésimas de %
+    uint8_t output_min;        // Límite mínimo de salida (%)
+    uint8_t output_max;        // Límite máximo de salida (%)
+    uint32_t last_time;        // Último tiempo de cálculo
 } pid_controller_t;
 
 // Funciones para el dimmer AC con cruce por cero
@@ -38,7 +38,7 @@ void ac_dimmer_init(void);
 void ac_dimmer_set_value(uint8_t value);
 
 // Funciones para el controlador PID
-void pid_init(pid_controller_t *pid, double kp, double ki, double kd, double setpoint, double output_min, double output_max, double max_safe_temp);
-double pid_compute(pid_controller_t *pid, double input);
+void pid_init(pid_controller_t *pid, int32_t kp_milli, int32_t ki_milli, int32_t kd_milli, int16_t setpoint_tenths, uint8_t output_min, uint8_t output_max, int16_t max_safe_tenths);
+uint8_t pid_compute(pid_controller_t *pid, int16_t input_tenths);
 
 #endif /* AC_DIMMER_H */
\ No newline at end of file
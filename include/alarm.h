@@ -0,0 +1,53 @@
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// Conditions reported on the alarm topic, ahead of regular telemetry
+typedef enum {
+    ALARM_OVER_TEMPERATURE = 0, // Temperature at or above the threshold
+    ALARM_ZERO_CROSS_LOST,      // Dimmer enabled but no zero crossing seen
+    ALARM_KIND_COUNT,
+} alarm_kind_t;
+
+// A condition being raised or cleared
+typedef struct {
+    alarm_kind_t kind;
+    bool active;
+    uint32_t uptime_ms;
+    int16_t value_tenths;       // Temperature for ALARM_OVER_TEMPERATURE, else 0
+} alarm_event_t;
+
+typedef struct {
+    int16_t over_temperature_tenths;    // Raise at or above, 0 = off
+    int16_t hysteresis_tenths;          // Clear below the threshold minus this
+    uint32_t zero_cross_timeout_ms;     // Raise after this long without a crossing, 0 = off
+} alarm_config_t;
+
+typedef struct {
+    alarm_config_t config;
+    bool active[ALARM_KIND_COUNT];
+    bool has_zero_cross;                // zero_cross_count/ms below are valid
+    uint32_t zero_cross_count;          // Counter value when it last moved
+    uint32_t zero_cross_ms;             // Uptime when it last moved
+} alarm_monitor_t;
+
+void alarm_monitor_init(alarm_monitor_t *monitor, const alarm_config_t *config);
+
+// Check reading and the running zero-crossing counter against the alarm
+// conditions. Each condition that changed state is stored in events, which
+// must hold ALARM_KIND_COUNT entries. Returns the number of events.
+size_t alarm_monitor_evaluate(alarm_monitor_t *monitor, const telemetry_reading_t *reading,
+                              uint32_t zero_cross_count, alarm_event_t *events);
+
+// Render event as a small JSON document. Returns the payload length, or -1.
+int alarm_encode_json(const alarm_event_t *event, const char *client, char *buffer, size_t size);
+
+// Short name of a kind, for payloads and logs
+const char *alarm_kind_name(alarm_kind_t kind);
+
+#endif /* ALARM_H */
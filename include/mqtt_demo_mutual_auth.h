@@ -72,6 +72,21 @@
     #define AWS_MQTT_PORT    ( CONFIG_MQTT_BROKER_PORT )
 #endif
 
+/**
+* @brief Backup MQTT broker, used when the primary one fails or is slower.
+* An empty string disables failover.
+*/
+#ifndef MQTT_BACKUP_ENDPOINT
+    #define MQTT_BACKUP_ENDPOINT    CONFIG_MQTT_BROKER_BACKUP_ENDPOINT
+#endif
+
+/**
+* @brief Backup MQTT broker port number.
+*/
+#ifndef MQTT_BACKUP_PORT
+    #define MQTT_BACKUP_PORT    ( CONFIG_MQTT_BROKER_BACKUP_PORT )
+#endif
+
 /**
 * @brief The username value for authenticating client to MQTT broker when
 * username/password based client authentication is used.
@@ -165,7 +180,8 @@ static uint16_t globalMqttTopicLength = ( uint16_t ) ( sizeof( globalMqttTopic )
 * @brief Initializes the MQTT library.
 *
 * @param[in] pMqttContext MQTT context pointer.
-* @param[in] pNetworkContext The network context pointer.
+* @param[in] pNetworkContext Network context of the primary broker. The
+* backup broker, if configured, uses a context of its own.
 *
 * @return EXIT_SUCCESS if the MQTT library is initialized;
 * EXIT_FAILURE otherwise.
@@ -176,33 +192,84 @@ int initializeMqtt( MQTTContext_t * pMqttContext,
 /**
 * @brief Connect to MQTT broker with reconnection retries.
 *
-* If connection fails, retry is attempted after a timeout.
+* The broker with the lowest measured connect and PUBACK times is tried
+* first, using its standby connection if one is open. A failed broker is
+* skipped for a while, so a failure moves straight on to the other broker.
+* Once every broker has failed, retry is attempted after a timeout.
 * Timeout value will exponentially increase until maximum
 * timeout value is reached or the number of attempts are exhausted.
 *
-* @param[out] pNetworkContext The output parameter to return the created network context.
+* @param[in] pMqttContext MQTT context whose transport is pointed at the
+* connected broker.
 *
 * @return EXIT_FAILURE on failure; EXIT_SUCCESS on successful connection.
 */
-int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext );
+int connectToServerWithBackoffRetries( MQTTContext_t * pMqttContext );
+
+/**
+* @brief Close the connection made by connectToServerWithBackoffRetries().
+* A standby connection to the other broker is kept open.
+*
+* @param[in] sessionFailed true if the MQTT session on this connection
+* failed, which makes the next connection prefer the other broker.
+*/
+void disconnectFromServer( bool sessionFailed );
+
+/**
+* @brief Priority lanes of outgoing publishes, highest first. Each lane has
+* its own limit of publishes awaiting a PUBACK, so a backlog in a lower lane
+* never takes every slot from a higher one.
+*/
+typedef enum MqttLane
+{
+    MqttLaneAlarm = 0, /**< @brief Alarm events; sent before anything else. */
+    MqttLaneTelemetry, /**< @brief Regular and backlogged readings. */
+    MqttLaneCount
+} MqttLane_t;
+
+/**
+* @brief One payload to publish.
+*/
+typedef struct MqttPayload
+{
+    const char * pData;
+    uint16_t length;
+    const char * pTopic;  /**< @brief Topic to publish on; NULL for the subscribed topic. Must stay valid until acknowledged. */
+    uint16_t topicLength;
+    MqttLane_t lane;
+    bool acknowledged;    /**< @brief Set when the broker's PUBACK was received. */
+} MqttPayload_t;
 
 /**
 * @brief A function that connects to MQTT broker,
-* subscribes a topic, publishes to the same
-* topic MQTT_PUBLISH_COUNT_PER_LOOP number of times, and verifies if it
-* receives the Publish message back.
+* subscribes a topic, publishes each payload to the same
+* topic, and verifies if it receives the Publish messages back.
 *
-* @param[in] pMqttContext MQTT context pointer.
-* @param[in,out] pClientSessionPresent Pointer to flag indicating if an
-* MQTT session is present in the client.
+* @param[in] pMqttContext MQTT context pointer, connected by
+* connectToServerWithBackoffRetries(). The session is resumed if one was
+* opened with the same broker before.
+* @param[in,out] pPayloads Payloads to publish. Higher lanes go first, each
+* lane in order. Each is copied into the publish pool, so the data need only
+* stay valid for the call; payloads left over once their lane has no room
+* for another publish awaiting a PUBACK are not sent. On return each is
+* marked with whether its PUBACK arrived.
+* @param[in] payloadCount Number of payloads.
 *
 * @return EXIT_FAILURE on failure; EXIT_SUCCESS on success.
 */
 int subscribePublishLoop( MQTTContext_t * pMqttContext,
-                        bool * pClientSessionPresent,
                         const char * pcTopicFilter,
                         uint16_t usTopicFilterLength,
-                        const char * pcPayload,
-                        uint16_t payloadLength );
+                        MqttPayload_t * pPayloads,
+                        size_t payloadCount );
+
+#if CONFIG_FAULT_INJECTION_ENABLE
+
+/**
+* @brief Account for one completed demo iteration under the running fault
+* scenario; logs its report and moves on to the next scenario when it is done.
+*/
+void faultInjectionIterationDone( void );
+#endif
 
 #endif /* ifndef MQTT_DEMO_MUTUAL_AUTH_H_ */
@@ -0,0 +1,46 @@
+#ifndef REPORT_POLICY_H
+#define REPORT_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// When a reading is worth publishing. Sensor values are compared with the
+// last reported reading, not the previous sample, so a slow drift is still
+// reported once it adds up to a deadband: an unreported value is never more
+// than one deadband away from the last published one.
+typedef struct {
+    int16_t temperature_deadband_tenths; // Absolute change that triggers a report, 0 = off
+    int16_t humidity_deadband_tenths;    // Absolute change that triggers a report, 0 = off
+    uint16_t relative_deadband_permille; // Change relative to the reported value, 0 = off
+    uint32_t heartbeat_ms;               // Longest silence; 0 reports every reading
+} report_policy_config_t;
+
+// Why a reading was reported
+typedef enum {
+    REPORT_SKIP = 0,    // Within the deadbands and the heartbeat has not expired
+    REPORT_FIRST,       // Nothing reported yet
+    REPORT_STATE,       // Sensor health or dimmer state changed
+    REPORT_DEADBAND,    // Temperature or humidity moved past a deadband
+    REPORT_HEARTBEAT,   // Nothing reported for heartbeat_ms
+} report_reason_t;
+
+typedef struct {
+    report_policy_config_t config;
+    bool has_reported;
+    telemetry_reading_t last;   // Last reported reading
+    uint32_t evaluated;         // Readings seen
+    uint32_t reported;          // Readings that passed
+} report_policy_t;
+
+void report_policy_init(report_policy_t *policy, const report_policy_config_t *config);
+
+// Decide whether reading should be published, using its uptime_ms as the
+// clock. A reading that passes becomes the new reference.
+report_reason_t report_policy_evaluate(report_policy_t *policy, const telemetry_reading_t *reading);
+
+// Short name of a reason, for logs
+const char *report_reason_name(report_reason_t reason);
+
+#endif /* REPORT_POLICY_H */
@@ -0,0 +1,41 @@
+#ifndef SAMPLE_INTERVAL_H
+#define SAMPLE_INTERVAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// The DHT22 needs at least this long between reads
+#define SAMPLE_INTERVAL_FLOOR_MS 2000
+
+// Picks the time to the next sample from how fast the readings move. The
+// interval is the time temperature or humidity takes, at its recent rate of
+// change, to move by its tolerance: a flat signal is sampled rarely and a
+// fast one often, and linear interpolation between samples stays within
+// about one tolerance of the real signal.
+typedef struct {
+    uint32_t min_ms;                        // Shortest interval, raised to SAMPLE_INTERVAL_FLOOR_MS
+    uint32_t max_ms;                        // Longest interval, while the signal is flat
+    uint32_t initial_ms;                    // Interval until the rate is known
+    int16_t temperature_tolerance_tenths;   // Change worth a sample, at least 1
+    int16_t humidity_tolerance_tenths;      // Change worth a sample, at least 1
+} sample_interval_config_t;
+
+typedef struct {
+    sample_interval_config_t config;
+    uint32_t interval_ms;       // Time to the next sample
+    uint32_t rate;              // Smoothed rate of change, thousandths of a tolerance per second
+    bool has_last;
+    telemetry_reading_t last;   // Previous good reading
+} sample_interval_t;
+
+void sample_interval_init(sample_interval_t *sampler, const sample_interval_config_t *config);
+
+// Update the rate of change with reading, timed by its uptime_ms, and return
+// the time to the next sample. A rise in the rate shortens the interval at
+// once; a fall lengthens it gradually. A dimmer change drops the interval to
+// the minimum, since the temperature is about to respond to it.
+uint32_t sample_interval_update(sample_interval_t *sampler, const telemetry_reading_t *reading);
+
+#endif /* SAMPLE_INTERVAL_H */
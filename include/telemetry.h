@@ -0,0 +1,85 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of the buffer a telemetry payload is rendered into
+#define TELEMETRY_PAYLOAD_SIZE 384
+
+// Payload encodings
+typedef enum {
+    TELEMETRY_FORMAT_JSON = 0,
+    TELEMETRY_FORMAT_CBOR = 1,      // Same document as CBOR (RFC 8949), decimals as tag 4
+    TELEMETRY_FORMAT_BLOCK = 2,     // Several readings per payload as a compressed time-series block
+} telemetry_format_t;
+
+// Channels of a time-series block payload, in order: temperature_tenths,
+// humidity_tenths, dimmer_ch1, dimmer_ch2 and flags (bit 0 sensor_ok,
+// bit 1 dimmer_enabled, bits 2-3 quality). Samples are timestamped with
+// uptime_ms.
+#define TELEMETRY_BLOCK_CHANNELS 5
+
+// Size of the buffer each constant payload prefix is rendered into
+#define TELEMETRY_PREFIX_SIZE 192
+
+// One sample of the variable part of a telemetry payload. The device
+// identity is constant and set once with telemetry_set_identity().
+typedef struct {
+    uint32_t uptime_ms;         // Time since boot
+    uint32_t interval_ms;       // Time to the next sample
+    bool sensor_ok;             // false if the DHT read failed; readings are sent as null
+    int16_t temperature_tenths; // Temperature in tenths of a degree C
+    int16_t humidity_tenths;    // Relative humidity in tenths of a percent
+    uint8_t quality;            // SensorQuality_t of the worse of the two values
+    uint8_t dimmer_ch1;         // Channel 1 level (0-100%)
+    uint8_t dimmer_ch2;         // Channel 2 level (0-100%)
+    bool dimmer_enabled;
+} telemetry_reading_t;
+
+// Render the fields that never change (client, status, MAC address and
+// firmware version) once, as the leading part of every JSON and CBOR
+// payload. Call before encoding anything; the strings are copied.
+void telemetry_set_identity(const char *hardware, const char *firmware, const char *client);
+
+// Render the device/sensors/dimmer JSON document straight into buffer without
+// allocating. Returns the payload length, or -1 if it does not fit.
+int telemetry_encode_json(const telemetry_reading_t *reading, char *buffer, size_t size);
+
+// Same document as telemetry_encode_json() in CBOR; decode with tools/cbor_decode.py.
+int telemetry_encode_cbor(const telemetry_reading_t *reading, uint8_t *buffer, size_t size);
+
+// Render as many of count readings as fit into one time-series block (see
+// ts_block.h; decode with tools/ts_block_decode.py) and store how many were
+// taken. Returns the payload length, or -1 if not even one reading fits.
+int telemetry_encode_block(const telemetry_reading_t *readings, size_t count,
+                           uint8_t *buffer, size_t size, size_t *taken);
+
+// Encoding used by telemetry_encode(); defaults to the Kconfig choice
+void telemetry_set_format(telemetry_format_t format);
+telemetry_format_t telemetry_get_format(void);
+
+// Render reading in the current format. Returns the payload length, or -1.
+int telemetry_encode(const telemetry_reading_t *reading, char *buffer, size_t size);
+
+// A payload buffer that keeps the constant prefix between payloads: the
+// prefix is copied in the first time, and from then on only the variable
+// fields of each reading are rendered after it.
+typedef struct {
+    char *buffer;
+    size_t size;
+    int primed;                 // Format whose prefix the buffer holds, or -1
+} telemetry_composer_t;
+
+void telemetry_composer_init(telemetry_composer_t *composer, char *buffer, size_t size);
+
+// Render reading as a JSON or CBOR payload in the composer's buffer.
+// Returns the payload length, or -1 if it does not fit.
+int telemetry_compose(telemetry_composer_t *composer, const telemetry_reading_t *reading,
+                      telemetry_format_t format);
+
+// Forget the prefix, once the buffer has been used for anything else
+void telemetry_composer_reset(telemetry_composer_t *composer);
+
+#endif /* TELEMETRY_H */
@@ -4,6 +4,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "zc_pll.h"
 
 static const char *TAG = "AC_DIMMER";
 
@@ -12,14 +13,22 @@ volatile uint8_t dimming_level = 0;  // 0-100%
 volatile bool zero_cross_detected = false;
 esp_timer_handle_t dimmer_timer;
 
+// Mide la frecuencia de red y filtra los flancos de cruce por cero
+static zc_pll_t zero_cross_pll;
+
 // Rutina de interrupción para la detección de cruce por cero
 static void IRAM_ATTR zero_cross_isr(void* arg) {
+    // Solo disparan los flancos que el PLL acepta como cruces: los rebotes y
+    // el ruido no vuelven a programar el disparo, y sin enganche no se dispara
+    if (!zc_pll_edge(&zero_cross_pll, (uint32_t) esp_timer_get_time())) {
+        return;
+    }
     zero_cross_detected = true;
     
     // Calcular el tiempo de retraso para el disparo del triac
     // Un valor de dimming de 0 significa potencia máxima (disparo inmediato)
     // Un valor de dimming de 100 significa potencia mínima (disparo tardío o ninguno)
-    int32_t delay_us = (HALF_PERIOD_US * dimming_level) / 100;
+    int32_t delay_us = (zc_pll_half_cycle_us(&zero_cross_pll) * dimming_level) / 100;
     
     // Si el nivel de dimming es muy alto, simplemente no disparamos
     if (dimming_level >= 99) {
@@ -77,6 +86,7 @@ void ac_dimmer_init(void) {
     ESP_ERROR_CHECK(esp_timer_create(&timer_args, &dimmer_timer));
     
     // Instalar el handler de la interrupción de cruce por cero
+    zc_pll_init(&zero_cross_pll);
     gpio_install_isr_service(0);
     gpio_isr_handler_add(ZERO_CROSS_PIN, zero_cross_isr, NULL);
     
@@ -93,68 +103,85 @@ void ac_dimmer_set_value(uint8_t value) {
     ESP_LOGI(TAG, "Setting dimmer level to: %d%%", dimming_level);
 }
 
+// Escalas internas de la salida y de la integral, en partes de un %. La
+// integral lleva más resolución para no perder los incrementos pequeños.
+#define PID_OUTPUT_SCALE 1000
+#define PID_INTEGRAL_SCALE 10000000LL
+
+static int32_t clamp_output(int64_t value, const pid_controller_t *pid) {
+    if (value > (int64_t) pid->output_max * PID_OUTPUT_SCALE) return pid->output_max * PID_OUTPUT_SCALE;
+    if (value < (int64_t) pid->output_min * PID_OUTPUT_SCALE) return pid->output_min * PID_OUTPUT_SCALE;
+    return (int32_t) value;
+}
+
 // Inicializar el controlador PID
-void pid_init(pid_controller_t *pid, double kp, double ki, double kd, double setpoint, double output_min, double output_max, double max_safe_temp) {
-    pid->kp = kp;
-    pid->ki = ki;
-    pid->kd = kd;
-    pid->setpoint = setpoint;
+void pid_init(pid_controller_t *pid, int32_t kp_milli, int32_t ki_milli, int32_t kd_milli, int16_t setpoint_tenths, uint8_t output_min, uint8_t output_max, int16_t max_safe_tenths) {
+    pid->kp_milli = kp_milli;
+    pid->ki_milli = ki_milli;
+    pid->kd_milli = kd_milli;
+    pid->setpoint_tenths = setpoint_tenths;
     pid->output_min = output_min;
     pid->output_max = output_max;
-    pid->max_safe_temp = max_safe_temp;
-    pid->last_error = 0;
+    pid->max_safe_tenths = max_safe_tenths;
+    pid->input_tenths = 0;
+    pid->last_error_tenths = 0;
     pid->integral = 0;
-    pid->derivative = 0;
-    pid->last_input = 0;
-    pid->output = 0;
+    pid->derivative_milli = 0;
+    pid->last_input_tenths = 0;
+    pid->output_milli = 0;
     pid->last_time = esp_timer_get_time() / 1000; // Convertir a milisegundos
     
-    ESP_LOGI(TAG, "PID controller initialized with Kp=%.2f, Ki=%.2f, Kd=%.2f, Setpoint=%.2f", 
-             pid->kp, pid->ki, pid->kd, pid->setpoint);
+    ESP_LOGI(TAG, "PID controller initialized with Kp=%d, Ki=%d, Kd=%d (thousandths), Setpoint=%d (tenths)", 
+             pid->kp_milli, pid->ki_milli, pid->kd_milli, pid->setpoint_tenths);
 }
 
-// Calcular salida del controlador PID
-double pid_compute(pid_controller_t *pid, double input) {
+// Calcular salida del controlador PID, en %
+uint8_t pid_compute(pid_controller_t *pid, int16_t input_tenths) {
     // Verificar si la temperatura está por encima del límite seguro
-    if (input > pid->max_safe_temp) {
+    if (input_tenths > pid->max_safe_tenths) {
         ESP_LOGW(TAG, "Temperature above safety limit! Turning off heater.");
         return 100; // Apagar la calefacción (100% dimming = mínima potencia)
     }
     
     // Obtener el tiempo actual en milisegundos
     uint32_t now = esp_timer_get_time() / 1000;
-    double time_change = (now - pid->last_time);
+    uint32_t time_change = now - pid->last_time;
     
     // Si ha pasado muy poco tiempo, no recalcular
     if (time_change < 100) { // Menos de 100ms
-        return pid->output;
+        return (uint8_t) ((pid->output_milli + PID_OUTPUT_SCALE / 2) / PID_OUTPUT_SCALE);
     }
     
     // Calcular error
-    double error = pid->setpoint - input;
-    ESP_LOGD(TAG, "PID Error: %.2f (Setpoint: %.2f, Input: %.2f)", error, pid->setpoint, input);
-    
-    // Calcular término integral (con anti-windup)
-    pid->integral += (pid->ki * error * time_change / 1000.0);
-    if (pid->integral > pid->output_max) pid->integral = pid->output_max;
-    else if (pid->integral < pid->output_min) pid->integral = pid->output_min;
-    
-    // Calcular término derivativo (sobre el cambio de la medida, no del error)
-    pid->derivative = (input - pid->last_input) / (time_change / 1000.0);
-    
-    // Calcular salida PID
-    pid->output = (pid->kp * error) + pid->integral - (pid->kd * pid->derivative);
+    int32_t error = pid->setpoint_tenths - input_tenths;
+    pid->input_tenths = input_tenths;
+    pid->last_error_tenths = (int16_t) error;
+    ESP_LOGD(TAG, "PID Error: %d (Setpoint: %d, Input: %d, tenths)", error, pid->setpoint_tenths, input_tenths);
+    
+    // Calcular término integral (con anti-windup):
+    // Ki/1000 * error/10 * tiempo/1000 = Ki * error * tiempo / 10^7 %
+    pid->integral += (int64_t) pid->ki_milli * error * time_change;
+    if (pid->integral > pid->output_max * PID_INTEGRAL_SCALE) pid->integral = pid->output_max * PID_INTEGRAL_SCALE;
+    else if (pid->integral < pid->output_min * PID_INTEGRAL_SCALE) pid->integral = pid->output_min * PID_INTEGRAL_SCALE;
+    
+    // Calcular término derivativo (sobre el cambio de la medida, no del error):
+    // Kd/1000 * (cambio/10) / (tiempo/1000) = Kd * cambio / (10 * tiempo) %
+    pid->derivative_milli = (int32_t) ((int64_t) pid->kd_milli * (input_tenths - pid->last_input_tenths) *
+                                       (PID_OUTPUT_SCALE / 10) / (int64_t) time_change);
+    
+    // Calcular salida PID: Kp/1000 * error/10 = Kp * error / 10^4 %
+    int32_t proportional = pid->kp_milli * error / (10000 / PID_OUTPUT_SCALE);
+    int64_t integral = pid->integral / (PID_INTEGRAL_SCALE / PID_OUTPUT_SCALE);
     
     // Limitar la salida
-    if (pid->output > pid->output_max) pid->output = pid->output_max;
-    else if (pid->output < pid->output_min) pid->output = pid->output_min;
+    pid->output_milli = clamp_output(proportional + integral - pid->derivative_milli, pid);
     
     // Actualizar variables para la próxima iteración
-    pid->last_input = input;
+    pid->last_input_tenths = input_tenths;
     pid->last_time = now;
     
-    ESP_LOGD(TAG, "PID Output: %.2f (P=%.2f, I=%.2f, D=%.2f)", 
-             pid->output, (pid->kp * error), pid->integral, (-pid->kd * pid->derivative));
+    ESP_LOGD(TAG, "PID Output: %d (P=%d, I=%d, D=%d, thousandths of %%)", 
+             pid->output_milli, proportional, (int) integral, -pid->derivative_milli);
     
-    return pid->output;
-}
\ No newline at end of file
+    return (uint8_t) ((pid->output_milli + PID_OUTPUT_SCALE / 2) / PID_OUTPUT_SCALE);
+}
@@ -0,0 +1,90 @@
+#include "alarm.h"
+#include "json_writer.h"
+
+void alarm_monitor_init(alarm_monitor_t *monitor, const alarm_config_t *config)
+{
+    monitor->config = *config;
+    for (size_t i = 0; i < ALARM_KIND_COUNT; i++) {
+        monitor->active[i] = false;
+    }
+    monitor->has_zero_cross = false;
+    monitor->zero_cross_count = 0;
+    monitor->zero_cross_ms = 0;
+}
+
+// Moves kind to active and records the transition, if it is a change
+static size_t transition(alarm_monitor_t *monitor, alarm_kind_t kind, bool active,
+                         const telemetry_reading_t *reading, int16_t value_tenths,
+                         alarm_event_t *events, size_t count)
+{
+    if (monitor->active[kind] == active) {
+        return count;
+    }
+    monitor->active[kind] = active;
+    events[count].kind = kind;
+    events[count].active = active;
+    events[count].uptime_ms = reading->uptime_ms;
+    events[count].value_tenths = value_tenths;
+    return count + 1;
+}
+
+size_t alarm_monitor_evaluate(alarm_monitor_t *monitor, const telemetry_reading_t *reading,
+                              uint32_t zero_cross_count, alarm_event_t *events)
+{
+    const alarm_config_t *config = &monitor->config;
+    size_t count = 0;
+
+    // A failed read says nothing about the temperature; keep the state
+    if (config->over_temperature_tenths != 0 && reading->sensor_ok) {
+        bool active = monitor->active[ALARM_OVER_TEMPERATURE]
+                          ? reading->temperature_tenths >= config->over_temperature_tenths - config->hysteresis_tenths
+                          : reading->temperature_tenths >= config->over_temperature_tenths;
+        count = transition(monitor, ALARM_OVER_TEMPERATURE, active, reading,
+                           reading->temperature_tenths, events, count);
+    }
+
+    if (config->zero_cross_timeout_ms != 0) {
+        if (!monitor->has_zero_cross || zero_cross_count != monitor->zero_cross_count ||
+            !reading->dimmer_enabled) {
+            // Crossings are flowing, or not expected: restart the timeout
+            monitor->has_zero_cross = true;
+            monitor->zero_cross_count = zero_cross_count;
+            monitor->zero_cross_ms = reading->uptime_ms;
+        }
+        // Unsigned subtraction copes with the millisecond counter wrapping
+        bool active = reading->uptime_ms - monitor->zero_cross_ms >= config->zero_cross_timeout_ms;
+        count = transition(monitor, ALARM_ZERO_CROSS_LOST, active, reading, 0, events, count);
+    }
+
+    return count;
+}
+
+int alarm_encode_json(const alarm_event_t *event, const char *client, char *buffer, size_t size)
+{
+    JsonWriter_t writer;
+
+    JsonWriter_Init(&writer, buffer, size);
+    JsonWriter_BeginObject(&writer, NULL);
+    JsonWriter_String(&writer, "alarm", alarm_kind_name(event->kind));
+    JsonWriter_Bool(&writer, "active", event->active);
+    JsonWriter_Uint(&writer, "uptime", event->uptime_ms);
+    if (event->kind == ALARM_OVER_TEMPERATURE) {
+        JsonWriter_Fixed(&writer, "temperature", event->value_tenths, 1);
+    }
+    JsonWriter_String(&writer, "client", client);
+    JsonWriter_EndObject(&writer);
+
+    return JsonWriter_Finish(&writer);
+}
+
+const char *alarm_kind_name(alarm_kind_t kind)
+{
+    switch (kind) {
+    case ALARM_OVER_TEMPERATURE:
+        return "over_temperature";
+    case ALARM_ZERO_CROSS_LOST:
+        return "zero_cross_lost";
+    default:
+        return "unknown";
+    }
+}
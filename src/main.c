@@ -5,14 +5,25 @@
 #include "esp_system.h"
 #include "rom/ets_sys.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "driver/gpio.h"
 #include "driver/timer.h"
+#include "soc/gpio_reg.h"
 #include "sdkconfig.h"
-#include "cJSON.h"
 #include <string.h>
 #include <math.h>
 #include "esp_log.h"
 #include "DHT22.h"
+#include "dht.h"
+#include "dimmer_core.h"
+#include "telemetry.h"
+#include "report_policy.h"
+#include "sample_interval.h"
+#include "alarm.h"
+#include "spsc_ring.h"
+#include "sensor_cache.h"
+#include "sensor_filter.h"
+#include "offline_log.h"
 #include "wifi.h"
 #include "mqtt_demo_mutual_auth.h"
 static const char *TAG = "MQTT_EXAMPLE";
@@ -20,35 +31,83 @@ static const char *TAG = "MQTT_EXAMPLE";
 // AC Dimmer configuration
 #define DIMMER_ZERO_CROSS_PIN   GPIO_NUM_23    // Zero crossing detection pin
 #define DIMMER_CH1_PIN          GPIO_NUM_22    // Channel 1 control pin
-#define DIMMER_CH2_PIN          GPIO_NUM_19    // Channel 2 control pin (if needed)
-#define DIMMER_FREQ             60             // AC frequency in Hz (50 or 60)
+#define DIMMER_CH2_PIN          GPIO_NUM_19    // Channel 2 control pin
 #define DIMMER_TIMER_GROUP      TIMER_GROUP_0
 #define DIMMER_TIMER_IDX        TIMER_0
 #define DIMMER_TIMER_DIVIDER    80             // Timer clock divider
 #define DIMMER_RESOLUTION       100            // Dimming resolution (0-100%)
 
-// Global variables for dimmer control
-static uint8_t dimmer_level_ch1 = 50;           // Initial dimmer level for channel 1 (50%)
-static uint8_t dimmer_level_ch2 = 0;            // Current dimmer level for channel 2 (0-100%)
-static bool dimmer_enabled = true;              // Flag to enable/disable dimmer
-static QueueHandle_t zero_cross_evt_queue = NULL;
+// Gate pin of each channel, one per heater zone, up to DIMMER_CHANNELS_MAX.
+// All must be below GPIO 32, so one register write switches any set of them.
+static const gpio_num_t dimmer_gate_pins[] = { DIMMER_CH1_PIN, DIMMER_CH2_PIN };
+#define DIMMER_CHANNELS (sizeof(dimmer_gate_pins) / sizeof(dimmer_gate_pins[0]))
 
-// DEBUG flags
-static volatile uint32_t debug_zero_cross_count = 0;  // Counter for zero crossing events
-static volatile uint32_t debug_triac_triggers = 0;    // Counter for TRIAC triggers
+// GPIO bit of each channel, in DRAM for the ISRs
+static DRAM_ATTR uint32_t dimmer_gate_bits[DIMMER_CHANNELS_MAX];
 
-// Variables para prevenir watchdog y reinicios
-static portMUX_TYPE dimmer_spinlock = portMUX_INITIALIZER_UNLOCKED;
-static bool in_critical_section = false;
+// Dimmer state: channel levels, enabled flag and the zero crossing and
+// TRIAC trigger counters. The ISRs below run it through dimmer_core, and
+// tasks read and write it without locks (see dimmer_core.h): both ISRs are
+// registered from dimmer_init, on the same CPU and at the same level.
+static dimmer_t dimmer;
+
+// Notification bits of dimmer_control_task, for the rare dimmer events; the
+// zero crossings themselves are only counted
+#define DIMMER_EVT_LOCKED BIT0
+#define DIMMER_EVT_LOST BIT1
+#define DIMMER_REPORT_MS 5000
+static TaskHandle_t dimmer_task_handle = NULL;
+
+// Notified on a dimmer change, to sample the response without waiting out
+// a long interval
+static TaskHandle_t sampling_task_handle = NULL;
 
 // Forward declarations
 static void dimmer_timer_init(void);
 static void dimmer_gpio_init(void);
+static void dimmer_isr_install(void);
 static void IRAM_ATTR dimmer_zero_cross_isr(void* arg);
 static void IRAM_ATTR dimmer_timer_isr(void* arg);
 static void dimmer_control_task(void* pvParameters);
 void set_dimmer_level(uint8_t channel, uint8_t level);
 
+// Wakes dimmer_control_task when the PLL locks onto the mains or loses it
+static void IRAM_ATTR dimmer_on_lock(void *context, bool locked) {
+    BaseType_t woken = pdFALSE;
+
+    if (dimmer_task_handle != NULL) {
+        xTaskNotifyFromISR(dimmer_task_handle, locked ? DIMMER_EVT_LOCKED : DIMMER_EVT_LOST, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+// Hardware the dimmer core drives; called from the ISRs
+static void IRAM_ATTR dimmer_set_gates(void *context, uint32_t mask, bool on) {
+    uint32_t bits = 0;
+    (void) context;
+    for (uint8_t channel = 0; mask != 0; channel++, mask >>= 1) {
+        if (mask & 1) {
+            bits |= dimmer_gate_bits[channel];
+        }
+    }
+    REG_WRITE(on ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, bits);
+}
+
+// The timer runs all the time at 1 MHz; the core works on the low 32 bits
+// of its count and only moves the alarm
+static uint32_t IRAM_ATTR dimmer_now_us(void *context) {
+    (void) context;
+    return (uint32_t) timer_group_get_counter_value_in_isr(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX);
+}
+
+static void IRAM_ATTR dimmer_set_alarm(void *context, uint32_t at_us) {
+    uint64_t now = timer_group_get_counter_value_in_isr(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX);
+    (void) context;
+    timer_group_set_alarm_value_in_isr(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX,
+                                       now + (int32_t) (at_us - (uint32_t) now));
+    timer_group_enable_alarm_in_isr(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX);
+}
+
 // Initialize dimmer timer
 static void dimmer_timer_init(void) {
     // Timer configuration for dimmer control
@@ -63,9 +122,20 @@ static void dimmer_timer_init(void) {
     
     // Set timer counting to microseconds
     timer_set_counter_value(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX, 0);
-    
-    // Register timer interrupt handler
-    timer_isr_register(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX, dimmer_timer_isr, NULL, ESP_INTR_FLAG_IRAM, NULL);
+}
+
+// Install both dimmer interrupt handlers back to back from app_main, which
+// is pinned to one core, so they are allocated on that core at the same
+// level and never preempt each other (see dimmer_core.h). Both stay enabled
+// while the flash cache is off: a zero-cross edge lost to a flash write or
+// OTA would leave the PLL coasting and the load flickering.
+static void dimmer_isr_install(void) {
+    gpio_install_isr_service(ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL1);
+    gpio_isr_handler_add(DIMMER_ZERO_CROSS_PIN, dimmer_zero_cross_isr, NULL);
+    timer_isr_register(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX, dimmer_timer_isr, NULL,
+                       ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL1, NULL);
+    ESP_LOGI(TAG, "Dimmer interrupts on core %d", xPortGetCoreID());
+    timer_start(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX);
 }
 
 // Initialize GPIO pins for dimmer control
@@ -83,75 +153,25 @@ static void dimmer_gpio_init(void) {
     // Configure dimmer control pins as outputs
     io_conf.intr_type = GPIO_INTR_DISABLE;
     io_conf.mode = GPIO_MODE_OUTPUT;
-    io_conf.pin_bit_mask = ((1ULL << DIMMER_CH1_PIN) | (1ULL << DIMMER_CH2_PIN));
+    io_conf.pin_bit_mask = 0;
+    for (size_t channel = 0; channel < DIMMER_CHANNELS; channel++) {
+        dimmer_gate_bits[channel] = 1u << dimmer_gate_pins[channel];
+        io_conf.pin_bit_mask |= 1ULL << dimmer_gate_pins[channel];
+    }
     io_conf.pull_down_en = 0;
     io_conf.pull_up_en = 0;
     gpio_config(&io_conf);
     
     // Set initial state of dimmer pins to OFF
-    gpio_set_level(DIMMER_CH1_PIN, 0);
-    gpio_set_level(DIMMER_CH2_PIN, 0);
-    
-    // Install GPIO ISR service and add ISR handler for zero crossing pin
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(DIMMER_ZERO_CROSS_PIN, dimmer_zero_cross_isr, NULL);
+    for (size_t channel = 0; channel < DIMMER_CHANNELS; channel++) {
+        gpio_set_level(dimmer_gate_pins[channel], 0);
+    }
 }
 
-// Zero crossing interrupt handler - MODIFICADO PARA ESTABILIDAD
+// Zero crossing interrupt handler
 static void IRAM_ATTR dimmer_zero_cross_isr(void* arg) {
-    // Usamos una bandera para evitar anidamiento de interrupciones que puedan causar problemas
-    if (in_critical_section) {
-        return;  // Si ya estamos en una sección crítica, salimos para evitar problemas
-    }
-    
-    in_critical_section = true;
-    
-    // Desactivamos interrupciones para este bloque crítico
-    portENTER_CRITICAL_ISR(&dimmer_spinlock);
-    
-    uint32_t gpio_num = (uint32_t) arg;
-    xQueueSendFromISR(zero_cross_evt_queue, &gpio_num, NULL);
-    
-    debug_zero_cross_count++;  // Increment zero crossing counter
-    
-    // Caso especial: Si el nivel es 100%, activamos TRIAC directamente
-    if (dimmer_enabled && dimmer_level_ch1 >= 100) {
-        gpio_set_level(DIMMER_CH1_PIN, 1);
-        debug_triac_triggers++;
-    }
-    // Caso especial: Si el nivel es 0%, mantenemos el TRIAC apagado
-    else if (dimmer_enabled && dimmer_level_ch1 <= 0) {
-        gpio_set_level(DIMMER_CH1_PIN, 0);
-    }
-    // Para otros valores (1-99%), configuramos un timer
-    else if (dimmer_enabled) {
-        // Mantenemos el TRIAC apagado inicialmente
-        gpio_set_level(DIMMER_CH1_PIN, 0);
-        
-        // Calculate firing delay based on dimmer levels (0-100%)
-        uint32_t half_cycle_us = (1000000 / (2 * DIMMER_FREQ)); // Half cycle time in microseconds
-        uint32_t delay_us = (100 - dimmer_level_ch1) * half_cycle_us / 100;
-        
-        // Safety: prevent extremely short delays that could cause issues
-        if (delay_us < 500) delay_us = 500;  // Mínimo 500us para evitar problemas
-        
-        // Set timer for triac firing
-        timer_set_counter_value(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX, 0);
-        timer_set_alarm_value(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX, delay_us);
-        timer_set_alarm(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX, 1);
-        timer_start(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX);
-    }
-    else {
-        // Dimmer disabled - keep TRIAC off for safety
-        gpio_set_level(DIMMER_CH1_PIN, 0);
-    }
-    
-    // Channel 2 is always OFF in this application
-    gpio_set_level(DIMMER_CH2_PIN, 0);
-    
-    // Reactivamos interrupciones
-    portEXIT_CRITICAL_ISR(&dimmer_spinlock);
-    in_critical_section = false;
+    // Timestamp the edge for the PLL; the half-cycles run from the timer
+    dimmer_core_zero_cross(&dimmer);
 }
 
 // Timer interrupt handler for triac firing - SIMPLIFICADO
@@ -159,33 +179,38 @@ static void IRAM_ATTR dimmer_timer_isr(void* arg) {
     // Clear interrupt flag
     timer_group_clr_intr_status_in_isr(DIMMER_TIMER_GROUP, DIMMER_TIMER_IDX);
     
-    if (dimmer_enabled && dimmer_level_ch1 > 0 && dimmer_level_ch1 < 100) {
-        // Activate TRIAC
-        gpio_set_level(DIMMER_CH1_PIN, 1);
-        debug_triac_triggers++;
-        
-        // We'll turn off the TRIAC at the next zero crossing
-        // No need for a short pulse that might cause issues
-    }
+    // Fire the channels now due, or end the half-cycle, and set the alarm
+    dimmer_core_timer(&dimmer);
 }
 
-// Task for dimmer control
+// Task for dimmer control. It sleeps until the PLL locks or loses the
+// mains, or the next report is due; the ISRs do all the per-edge work.
 static void dimmer_control_task(void* pvParameters) {
-    uint32_t gpio_num;
-    uint32_t last_reported_time = 0;
+    TickType_t last_report = xTaskGetTickCount();
     
     while (1) {
-        if (xQueueReceive(zero_cross_evt_queue, &gpio_num, portMAX_DELAY)) {
-            // Process zero crossing event if needed
-            // Most work is done in the ISR
-            
-            // Debug info each second
-            uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-            if (current_time - last_reported_time > 5000) {  // Report every 5 seconds
-                ESP_LOGI(TAG, "Zero crossings: %u, TRIAC triggers: %u, Dimmer level: %u%%", 
-                    debug_zero_cross_count, debug_triac_triggers, dimmer_level_ch1);
-                last_reported_time = current_time;
-            }
+        TickType_t elapsed = xTaskGetTickCount() - last_report;
+        TickType_t period = pdMS_TO_TICKS(DIMMER_REPORT_MS);
+        uint32_t events = 0;
+        
+        if (elapsed < period) {
+            xTaskNotifyWait(0, UINT32_MAX, &events, period - elapsed);
+        }
+        if (events & DIMMER_EVT_LOCKED) {
+            uint32_t mains_mhz = zc_pll_mains_mhz(&dimmer.pll);
+            ESP_LOGI(TAG, "Locked onto the mains at %u.%03u Hz", mains_mhz / 1000, mains_mhz % 1000);
+        }
+        if (events & DIMMER_EVT_LOST) {
+            ESP_LOGW(TAG, "Lost the mains; TRIACs off until the zero crossings return");
+        }
+        
+        // Debug info every 5 seconds
+        if (xTaskGetTickCount() - last_report >= period) {
+            uint32_t mains_mhz = zc_pll_mains_mhz(&dimmer.pll);
+            ESP_LOGI(TAG, "Zero crossings: %u, TRIAC triggers: %u, Dimmer level: %u%%, Mains: %u.%03u Hz, edges rejected: %u",
+                dimmer.zero_crosses, dimmer.triggers, dimmer.power[0] / 10,
+                mains_mhz / 1000, mains_mhz % 1000, dimmer.pll.rejected);
+            last_report = xTaskGetTickCount();
         }
     }
 }
@@ -195,17 +220,15 @@ void set_dimmer_level(uint8_t channel, uint8_t level) {
     // Ensure level is within range
     if (level > 100) level = 100;
     
-    // Para prevenir problemas, deshabilitamos interrupciones mientras cambiamos el valor
-    portENTER_CRITICAL(&dimmer_spinlock);
-    
-    // Update the appropriate channel
-    if (channel == 1) {
-        dimmer_level_ch1 = level;
-    } else if (channel == 2) {
-        dimmer_level_ch2 = level;
+    // Update the appropriate channel; the ISRs read the power in one access
+    // Levels are linear in power, so each percent is 10 permille
+    if (channel >= 1 && channel <= DIMMER_CHANNELS) {
+        dimmer.power[channel - 1] = level * (DIMMER_POWER_FULL / 100);
+    }
+
+    if (sampling_task_handle != NULL) {
+        xTaskNotifyGive(sampling_task_handle);
     }
-    
-    portEXIT_CRITICAL(&dimmer_spinlock);
     
     // Log the change
     ESP_LOGI(TAG, "Dimmer channel %d set to %d%%", channel, level);
@@ -213,8 +236,21 @@ void set_dimmer_level(uint8_t channel, uint8_t level) {
 
 // Initialize the dimmer module - MODIFICADA PARA ESTABILIDAD
 void dimmer_init(void) {
-    // Create queue for zero crossing events
-    zero_cross_evt_queue = xQueueCreate(10, sizeof(uint32_t));
+    const dimmer_hal_t hal = {
+        .context = NULL,
+        .set_gates = dimmer_set_gates,
+        .set_alarm = dimmer_set_alarm,
+        .now_us = dimmer_now_us,
+        .on_lock = dimmer_on_lock,
+    };
+    
+    // Starts disabled, before any ISR can run; the mains frequency is
+    // measured from the zero-cross edges
+    _Static_assert(DIMMER_CHANNELS <= DIMMER_CHANNELS_MAX, "too many dimmer channels");
+    dimmer_core_init(&dimmer, &hal, DIMMER_CHANNELS);
+    
+    // Create dimmer control task before the ISRs that notify it
+    xTaskCreate(dimmer_control_task, "dimmer_control_task", 2048, NULL, 10, &dimmer_task_handle);
     
     // Initialize GPIO pins
     dimmer_gpio_init();
@@ -222,88 +258,463 @@ void dimmer_init(void) {
     // Initialize timer
     dimmer_timer_init();
     
-    // Inicialmente desactivamos el dimmer para estabilidad
-    dimmer_enabled = false;
+    // Zero-cross and timer interrupts
+    dimmer_isr_install();
     
-    // Esperar un segundo para que el sistema se estabilice
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    
-    // Create dimmer control task
-    xTaskCreate(dimmer_control_task, "dimmer_control_task", 2048, NULL, 10, NULL);
-    
-    // Esperar otro segundo
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    // Esperar dos segundos para que el sistema se estabilice
+    vTaskDelay(2000 / portTICK_PERIOD_MS);
     
     // Ahora habilitamos el dimmer
-    dimmer_enabled = true;
+    dimmer.enabled = true;
     
     // Establecer nivel de potencia inicial (100% para estabilidad)
-    dimmer_level_ch1 = 100;
+    dimmer.power[0] = DIMMER_POWER_FULL;
     
-    ESP_LOGI(TAG, "AC Dimmer initialized at %d%% brightness", dimmer_level_ch1);
-    ESP_LOGI(TAG, "Dimmer pins - ZC: %d, CH1: %d", DIMMER_ZERO_CROSS_PIN, DIMMER_CH1_PIN);
+    ESP_LOGI(TAG, "AC Dimmer initialized at %d%% brightness", dimmer.power[0] / 10);
+    ESP_LOGI(TAG, "Dimmer pins - ZC: %d, CH1: %d, channels: %u", DIMMER_ZERO_CROSS_PIN, DIMMER_CH1_PIN,
+             (unsigned) DIMMER_CHANNELS);
+}
+
+
+// Topic per telemetry format, so consumers know how to decode the payload
+static const char *const telemetry_topics[] = {
+    [TELEMETRY_FORMAT_JSON] = "clients/" CLIENT_IDENTIFIER "/sensor/dth11",
+    [TELEMETRY_FORMAT_CBOR] = "clients/" CLIENT_IDENTIFIER "/sensor/dth11/cbor",
+    [TELEMETRY_FORMAT_BLOCK] = "clients/" CLIENT_IDENTIFIER "/sensor/dth11/block",
+};
+
+// Applies the telemetry format stored in NVS ("telemetry"/"format"), if any,
+// over the Kconfig default
+static void load_telemetry_format(void)
+{
+    nvs_handle_t handle;
+    uint8_t format;
+
+    if (nvs_open("telemetry", NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_u8(handle, "format", &format) == ESP_OK && format <= TELEMETRY_FORMAT_BLOCK) {
+        telemetry_set_format((telemetry_format_t) format);
+    }
+    nvs_close(handle);
+}
+
+#if (CONFIG_TELEMETRY_RING_CAPACITY & (CONFIG_TELEMETRY_RING_CAPACITY - 1)) != 0
+#error "CONFIG_TELEMETRY_RING_CAPACITY must be a power of two"
+#endif
+#if CONFIG_TELEMETRY_BLOCK_SAMPLES > CONFIG_TELEMETRY_RING_CAPACITY
+#error "CONFIG_TELEMETRY_BLOCK_SAMPLES must not exceed CONFIG_TELEMETRY_RING_CAPACITY"
+#endif
+#if TELEMETRY_PAYLOAD_SIZE > CONFIG_MQTT_PUBLISH_POOL_SLOT_SIZE
+#error "CONFIG_MQTT_PUBLISH_POOL_SLOT_SIZE must hold a telemetry payload"
+#endif
+
+// Most readings taken from the ring per iteration: one per payload, or a
+// block's worth
+#if CONFIG_TELEMETRY_BLOCK_SAMPLES > CONFIG_TELEMETRY_BATCH_MAX
+#define READINGS_PER_ITERATION CONFIG_TELEMETRY_BLOCK_SAMPLES
+#else
+#define READINGS_PER_ITERATION CONFIG_TELEMETRY_BATCH_MAX
+#endif
+
+// Readings waiting to be published; filled by sampling_task, drained by aws_iot_demo
+static telemetry_reading_t sample_storage[CONFIG_TELEMETRY_RING_CAPACITY];
+static SpscRing_t sample_ring;
+
+// Decides which readings are worth publishing
+static report_policy_t report_policy;
+
+// Decides when to sample next; the publishing task paces itself on the
+// latest interval too
+static sample_interval_t sample_interval;
+static volatile uint32_t sample_interval_ms = CONFIG_TELEMETRY_SAMPLE_PERIOD_MS;
+
+// Alarm events waiting to be published; filled by sampling_task, drained by
+// aws_iot_demo ahead of the readings
+#define ALARM_RING_CAPACITY 8
+#define ALARM_BATCH_MAX 4
+#define ALARM_PAYLOAD_SIZE (112 + sizeof(CLIENT_IDENTIFIER))
+static const char alarm_topic[] = "clients/" CLIENT_IDENTIFIER "/alarm";
+static alarm_event_t alarm_storage[ALARM_RING_CAPACITY];
+static SpscRing_t alarm_ring;
+static alarm_monitor_t alarm_monitor;
+
+// Renders the constant part of every telemetry payload. The MAC address and
+// firmware version cannot change while running, so they are read once here
+// instead of on every sample.
+static void set_device_identity(void)
+{
+    uint8_t mac[6];
+    char hardware[18];
+
+    esp_efuse_mac_get_default(mac);
+    snprintf(hardware, sizeof(hardware), "%02x:%02x:%02x:%02x:%02x:%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    telemetry_set_identity(hardware, esp_get_idf_version(), CLIENT_IDENTIFIER);
 }
 
+// Temperature and humidity sensor; only sampling_task reads it
+#define DHT_GPIO GPIO_NUM_21
+static dht_handle_t dht_sensor;
+
+// Latest reading with its age, for any task that wants the current value
+// without waiting on the sensor; written by sampling_task
+static SensorCache_t sensor_cache;
+
+// Turn raw samples into the values reported, each with its quality; only
+// sampling_task uses them
+static SensorFilter_t temperature_filter;
+static SensorFilter_t humidity_filter;
+
+static void sensor_filters_init(void)
+{
+    SensorFilterConfig_t config = {
+#if CONFIG_SENSOR_FILTER_HAMPEL
+        .mode = SensorFilterHampel,
+        .hampelKTenths = CONFIG_SENSOR_FILTER_HAMPEL_K_TENTHS,
+#else
+        .mode = SensorFilterMedian,
+#endif
+        .window = CONFIG_SENSOR_FILTER_WINDOW | 1,    // The filter needs an odd window
+        .reanchorAfter = CONFIG_SENSOR_REANCHOR_SAMPLES,
+    };
+
+    // DHT22 range, and about twice its noise as the deadband
+    config.deadband = 2;
+    config.minimum = -400;
+    config.maximum = 800;
+    config.maxStep = CONFIG_SENSOR_MAX_TEMPERATURE_STEP_TENTHS;
+    config.maxRatePerS = CONFIG_SENSOR_MAX_TEMPERATURE_RATE_TENTHS;
+    SensorFilter_Init(&temperature_filter, &config);
+
+    config.deadband = 5;
+    config.minimum = 0;
+    config.maximum = 1000;
+    config.maxStep = CONFIG_SENSOR_MAX_HUMIDITY_STEP_TENTHS;
+    config.maxRatePerS = CONFIG_SENSOR_MAX_HUMIDITY_RATE_TENTHS;
+    SensorFilter_Init(&humidity_filter, &config);
+}
 
-// Modified DHT reader task to include dimmer status
-char* DHT_reader_task(void)
+static uint32_t uptime_ms(void *context)
 {
-    setDHTgpio(GPIO_NUM_21);
+    (void) context;
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
 
+// Reads the DHT sensor and the dimmer state into reading
+static void DHT_reader_task(telemetry_reading_t *reading)
+{
     printf("DHT Sensor Readings\n" );
-    int ret = readDHT();
-    
+    int ret = dht_read(&dht_sensor);
+    int retries = CONFIG_SENSOR_READ_RETRIES;
+    // Failed reads are retried as soon as the sensor allows. A wait counted
+    // in ticks can end up to a tick short of the sensor's minimum interval,
+    // so a read refused as too soon does not use up a retry.
+    while (ret == DHT_TOO_SOON_ERROR || (ret != DHT_OK && retries-- > 0)) {
+        if (ret != DHT_TOO_SOON_ERROR) {
+            errorHandler(ret);
+        }
+        uint32_t wait_ms = dht_ms_until_ready(&dht_sensor, dht_now_ms(&dht_sensor));
+        vTaskDelay(pdMS_TO_TICKS(wait_ms) + 1);
+        ret = dht_read(&dht_sensor);
+    }
     errorHandler(ret);
 
-    char humidityStr[10];
-    char temperatureStr[10];
-    sprintf(humidityStr, "%.2f", getHumidity());
-    sprintf(temperatureStr, "%.2f", getTemperature());
-    
-    uint8_t mac[6];
-    char mac_str[18];
-    esp_efuse_mac_get_default(mac);    
-    sprintf(mac_str, "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-
-    cJSON *root = cJSON_CreateObject();
-    cJSON *device = cJSON_CreateObject();
-    cJSON *sensors = cJSON_CreateObject();
-    cJSON *dimmer = cJSON_CreateObject();
-    
-    cJSON_AddItemToObject(root, "device", device);
-    cJSON_AddItemToObject(root, "sensors", sensors);
-    cJSON_AddItemToObject(root, "dimmer", dimmer);
-    
-    cJSON_AddNumberToObject(device, "uptime", xTaskGetTickCount() * portTICK_RATE_MS);
-    cJSON_AddStringToObject(device, "hardware", mac_str);
-    cJSON_AddStringToObject(device, "firmware", esp_get_idf_version());  
-    
-    cJSON_AddStringToObject(sensors, "temperature", temperatureStr);
-    cJSON_AddStringToObject(sensors, "humidity", humidityStr);
-    
-    // Para prevenir problemas de concurrencia, obtenemos los valores en una sección crítica
-    portENTER_CRITICAL(&dimmer_spinlock);
-    uint8_t ch1_level = dimmer_level_ch1;
-    uint8_t ch2_level = dimmer_level_ch2;
-    bool is_enabled = dimmer_enabled;
-    portEXIT_CRITICAL(&dimmer_spinlock);
-    
-    cJSON_AddNumberToObject(dimmer, "channel1", ch1_level);
-    cJSON_AddNumberToObject(dimmer, "channel2", ch2_level);
-    cJSON_AddBoolToObject(dimmer, "enabled", is_enabled);
+    reading->uptime_ms = xTaskGetTickCount() * portTICK_RATE_MS;
+
+    // A failed read reports nothing rather than the last values
+    SensorQuality_t quality = SensorQualityFailed;
+    if (ret == DHT_OK) {
+        quality = SensorFilter_Add(&temperature_filter, dht_sensor.temperature_tenths,
+                                   reading->uptime_ms, &reading->temperature_tenths);
+        SensorQuality_t humidity_quality = SensorFilter_Add(&humidity_filter, dht_sensor.humidity_tenths,
+                                                            reading->uptime_ms, &reading->humidity_tenths);
+        if (humidity_quality > quality) {
+            quality = humidity_quality;
+        }
+        if (quality >= SensorQualityHeld) {
+            ESP_LOGW(TAG, "Implausible reading %d/%d rejected",
+                     dht_sensor.temperature_tenths, dht_sensor.humidity_tenths);
+        }
+    } else {
+        SensorFilter_Missed(&temperature_filter);
+        SensorFilter_Missed(&humidity_filter);
+    }
+    reading->sensor_ok = (quality != SensorQualityFailed);
+    reading->quality = (uint8_t) quality;
+
+    // The cache only takes values that were read, not repeated ones
+    if (ret != DHT_OK || quality <= SensorQualityFiltered) {
+        SensorCache_Update(&sensor_cache, ret, reading->temperature_tenths, reading->humidity_tenths);
+    }
     
-    cJSON_AddStringToObject(root, "client", CLIENT_IDENTIFIER);
-    cJSON_AddStringToObject(root, "status", "online");
+    // Each value is read in one access, so no lock is needed
+    reading->dimmer_ch1 = dimmer.power[0] / 10;
+    reading->dimmer_ch2 = dimmer.power[1] / 10;
+    reading->dimmer_enabled = dimmer.enabled;
+}
 
-    char *json_string = cJSON_Print(root);
-    printf("%s\n", json_string);
-    cJSON_Delete(root);
+// Samples at the pace set by sample_interval, whatever the network is doing.
+// The DHT22 needs at least 2 seconds between reads, which sample_interval
+// enforces.
+static void sampling_task(void *pvParameters)
+{
+    telemetry_reading_t reading;
 
-    // -- wait at least 2 sec before reading again ------------
-    // The interval of whole process must be beyond 2 seconds !!
-    vTaskDelay(2000 / portTICK_RATE_MS);
-    
-    return json_string;
+    while (1) {
+        TickType_t last_read = xTaskGetTickCount();
+        DHT_reader_task(&reading);
+        reading.interval_ms = sample_interval_update(&sample_interval, &reading);
+        sample_interval_ms = reading.interval_ms;
+
+        // Alarms are queued on every sample, whatever the reporting policy
+        alarm_event_t events[ALARM_KIND_COUNT];
+        size_t event_count = alarm_monitor_evaluate(&alarm_monitor, &reading, dimmer.zero_crosses, events);
+        for (size_t i = 0; i < event_count; i++) {
+            ESP_LOGW(TAG, "Alarm %s %s", alarm_kind_name(events[i].kind),
+                     events[i].active ? "raised" : "cleared");
+            if (!SpscRing_Push(&alarm_ring, &events[i])) {
+                ESP_LOGE(TAG, "Alarm queue full, event dropped");
+            }
+        }
+
+        report_reason_t reason = report_policy_evaluate(&report_policy, &reading);
+        if (reason == REPORT_SKIP) {
+            ESP_LOGD(TAG, "Reading within deadbands, not reported");
+        } else if (SpscRing_Push(&sample_ring, &reading)) {
+            ESP_LOGI(TAG, "Reporting reading (%s), %u of %u readings reported",
+                     report_reason_name(reason), report_policy.reported, report_policy.evaluated);
+        } else {
+            ESP_LOGW(TAG, "Sample queue full, reading dropped (%u so far)",
+                     SpscRing_Drops(&sample_ring));
+        }
+
+        // Sleep out the interval, unless the dimmer changes first; even then
+        // the DHT22 gets its minimum rest
+        TickType_t elapsed = xTaskGetTickCount() - last_read;
+        TickType_t interval = pdMS_TO_TICKS(reading.interval_ms);
+        if (elapsed < interval && ulTaskNotifyTake(pdTRUE, interval - elapsed) > 0) {
+            vTaskDelayUntil(&last_read, pdMS_TO_TICKS(SAMPLE_INTERVAL_FLOOR_MS));
+        }
+    }
+}
+
+// True once a full time-series block is queued, or a partial one has waited
+// long enough since the last block was taken at last_block_ms
+static bool block_due(uint32_t last_block_ms)
+{
+    uint32_t queued = SpscRing_Count(&sample_ring);
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    return queued >= CONFIG_TELEMETRY_BLOCK_SAMPLES ||
+           (queued > 0 && now_ms - last_block_ms >= CONFIG_TELEMETRY_BLOCK_MAX_DELAY_SECONDS * 1000U);
+}
+
+// Points payload at a telemetry buffer, to go out on the telemetry lane and
+// the subscribed topic
+static void set_telemetry_payload(MqttPayload_t *payload, const char *data, size_t length)
+{
+    payload->pData = data;
+    payload->length = (uint16_t) length;
+    payload->pTopic = NULL;
+    payload->topicLength = 0;
+    payload->lane = MqttLaneTelemetry;
+    payload->acknowledged = false;
+}
+
+// Encodes a batch of readings into payloads, one composer buffer each: a
+// payload per reading, or with the block format as many readings per payload
+// as fit. Readings that do not fit are skipped. Returns the number of payloads.
+static size_t encode_batch(const telemetry_reading_t *readings, size_t count, telemetry_format_t format,
+                           telemetry_composer_t *composers, MqttPayload_t *payloads)
+{
+    size_t encoded = 0;
+    size_t taken;
+
+    for (size_t i = 0; i < count && encoded < CONFIG_TELEMETRY_BATCH_MAX; i += taken) {
+        char *buffer = composers[encoded].buffer;
+        int length;
+        if (format == TELEMETRY_FORMAT_BLOCK) {
+            telemetry_composer_reset(&composers[encoded]);
+            length = telemetry_encode_block(&readings[i], count - i, (uint8_t *) buffer,
+                                            TELEMETRY_PAYLOAD_SIZE, &taken);
+        } else {
+            // Only the variable fields are rendered; the prefix stays in place
+            length = telemetry_compose(&composers[encoded], &readings[i], format);
+            taken = 1;
+        }
+        if (length < 0) {
+            ESP_LOGE(TAG, "Telemetry payload does not fit in %u bytes", TELEMETRY_PAYLOAD_SIZE);
+            taken = 1;
+            continue;
+        }
+        if (format == TELEMETRY_FORMAT_JSON) {
+            printf("%s\n", buffer);
+        } else if (format == TELEMETRY_FORMAT_BLOCK) {
+            ESP_LOGD(TAG, "%d byte block of %u readings", length, (unsigned) taken);
+        } else {
+            ESP_LOGD(TAG, "%d byte CBOR payload", length);
+        }
+        set_telemetry_payload(&payloads[encoded], buffer, (size_t) length);
+        encoded++;
+    }
+
+    return encoded;
+}
+
+#if CONFIG_TELEMETRY_OFFLINE_LOG
+
+// Payloads that could not be delivered, kept across outages and reboots
+static OfflineLog_t offline_log;
+static bool offline_log_ready = false;
+static uint32_t offline_log_skipped = 0;   // Pending records lost to corruption
+
+// Mounts the offline log on its data partition
+static void offline_log_init(void)
+{
+    OfflineLogBackend_t backend;
+
+    if (!OfflineLogPartition_Open(&backend, CONFIG_TELEMETRY_OFFLINE_LOG_PARTITION)) {
+        ESP_LOGW(TAG, "No \"%s\" partition, readings taken while offline will be lost",
+                 CONFIG_TELEMETRY_OFFLINE_LOG_PARTITION);
+        return;
+    }
+    if (OfflineLog_Init(&offline_log, &backend) != OfflineLogSuccess) {
+        ESP_LOGE(TAG, "Offline log could not be mounted");
+        return;
+    }
+    offline_log_ready = true;
+    ESP_LOGI(TAG, "Offline log: %u payloads pending, %u segments, most erased %u times",
+             OfflineLog_Pending(&offline_log), backend.segmentCount,
+             OfflineLog_MaxEraseCount(&offline_log));
+}
+
+// Stores the payloads the broker did not acknowledge, in order
+static void offline_log_store(const MqttPayload_t *payloads, size_t count, telemetry_format_t format)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (payloads[i].acknowledged) {
+            continue;
+        }
+        if (OfflineLog_Append(&offline_log, payloads[i].pData, payloads[i].length,
+                              (uint8_t) format) != OfflineLogSuccess) {
+            ESP_LOGE(TAG, "Could not store payload in the offline log");
+        }
+    }
+}
+
+// Loads the oldest stored payloads into the composer buffers, as many as
+// share the format of the first one. Returns the number of payloads.
+static size_t offline_log_load(telemetry_composer_t *composers, MqttPayload_t *payloads,
+                               telemetry_format_t *format)
+{
+    OfflineLogCursor_t cursor;
+    OfflineLogStatus_t status = OfflineLogSuccess;
+    size_t count = 0;
+    uint16_t length;
+    uint8_t tag;
+
+    OfflineLog_Begin(&offline_log, &cursor);
+    while (count < CONFIG_TELEMETRY_BATCH_MAX) {
+        // The stored payload overwrites the prefix
+        telemetry_composer_reset(&composers[count]);
+        status = OfflineLog_Next(&offline_log, &cursor, composers[count].buffer, TELEMETRY_PAYLOAD_SIZE,
+                                 &length, &tag);
+        if (status != OfflineLogSuccess) {
+            break;
+        }
+        if (count > 0 && tag != (uint8_t) *format) {
+            break;
+        }
+        *format = (telemetry_format_t) tag;
+        set_telemetry_payload(&payloads[count], composers[count].buffer, length);
+        count++;
+    }
+
+    if (count == 0 && status == OfflineLogEmpty) {
+        // Records are counted as pending but none reads back: they failed
+        // their CRC since they were written, and the log skips them. Drop
+        // them from the count so new readings do not queue up behind them
+        // forever.
+        uint32_t skipped = OfflineLog_Pending(&offline_log);
+
+        (void) OfflineLog_Consume(&offline_log, 1);
+        skipped -= OfflineLog_Pending(&offline_log);
+        offline_log_skipped += skipped;
+        ESP_LOGW(TAG, "Skipped %u corrupt offline log records, %u in total",
+                 (unsigned) skipped, (unsigned) offline_log_skipped);
+    } else if (count == 0) {
+        // Too large for this build's buffers, or a storage error that may
+        // clear: keep the record and try again next time
+        ESP_LOGE(TAG, "Could not read the oldest offline log record (status %d); keeping it", (int) status);
+    }
+
+    return count;
+}
+
+// Consumes the stored payloads the broker acknowledged. Only a leading run
+// can be consumed; the rest are sent again, which QoS1 allows.
+static void offline_log_consume(const MqttPayload_t *payloads, size_t count)
+{
+    uint32_t acknowledged = 0;
+
+    while (acknowledged < count && payloads[acknowledged].acknowledged) {
+        acknowledged++;
+    }
+    if (OfflineLog_Consume(&offline_log, acknowledged) != OfflineLogSuccess) {
+        ESP_LOGE(TAG, "Could not mark payloads delivered in the offline log");
+    }
+}
+
+#endif /* CONFIG_TELEMETRY_OFFLINE_LOG */
+
+// Tops alarms up to ALARM_BATCH_MAX from the alarm queue, after the ones
+// still waiting from the last iteration. Returns the new count.
+static size_t collect_alarms(alarm_event_t *alarms, size_t count)
+{
+    return count + SpscRing_PopBatch(&alarm_ring, &alarms[count], ALARM_BATCH_MAX - count);
+}
+
+// Encodes alarms into payloads on the alarm lane, one buffer each. An alarm
+// that does not fit is dropped, so alarms and payloads stay index-aligned.
+// Returns the number of payloads.
+static size_t encode_alarms(alarm_event_t *alarms, size_t count,
+                            char buffers[][ALARM_PAYLOAD_SIZE], MqttPayload_t *payloads)
+{
+    size_t encoded = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int length = alarm_encode_json(&alarms[i], CLIENT_IDENTIFIER, buffers[encoded], ALARM_PAYLOAD_SIZE);
+        if (length < 0) {
+            ESP_LOGE(TAG, "Alarm payload does not fit in %u bytes", (unsigned) ALARM_PAYLOAD_SIZE);
+            continue;
+        }
+        alarms[encoded] = alarms[i];
+        payloads[encoded].pData = buffers[encoded];
+        payloads[encoded].length = (uint16_t) length;
+        payloads[encoded].pTopic = alarm_topic;
+        payloads[encoded].topicLength = sizeof(alarm_topic) - 1;
+        payloads[encoded].lane = MqttLaneAlarm;
+        payloads[encoded].acknowledged = false;
+        encoded++;
+    }
+
+    return encoded;
+}
+
+// Drops the alarms the broker acknowledged, keeping the rest in order for
+// the next iteration. Returns how many are left.
+static size_t drop_acknowledged_alarms(alarm_event_t *alarms, const MqttPayload_t *payloads, size_t count)
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!payloads[i].acknowledged) {
+            alarms[kept++] = alarms[i];
+        }
+    }
+
+    return kept;
 }
 
 /*-----------------------------------------------------------*/
@@ -326,10 +737,32 @@ void aws_iot_demo(void *arg)
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTContext_t mqttContext = { 0 };
-    NetworkContext_t xNetworkContext = { 0 };
-    bool clientSessionPresent = false;
     struct timespec tp;
 
+    /* The network context carries the transport counters and the
+    * parsed server root CA, too large for this task's stack. */
+    static NetworkContext_t xNetworkContext = { 0 };
+    UBaseType_t uxStackLowest = ~( UBaseType_t ) 0;
+
+    /* Telemetry payloads of one iteration; the MQTT layer copies each one it
+    * sends into its publish pool until the PUBACK. Each buffer keeps the
+    * constant payload prefix between iterations. */
+    static char pcPayloads[ CONFIG_TELEMETRY_BATCH_MAX ][ TELEMETRY_PAYLOAD_SIZE ];
+    static telemetry_composer_t xComposers[ CONFIG_TELEMETRY_BATCH_MAX ];
+    static telemetry_reading_t xReadings[ READINGS_PER_ITERATION ];
+    static char pcAlarmPayloads[ ALARM_BATCH_MAX ][ ALARM_PAYLOAD_SIZE ];
+    static alarm_event_t xAlarms[ ALARM_BATCH_MAX ];
+    size_t xAlarmCount = 0;
+
+    /* Alarm payloads first, then the telemetry payloads right after them. */
+    MqttPayload_t xPayloads[ ALARM_BATCH_MAX + CONFIG_TELEMETRY_BATCH_MAX ];
+    MqttPayload_t * pxTelemetry;
+    telemetry_format_t xFormat;
+    bool xFromOfflineLog;
+    bool xCatchUp;
+    uint32_t xLastBlockMs = 0;
+    SensorCacheSnapshot_t xLatest;
+
     /* Seed pseudo random number generator (provided by ISO C standard library) for
     * use by retry utils library when retrying failed network operations. */
 
@@ -338,6 +771,11 @@ void aws_iot_demo(void *arg)
     /* Seed pseudo random number generator with nanoseconds. */
     srand( tp.tv_nsec );
 
+    for( size_t i = 0; i < CONFIG_TELEMETRY_BATCH_MAX; i++ )
+    {
+        telemetry_composer_init( &xComposers[ i ], pcPayloads[ i ], TELEMETRY_PAYLOAD_SIZE );
+    }
+
     /* Initialize MQTT library. Initialization of the MQTT library needs to be
     * done only once in this demo. */
     returnStatus = initializeMqtt( &mqttContext, &xNetworkContext );
@@ -346,16 +784,82 @@ void aws_iot_demo(void *arg)
     {
         for( ; ; )
         {
-            /* Generate payload from DHT sensor. */
-            char* pcPayload = DHT_reader_task();
-            uint16_t payloadLength = ( uint16_t ) strlen(pcPayload);
+            /* Take the oldest readings sampled since the last iteration; with
+            * the block format, wait until a block's worth is queued. */
+            size_t readingCount = 0;
+            xFormat = telemetry_get_format();
+
+            if( xFormat != TELEMETRY_FORMAT_BLOCK )
+            {
+                readingCount = SpscRing_PopBatch( &sample_ring, xReadings, CONFIG_TELEMETRY_BATCH_MAX );
+            }
+            else if( block_due( xLastBlockMs ) )
+            {
+                readingCount = SpscRing_PopBatch( &sample_ring, xReadings, CONFIG_TELEMETRY_BLOCK_SAMPLES );
+                xLastBlockMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            }
+
+            xAlarmCount = collect_alarms( xAlarms, xAlarmCount );
+            xAlarmCount = encode_alarms( xAlarms, xAlarmCount, pcAlarmPayloads, xPayloads );
+            pxTelemetry = &xPayloads[ xAlarmCount ];
+
+            size_t payloadCount = encode_batch( xReadings, readingCount, xFormat, xComposers, pxTelemetry );
+
+            LogInfo( ( "Publishing %u alarms, %u readings in %u payloads, %u still queued (high water %u of %u), %u dropped.",
+                       ( unsigned ) xAlarmCount,
+                       ( unsigned ) readingCount,
+                       ( unsigned ) payloadCount,
+                       ( unsigned ) SpscRing_Count( &sample_ring ),
+                       ( unsigned ) SpscRing_HighWater( &sample_ring ),
+                       ( unsigned ) SpscRing_Capacity( &sample_ring ),
+                       ( unsigned ) SpscRing_Drops( &sample_ring ) ) );
+
+            /* The freshest reading, whether or not the reporting policy
+            * queued it, without waiting on the sensor. */
+            if( SensorCache_Get( &sensor_cache, &xLatest ) )
+            {
+                LogInfo( ( "Latest reading %u ms old: temperature %d, humidity %d (tenths), %u failed reads since.",
+                           ( unsigned ) xLatest.ageMs,
+                           xLatest.temperatureTenths,
+                           xLatest.humidityTenths,
+                           ( unsigned ) xLatest.consecutiveErrors ) );
+            }
+
+            xFromOfflineLog = false;
+            xCatchUp = false;
+
+            #if CONFIG_TELEMETRY_OFFLINE_LOG
+                if( offline_log_ready && ( OfflineLog_Pending( &offline_log ) > 0U ) )
+                {
+                    /* Older payloads are waiting: queue the new ones behind them
+                    * and send the oldest first. */
+                    offline_log_store( pxTelemetry, payloadCount, xFormat );
+                    payloadCount = offline_log_load( xComposers, pxTelemetry, &xFormat );
+                    xFromOfflineLog = true;
+
+                    LogInfo( ( "Draining offline log: %u payloads pending, %u dropped, %u skipped as corrupt.",
+                               ( unsigned ) OfflineLog_Pending( &offline_log ),
+                               ( unsigned ) OfflineLog_Dropped( &offline_log ),
+                               ( unsigned ) offline_log_skipped ) );
+                }
+            #endif
+
+            if( ( payloadCount == 0 ) && ( xAlarmCount == 0 ) )
+            {
+                vTaskDelay( pdMS_TO_TICKS( sample_interval_ms ) );
+                continue;
+            }
+
+            /* Publish on the topic of the format the payload was encoded in. */
+            globalMqttTopic = telemetry_topics[ xFormat ];
+            globalMqttTopicLength = ( uint16_t ) strlen( globalMqttTopic );
 
             /* Attempt to connect to the MQTT broker. If connection fails, retry after
             * a timeout. Timeout value will be exponentially increased till the maximum
             * attempts are reached or maximum timeout value is reached. The function
             * returns EXIT_FAILURE if the TCP connection cannot be established to
             * broker after configured number of attempts. */
-            returnStatus = connectToServerWithBackoffRetries( &xNetworkContext );
+            returnStatus = connectToServerWithBackoffRetries( &mqttContext );
             if( returnStatus == EXIT_FAILURE )
             {
                 /* Log error to indicate connection failure after all
@@ -368,11 +872,10 @@ void aws_iot_demo(void *arg)
             {
                 /* If TLS session is established, execute Subscribe/Publish loop. */
                 returnStatus = subscribePublishLoop( &mqttContext,
-                                                    &clientSessionPresent,
                                                     globalMqttTopic,
                                                     globalMqttTopicLength,
-                                                    pcPayload, 
-                                                    payloadLength );
+                                                    xPayloads,
+                                                    xAlarmCount + payloadCount );
             }
 
             if( returnStatus == EXIT_SUCCESS )
@@ -382,10 +885,52 @@ void aws_iot_demo(void *arg)
             }
 
             /* End TLS session, then close TCP connection. */
-            ( void ) xTlsDisconnect( &xNetworkContext );
+            disconnectFromServer( returnStatus != EXIT_SUCCESS );
+
+            /* The TLS handshake is the deepest call this task makes; report
+            * each new low of the stack left over. */
+            if( uxTaskGetStackHighWaterMark( NULL ) < uxStackLowest )
+            {
+                uxStackLowest = uxTaskGetStackHighWaterMark( NULL );
+                LogInfo( ( "aws_iot_demo stack: %u bytes never used.", ( unsigned ) uxStackLowest ) );
+            }
 
-            LogInfo( ( "Short delay before starting the next iteration....\n" ) );
-            sleep( MQTT_SUBPUB_LOOP_DELAY_SECONDS );
+            #if CONFIG_TELEMETRY_OFFLINE_LOG
+                if( offline_log_ready )
+                {
+                    /* Keep whatever the broker did not acknowledge. */
+                    if( xFromOfflineLog )
+                    {
+                        offline_log_consume( pxTelemetry, payloadCount );
+                    }
+                    else
+                    {
+                        offline_log_store( pxTelemetry, payloadCount, xFormat );
+                    }
+
+                    /* Catch up without waiting while the broker is reachable. */
+                    xCatchUp = ( returnStatus == EXIT_SUCCESS ) && ( OfflineLog_Pending( &offline_log ) > 0U );
+                }
+            #endif
+
+            /* Unacknowledged alarms go out first next time, without waiting
+            * for the delay if the broker is reachable. */
+            xAlarmCount = drop_acknowledged_alarms( xAlarms, xPayloads, xAlarmCount );
+            xCatchUp = xCatchUp ||
+                       ( ( returnStatus == EXIT_SUCCESS ) && ( ( xAlarmCount > 0 ) || ( SpscRing_Count( &alarm_ring ) > 0U ) ) );
+
+            #if CONFIG_FAULT_INJECTION_ENABLE
+                faultInjectionIterationDone();
+            #endif
+
+            if( !xCatchUp )
+            {
+                /* Publish as often as the sensor is sampled: more often while
+                * the readings move fast, less while they are flat. */
+                LogInfo( ( "Waiting %u ms before starting the next iteration....\n",
+                           ( unsigned ) sample_interval_ms ) );
+                vTaskDelay( pdMS_TO_TICKS( sample_interval_ms ) );
+            }
         }
     }
 
@@ -414,9 +959,52 @@ void app_main()
     // Iniciar con WiFi y conexión MQTT
     initialise_wifi();
 
-    /* Set MQTT Topic name to the global variable. */ 
-    globalMqttTopic = "clients/" CLIENT_IDENTIFIER "/sensor/dth11";
-    globalMqttTopicLength = ( uint16_t ) strlen( globalMqttTopic );
+    set_device_identity();
+    dht_init(&dht_sensor, DHT_GPIO, dht_bus_default());
+    sensor_filters_init();
+    SensorCache_Init(&sensor_cache, uptime_ms, NULL);
+
+    /* Start sampling before the first connection so no readings wait on it. */
+    const report_policy_config_t report_config = {
+        .temperature_deadband_tenths = CONFIG_REPORT_TEMPERATURE_DEADBAND_TENTHS,
+        .humidity_deadband_tenths = CONFIG_REPORT_HUMIDITY_DEADBAND_TENTHS,
+        .relative_deadband_permille = CONFIG_REPORT_RELATIVE_DEADBAND_PERMILLE,
+        .heartbeat_ms = CONFIG_REPORT_HEARTBEAT_SECONDS * 1000U,
+    };
+    report_policy_init(&report_policy, &report_config);
+
+    const sample_interval_config_t interval_config = {
+#if CONFIG_TELEMETRY_ADAPTIVE_INTERVAL
+        .min_ms = CONFIG_TELEMETRY_INTERVAL_MIN_MS,
+        .max_ms = CONFIG_TELEMETRY_INTERVAL_MAX_MS,
+        .temperature_tolerance_tenths = CONFIG_TELEMETRY_INTERVAL_TEMPERATURE_TOLERANCE_TENTHS,
+        .humidity_tolerance_tenths = CONFIG_TELEMETRY_INTERVAL_HUMIDITY_TOLERANCE_TENTHS,
+#else
+        .min_ms = CONFIG_TELEMETRY_SAMPLE_PERIOD_MS,
+        .max_ms = CONFIG_TELEMETRY_SAMPLE_PERIOD_MS,
+        .temperature_tolerance_tenths = 1,
+        .humidity_tolerance_tenths = 1,
+#endif
+        .initial_ms = CONFIG_TELEMETRY_SAMPLE_PERIOD_MS,
+    };
+    sample_interval_init(&sample_interval, &interval_config);
+    SpscRing_Init(&sample_ring, sample_storage, sizeof(sample_storage[0]), CONFIG_TELEMETRY_RING_CAPACITY);
+
+    const alarm_config_t alarm_config = {
+        .over_temperature_tenths = CONFIG_ALARM_OVER_TEMPERATURE_TENTHS,
+        .hysteresis_tenths = CONFIG_ALARM_HYSTERESIS_TENTHS,
+        .zero_cross_timeout_ms = CONFIG_ALARM_ZERO_CROSS_TIMEOUT_MS,
+    };
+    alarm_monitor_init(&alarm_monitor, &alarm_config);
+    SpscRing_Init(&alarm_ring, alarm_storage, sizeof(alarm_storage[0]), ALARM_RING_CAPACITY);
+    xTaskCreate(&sampling_task, "sampling_task", 3072, NULL, 6, &sampling_task_handle);
+
+    /* Pick the telemetry format; the topic follows it. */
+    load_telemetry_format();
+
+#if CONFIG_TELEMETRY_OFFLINE_LOG
+    offline_log_init();
+#endif
 
     xTaskCreate(&aws_iot_demo, "aws_iot_demo", 4096, NULL, 5, NULL );
     
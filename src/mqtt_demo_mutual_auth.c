@@ -52,11 +52,13 @@
 
 /* Standard includes. */
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 /* POSIX includes. */
+#include <sys/socket.h>
 #include <unistd.h>
 
 /* Include Demo Config as the first non-system header. */
@@ -75,6 +77,20 @@
 /* Clock for timer. */
 #include "clock.h"
 
+/* Broker selection and failover. */
+#include "endpoint_pool.h"
+
+/* Owned copies of the payloads awaiting a PUBACK. */
+#include "payload_pool.h"
+
+/* Priority lanes of outgoing publishes. */
+#include "publish_lanes.h"
+
+#if CONFIG_FAULT_INJECTION_ENABLE
+    /* Fault-injecting transport decorator used for benchmarking. */
+    #include "fault_transport.h"
+#endif
+
 /**
 * These configuration settings are required to run the mutual auth demo.
 * Throw compilation error if the below configs are not defined.
@@ -132,6 +148,11 @@
 */
 #define AWS_IOT_ENDPOINT_LENGTH         ( ( uint16_t ) ( sizeof( AWS_IOT_ENDPOINT ) - 1 ) )
 
+/**
+* @brief Length of the backup MQTT server host name; 0 disables failover.
+*/
+#define MQTT_BACKUP_ENDPOINT_LENGTH     ( ( uint16_t ) ( sizeof( MQTT_BACKUP_ENDPOINT ) - 1 ) )
+
 /**
 * @brief Length of client identifier.
 */
@@ -188,7 +209,27 @@
 * @brief Maximum number of outgoing publishes maintained in the application
 * until an ack is received from the broker.
 */
-#define MAX_OUTGOING_PUBLISHES              ( 5U )
+#define MAX_OUTGOING_PUBLISHES              ( CONFIG_MQTT_PUBLISH_POOL_SLOTS )
+
+#if MAX_OUTGOING_PUBLISHES > CONFIG_MQTT_STATE_ARRAY_MAX_COUNT
+    #error "CONFIG_MQTT_PUBLISH_POOL_SLOTS must not exceed CONFIG_MQTT_STATE_ARRAY_MAX_COUNT"
+#endif
+
+/**
+* @brief Publishes of the alarm lane that can await a PUBACK; the telemetry
+* lane may use the remaining slots of the publish pool.
+*/
+#define ALARM_LANE_IN_FLIGHT                ( CONFIG_MQTT_ALARM_LANE_IN_FLIGHT )
+
+#if ALARM_LANE_IN_FLIGHT >= MAX_OUTGOING_PUBLISHES
+    #error "CONFIG_MQTT_ALARM_LANE_IN_FLIGHT must leave the telemetry lane at least one publish pool slot"
+#endif
+
+/**
+* @brief Buckets of the packet ID table of the publish pool; a power of two
+* at least as large as the largest pool.
+*/
+#define PUBLISH_POOL_BUCKET_COUNT           ( 64U )
 
 /**
 * @brief Invalid packet identifier for the MQTT packets. Zero is always an
@@ -217,11 +258,6 @@
 */
 #define DELAY_BETWEEN_PUBLISHES_SECONDS     ( 1U )
 
-/**
-* @brief Number of PUBLISH messages sent per iteration.
-*/
-#define MQTT_PUBLISH_COUNT_PER_LOOP         ( 1U )
-
 /**
 * @brief Transport timeout in milliseconds for transport send and receive.
 */
@@ -238,6 +274,31 @@
 #define METRICS_STRING_LENGTH               ( ( uint16_t ) ( sizeof( METRICS_STRING ) - 1 ) )
 
 
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+/**
+* @brief Interval between two transport statistics reports in milliseconds.
+*/
+    #define TRANSPORT_STATS_PUBLISH_INTERVAL_MS    ( 60000U )
+
+/**
+* @brief Topic the transport statistics are published to.
+*/
+    #define TRANSPORT_STATS_TOPIC                  "clients/" CLIENT_IDENTIFIER "/telemetry/transport"
+
+/**
+* @brief Length of the transport statistics topic.
+*/
+    #define TRANSPORT_STATS_TOPIC_LENGTH           ( ( uint16_t ) ( sizeof( TRANSPORT_STATS_TOPIC ) - 1 ) )
+
+/**
+* @brief Size of the buffer the transport statistics are rendered into. The
+* longest rendering, with every counter and bucket at its limit, is 902
+* bytes (test/test_network_transport.c).
+*/
+    #define TRANSPORT_STATS_PAYLOAD_SIZE           ( 1024U )
+#endif
+
 #ifdef CLIENT_USERNAME
 
 /**
@@ -253,7 +314,8 @@
 
 /**
 * @brief Structure to keep the MQTT publish packets until an ack is received
-* for QoS1 publishes.
+* for QoS1 publishes. The payload itself is held by #publishPool, in the slot
+* with the same index.
 */
 typedef struct PublishPackets
 {
@@ -266,6 +328,27 @@ typedef struct PublishPackets
     * @brief Publish info of the publish packet.
     */
     MQTTPublishInfo_t pubInfo;
+
+    /**
+    * @brief Time the publish was first sent, for PUBACK latency tracking.
+    */
+    uint32_t sentAtMs;
+
+    /**
+    * @brief Payload descriptor to mark acknowledged on PUBACK; NULL once the
+    * subscribePublishLoop() call that sent it has returned.
+    */
+    MqttPayload_t * pSource;
+
+    /**
+    * @brief Lane the publish was scheduled from.
+    */
+    MqttLane_t lane;
+
+    /**
+    * @brief Broker the publish was sent to; only its session can resend it.
+    */
+    const Endpoint_t * pEndpoint;
 } PublishPackets_t;
 
 /*-----------------------------------------------------------*/
@@ -284,12 +367,30 @@ static uint16_t globalSubscribePacketIdentifier = 0U;
 static uint16_t globalUnsubscribePacketIdentifier = 0U;
 
 /**
-* @brief Array to keep the outgoing publish messages.
-* These stored outgoing publish messages are kept until a successful ack
+* @brief Array to keep the outgoing publish messages, indexed by publish pool
+* slot. These stored outgoing publish messages are kept until a successful ack
 * is received.
 */
 static PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ] = { 0 };
 
+/**
+* @brief Copies of the outgoing publish payloads, looked up by packet ID.
+*/
+static PayloadPool_t publishPool;
+
+/**
+* @brief Memory of #publishPool.
+*/
+static PayloadPoolSlot_t publishPoolSlots[ MAX_OUTGOING_PUBLISHES ];
+static uint8_t publishPoolStorage[ MAX_OUTGOING_PUBLISHES ][ CONFIG_MQTT_PUBLISH_POOL_SLOT_SIZE ];
+static uint16_t publishPoolBuckets[ PUBLISH_POOL_BUCKET_COUNT ];
+
+/**
+* @brief Picks the lane each publish is sent from and tracks the publishes
+* awaiting a PUBACK per lane.
+*/
+static PublishLanes_t publishLanes;
+
 /**
 * @brief Array to keep subscription topics.
 * Used to re-subscribe to topics that failed initial subscription attempts.
@@ -309,9 +410,63 @@ static uint8_t buffer[ NETWORK_BUFFER_SIZE ];
 static MQTTSubAckStatus_t globalSubAckStatus = MQTTSubAckFailure;
 
 /**
-* @brief Static buffer for TLS Context Semaphore.
+* @brief Static buffers for the TLS context semaphores, one per broker.
+*/
+static StaticSemaphore_t xTlsContextSemaphoreBuffer[ 2 ];
+
+/**
+* @brief Network context of the backup broker; the primary one is supplied
+* by the caller of initializeMqtt().
+*/
+static NetworkContext_t backupNetworkContext;
+
+/**
+* @brief Brokers to choose from, with their health and latency.
+*/
+static EndpointPool_t endpointPool;
+
+#if CONFIG_FAULT_INJECTION_ENABLE
+
+/**
+* @brief Decorator between the MQTT library and the TLS transport.
+*/
+static FaultTransport_t faultTransport;
+
+/**
+* @brief Outcome of the scenario currently running.
+*/
+static FaultScenarioReport_t faultReport;
+
+/**
+* @brief Index of the running scenario in FaultTransport_Scenarios().
+*/
+static size_t faultScenarioIndex = 0U;
+
+/**
+* @brief Demo iterations completed under the running scenario.
+*/
+static uint32_t faultScenarioIterations = 0U;
+
+/**
+* @brief Set when a session fails, so the next connection is timed as a
+* reconnect; the first connection and those after a clean disconnect are not.
+*/
+static bool faultReconnecting = false;
+#endif
+
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+/**
+* @brief Time of the last transport statistics report.
+*/
+static uint32_t lastTransportStatsPublishMs = 0U;
+
+/**
+* @brief Buffer the transport statistics are rendered into. QoS0 publishes
+* are not retained, so a single buffer is enough.
 */
-static StaticSemaphore_t xTlsContextSemaphoreBuffer;
+static char transportStatsPayload[ TRANSPORT_STATS_PAYLOAD_SIZE ];
+#endif
 
 /*-----------------------------------------------------------*/
 
@@ -402,6 +557,8 @@ static int unsubscribeFromTopic( MQTTContext_t * pMqttContext,
 * the top of the file.
 *
 * @param[in] pMqttContext MQTT context pointer.
+* @param[in,out] pPayload Payload to send; copied into #publishPool, and
+* marked acknowledged on PUBACK.
 *
 * @return EXIT_SUCCESS if PUBLISH was successfully sent;
 * EXIT_FAILURE otherwise.
@@ -409,19 +566,7 @@ static int unsubscribeFromTopic( MQTTContext_t * pMqttContext,
 static int publishToTopic( MQTTContext_t * pMqttContext,
                         const char * pcTopicFilter,
                         int32_t topicFilterLength,
-                        const char * pcPayload,
-                        uint16_t payloadLength );
-/**
-* @brief Function to get the free index at which an outgoing publish
-* can be stored.
-*
-* @param[out] pIndex The output parameter to return the index at which an
-* outgoing publish message can be stored.
-*
-* @return EXIT_FAILURE if no more publishes can be stored;
-* EXIT_SUCCESS if an index to store the next outgoing publish is obtained.
-*/
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex );
+                        MqttPayload_t * pPayload );
 
 /**
 * @brief Function to clean up an outgoing publish at given index from the
@@ -429,13 +574,25 @@ static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex );
 *
 * @param[in] index The index at which a publish message has to be cleaned up.
 */
-static void cleanupOutgoingPublishAt( uint8_t index );
+static void cleanupOutgoingPublishAt( uint16_t index );
 
 /**
-* @brief Function to clean up all the outgoing publishes maintained in the
-* array.
+* @brief Function to clean up the outgoing publishes sent to one broker,
+* when its session is gone.
+*
+* @param[in] pEndpoint Broker whose publishes are cleaned up.
+*
+* @return true if any publish was cleaned up.
 */
-static void cleanupOutgoingPublishes( void );
+static bool cleanupOutgoingPublishes( const Endpoint_t * pEndpoint );
+
+/**
+* @brief Give up the sessions kept for the brokers not in use, with the
+* publishes they still owe a PUBACK for.
+*
+* @return true if any publish was cleaned up.
+*/
+static bool releaseParkedSessions( void );
 
 /**
 * @brief Function to clean up the publish packet with the given packet id.
@@ -473,6 +630,20 @@ static int handleResubscribe( MQTTContext_t * pMqttContext,
                                 const char * pcTopicFilter,
                                 uint16_t usTopicFilterLength );
 
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+/**
+* @brief Publish the transport statistics collected since the last report
+* with QoS0, once every #TRANSPORT_STATS_PUBLISH_INTERVAL_MS.
+*
+* @param[in] pMqttContext MQTT context pointer.
+*
+* @return EXIT_SUCCESS if nothing was due or the report was sent;
+* EXIT_FAILURE otherwise.
+*/
+static int publishTransportStats( MQTTContext_t * pMqttContext );
+#endif
+
 /*-----------------------------------------------------------*/
 
 static uint32_t generateRandomNumber()
@@ -481,20 +652,35 @@ static uint32_t generateRandomNumber()
 }
 
 /*-----------------------------------------------------------*/
-int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext )
+static void prepareNetworkContext( NetworkContext_t * pNetworkContext,
+                                   const char * pcHostName,
+                                   uint16_t usPort,
+                                   StaticSemaphore_t * pxSemaphoreBuffer )
 {
-    int returnStatus = EXIT_SUCCESS;
-    BackoffAlgorithmStatus_t backoffAlgStatus = BackoffAlgorithmSuccess;
-    TlsTransportStatus_t tlsStatus = TLS_TRANSPORT_SUCCESS;
-    BackoffAlgorithmContext_t reconnectParams;
-
-    pNetworkContext->pcHostname = AWS_IOT_ENDPOINT;
-    pNetworkContext->xPort = AWS_MQTT_PORT;
+    pNetworkContext->pcHostname = pcHostName;
+    pNetworkContext->xPort = usPort;
     pNetworkContext->pxTls = NULL;
-    pNetworkContext->xTlsContextSemaphore = xSemaphoreCreateMutexStatic(&xTlsContextSemaphoreBuffer);
+    pNetworkContext->xTlsContextSemaphore = xSemaphoreCreateMutexStatic( pxSemaphoreBuffer );
 
     pNetworkContext->disableSni = 0;
-    uint16_t nextRetryBackOff;
+
+    /* Ask the broker for records no larger than the MQTT network buffer so
+    * the TLS buffers can be sized down after the handshake. */
+    #ifdef CONFIG_CORE_MQTT_TLS_MAX_FRAGMENT_LEN
+        pNetworkContext->usMaxFragmentLength = CONFIG_CORE_MQTT_TLS_MAX_FRAGMENT_LEN;
+    #else
+        pNetworkContext->usMaxFragmentLength = 0;
+    #endif
+
+    /* With a P-256 client key, ECDHE-ECDSA makes the client signature an
+    * ECDSA one, far cheaper than an RSA-2048 private key operation. */
+    #if CONFIG_CORE_MQTT_TLS_PREFER_ECDHE_ECDSA
+        pNetworkContext->pxCipherSuites = pxTlsEcdheEcdsaCipherSuites;
+        pNetworkContext->pxCurves = pxTlsP256Curves;
+    #else
+        pNetworkContext->pxCipherSuites = NULL;
+        pNetworkContext->pxCurves = NULL;
+    #endif
 
     /* Initialize credentials for establishing TLS session. */
     pNetworkContext->pcServerRootCAPem = root_cert_auth_pem_start;
@@ -512,7 +698,7 @@ int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext )
     * SNI for AWS IoT can be found in the link below.
     * https://docs.aws.amazon.com/iot/latest/developerguide/transport-security.html */
 
-    if( AWS_MQTT_PORT == 443 )
+    if( usPort == 443 )
     {
         /* Pass the ALPN protocol name depending on the port being used.
         * Please see more details about the ALPN protocol for the AWS IoT MQTT
@@ -537,6 +723,66 @@ int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext )
     } else {
         pNetworkContext->pAlpnProtos = NULL;
     }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool connectEndpoint( Endpoint_t * pEndpoint )
+{
+    LogInfo( ( "Establishing a TLS session to %s:%u.",
+               pEndpoint->pHostName,
+               ( unsigned ) pEndpoint->port ) );
+
+    #if CONFIG_FAULT_INJECTION_ENABLE
+        if( FaultTransport_ShouldFailConnect( &faultTransport ) )
+        {
+            return false;
+        }
+    #endif
+
+    return xTlsConnect( pEndpoint->pNetworkContext ) == TLS_TRANSPORT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static void disconnectEndpoint( Endpoint_t * pEndpoint )
+{
+    /* End TLS session, then close TCP connection. */
+    ( void ) xTlsDisconnect( pEndpoint->pNetworkContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool keepAliveEndpoint( Endpoint_t * pEndpoint )
+{
+    int sockfd = -1;
+    char byte;
+
+    /* Nothing is sent on a standby connection before CONNECT, so anything
+    * to read is the broker closing it: a close_notify alert, EOF or a reset. */
+    if( esp_tls_get_conn_sockfd( pEndpoint->pNetworkContext->pxTls, &sockfd ) != ESP_OK )
+    {
+        return false;
+    }
+
+    return ( recv( sockfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT ) < 0 ) &&
+           ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) );
+}
+
+/*-----------------------------------------------------------*/
+
+int connectToServerWithBackoffRetries( MQTTContext_t * pMqttContext )
+{
+    int returnStatus = EXIT_SUCCESS;
+    BackoffAlgorithmStatus_t backoffAlgStatus = BackoffAlgorithmSuccess;
+    BackoffAlgorithmContext_t reconnectParams;
+    Endpoint_t * pEndpoint = NULL;
+    bool connected = false;
+    uint16_t nextRetryBackOff;
+
+    #if CONFIG_FAULT_INJECTION_ENABLE
+        uint32_t connectStartMs = Clock_GetTimeMs();
+    #endif
 
     /* Initialize reconnect attempts and interval */
     BackoffAlgorithm_InitializeParams( &reconnectParams,
@@ -544,22 +790,17 @@ int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext )
                                     CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS,
                                     CONNECTION_RETRY_MAX_ATTEMPTS );
 
-    /* Attempt to connect to MQTT broker. If connection fails, retry after
-    * a timeout. Timeout value will exponentially increase until maximum
-    * attempts are reached.
+    /* Attempt to connect to the best available MQTT broker. A failed broker
+    * is held off, so the next attempt goes straight to the other one; only
+    * when every broker has failed recently is there a back-off delay, which
+    * increases exponentially until maximum attempts are reached.
     */
     do
     {
-        /* Establish a TLS session with the MQTT broker. This example connects
-        * to the MQTT broker as specified in AWS_IOT_ENDPOINT and AWS_MQTT_PORT
-        * at the demo config header. */
-        LogInfo( ( "Establishing a TLS session to %.*s:%d.",
-                AWS_IOT_ENDPOINT_LENGTH,
-                AWS_IOT_ENDPOINT,
-                AWS_MQTT_PORT ) );
-        tlsStatus = xTlsConnect ( pNetworkContext );
+        pEndpoint = EndpointPool_Select( &endpointPool );
+        connected = EndpointPool_Connect( &endpointPool, pEndpoint );
 
-        if( tlsStatus != TLS_TRANSPORT_SUCCESS )
+        if( !connected && !EndpointPool_IsAvailable( &endpointPool, EndpointPool_Select( &endpointPool ) ) )
         {
             /* Generate a random number and get back-off value (in milliseconds) for the next connection retry. */
             backoffAlgStatus = BackoffAlgorithm_GetNextBackoff( &reconnectParams, generateRandomNumber(), &nextRetryBackOff );
@@ -577,40 +818,61 @@ int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext )
                 Clock_SleepMs( nextRetryBackOff );
             }
         }
-    } while( ( tlsStatus != TLS_TRANSPORT_SUCCESS ) && ( backoffAlgStatus == BackoffAlgorithmSuccess ) );
+    } while( !connected && ( backoffAlgStatus == BackoffAlgorithmSuccess ) );
+
+    if( connected )
+    {
+        /* Route the MQTT session over the connection just made. */
+        pMqttContext->transportInterface.pNetworkContext = pEndpoint->pNetworkContext;
+
+        #if CONFIG_FAULT_INJECTION_ENABLE
+            FaultTransport_Rebind( &faultTransport,
+                                   pEndpoint->pNetworkContext,
+                                   &pMqttContext->transportInterface );
+            FaultTransport_Reconnected( &faultTransport );
+        #endif
+
+        #if CONFIG_MQTT_BROKER_WARM_STANDBY
+            /* Have the other broker ready in case this one fails. */
+            EndpointPool_WarmStandby( &endpointPool );
+        #endif
+    }
+
+    #if CONFIG_FAULT_INJECTION_ENABLE
+        if( faultReconnecting )
+        {
+            FaultReport_RecordReconnect( &faultReport,
+                                         Clock_GetTimeMs() - connectStartMs,
+                                         connected );
+            faultReconnecting = !connected;
+        }
+    #endif
 
     return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
 
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex )
+void disconnectFromServer( bool sessionFailed )
 {
-    int returnStatus = EXIT_FAILURE;
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( pIndex != NULL );
+    #if CONFIG_FAULT_INJECTION_ENABLE
+        faultReconnecting = faultReconnecting || sessionFailed;
+    #endif
 
-    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
+    if( sessionFailed && ( endpointPool.pActive != NULL ) )
     {
-        /* A free index is marked by invalid packet id.
-        * Check if the the index has a free slot. */
-        if( outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID )
-        {
-            returnStatus = EXIT_SUCCESS;
-            break;
-        }
+        /* Closes the connection and steers the next attempt elsewhere. */
+        EndpointPool_RecordFailure( &endpointPool, endpointPool.pActive );
+    }
+    else
+    {
+        EndpointPool_Release( &endpointPool );
     }
-
-    /* Copy the available index into the output param. */
-    *pIndex = index;
-
-    return returnStatus;
 }
+
 /*-----------------------------------------------------------*/
 
-static void cleanupOutgoingPublishAt( uint8_t index )
+static void cleanupOutgoingPublishAt( uint16_t index )
 {
     assert( outgoingPublishPackets != NULL );
     assert( index < MAX_OUTGOING_PUBLISHES );
@@ -623,33 +885,84 @@ static void cleanupOutgoingPublishAt( uint8_t index )
 
 /*-----------------------------------------------------------*/
 
-static void cleanupOutgoingPublishes( void )
+static bool cleanupOutgoingPublishes( const Endpoint_t * pEndpoint )
 {
+    bool cleaned = false;
+    uint16_t index;
+
     assert( outgoingPublishPackets != NULL );
+    assert( pEndpoint != NULL );
+
+    /* Clean up the publish packets sent to this broker and free their
+    * payloads; those awaiting another broker's session stay. */
+    for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        if( ( outgoingPublishPackets[ index ].pEndpoint == pEndpoint ) &&
+            ( outgoingPublishPackets[ index ].packetId != MQTT_PACKET_ID_INVALID ) )
+        {
+            ( void ) PayloadPool_Release( &publishPool, outgoingPublishPackets[ index ].packetId, NULL );
+            PublishLanes_Acked( &publishLanes, outgoingPublishPackets[ index ].lane );
+            cleanupOutgoingPublishAt( index );
+            cleaned = true;
+        }
+    }
+
+    return cleaned;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool releaseParkedSessions( void )
+{
+    bool released = false;
+    size_t i;
+
+    for( i = 0U; i < endpointPool.count; i++ )
+    {
+        Endpoint_t * pEndpoint = &endpointPool.endpoints[ i ];
 
-    /* Clean up all the outgoing publish packets. */
-    ( void ) memset( outgoingPublishPackets, 0x00, sizeof( outgoingPublishPackets ) );
+        if( ( pEndpoint != endpointPool.pBound ) && cleanupOutgoingPublishes( pEndpoint ) )
+        {
+            LogWarn( ( "Giving up the session with %s:%u to make room for new publishes.",
+                       pEndpoint->pHostName,
+                       ( unsigned ) pEndpoint->port ) );
+            EndpointPool_ForgetSession( &endpointPool, pEndpoint );
+            released = true;
+        }
+    }
+
+    return released;
 }
 
 /*-----------------------------------------------------------*/
 
 static void cleanupOutgoingPublishWithPacketID( uint16_t packetId )
 {
-    uint8_t index = 0;
+    uint16_t index = 0;
 
     assert( outgoingPublishPackets != NULL );
     assert( packetId != MQTT_PACKET_ID_INVALID );
 
-    /* Clean up all the saved outgoing publishes. */
-    for( ; index < MAX_OUTGOING_PUBLISHES; index++ )
+    /* Free the payload; the slot it was in indexes the publish record. */
+    if( PayloadPool_Release( &publishPool, packetId, &index ) )
     {
-        if( outgoingPublishPackets[ index ].packetId == packetId )
+        uint32_t ackLatencyMs = Clock_GetTimeMs() - outgoingPublishPackets[ index ].sentAtMs;
+
+        EndpointPool_RecordPubAck( &endpointPool, ackLatencyMs );
+        PublishLanes_Acked( &publishLanes, outgoingPublishPackets[ index ].lane );
+
+        if( outgoingPublishPackets[ index ].pSource != NULL )
         {
-            cleanupOutgoingPublishAt( index );
-            LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.\n\n",
-                    packetId ) );
-            break;
+            outgoingPublishPackets[ index ].pSource->acknowledged = true;
         }
+
+        #if CONFIG_FAULT_INJECTION_ENABLE
+            FaultReport_RecordAck( &faultReport, ackLatencyMs );
+        #endif
+
+        cleanupOutgoingPublishAt( index );
+        LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.\n\n",
+                packetId ) );
     }
 }
 
@@ -659,10 +972,9 @@ static int handlePublishResend( MQTTContext_t * pMqttContext )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t index = 0U;
+    uint16_t index = 0U;
     MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
     uint16_t packetIdToResend = MQTT_PACKET_ID_INVALID;
-    bool foundPacketId = false;
 
     assert( pMqttContext != NULL );
     assert( outgoingPublishPackets != NULL );
@@ -670,59 +982,48 @@ static int handlePublishResend( MQTTContext_t * pMqttContext )
     /* MQTT_PublishToResend() provides a packet ID of the next PUBLISH packet
     * that should be resent. In accordance with the MQTT v3.1.1 spec,
     * MQTT_PublishToResend() preserves the ordering of when the original
-    * PUBLISH packets were sent. The outgoingPublishPackets array is searched
-    * through for the associated packet ID. If the application requires
-    * increased efficiency in the look up of the packet ID, then a hashmap of
-    * packetId key and PublishPacket_t values may be used instead. */
+    * PUBLISH packets were sent. The publish pool maps the packet ID to the
+    * slot holding its payload and publish record. */
     packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
 
     while( packetIdToResend != MQTT_PACKET_ID_INVALID )
     {
-        foundPacketId = false;
-
-        for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
-        {
-            if( outgoingPublishPackets[ index ].packetId == packetIdToResend )
-            {
-                foundPacketId = true;
-                outgoingPublishPackets[ index ].pubInfo.dup = true;
-
-                LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
-                        outgoingPublishPackets[ index ].packetId ) );
-                mqttStatus = MQTT_Publish( pMqttContext,
-                                        &outgoingPublishPackets[ index ].pubInfo,
-                                        outgoingPublishPackets[ index ].packetId );
-
-                if( mqttStatus != MQTTSuccess )
-                {
-                    LogError( ( "Sending duplicate PUBLISH for packet id %u "
-                                " failed with status %s.",
-                                outgoingPublishPackets[ index ].packetId,
-                                MQTT_Status_strerror( mqttStatus ) ) );
-                    returnStatus = EXIT_FAILURE;
-                    break;
-                }
-                else
-                {
-                    LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.\n\n",
-                            outgoingPublishPackets[ index ].packetId ) );
-                }
-            }
-        }
-
-        if( foundPacketId == false )
+        if( PayloadPool_Find( &publishPool, packetIdToResend, &index ) == false )
         {
             LogError( ( "Packet id %u requires resend, but was not found in "
-                        "outgoingPublishPackets.",
+                        "the publish pool.",
                         packetIdToResend ) );
             returnStatus = EXIT_FAILURE;
             break;
         }
-        else
+
+        outgoingPublishPackets[ index ].pubInfo.dup = true;
+
+        /* Time the PUBACK from the resend; the first send may be a whole
+        * outage ago, which is not this broker's latency. */
+        outgoingPublishPackets[ index ].sentAtMs = Clock_GetTimeMs();
+
+        LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
+                packetIdToResend ) );
+        mqttStatus = MQTT_Publish( pMqttContext,
+                                &outgoingPublishPackets[ index ].pubInfo,
+                                packetIdToResend );
+
+        if( mqttStatus != MQTTSuccess )
         {
-            /* Get the next packetID to be resent. */
-            packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
+            LogError( ( "Sending duplicate PUBLISH for packet id %u "
+                        " failed with status %s.",
+                        packetIdToResend,
+                        MQTT_Status_strerror( mqttStatus ) ) );
+            returnStatus = EXIT_FAILURE;
+            break;
         }
+
+        LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.\n\n",
+                packetIdToResend ) );
+
+        /* Get the next packetID to be resent. */
+        packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
     }
 
     return returnStatus;
@@ -1150,30 +1451,36 @@ static int unsubscribeFromTopic( MQTTContext_t * pMqttContext,
 static int publishToTopic( MQTTContext_t * pMqttContext,
                         const char * pcTopicFilter,
                         int32_t topicFilterLength,
-                        const char * pcPayload,
-                        uint16_t payloadLength )
+                        MqttPayload_t * pPayload )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t publishIndex = MAX_OUTGOING_PUBLISHES;
+    PayloadPoolStatus_t poolStatus = PayloadPoolSuccess;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    uint16_t publishIndex = MAX_OUTGOING_PUBLISHES;
 
     assert( pMqttContext != NULL );
     assert( pcTopicFilter != NULL );
     assert( topicFilterLength > 0 );
+    assert( pPayload != NULL );
 
     // LogInfo( ( "Recieved Payload in publishToTopic: %.*s.",
-    //                         payloadLength,
-    //                         pcPayload ) );
+    //                         pPayload->length,
+    //                         pPayload->pData ) );
 
-    /* Get the next free index for the outgoing publish. All QoS1 outgoing
-    * publishes are stored until a PUBACK is received. These messages are
-    * stored for supporting a resend if a network connection is broken before
-    * receiving a PUBACK. */
-    returnStatus = getNextFreeIndexForOutgoingPublishes( &publishIndex );
+    /* Copy the payload into the publish pool. All QoS1 outgoing publishes are
+    * stored until a PUBACK is received. These messages are stored for
+    * supporting a resend if a network connection is broken before receiving
+    * a PUBACK; the copy stays valid however long that takes. */
+    packetId = MQTT_GetPacketId( pMqttContext );
+    poolStatus = PayloadPool_Store( &publishPool, packetId, pPayload->pData, pPayload->length, &publishIndex );
 
-    if( returnStatus == EXIT_FAILURE )
+    if( poolStatus != PayloadPoolSuccess )
     {
-        LogError( ( "Unable to find a free spot for outgoing PUBLISH message.\n\n" ) );
+        LogError( ( "Unable to store outgoing PUBLISH message of %u bytes: %s.\n\n",
+                    pPayload->length,
+                    ( poolStatus == PayloadPoolTooLarge ) ? "larger than a pool slot" : "pool exhausted" ) );
+        returnStatus = EXIT_FAILURE;
     }
     else
     {
@@ -1181,11 +1488,19 @@ static int publishToTopic( MQTTContext_t * pMqttContext,
         outgoingPublishPackets[ publishIndex ].pubInfo.qos = MQTTQoS1;
         outgoingPublishPackets[ publishIndex ].pubInfo.pTopicName = pcTopicFilter;
         outgoingPublishPackets[ publishIndex ].pubInfo.topicNameLength = topicFilterLength;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = pcPayload;
-        outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = payloadLength;
-
-        /* Get a new packet id. */
-        outgoingPublishPackets[ publishIndex ].packetId = MQTT_GetPacketId( pMqttContext );
+        outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = PayloadPool_Data( &publishPool, publishIndex );
+        outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = PayloadPool_Length( &publishPool, publishIndex );
+        outgoingPublishPackets[ publishIndex ].pSource = pPayload;
+        outgoingPublishPackets[ publishIndex ].lane = pPayload->lane;
+        outgoingPublishPackets[ publishIndex ].packetId = packetId;
+        outgoingPublishPackets[ publishIndex ].pEndpoint = endpointPool.pActive;
+        PublishLanes_Sent( &publishLanes, pPayload->lane );
+
+        outgoingPublishPackets[ publishIndex ].sentAtMs = Clock_GetTimeMs();
+
+        #if CONFIG_FAULT_INJECTION_ENABLE
+            FaultReport_RecordPublish( &faultReport );
+        #endif
 
         /* Send PUBLISH packet. */
         mqttStatus = MQTT_Publish( pMqttContext,
@@ -1196,6 +1511,8 @@ static int publishToTopic( MQTTContext_t * pMqttContext,
         {
             LogError( ( "Failed to send PUBLISH packet to broker with error = %s.",
                         MQTT_Status_strerror( mqttStatus ) ) );
+            ( void ) PayloadPool_Release( &publishPool, packetId, NULL );
+            PublishLanes_Acked( &publishLanes, pPayload->lane );
             cleanupOutgoingPublishAt( publishIndex );
             returnStatus = EXIT_FAILURE;
         }
@@ -1213,6 +1530,63 @@ static int publishToTopic( MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+static int publishTransportStats( MQTTContext_t * pMqttContext )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    MQTTPublishInfo_t publishInfo = { 0 };
+    TlsTransportStats_t stats;
+    int32_t payloadLength;
+    uint32_t now = Clock_GetTimeMs();
+
+    assert( pMqttContext != NULL );
+
+    if( ( now - lastTransportStatsPublishMs ) < TRANSPORT_STATS_PUBLISH_INTERVAL_MS )
+    {
+        return EXIT_SUCCESS;
+    }
+
+    lastTransportStatsPublishMs = now;
+
+    /* Each report covers the interval since the previous one. */
+    vTlsTransportGetStats( pMqttContext->transportInterface.pNetworkContext, &stats, true );
+    payloadLength = lTlsTransportFormatStats( &stats,
+                                              transportStatsPayload,
+                                              sizeof( transportStatsPayload ) );
+
+    if( payloadLength < 0 )
+    {
+        LogError( ( "Transport statistics do not fit in %u bytes.",
+                    ( unsigned ) sizeof( transportStatsPayload ) ) );
+        returnStatus = EXIT_FAILURE;
+    }
+    else
+    {
+        publishInfo.qos = MQTTQoS0;
+        publishInfo.pTopicName = TRANSPORT_STATS_TOPIC;
+        publishInfo.topicNameLength = TRANSPORT_STATS_TOPIC_LENGTH;
+        publishInfo.pPayload = transportStatsPayload;
+        publishInfo.payloadLength = ( size_t ) payloadLength;
+
+        /* QoS0 publishes do not use a packet identifier. */
+        mqttStatus = MQTT_Publish( pMqttContext, &publishInfo, 0U );
+
+        if( mqttStatus != MQTTSuccess )
+        {
+            LogError( ( "Failed to publish transport statistics with error = %s.",
+                        MQTT_Status_strerror( mqttStatus ) ) );
+            returnStatus = EXIT_FAILURE;
+        }
+    }
+
+    return returnStatus;
+}
+#endif /* if CONFIG_CORE_MQTT_TRANSPORT_STATS */
+
+/*-----------------------------------------------------------*/
+
 int initializeMqtt( MQTTContext_t * pMqttContext,
                         NetworkContext_t * pNetworkContext )
 {
@@ -1224,6 +1598,45 @@ int initializeMqtt( MQTTContext_t * pMqttContext,
     assert( pMqttContext != NULL );
     assert( pNetworkContext != NULL );
 
+    /* Outgoing publishes keep a copy of their payload until acknowledged. */
+    if( PayloadPool_Init( &publishPool,
+                          publishPoolSlots,
+                          MAX_OUTGOING_PUBLISHES,
+                          publishPoolStorage,
+                          CONFIG_MQTT_PUBLISH_POOL_SLOT_SIZE,
+                          publishPoolBuckets,
+                          PUBLISH_POOL_BUCKET_COUNT ) == false )
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* Alarms keep their own share of the pool, whatever the telemetry
+    * backlog. */
+    {
+        const uint16_t laneLimits[ MqttLaneCount ] =
+        {
+            [ MqttLaneAlarm ] = ALARM_LANE_IN_FLIGHT,
+            [ MqttLaneTelemetry ] = MAX_OUTGOING_PUBLISHES - ALARM_LANE_IN_FLIGHT
+        };
+
+        if( PublishLanes_Init( &publishLanes, laneLimits, MqttLaneCount, MAX_OUTGOING_PUBLISHES ) == false )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Register the brokers. The primary comes first so it is preferred
+    * until latencies have been measured. */
+    EndpointPool_Init( &endpointPool, connectEndpoint, disconnectEndpoint, keepAliveEndpoint, Clock_GetTimeMs );
+    prepareNetworkContext( pNetworkContext, AWS_IOT_ENDPOINT, AWS_MQTT_PORT, &xTlsContextSemaphoreBuffer[ 0 ] );
+    ( void ) EndpointPool_Add( &endpointPool, AWS_IOT_ENDPOINT, AWS_MQTT_PORT, pNetworkContext );
+
+    if( MQTT_BACKUP_ENDPOINT_LENGTH > 0U )
+    {
+        prepareNetworkContext( &backupNetworkContext, MQTT_BACKUP_ENDPOINT, MQTT_BACKUP_PORT, &xTlsContextSemaphoreBuffer[ 1 ] );
+        ( void ) EndpointPool_Add( &endpointPool, MQTT_BACKUP_ENDPOINT, MQTT_BACKUP_PORT, &backupNetworkContext );
+    }
+
     /* Fill in TransportInterface send and receive function pointers.
     * For this demo, TCP sockets are used to send and receive data
     * from network. Network context is SSL context for OpenSSL.*/
@@ -1231,6 +1644,22 @@ int initializeMqtt( MQTTContext_t * pMqttContext,
     transport.send = espTlsTransportSend;
     transport.recv = espTlsTransportRecv;
 
+    #if CONFIG_FAULT_INJECTION_ENABLE
+        {
+            size_t scenarioCount;
+
+            /* Route all MQTT traffic through the decorator, starting with
+            * the first scenario. */
+            if( FaultTransport_Init( &faultTransport,
+                                     &transport,
+                                     &FaultTransport_Scenarios( &scenarioCount )[ 0 ],
+                                     &transport ) == false )
+            {
+                return EXIT_FAILURE;
+            }
+        }
+    #endif
+
     /* Fill the values for network buffer. */
     networkBuffer.pBuffer = buffer;
     networkBuffer.size = NETWORK_BUFFER_SIZE;
@@ -1254,33 +1683,37 @@ int initializeMqtt( MQTTContext_t * pMqttContext,
 /*-----------------------------------------------------------*/
 
 int subscribePublishLoop( MQTTContext_t * pMqttContext,
-                        bool * pClientSessionPresent,
                         const char * pcTopicFilter,
                         uint16_t usTopicFilterLength,
-                        const char * pcPayload,
-                        uint16_t payloadLength )
+                        MqttPayload_t * pPayloads,
+                        size_t payloadCount )
 {
     int returnStatus = EXIT_SUCCESS;
     bool mqttSessionEstablished = false, brokerSessionPresent;
     MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint32_t publishCount = 0;
-    const uint32_t maxPublishCount = MQTT_PUBLISH_COUNT_PER_LOOP;
+    size_t publishCount = 0;
+    size_t laneNext[ MqttLaneCount ] = { 0 };
+    uint32_t readyMask;
+    uint8_t lane;
+    const char * pcPublishTopic;
+    uint16_t usPublishTopicLength;
+    uint16_t index = 0;
     bool createCleanSession = false;
 
     assert( pMqttContext != NULL );
-    assert( pClientSessionPresent != NULL );
     assert( pcTopicFilter != NULL );
     assert( usTopicFilterLength > 0 );
-    assert( pcPayload != NULL );
-    assert( payloadLength > 0 );
+    assert( pPayloads != NULL );
+    assert( payloadCount > 0 );
 
     // LogInfo( ( "Recieved Payload in subscribePublishLoop: %.*s.",
     //                         payloadLength,
     //                         pcPayload ) );
 
-    /* A clean MQTT session needs to be created, if there is no session saved
-    * in this MQTT client. */
-    createCleanSession = ( *pClientSessionPresent == true ) ? false : true;
+    /* Each broker has its own session. Load the state of the one connected
+    * to, keeping the other's, and create a clean MQTT session if none was
+    * opened with this broker before. */
+    createCleanSession = ( EndpointPool_BindSession( &endpointPool, pMqttContext ) == true ) ? false : true;
 
     /* Establish MQTT session on top of TCP+TLS connection. */
     LogInfo( ( "Creating an MQTT connection to %.*s.",
@@ -1299,10 +1732,10 @@ int subscribePublishLoop( MQTTContext_t * pMqttContext,
         * of the demo, even if there are intermediate failures. */
         mqttSessionEstablished = true;
 
-        /* Update the flag to indicate that an MQTT client session is saved.
-        * Once this flag is set, MQTT connect in the following iterations of
-        * this demo will be attempted without requesting for a clean session. */
-        *pClientSessionPresent = true;
+        /* Record that an MQTT client session is saved with this broker.
+        * MQTT connect to it in the following iterations of this demo will
+        * be attempted without requesting for a clean session. */
+        EndpointPool_SessionOpened( &endpointPool );
 
         /* Check if session is present and if there are any outgoing publishes
         * that need to resend. This is only valid if the broker is
@@ -1318,11 +1751,12 @@ int subscribePublishLoop( MQTTContext_t * pMqttContext,
         else
         {
             LogInfo( ( "A clean MQTT connection is established."
-                    " Cleaning up all the stored outgoing publishes.\n\n" ) );
+                    " Cleaning up the outgoing publishes stored for this broker.\n\n" ) );
 
-            /* Clean up the outgoing publishes waiting for ack as this new
-            * connection doesn't re-establish an existing session. */
-            cleanupOutgoingPublishes();
+            /* Clean up the outgoing publishes waiting for ack from this
+            * broker as this new connection doesn't re-establish an existing
+            * session. The MQTT library has cleared their state already. */
+            ( void ) cleanupOutgoingPublishes( endpointPool.pActive );
         }
     }
 
@@ -1374,18 +1808,76 @@ int subscribePublishLoop( MQTTContext_t * pMqttContext,
 
     if( returnStatus == EXIT_SUCCESS )
     {
+        for( publishCount = 0; publishCount < payloadCount; publishCount++ )
+        {
+            assert( pPayloads[ publishCount ].length > 0 );
+            assert( pPayloads[ publishCount ].lane < MqttLaneCount );
+
+            pPayloads[ publishCount ].acknowledged = false;
+        }
+
         /* Publish messages with QOS1, receive incoming messages and
-        * send keep alive messages. */
-        for( publishCount = 0; publishCount < maxPublishCount; publishCount++ )
+        * send keep alive messages. Each round sends the oldest payload of
+        * the highest lane that has one and room for another publish. */
+        for( publishCount = 0; publishCount < payloadCount; publishCount++ )
         {
-            LogInfo( ( "Sending Publish to the MQTT topic %.*s.",
-                    usTopicFilterLength,
-                    pcTopicFilter ) );
+            readyMask = 0U;
+
+            for( lane = 0U; lane < MqttLaneCount; lane++ )
+            {
+                while( ( laneNext[ lane ] < payloadCount ) && ( pPayloads[ laneNext[ lane ] ].lane != lane ) )
+                {
+                    laneNext[ lane ]++;
+                }
+
+                if( laneNext[ lane ] < payloadCount )
+                {
+                    readyMask |= 1UL << lane;
+                }
+            }
+
+            lane = PublishLanes_Select( &publishLanes, readyMask );
+
+            if( ( lane == PUBLISH_LANE_NONE ) && releaseParkedSessions() )
+            {
+                /* Publishes awaiting a broker not in use give way to new
+                * ones. They were returned unacknowledged, so the caller
+                * retries them anyway. */
+                lane = PublishLanes_Select( &publishLanes, readyMask );
+            }
+
+            if( lane == PUBLISH_LANE_NONE )
+            {
+                /* Every lane with work is at its limit of publishes awaiting
+                * a PUBACK. Hold the rest back instead of failing the
+                * session; it is returned unacknowledged for the caller to
+                * retry. */
+                LogWarn( ( "Publish lanes full, holding back %u payloads.",
+                           ( unsigned ) ( payloadCount - publishCount ) ) );
+                break;
+            }
+
+            index = ( uint16_t ) laneNext[ lane ]++;
+
+            if( pPayloads[ index ].pTopic != NULL )
+            {
+                pcPublishTopic = pPayloads[ index ].pTopic;
+                usPublishTopicLength = pPayloads[ index ].topicLength;
+            }
+            else
+            {
+                pcPublishTopic = pcTopicFilter;
+                usPublishTopicLength = usTopicFilterLength;
+            }
+
+            LogInfo( ( "Sending Publish from lane %u to the MQTT topic %.*s.",
+                    ( unsigned ) lane,
+                    usPublishTopicLength,
+                    pcPublishTopic ) );
             returnStatus = publishToTopic( pMqttContext,
-                                        pcTopicFilter,
-                                        usTopicFilterLength,
-                                        pcPayload,
-                                        payloadLength );
+                                        pcPublishTopic,
+                                        usPublishTopicLength,
+                                        &pPayloads[ index ] );
 
             /* Calling MQTT_ProcessLoop to process incoming publish echo, since
             * application subscribed to the same topic the broker will send
@@ -1404,14 +1896,32 @@ int subscribePublishLoop( MQTTContext_t * pMqttContext,
                 returnStatus = EXIT_FAILURE;
                 break;
             }
+        }
 
-            LogInfo( ( "Delay before continuing to next iteration.\n\n" ) );
+        LogInfo( ( "Publish pool: %u of %u slots awaiting PUBACK (alarm %u, telemetry %u), high water %u.",
+                   ( unsigned ) ( PayloadPool_Capacity( &publishPool ) - PayloadPool_Available( &publishPool ) ),
+                   ( unsigned ) PayloadPool_Capacity( &publishPool ),
+                   ( unsigned ) PublishLanes_InFlight( &publishLanes, MqttLaneAlarm ),
+                   ( unsigned ) PublishLanes_InFlight( &publishLanes, MqttLaneTelemetry ),
+                   ( unsigned ) PayloadPool_HighWater( &publishPool ) ) );
+    }
 
-            /* Leave connection idle for some time. */
-            sleep( DELAY_BETWEEN_PUBLISHES_SECONDS );
-        }
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        LogInfo( ( "Delay before continuing to next iteration.\n\n" ) );
+
+        /* Leave connection idle for some time. */
+        sleep( DELAY_BETWEEN_PUBLISHES_SECONDS );
     }
 
+    #if CONFIG_CORE_MQTT_TRANSPORT_STATS
+        if( returnStatus == EXIT_SUCCESS )
+        {
+            /* Report how the transport behaved since the last report. */
+            returnStatus = publishTransportStats( pMqttContext );
+        }
+    #endif
+
     if( returnStatus == EXIT_SUCCESS )
     {
         /* Unsubscribe from the topic. */
@@ -1460,7 +1970,39 @@ int subscribePublishLoop( MQTTContext_t * pMqttContext,
     /* Reset global SUBACK status variable after completion of subscription request cycle. */
     globalSubAckStatus = MQTTSubAckFailure;
 
+    /* The caller reuses the payload descriptors; a PUBACK arriving later, for
+    * a resent publish, must not mark them. */
+    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        outgoingPublishPackets[ index ].pSource = NULL;
+    }
+
     return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
+
+#if CONFIG_FAULT_INJECTION_ENABLE
+
+void faultInjectionIterationDone( void )
+{
+    size_t scenarioCount;
+    const FaultTransportConfig_t * pScenarios = FaultTransport_Scenarios( &scenarioCount );
+
+    faultScenarioIterations++;
+
+    if( faultScenarioIterations >= CONFIG_FAULT_INJECTION_ITERATIONS_PER_SCENARIO )
+    {
+        FaultReport_Log( &faultReport, &faultTransport );
+
+        faultScenarioIndex = ( faultScenarioIndex + 1U ) % scenarioCount;
+        faultScenarioIterations = 0U;
+        ( void ) memset( &faultReport, 0x00, sizeof( faultReport ) );
+        FaultTransport_SetConfig( &faultTransport, &pScenarios[ faultScenarioIndex ] );
+
+        LogInfo( ( "Switching to fault scenario %s.", pScenarios[ faultScenarioIndex ].pName ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+#endif /* if CONFIG_FAULT_INJECTION_ENABLE */
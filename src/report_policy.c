@@ -0,0 +1,85 @@
+#include <stdlib.h>
+
+#include "report_policy.h"
+
+void report_policy_init(report_policy_t *policy, const report_policy_config_t *config)
+{
+    policy->config = *config;
+    policy->has_reported = false;
+    policy->evaluated = 0;
+    policy->reported = 0;
+}
+
+// True if value moved from reference past the absolute or the relative
+// deadband, whichever is crossed first
+static bool past_deadband(int16_t value, int16_t reference, int16_t absolute, uint16_t permille)
+{
+    int32_t change = abs((int32_t) value - reference);
+
+    if (absolute > 0 && change >= absolute) {
+        return true;
+    }
+    if (permille > 0 && change > 0 && change * 1000 >= (int32_t) permille * abs(reference)) {
+        return true;
+    }
+    // With both deadbands off, any change counts
+    return absolute <= 0 && permille == 0 && change > 0;
+}
+
+static report_reason_t classify(const report_policy_t *policy, const telemetry_reading_t *reading)
+{
+    const report_policy_config_t *config = &policy->config;
+    const telemetry_reading_t *last = &policy->last;
+
+    if (!policy->has_reported) {
+        return REPORT_FIRST;
+    }
+    if (reading->sensor_ok != last->sensor_ok ||
+        reading->quality != last->quality ||
+        reading->dimmer_ch1 != last->dimmer_ch1 ||
+        reading->dimmer_ch2 != last->dimmer_ch2 ||
+        reading->dimmer_enabled != last->dimmer_enabled) {
+        return REPORT_STATE;
+    }
+    if (reading->sensor_ok &&
+        (past_deadband(reading->temperature_tenths, last->temperature_tenths,
+                       config->temperature_deadband_tenths, config->relative_deadband_permille) ||
+         past_deadband(reading->humidity_tenths, last->humidity_tenths,
+                       config->humidity_deadband_tenths, config->relative_deadband_permille))) {
+        return REPORT_DEADBAND;
+    }
+    // Unsigned subtraction copes with the millisecond counter wrapping
+    if (reading->uptime_ms - last->uptime_ms >= config->heartbeat_ms) {
+        return REPORT_HEARTBEAT;
+    }
+    return REPORT_SKIP;
+}
+
+report_reason_t report_policy_evaluate(report_policy_t *policy, const telemetry_reading_t *reading)
+{
+    report_reason_t reason = classify(policy, reading);
+
+    policy->evaluated++;
+    if (reason != REPORT_SKIP) {
+        policy->last = *reading;
+        policy->has_reported = true;
+        policy->reported++;
+    }
+    return reason;
+}
+
+const char *report_reason_name(report_reason_t reason)
+{
+    switch (reason) {
+    case REPORT_FIRST:
+        return "first";
+    case REPORT_STATE:
+        return "state";
+    case REPORT_DEADBAND:
+        return "deadband";
+    case REPORT_HEARTBEAT:
+        return "heartbeat";
+    default:
+        return "skip";
+    }
+}
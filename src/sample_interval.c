@@ -0,0 +1,100 @@
+#include <stdlib.h>
+
+#include "sample_interval.h"
+
+// Steps of one tenth come and go on a steady signal with the DHT22, so they
+// are not counted as movement
+#define NOISE_TENTHS 1
+
+// Interval in which a signal moving at rate covers one tolerance
+static uint32_t interval_for(const sample_interval_config_t *config, uint32_t rate)
+{
+    uint32_t interval = rate > 0 ? 1000000U / rate : config->max_ms;
+
+    if (interval < config->min_ms) {
+        return config->min_ms;
+    }
+    if (interval > config->max_ms) {
+        return config->max_ms;
+    }
+    return interval;
+}
+
+// Rate at which value moved from previous over elapsed_ms, in thousandths of
+// tolerance per second
+static uint32_t rate_of(int16_t value, int16_t previous, int16_t tolerance, uint32_t elapsed_ms)
+{
+    int32_t change = abs((int32_t) value - previous) - NOISE_TENTHS;
+
+    if (change <= 0) {
+        return 0;
+    }
+    uint64_t rate = (uint64_t) change * 1000000U / ((uint64_t) tolerance * elapsed_ms);
+    return rate > UINT32_MAX ? UINT32_MAX : (uint32_t) rate;
+}
+
+void sample_interval_init(sample_interval_t *sampler, const sample_interval_config_t *config)
+{
+    sample_interval_config_t *own = &sampler->config;
+
+    *own = *config;
+    if (own->min_ms < SAMPLE_INTERVAL_FLOOR_MS) {
+        own->min_ms = SAMPLE_INTERVAL_FLOOR_MS;
+    }
+    if (own->max_ms < own->min_ms) {
+        own->max_ms = own->min_ms;
+    }
+    if (own->temperature_tolerance_tenths < 1) {
+        own->temperature_tolerance_tenths = 1;
+    }
+    if (own->humidity_tolerance_tenths < 1) {
+        own->humidity_tolerance_tenths = 1;
+    }
+    sampler->interval_ms = own->initial_ms < own->min_ms ? own->min_ms
+                         : own->initial_ms > own->max_ms ? own->max_ms
+                         : own->initial_ms;
+    sampler->rate = 0;
+    sampler->has_last = false;
+}
+
+uint32_t sample_interval_update(sample_interval_t *sampler, const telemetry_reading_t *reading)
+{
+    const sample_interval_config_t *config = &sampler->config;
+    const telemetry_reading_t *last = &sampler->last;
+
+    // A failed read says nothing about the signal; retry at the same pace
+    if (!reading->sensor_ok) {
+        return sampler->interval_ms;
+    }
+
+    if (sampler->has_last &&
+        (reading->dimmer_ch1 != last->dimmer_ch1 ||
+         reading->dimmer_ch2 != last->dimmer_ch2 ||
+         reading->dimmer_enabled != last->dimmer_enabled)) {
+        // Follow the response to the new power level closely, then let the
+        // rate decay from there
+        sampler->rate = 1000000U / config->min_ms;
+    } else if (sampler->has_last) {
+        // Unsigned subtraction copes with the millisecond counter wrapping
+        uint32_t elapsed_ms = reading->uptime_ms - last->uptime_ms;
+        if (elapsed_ms == 0) {
+            return sampler->interval_ms;
+        }
+        uint32_t temperature = rate_of(reading->temperature_tenths, last->temperature_tenths,
+                                       config->temperature_tolerance_tenths, elapsed_ms);
+        uint32_t humidity = rate_of(reading->humidity_tenths, last->humidity_tenths,
+                                    config->humidity_tolerance_tenths, elapsed_ms);
+        uint32_t rate = temperature > humidity ? temperature : humidity;
+
+        // Fast attack, slow decay: one quiet interval in a ramp does not
+        // stretch the interval all the way out
+        sampler->rate = rate >= sampler->rate ? rate : sampler->rate - (sampler->rate - rate) / 4;
+    }
+
+    if (sampler->has_last) {
+        sampler->interval_ms = interval_for(config, sampler->rate);
+    }
+    sampler->last = *reading;
+    sampler->has_last = true;
+    return sampler->interval_ms;
+}
@@ -0,0 +1,248 @@
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "telemetry.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "ts_block.h"
+#include "sensor_filter.h"
+
+#if CONFIG_TELEMETRY_FORMAT_CBOR
+static telemetry_format_t current_format = TELEMETRY_FORMAT_CBOR;
+#elif CONFIG_TELEMETRY_FORMAT_BLOCK
+static telemetry_format_t current_format = TELEMETRY_FORMAT_BLOCK;
+#else
+static telemetry_format_t current_format = TELEMETRY_FORMAT_JSON;
+#endif
+
+// Leading part of the JSON and CBOR documents, up to the first variable
+// field. The JSON writer is saved where the prefix ends so each payload can
+// carry on from there.
+static struct {
+    char json[TELEMETRY_PREFIX_SIZE];
+    JsonWriter_t json_writer;
+    uint8_t cbor[TELEMETRY_PREFIX_SIZE];
+    int cbor_length;            // -1 if the identity did not fit
+} prefix = { .json_writer = { .failed = true }, .cbor_length = -1 };
+
+void telemetry_set_identity(const char *hardware, const char *firmware, const char *client)
+{
+    CborWriter_t cbor;
+
+    // {"client":..,"status":"online","device":{"hardware":..,"firmware":..
+    JsonWriter_Init(&prefix.json_writer, prefix.json, sizeof(prefix.json));
+    JsonWriter_BeginObject(&prefix.json_writer, NULL);
+    JsonWriter_String(&prefix.json_writer, "client", client);
+    JsonWriter_String(&prefix.json_writer, "status", "online");
+    JsonWriter_BeginObject(&prefix.json_writer, "device");
+    JsonWriter_String(&prefix.json_writer, "hardware", hardware);
+    JsonWriter_String(&prefix.json_writer, "firmware", firmware);
+    // Keep a byte for the terminator a complete document would need
+    if (prefix.json_writer.length >= sizeof(prefix.json)) {
+        prefix.json_writer.failed = true;
+    }
+
+    CborWriter_Init(&cbor, prefix.cbor, sizeof(prefix.cbor));
+    CborWriter_Map(&cbor, 5);
+    CborWriter_Text(&cbor, "client");
+    CborWriter_Text(&cbor, client);
+    CborWriter_Text(&cbor, "status");
+    CborWriter_Text(&cbor, "online");
+    CborWriter_Text(&cbor, "device");
+    CborWriter_Map(&cbor, 4);
+    CborWriter_Text(&cbor, "hardware");
+    CborWriter_Text(&cbor, hardware);
+    CborWriter_Text(&cbor, "firmware");
+    CborWriter_Text(&cbor, firmware);
+    prefix.cbor_length = CborWriter_Finish(&cbor);
+}
+
+// Renders the fields after the prefix; buffer must already hold the prefix
+static int encode_json_suffix(const telemetry_reading_t *reading, char *buffer, size_t size)
+{
+    JsonWriter_t writer;
+
+    JsonWriter_Resume(&writer, &prefix.json_writer, buffer, size);
+    JsonWriter_Uint(&writer, "uptime", reading->uptime_ms);
+    JsonWriter_Uint(&writer, "interval", reading->interval_ms);
+    JsonWriter_EndObject(&writer);
+
+    // A failed read is reported as null rather than the last good value
+    JsonWriter_BeginObject(&writer, "sensors");
+    if (reading->sensor_ok) {
+        JsonWriter_Fixed(&writer, "temperature", reading->temperature_tenths, 1);
+        JsonWriter_Fixed(&writer, "humidity", reading->humidity_tenths, 1);
+    } else {
+        JsonWriter_Null(&writer, "temperature");
+        JsonWriter_Null(&writer, "humidity");
+    }
+    JsonWriter_String(&writer, "quality", SensorFilter_QualityName((SensorQuality_t) reading->quality));
+    JsonWriter_EndObject(&writer);
+
+    JsonWriter_BeginObject(&writer, "dimmer");
+    JsonWriter_Uint(&writer, "channel1", reading->dimmer_ch1);
+    JsonWriter_Uint(&writer, "channel2", reading->dimmer_ch2);
+    JsonWriter_Bool(&writer, "enabled", reading->dimmer_enabled);
+    JsonWriter_EndObject(&writer);
+
+    JsonWriter_EndObject(&writer);
+
+    return JsonWriter_Finish(&writer);
+}
+
+static int encode_cbor_suffix(const telemetry_reading_t *reading, uint8_t *buffer, size_t size)
+{
+    CborWriter_t writer;
+
+    CborWriter_Resume(&writer, buffer, size, (size_t) prefix.cbor_length);
+    CborWriter_Text(&writer, "uptime");
+    CborWriter_Uint(&writer, reading->uptime_ms);
+    CborWriter_Text(&writer, "interval");
+    CborWriter_Uint(&writer, reading->interval_ms);
+
+    CborWriter_Text(&writer, "sensors");
+    CborWriter_Map(&writer, 3);
+    CborWriter_Text(&writer, "temperature");
+    if (reading->sensor_ok) {
+        CborWriter_Decimal(&writer, reading->temperature_tenths, -1);
+    } else {
+        CborWriter_Null(&writer);
+    }
+    CborWriter_Text(&writer, "humidity");
+    if (reading->sensor_ok) {
+        CborWriter_Decimal(&writer, reading->humidity_tenths, -1);
+    } else {
+        CborWriter_Null(&writer);
+    }
+    CborWriter_Text(&writer, "quality");
+    CborWriter_Text(&writer, SensorFilter_QualityName((SensorQuality_t) reading->quality));
+
+    CborWriter_Text(&writer, "dimmer");
+    CborWriter_Map(&writer, 3);
+    CborWriter_Text(&writer, "channel1");
+    CborWriter_Uint(&writer, reading->dimmer_ch1);
+    CborWriter_Text(&writer, "channel2");
+    CborWriter_Uint(&writer, reading->dimmer_ch2);
+    CborWriter_Text(&writer, "enabled");
+    CborWriter_Bool(&writer, reading->dimmer_enabled);
+
+    return CborWriter_Finish(&writer);
+}
+
+// Copies the prefix of format into buffer. Returns false if it does not fit
+// or the identity could not be rendered.
+static bool copy_prefix(telemetry_format_t format, char *buffer, size_t size)
+{
+    if (format == TELEMETRY_FORMAT_CBOR) {
+        if (prefix.cbor_length < 0 || (size_t) prefix.cbor_length > size) {
+            return false;
+        }
+        memcpy(buffer, prefix.cbor, (size_t) prefix.cbor_length);
+        return true;
+    }
+    if (prefix.json_writer.failed || prefix.json_writer.length >= size) {
+        return false;
+    }
+    memcpy(buffer, prefix.json, prefix.json_writer.length);
+    return true;
+}
+
+int telemetry_encode_json(const telemetry_reading_t *reading, char *buffer, size_t size)
+{
+    if (!copy_prefix(TELEMETRY_FORMAT_JSON, buffer, size)) {
+        return -1;
+    }
+    return encode_json_suffix(reading, buffer, size);
+}
+
+int telemetry_encode_cbor(const telemetry_reading_t *reading, uint8_t *buffer, size_t size)
+{
+    if (!copy_prefix(TELEMETRY_FORMAT_CBOR, (char *) buffer, size)) {
+        return -1;
+    }
+    return encode_cbor_suffix(reading, buffer, size);
+}
+
+int telemetry_encode_block(const telemetry_reading_t *readings, size_t count,
+                           uint8_t *buffer, size_t size, size_t *taken)
+{
+    TsBlockEncoder_t encoder;
+    int32_t values[TELEMETRY_BLOCK_CHANNELS];
+    size_t i;
+
+    TsBlock_EncoderInit(&encoder, buffer, size, TELEMETRY_BLOCK_CHANNELS);
+    for (i = 0; i < count; i++) {
+        values[0] = readings[i].temperature_tenths;
+        values[1] = readings[i].humidity_tenths;
+        values[2] = readings[i].dimmer_ch1;
+        values[3] = readings[i].dimmer_ch2;
+        values[4] = (readings[i].sensor_ok ? 1 : 0) | (readings[i].dimmer_enabled ? 2 : 0) |
+                    ((readings[i].quality & 3) << 2);
+        if (!TsBlock_Append(&encoder, readings[i].uptime_ms, values)) {
+            break;
+        }
+    }
+
+    *taken = i;
+    return i > 0 ? TsBlock_EncoderFinish(&encoder) : -1;
+}
+
+void telemetry_set_format(telemetry_format_t format)
+{
+    current_format = format;
+}
+
+telemetry_format_t telemetry_get_format(void)
+{
+    return current_format;
+}
+
+int telemetry_encode(const telemetry_reading_t *reading, char *buffer, size_t size)
+{
+    size_t taken;
+
+    if (current_format == TELEMETRY_FORMAT_CBOR) {
+        return telemetry_encode_cbor(reading, (uint8_t *) buffer, size);
+    }
+    if (current_format == TELEMETRY_FORMAT_BLOCK) {
+        return telemetry_encode_block(reading, 1, (uint8_t *) buffer, size, &taken);
+    }
+    return telemetry_encode_json(reading, buffer, size);
+}
+
+void telemetry_composer_init(telemetry_composer_t *composer, char *buffer, size_t size)
+{
+    composer->buffer = buffer;
+    composer->size = size;
+    composer->primed = -1;
+}
+
+int telemetry_compose(telemetry_composer_t *composer, const telemetry_reading_t *reading,
+                      telemetry_format_t format)
+{
+    int length;
+
+    if (composer->primed != (int) format) {
+        if (!copy_prefix(format, composer->buffer, composer->size)) {
+            composer->primed = -1;
+            return -1;
+        }
+        composer->primed = (int) format;
+    }
+
+    if (format == TELEMETRY_FORMAT_CBOR) {
+        length = encode_cbor_suffix(reading, (uint8_t *) composer->buffer, composer->size);
+    } else {
+        length = encode_json_suffix(reading, composer->buffer, composer->size);
+    }
+    // A JSON overflow clears the buffer, prefix included
+    if (length < 0) {
+        composer->primed = -1;
+    }
+    return length;
+}
+
+void telemetry_composer_reset(telemetry_composer_t *composer)
+{
+    composer->primed = -1;
+}
@@ -0,0 +1,55 @@
+/*
+    Helpers shared by the host tests: checks that report the failed
+    expression and let the test run on, and a clock for benchmarks. Each
+    test is a single source file that returns host_test_result() from main.
+*/
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int host_test_failures;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            host_test_failures++;                                                     \
+        }                                                                             \
+    } while (0)
+
+// Exit status for main
+static inline int host_test_result(void)
+{
+    if (host_test_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", host_test_failures);
+        return 1;
+    }
+    return 0;
+}
+
+// Monotonic host time in nanoseconds
+static inline uint64_t host_test_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+// Small deterministic generator, so every run sees the same data
+static inline uint32_t host_test_random(uint32_t *state)
+{
+    uint32_t x = *state ? *state : 1;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+    Stand-in for the ESP-IDF GPIO driver: configuration and level calls are
+    accepted and do nothing.
+*/
+
+#ifndef DRIVER_GPIO_H_
+#define DRIVER_GPIO_H_
+
+#include <stdint.h>
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_4 4
+#define GPIO_NUM_5 5
+
+enum {
+    GPIO_INTR_DISABLE,
+    GPIO_INTR_POSEDGE,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+    GPIO_PULLDOWN_DISABLE,
+    GPIO_PULLUP_DISABLE,
+    GPIO_PULLUP_ENABLE,
+};
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    int mode;
+    int pull_up_en;
+    int pull_down_en;
+    int intr_type;
+} gpio_config_t;
+
+static inline int gpio_config(const gpio_config_t *config)
+{
+    (void) config;
+    return 0;
+}
+
+static inline int gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    (void) gpio;
+    (void) level;
+    return 0;
+}
+
+static inline int gpio_install_isr_service(int flags)
+{
+    (void) flags;
+    return 0;
+}
+
+static inline int gpio_isr_handler_add(gpio_num_t gpio, void (*handler)(void *arg), void *arg)
+{
+    (void) gpio;
+    (void) handler;
+    (void) arg;
+    return 0;
+}
+
+static inline void esp_rom_delay_us(uint32_t us)
+{
+    (void) us;
+}
+
+#endif
@@ -0,0 +1 @@
+/* Empty: the application modules the host tests build use no timer group calls. */
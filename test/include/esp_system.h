@@ -0,0 +1,14 @@
+/*
+    Stand-in for the ESP-IDF system calls the network transport logs heap
+    use with; the test defines them.
+*/
+
+#ifndef ESP_SYSTEM_H_
+#define ESP_SYSTEM_H_
+
+#include <stdint.h>
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+    Stand-in for esp-tls, as much of it as the network transport uses. The
+    test defines the calls and plays the connection behind them.
+*/
+
+#ifndef ESP_TLS_H_
+#define ESP_TLS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "mbedtls/ssl.h"
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED 0x8010
+
+#define ESP_TLS_ERR_SSL_WANT_READ MBEDTLS_ERR_SSL_WANT_READ
+#define ESP_TLS_ERR_SSL_WANT_WRITE MBEDTLS_ERR_SSL_WANT_WRITE
+
+typedef struct esp_tls_last_error *esp_tls_error_handle_t;
+
+typedef struct {
+    esp_tls_error_handle_t error_handle;
+} esp_tls_t;
+
+typedef struct {
+    const char **alpn_protos;
+    const unsigned char *cacert_buf;
+    unsigned int cacert_bytes;
+    const unsigned char *clientcert_buf;
+    unsigned int clientcert_bytes;
+    const unsigned char *clientkey_buf;
+    unsigned int clientkey_bytes;
+    int timeout_ms;
+    bool use_secure_element;
+    void *ds_data;
+    bool skip_common_name;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+} esp_tls_cfg_t;
+
+esp_tls_t *esp_tls_init(void);
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+int esp_tls_conn_destroy(esp_tls_t *tls);
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen);
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen);
+esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t h, int *esp_tls_code, int *esp_tls_flags);
+mbedtls_ssl_context *esp_tls_get_ssl_context(esp_tls_t *tls);
+
+#endif
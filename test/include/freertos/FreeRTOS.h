@@ -0,0 +1,24 @@
+/*
+    Stand-in for the FreeRTOS headers, for application modules that include
+    them but whose tested code makes no kernel calls. The semaphores of
+    semphr.h are no-ops for the network transport, whose test runs it on
+    one thread.
+*/
+
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IRAM_ATTR
+
+typedef long BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t) 0)
+#define pdTRUE ((BaseType_t) 1)
+#define portMAX_DELAY ((TickType_t) UINT32_MAX)
+
+#endif
@@ -0,0 +1 @@
+/* Empty: see FreeRTOS.h in this directory. */
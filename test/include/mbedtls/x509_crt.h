@@ -0,0 +1 @@
+/* Empty: see ssl.h in this directory. */
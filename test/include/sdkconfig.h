@@ -0,0 +1,18 @@
+/*
+    Stand-in for the sdkconfig.h ESP-IDF generates, for the application
+    modules and coreMQTT the host tests build. Defaults as in
+    Kconfig.projbuild and the coreMQTT Kconfig.
+*/
+
+#ifndef SDKCONFIG_H_
+#define SDKCONFIG_H_
+
+#define CONFIG_TELEMETRY_FORMAT_JSON 1
+
+#define CONFIG_MQTT_STATE_ARRAY_MAX_COUNT 10
+#define CONFIG_MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT 5
+#define CONFIG_MQTT_PINGRESP_TIMEOUT_MS 5000
+#define CONFIG_MQTT_RECV_POLLING_TIMEOUT_MS 10
+#define CONFIG_MQTT_SEND_RETRY_TIMEOUT_MS 10
+
+#endif
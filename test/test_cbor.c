@@ -0,0 +1,442 @@
+/*
+    CBOR and time-series block payloads against the JSON document they
+    stand for: a valid reading, a sensor failure and a block of readings
+    are decoded and compared field for field with the JSON encoding of the
+    same readings, and the size and encode time of each format printed.
+
+    Also writes cbor_<case>.cbor and cbor_<case>.json next to the test, for
+    the tools/cbor_decode.py --check tests registered after this one.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "sensor_filter.h"
+#include "telemetry.h"
+#include "ts_block.h"
+
+#define MAX_FIELDS 32
+#define BLOCK_READINGS 12
+#define ENCODES 1000000
+
+// One leaf of a document: its path from the root, e.g. sensors.humidity,
+// and its value as "string", #tenths for numbers, true, false or null
+typedef struct {
+    char path[48];
+    char value[48];
+} field_t;
+
+typedef struct {
+    field_t fields[MAX_FIELDS];
+    int count;
+    bool failed;
+} document_t;
+
+static volatile int sink;
+
+static void add_field(document_t *doc, const char *path, const char *value)
+{
+    if (doc->count == MAX_FIELDS) {
+        doc->failed = true;
+        return;
+    }
+    snprintf(doc->fields[doc->count].path, sizeof(doc->fields[0].path), "%s", path);
+    snprintf(doc->fields[doc->count].value, sizeof(doc->fields[0].value), "%s", value);
+    doc->count++;
+}
+
+static const char *find_field(const document_t *doc, const char *path)
+{
+    for (int i = 0; i < doc->count; i++) {
+        if (strcmp(doc->fields[i].path, path) == 0) {
+            return doc->fields[i].value;
+        }
+    }
+    return NULL;
+}
+
+static void join(char *path, size_t size, const char *parent, const char *key)
+{
+    snprintf(path, size, "%s%s%s", parent, *parent ? "." : "", key);
+}
+
+// CBOR, the subset cbor_writer produces
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t pos;
+} cbor_t;
+
+static bool cbor_head(cbor_t *c, uint8_t *major, uint64_t *argument)
+{
+    static const uint8_t sizes[4] = { 1, 2, 4, 8 };
+    uint8_t info;
+
+    if (c->pos >= c->length) {
+        return false;
+    }
+    *major = c->data[c->pos] >> 5;
+    info = c->data[c->pos++] & 0x1fu;
+    if (info < 24 || *major == 7) {
+        *argument = info;
+        return true;
+    }
+    if (info > 27 || c->pos + sizes[info - 24] > c->length) {
+        return false;
+    }
+    *argument = 0;
+    for (uint8_t i = 0; i < sizes[info - 24]; i++) {
+        *argument = *argument << 8 | c->data[c->pos++];
+    }
+    return true;
+}
+
+static bool cbor_text(cbor_t *c, char *text, size_t size)
+{
+    uint8_t major;
+    uint64_t length;
+
+    if (!cbor_head(c, &major, &length) || major != 3 || length >= size || c->pos + length > c->length) {
+        return false;
+    }
+    memcpy(text, &c->data[c->pos], (size_t) length);
+    text[length] = '\0';
+    c->pos += (size_t) length;
+    return true;
+}
+
+static bool cbor_integer(cbor_t *c, long long *value)
+{
+    uint8_t major;
+    uint64_t argument;
+
+    if (!cbor_head(c, &major, &argument) || major > 1) {
+        return false;
+    }
+    *value = major == 0 ? (long long) argument : -1 - (long long) argument;
+    return true;
+}
+
+static bool cbor_item(cbor_t *c, const char *path, document_t *doc)
+{
+    char text[48], child[48], string[40];
+    uint8_t major;
+    uint64_t argument;
+    long long exponent, mantissa;
+
+    if (!cbor_head(c, &major, &argument)) {
+        return false;
+    }
+    switch (major) {
+    case 0:
+    case 1:
+        snprintf(text, sizeof(text), "#%lld", (major == 0 ? (long long) argument : -1 - (long long) argument) * 10);
+        add_field(doc, path, text);
+        return true;
+    case 3:
+        c->pos--;
+        if (!cbor_text(c, string, sizeof(string))) {
+            return false;
+        }
+        snprintf(text, sizeof(text), "\"%s\"", string);
+        add_field(doc, path, text);
+        return true;
+    case 5:
+        for (uint64_t i = 0; i < argument; i++) {
+            char key[32];
+            if (!cbor_text(c, key, sizeof(key))) {
+                return false;
+            }
+            join(child, sizeof(child), path, key);
+            if (!cbor_item(c, child, doc)) {
+                return false;
+            }
+        }
+        return true;
+    case 6:
+        // Decimal fraction [exponent, mantissa], here always in tenths
+        if (argument != 4 || !cbor_head(c, &major, &argument) || major != 4 || argument != 2 ||
+            !cbor_integer(c, &exponent) || !cbor_integer(c, &mantissa) || exponent != -1) {
+            return false;
+        }
+        snprintf(text, sizeof(text), "#%lld", mantissa);
+        add_field(doc, path, text);
+        return true;
+    case 7:
+        add_field(doc, path, argument == 20 ? "false" : argument == 21 ? "true" : argument == 22 ? "null" : "?");
+        return argument >= 20 && argument <= 22;
+    default:
+        return false;
+    }
+}
+
+static bool cbor_flatten(const uint8_t *data, size_t length, document_t *doc)
+{
+    cbor_t c = { data, length, 0 };
+
+    *doc = (document_t) { 0 };
+    return cbor_item(&c, "", doc) && c.pos == length && !doc->failed;
+}
+
+// JSON, the subset json_writer produces for telemetry
+
+static bool json_item(const char **p, const char *path, document_t *doc);
+
+static bool json_string(const char **p, char *text, size_t size)
+{
+    size_t n = 0;
+
+    if (**p != '"') {
+        return false;
+    }
+    for ((*p)++; **p != '"'; (*p)++) {
+        if (**p == '\0' || n + 1 >= size) {
+            return false;
+        }
+        if (**p == '\\') {
+            (*p)++;
+        }
+        text[n++] = **p;
+    }
+    (*p)++;
+    text[n] = '\0';
+    return true;
+}
+
+static bool json_item(const char **p, const char *path, document_t *doc)
+{
+    char text[48], child[48], string[40];
+
+    if (**p == '{') {
+        (*p)++;
+        while (**p != '}') {
+            char key[32];
+            if (!json_string(p, key, sizeof(key)) || *(*p)++ != ':') {
+                return false;
+            }
+            join(child, sizeof(child), path, key);
+            if (!json_item(p, child, doc)) {
+                return false;
+            }
+            if (**p == ',') {
+                (*p)++;
+            }
+        }
+        (*p)++;
+        return true;
+    }
+    if (**p == '"') {
+        if (!json_string(p, string, sizeof(string))) {
+            return false;
+        }
+        snprintf(text, sizeof(text), "\"%s\"", string);
+        add_field(doc, path, text);
+        return true;
+    }
+    for (const char *literal = "true\0false\0null\0"; *literal; literal += strlen(literal) + 1) {
+        if (strncmp(*p, literal, strlen(literal)) == 0) {
+            *p += strlen(literal);
+            add_field(doc, path, literal);
+            return true;
+        }
+    }
+
+    // A number with at most one decimal, kept in tenths
+    char *end;
+    long long whole = strtoll(*p, &end, 10);
+    long long tenths = whole * 10;
+    if (end == *p) {
+        return false;
+    }
+    if (*end == '.') {
+        if (end[1] < '0' || end[1] > '9' || (end[2] >= '0' && end[2] <= '9')) {
+            return false;
+        }
+        tenths += (**p == '-' ? -1 : 1) * (end[1] - '0');
+        end += 2;
+    }
+    *p = end;
+    snprintf(text, sizeof(text), "#%lld", tenths);
+    add_field(doc, path, text);
+    return true;
+}
+
+static bool json_flatten(const char *text, document_t *doc)
+{
+    *doc = (document_t) { 0 };
+    return json_item(&text, "", doc) && *text == '\0' && !doc->failed;
+}
+
+// Every field of a must be in b with the same value, and the other way round
+static int field_mismatches(const document_t *a, const document_t *b)
+{
+    int mismatches = a->count == b->count ? 0 : 1;
+
+    for (int i = 0; i < a->count; i++) {
+        const char *value = find_field(b, a->fields[i].path);
+        if (value == NULL || strcmp(value, a->fields[i].value) != 0) {
+            fprintf(stderr, "  %s: %s against %s\n", a->fields[i].path, a->fields[i].value, value ? value : "(missing)");
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static void write_file(const char *name, const void *data, size_t length)
+{
+    FILE *file = fopen(name, "wb");
+
+    CHECK(file != NULL);
+    if (file != NULL) {
+        CHECK(fwrite(data, 1, length, file) == length);
+        fclose(file);
+    }
+}
+
+static void single(const char *name, const telemetry_reading_t *reading)
+{
+    char json[TELEMETRY_PAYLOAD_SIZE];
+    uint8_t cbor[TELEMETRY_PAYLOAD_SIZE];
+    document_t from_json, from_cbor;
+    char file[32];
+
+    int json_length = telemetry_encode_json(reading, json, sizeof(json));
+    int cbor_length = telemetry_encode_cbor(reading, cbor, sizeof(cbor));
+    CHECK(json_length > 0 && cbor_length > 0);
+    if (json_length <= 0 || cbor_length <= 0) {
+        return;
+    }
+    CHECK(json_flatten(json, &from_json));
+    CHECK(cbor_flatten(cbor, (size_t) cbor_length, &from_cbor));
+
+    int mismatches = field_mismatches(&from_json, &from_cbor);
+    printf("  %-14s %2d fields, %d differ; JSON %3d B, CBOR %3d B\n",
+           name, from_json.count, mismatches, json_length, cbor_length);
+    CHECK(from_json.count == 12);
+    CHECK(mismatches == 0);
+
+    snprintf(file, sizeof(file), "cbor_%s.cbor", name);
+    write_file(file, cbor, (size_t) cbor_length);
+    snprintf(file, sizeof(file), "cbor_%s.json", name);
+    write_file(file, json, (size_t) json_length);
+}
+
+// The block carries the readings' time, sensor and dimmer fields only
+static void block(const telemetry_reading_t *readings, size_t count)
+{
+    uint8_t buffer[TELEMETRY_PAYLOAD_SIZE];
+    TsBlockDecoder_t decoder;
+    uint32_t timestamp;
+    int32_t values[TELEMETRY_BLOCK_CHANNELS];
+    size_t taken = 0, decoded = 0;
+    int mismatches = 0, json_bytes = 0;
+
+    int length = telemetry_encode_block(readings, count, buffer, sizeof(buffer), &taken);
+    CHECK(length > 0 && taken == count);
+    CHECK(length > 0 && TsBlock_DecoderInit(&decoder, buffer, (size_t) length));
+    if (length <= 0) {
+        return;
+    }
+
+    while (decoded < taken && TsBlock_Next(&decoder, &timestamp, values)) {
+        char json[TELEMETRY_PAYLOAD_SIZE], text[48];
+        document_t from_json, from_block = { 0 };
+        bool sensor_ok = values[4] & 1;
+
+        json_bytes += telemetry_encode_json(&readings[decoded], json, sizeof(json));
+        CHECK(json_flatten(json, &from_json));
+
+        snprintf(text, sizeof(text), "#%lld", (long long) timestamp * 10);
+        add_field(&from_block, "device.uptime", text);
+        snprintf(text, sizeof(text), "#%d", (int) values[0]);
+        add_field(&from_block, "sensors.temperature", sensor_ok ? text : "null");
+        snprintf(text, sizeof(text), "#%d", (int) values[1]);
+        add_field(&from_block, "sensors.humidity", sensor_ok ? text : "null");
+        snprintf(text, sizeof(text), "\"%s\"", SensorFilter_QualityName((SensorQuality_t) ((values[4] >> 2) & 3)));
+        add_field(&from_block, "sensors.quality", text);
+        snprintf(text, sizeof(text), "#%d", (int) values[2] * 10);
+        add_field(&from_block, "dimmer.channel1", text);
+        snprintf(text, sizeof(text), "#%d", (int) values[3] * 10);
+        add_field(&from_block, "dimmer.channel2", text);
+        add_field(&from_block, "dimmer.enabled", values[4] & 2 ? "true" : "false");
+
+        for (int i = 0; i < from_block.count; i++) {
+            const char *value = find_field(&from_json, from_block.fields[i].path);
+            if (value == NULL || strcmp(value, from_block.fields[i].value) != 0) {
+                fprintf(stderr, "  reading %zu %s: %s in the block, %s in JSON\n", decoded,
+                        from_block.fields[i].path, from_block.fields[i].value, value ? value : "(missing)");
+                mismatches++;
+            }
+        }
+        decoded++;
+    }
+
+    printf("  block          %zu readings, %d fields differ; %d B against %d B as JSON payloads\n",
+           decoded, mismatches, length, json_bytes);
+    CHECK(decoded == count);
+    CHECK(mismatches == 0);
+}
+
+static void encode_time(const telemetry_reading_t *reading)
+{
+    char json[TELEMETRY_PAYLOAD_SIZE];
+    uint8_t cbor[TELEMETRY_PAYLOAD_SIZE];
+
+    uint64_t start = host_test_ns();
+    for (int i = 0; i < ENCODES; i++) {
+        sink += telemetry_encode_json(reading, json, sizeof(json));
+    }
+    uint64_t json_ns = host_test_ns() - start;
+
+    start = host_test_ns();
+    for (int i = 0; i < ENCODES; i++) {
+        sink += telemetry_encode_cbor(reading, cbor, sizeof(cbor));
+    }
+    uint64_t cbor_ns = host_test_ns() - start;
+
+    printf("  encode: JSON %.0f ns, CBOR %.0f ns per reading\n",
+           (double) json_ns / ENCODES, (double) cbor_ns / ENCODES);
+}
+
+int main(void)
+{
+    telemetry_reading_t valid = {
+        .uptime_ms = 86400123,
+        .interval_ms = 5000,
+        .sensor_ok = true,
+        .temperature_tenths = -57,
+        .humidity_tenths = 497,
+        .quality = SensorQualityFiltered,
+        .dimmer_ch1 = 35,
+        .dimmer_ch2 = 100,
+        .dimmer_enabled = true,
+    };
+    telemetry_reading_t failed = {
+        .uptime_ms = 4000000000u,
+        .interval_ms = 60000,
+        .sensor_ok = false,
+        .quality = SensorQualityFailed,
+    };
+    telemetry_reading_t readings[BLOCK_READINGS];
+
+    for (int i = 0; i < BLOCK_READINGS; i++) {
+        readings[i] = valid;
+        readings[i].uptime_ms += (uint32_t) i * 5000;
+        readings[i].temperature_tenths = (int16_t) (-20 + 7 * i);
+        readings[i].humidity_tenths = (int16_t) (497 - 3 * i);
+        readings[i].quality = (uint8_t) (i % (SensorQualityFailed + 1));
+        readings[i].sensor_ok = readings[i].quality != SensorQualityFailed;
+        readings[i].dimmer_ch1 = (uint8_t) (i * 9);
+        readings[i].dimmer_enabled = i % 3 != 0;
+    }
+
+    telemetry_set_identity("24:0a:c4:12:34:56", "v4.4.4", "esp32-dht22-01");
+    puts("Payloads decoded and compared with the JSON document:");
+    single("valid", &valid);
+    single("failed", &failed);
+    block(readings, BLOCK_READINGS);
+    encode_time(&valid);
+    return host_test_result();
+}
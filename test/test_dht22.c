@@ -0,0 +1,233 @@
+/*
+    DHT22 driver against the simulated bus: decode accuracy and CPU time
+    per read over pulse jitter, off-nominal bit timings and lost edges, the
+    decoder on malformed frames, and the read schedule of several sensors on
+    one bus.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dht.h"
+#include "dht22_decode.h"
+#include "host_test.h"
+
+#define READS 20000
+
+typedef struct {
+    const char *name;
+    uint32_t jitter_us;
+    uint16_t zero_high_us;
+    uint16_t one_high_us;
+    uint16_t drop_permille;
+    bool exact;                     // Every read must decode to the truth
+    bool no_wrong;                  // Reads may fail, but never decode wrong
+} accuracy_case_t;
+
+static const accuracy_case_t accuracy_cases[] = {
+    { "nominal", 0, 0, 0, 0, true, true },
+    { "jitter 10 us", 10, 0, 0, 0, true, true },
+    { "jitter 20 us", 20, 0, 0, 0, true, true },
+    { "jitter 25 us", 25, 0, 0, 0, false, false },
+    { "slow part (0: 35 us, 1: 80 us)", 5, 35, 80, 0, true, true },
+    { "fast part (0: 20 us, 1: 55 us)", 5, 20, 55, 0, true, true },
+    { "0.1% of edges lost", 5, 0, 0, 1, false, true },
+    { "1% of edges lost", 5, 0, 0, 10, false, true },
+};
+
+static void accuracy(const accuracy_case_t *c)
+{
+    dht_sim_sensor_t sensor = {
+        .gpio = 4,
+        .jitter_us = c->jitter_us,
+        .zero_high_us = c->zero_high_us,
+        .one_high_us = c->one_high_us,
+        .drop_permille = c->drop_permille,
+    };
+    dht_sim_t sim = { .sensors = &sensor, .count = 1, .seed = 7 };
+    dht_bus_t bus;
+    dht_handle_t dht;
+    int ok = 0, wrong = 0, checksum = 0, timeout = 0;
+    uint64_t spent_ns = 0;
+
+    dht_bus_sim_init(&bus, &sim);
+    dht_init(&dht, 4, &bus);
+    for (int i = 0; i < READS; i++) {
+        sensor.temperature_tenths = (int16_t) (-100 + i % 700);
+        sensor.humidity_tenths = (int16_t) (i % 1001);
+        sim.now_ms += DHT_MIN_INTERVAL_MS;
+
+        uint64_t start = host_test_ns();
+        int status = dht_read(&dht);
+        spent_ns += host_test_ns() - start;
+
+        if (status == DHT_OK) {
+            ok++;
+            if (dht.temperature_tenths != sensor.temperature_tenths ||
+                dht.humidity_tenths != sensor.humidity_tenths) {
+                wrong++;
+            }
+        } else if (status == DHT_CHECKSUM_ERROR) {
+            checksum++;
+        } else {
+            timeout++;
+        }
+    }
+
+    printf("  %-32s ok %6.2f%%  checksum %5.2f%%  timeout %5.2f%%  wrong values %4d  %.2f us/read\n",
+           c->name, 100.0 * ok / READS, 100.0 * checksum / READS, 100.0 * timeout / READS,
+           wrong, spent_ns / 1000.0 / READS);
+    CHECK(ok + checksum + timeout == READS);
+    if (c->exact) {
+        CHECK(ok == READS);
+    }
+    if (c->no_wrong) {
+        CHECK(wrong == 0);
+    }
+}
+
+// A frame as the sensor sends it, datasheet example: 65.2 %RH, 35.1 C.
+// With response false the response pulses are left out.
+static size_t build_frame(Dht22Edge_t *edges, bool response, int bits)
+{
+    static const uint8_t data[DHT22_DATA_BYTES] = { 0x02, 0x8c, 0x01, 0x5f, 0xee };
+    uint32_t t = UINT32_MAX - 1000;     // crosses the timer wrap
+    size_t n = 0;
+
+    edges[n++] = (Dht22Edge_t) { t, 1 };
+    t += 30;
+    if (response) {
+        edges[n++] = (Dht22Edge_t) { t, 0 };
+        t += 80;
+        edges[n++] = (Dht22Edge_t) { t, 1 };
+        t += 80;
+    }
+    for (int b = 0; b < bits; b++) {
+        edges[n++] = (Dht22Edge_t) { t, 0 };
+        t += 50;
+        edges[n++] = (Dht22Edge_t) { t, 1 };
+        t += (data[(b % 40) / 8] & (0x80 >> (b % 8))) ? 70 : 27;
+    }
+    edges[n++] = (Dht22Edge_t) { t, 0 };
+    t += 50;
+    edges[n++] = (Dht22Edge_t) { t, 1 };
+    return n;
+}
+
+static void malformed(void)
+{
+    Dht22Edge_t edges[DHT22_MAX_EDGES + 4];
+    uint8_t data[DHT22_DATA_BYTES];
+    size_t n;
+
+    n = build_frame(edges, true, 40);
+    CHECK(Dht22_DecodeEdges(edges, n, data) == Dht22DecodeSuccess);
+    CHECK(Dht22_HumidityTenths(data) == 652 && Dht22_TemperatureTenths(data) == 351);
+
+    // Without the response pulse the first 1 bit must not pass for it
+    n = build_frame(edges, false, 40);
+    CHECK(Dht22_DecodeEdges(edges, n, data) != Dht22DecodeSuccess);
+    CHECK(Dht22_DecodeEdges(edges, 0, data) == Dht22DecodeTooFewBits);
+
+    // One bit short, one bit over, cut off before the last bit
+    n = build_frame(edges, true, 39);
+    CHECK(Dht22_DecodeEdges(edges, n, data) == Dht22DecodeBadTiming);
+    n = build_frame(edges, true, 41);
+    CHECK(Dht22_DecodeEdges(edges, n, data) == Dht22DecodeBadTiming);
+    n = build_frame(edges, true, 40);
+    CHECK(Dht22_DecodeEdges(edges, n - 4, data) == Dht22DecodeBadTiming);
+
+    // A lost falling edge merges two bits into one long pulse; a lost
+    // rising edge leaves two lows in a row
+    n = build_frame(edges, true, 40);
+    memmove(&edges[20], &edges[21], (n - 21) * sizeof(edges[0]));
+    CHECK(Dht22_DecodeEdges(edges, n - 1, data) == Dht22DecodeBadTiming);
+    n = build_frame(edges, true, 40);
+    memmove(&edges[21], &edges[22], (n - 22) * sizeof(edges[0]));
+    CHECK(Dht22_DecodeEdges(edges, n - 1, data) == Dht22DecodeBadTiming);
+
+    // Bit 38, a 1, cut to 30 us reads as a 0
+    n = build_frame(edges, true, 40);
+    edges[n - 4].timeUs -= 40;
+    CHECK(Dht22_DecodeEdges(edges, n, data) == Dht22DecodeBadChecksum);
+    printf("  short, long, cut-off, merged and split frames rejected\n");
+}
+
+// Five sensors on one bus for a simulated hour, one of them absent and the
+// caller stalling now and then: no sensor is started too soon, and every
+// present one decodes its current value
+static void schedule(void)
+{
+    dht_sim_sensor_t sensors[5];
+    dht_handle_t handles[5];
+    dht_sim_t sim = { .sensors = sensors, .count = 5, .now_ms = UINT32_MAX - 600000, .seed = 11 };
+    dht_bus_t bus;
+    dht_schedule_t schedule;
+    uint32_t last_read_ms[5] = { 0 };
+    bool read_before[5] = { false };
+    uint32_t end_ms = sim.now_ms + 3600000;
+    uint32_t reads = 0, mismatches = 0, too_close = 0;
+
+    dht_bus_sim_init(&bus, &sim);
+    for (int i = 0; i < 5; i++) {
+        sensors[i] = (dht_sim_sensor_t) { .gpio = 20 + i, .jitter_us = 15, .absent = i == 3 };
+        dht_init(&handles[i], 20 + i, &bus);
+    }
+    dht_schedule_init(&schedule, handles, 5, 10000);
+
+    while ((int32_t) (end_ms - sim.now_ms) > 0) {
+        uint32_t wait_ms;
+        dht_handle_t *due = dht_schedule_due(&schedule, sim.now_ms, &wait_ms);
+
+        if (due == NULL) {
+            sim.now_ms += wait_ms;
+            continue;
+        }
+        int index = (int) (due - handles);
+        sensors[index].temperature_tenths = (int16_t) (reads % 500);
+        sensors[index].humidity_tenths = (int16_t) (reads % 1000);
+        if (read_before[index] && sim.now_ms - last_read_ms[index] < DHT_MIN_INTERVAL_MS) {
+            too_close++;
+        }
+        read_before[index] = true;
+        last_read_ms[index] = sim.now_ms;
+        if (dht_read(due) == DHT_OK &&
+            (due->temperature_tenths != sensors[index].temperature_tenths ||
+             due->humidity_tenths != sensors[index].humidity_tenths)) {
+            mismatches++;
+        }
+        reads++;
+        if (reads % 1000 == 0) {
+            sim.now_ms += 7000;
+        }
+    }
+
+    uint32_t too_soon = 0;
+    for (int i = 0; i < 5; i++) {
+        too_soon += sensors[i].too_soon;
+    }
+    printf("  5 sensors, 1 h: %u reads, %u started too soon, %u wrong values, absent sensor %u timeouts\n",
+           reads, too_soon, mismatches, handles[3].timeouts);
+    CHECK(too_soon == 0);
+    CHECK(too_close == 0);
+    CHECK(mismatches == 0);
+    CHECK(handles[3].reads_ok == 0 && handles[3].timeouts == handles[3].reads);
+    for (int i = 0; i < 5; i++) {
+        if (i != 3) {
+            CHECK(handles[i].reads_ok == handles[i].reads);
+        }
+    }
+}
+
+int main(void)
+{
+    printf("DHT22 through dht_read on the simulated bus, %d reads each:\n", READS);
+    for (size_t i = 0; i < sizeof(accuracy_cases) / sizeof(accuracy_cases[0]); i++) {
+        accuracy(&accuracy_cases[i]);
+    }
+    puts("Malformed frames:");
+    malformed();
+    puts("Read schedule:");
+    schedule();
+    return host_test_result();
+}
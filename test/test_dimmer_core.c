@@ -0,0 +1,593 @@
+/*
+    Dimmer core on simulated mains: the power every entry of the delay
+    tables conducts against the permille it stands for, firing accuracy
+    against the ideal delay under detector jitter, bounce, missed edges
+    and noise, next to the firing straight off the edges it replaced,
+    eight channels on one timer, a detector dropout, and the time the
+    handlers take and have.
+
+    The timer base starts just short of its 32-bit wrap, so every run
+    crosses it.
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "dimmer_core.h"
+#include "host_test.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TIMER_OFFSET 0xFFF00000u
+#define RUN_SECONDS 60
+
+// Mains frequency the firing before the PLL was built for (DIMMER_FREQ)
+#define DIRECT_BUILD_HZ 60
+
+static dimmer_hal_t sim_hal;
+
+static uint32_t offset_now_us(void *context)
+{
+    return sim_hal.now_us(context) + TIMER_OFFSET;
+}
+
+static void offset_set_alarm(void *context, uint32_t at_us)
+{
+    sim_hal.set_alarm(context, at_us - TIMER_OFFSET);
+}
+
+static void init(dimmer_t *dimmer, dimmer_sim_t *sim, uint8_t channels)
+{
+    dimmer_hal_t hal;
+
+    dimmer_hal_sim_init(&sim_hal, sim);
+    hal = sim_hal;
+    hal.now_us = offset_now_us;
+    hal.set_alarm = offset_set_alarm;
+    dimmer_core_init(dimmer, &hal, channels);
+    dimmer->enabled = true;
+}
+
+// Time of true crossing number index, and the crossing a time falls after
+static double crossing_us(const dimmer_sim_t *sim, uint64_t index)
+{
+    return index * 500000000.0 / sim->mains_mhz;
+}
+
+static uint64_t crossing_index(const dimmer_sim_t *sim, uint64_t t_us)
+{
+    uint64_t index = t_us * sim->mains_mhz / 500000000u;
+
+    if ((index + 1) * 500000000u / sim->mains_mhz <= t_us) {
+        index++;
+    }
+    return index;
+}
+
+// Share of full power a resistive load takes when fired delay_us into a
+// half-cycle
+static double power_at(double delay_us, double half_us)
+{
+    if (delay_us <= 0) {
+        return 1;
+    }
+    if (delay_us >= half_us) {
+        return 0;
+    }
+    double angle = M_PI * delay_us / half_us;
+    return 1 - angle / M_PI + sin(2 * angle) / (2 * M_PI);
+}
+
+// The same share integrated numerically: the load takes sin^2 of the
+// mains phase from the firing to the end of the half-cycle
+static double power_integrated(double delay_us, double half_us)
+{
+    const int steps = 2000;
+    double from = M_PI * (delay_us < 0 ? 0 : delay_us) / half_us;
+    double h = (M_PI - from) / steps;
+    double sum = 0;
+
+    if (from >= M_PI) {
+        return 0;
+    }
+    // Simpson's rule
+    for (int i = 0; i <= steps; i++) {
+        double s = sin(from + i * h);
+        sum += s * s * (i == 0 || i == steps ? 1 : i % 2 ? 4 : 2);
+    }
+    return sum * h / 3 / (M_PI / 2);
+}
+
+// Every entry of a table against the power it stands for. Rounding the
+// delay to 1 us costs at most 0.13 permille at 60 Hz; entries clamped to
+// DIMMER_MIN_DELAY_US from either crossing, at the ends of the 60 Hz
+// table, are off by up to 0.45 permille.
+static void table_linearity(const uint16_t *table, uint32_t hz)
+{
+    double half_us = 500000.0 / hz;
+    double error_max = 0, clamped_max = 0, formula_max = 0, sum_squares = 0;
+    int worst = 0, clamped = 0;
+    bool monotonic = true;
+
+    for (int permille = 0; permille < DIMMER_POWER_STEPS; permille++) {
+        double power = power_integrated(table[permille], half_us);
+        double error = fabs(power - permille / 1000.0) * 1000;
+        bool at_clamp = permille > 0 && permille < DIMMER_POWER_FULL &&
+                        (table[permille] == DIMMER_MIN_DELAY_US ||
+                         table[permille] == (uint16_t) half_us - DIMMER_MIN_DELAY_US);
+
+        formula_max = fmax(formula_max, fabs(power - power_at(table[permille], half_us)));
+        monotonic &= permille == 0 || table[permille] < table[permille - 1];
+        sum_squares += error * error;
+        if (at_clamp) {
+            clamped++;
+            clamped_max = fmax(clamped_max, error);
+        } else if (error > error_max) {
+            error_max = error;
+            worst = permille;
+        }
+    }
+
+    printf("  %u Hz, %d entries: error %.3f permille rms, %.3f max (at %d permille), "
+           "%.3f at the %d clamped entries\n",
+           hz, DIMMER_POWER_STEPS, sqrt(sum_squares / DIMMER_POWER_STEPS), error_max, worst,
+           clamped_max, clamped);
+    CHECK(formula_max < 1e-9);
+    CHECK(monotonic);
+    CHECK(table[0] == (uint16_t) (half_us + 0.5) && table[DIMMER_POWER_FULL] == 0);
+    CHECK(error_max < 0.15);
+    CHECK(clamped_max < 0.5);
+}
+
+// Earliest firing in each true half-cycle, -1 for none
+static struct {
+    const dimmer_sim_t *sim;
+    double *first;
+    long half_cycles;
+    long extra;
+} firings;
+
+static void record_firing(void *observer, uint8_t channel, int32_t delay_us)
+{
+    (void) observer;
+    (void) channel;
+    (void) delay_us;
+
+    uint64_t index = crossing_index(firings.sim, firings.sim->now_us);
+    if ((long) index >= firings.half_cycles) {
+        return;
+    }
+    double delay = firings.sim->now_us - crossing_us(firings.sim, index);
+    if (firings.first[index] >= 0) {
+        firings.extra++;
+    }
+    if (firings.first[index] < 0 || delay < firings.first[index]) {
+        firings.first[index] = delay;
+    }
+}
+
+typedef struct {
+    double hz;
+    uint32_t jitter_us;
+    uint16_t bounce_permille;
+    uint16_t miss_permille;
+    uint16_t noise_permille;
+    uint16_t power;
+} mains_case_t;
+
+static const mains_case_t mains_cases[] = {
+    { 60, 0, 0, 0, 0, 350 },
+    { 60, 50, 0, 0, 0, 350 },
+    { 60, 200, 0, 0, 0, 350 },
+    { 60, 50, 50, 0, 0, 350 },
+    { 60, 50, 0, 10, 0, 350 },
+    { 60, 50, 0, 0, 20, 350 },
+    { 50, 50, 0, 0, 0, 350 },
+    { 49.5, 100, 50, 10, 20, 350 },
+    { 60.5, 100, 50, 10, 20, 350 },
+    { 60, 100, 50, 10, 20, 1000 },
+    { 50, 100, 50, 10, 20, 1000 },
+};
+
+typedef struct {
+    long started;               // First half-cycle fired in, -1 for none
+    long held;
+    long unfired;
+    double rms;
+    double max_error;
+    double power_rms;
+} firing_score_t;
+
+// Runs the mains of c through the core, or the direct firing baseline if
+// dimmer is NULL, and scores the earliest firing in every half-cycle
+// against the ideal one
+static firing_score_t score(const mains_case_t *c, dimmer_sim_t *sim, dimmer_t *dimmer)
+{
+    firing_score_t result = { .started = -1 };
+    double half_us = 500000000.0 / sim->mains_mhz;
+
+    firings.sim = sim;
+    firings.half_cycles = (long) (RUN_SECONDS * 2 * c->hz);
+    firings.first = malloc(sizeof(double) * firings.half_cycles);
+    firings.extra = 0;
+    for (long i = 0; i < firings.half_cycles; i++) {
+        firings.first[i] = -1;
+    }
+
+    // Ideal firing: the table for the true nominal frequency, scaled to
+    // the true half-cycle
+    bool is_50hz = c->hz < 55;
+    const uint16_t *table = is_50hz ? dimmer_delay_50hz_us : dimmer_delay_60hz_us;
+    double ideal = c->power >= DIMMER_POWER_FULL ? 0 : table[c->power] * half_us / (is_50hz ? 10000 : 8333.33);
+    double target = power_at(ideal, half_us);
+
+    // A gate still on 50 us past a crossing, with no firing in the new
+    // half-cycle, lets the TRIAC latch again from its start
+    for (long i = 1; i < firings.half_cycles; i++) {
+        uint64_t until = i < firings.half_cycles - 1 ? (uint64_t) ceil(crossing_us(sim, i)) + 50
+                                                     : (uint64_t) crossing_us(sim, i);
+        if (dimmer != NULL) {
+            dimmer_sim_run(sim, dimmer, until);
+        } else {
+            dimmer_sim_run_direct(sim, c->power, DIRECT_BUILD_HZ, until);
+        }
+        if (i < firings.half_cycles - 1 && (sim->gates & 1) && firings.first[i] < 0) {
+            firings.first[i] = 0;
+            result.held++;
+        }
+    }
+
+    long n = 0;
+    double sum_sq = 0, power_sq = 0;
+    for (long i = 1; i < firings.half_cycles - 1; i++) {
+        if (firings.first[i] < 0) {
+            if (result.started >= 0) {
+                result.unfired++;
+            }
+            continue;
+        }
+        if (result.started < 0) {
+            // The half-cycle firing starts in is only partly scheduled
+            result.started = i;
+            continue;
+        }
+        double error = firings.first[i] - ideal;
+        double power = power_at(firings.first[i], half_us);
+        n++;
+        sum_sq += error * error;
+        result.max_error = fmax(result.max_error, fabs(error));
+        power_sq += (power - target) * (power - target);
+    }
+
+    result.rms = sqrt(sum_sq / n);
+    result.power_rms = 1000 * sqrt(power_sq / n);
+    free(firings.first);
+    return result;
+}
+
+static void mains(const mains_case_t *c)
+{
+    dimmer_sim_t sim = {
+        .mains_mhz = (uint32_t) (c->hz * 1000 + 0.5),
+        .jitter_us = c->jitter_us,
+        .bounce_permille = c->bounce_permille,
+        .bounce_max_us = 300,
+        .miss_permille = c->miss_permille,
+        .noise_permille = c->noise_permille,
+        .seed = 99,
+        .on_fire = record_firing,
+    };
+    dimmer_sim_t direct_sim = sim;
+    dimmer_hal_t direct_hal;
+    dimmer_t dimmer;
+
+    init(&dimmer, &sim, 1);
+    dimmer.power[0] = c->power;
+    firing_score_t pll = score(c, &sim, &dimmer);
+    long extra = firings.extra;
+
+    // The same mains, edge for edge, through the firing the PLL replaced
+    dimmer_hal_sim_init(&direct_hal, &direct_sim);
+    firing_score_t direct = score(c, &direct_sim, NULL);
+
+    printf("  %4.1f Hz jitter %3u us bounce %2u%% miss %u%% noise %u%%, power %4u: firing from half-cycle %2ld; "
+           "error rms %5.1f max %4.0f us; power rms error %4.1f permille; held over %ld, unfired %ld, extra %ld\n",
+           c->hz, c->jitter_us, c->bounce_permille / 10, c->miss_permille / 10, c->noise_permille / 10, c->power,
+           pll.started, pll.rms, pll.max_error, pll.power_rms, pll.held, pll.unfired, extra);
+    printf("      %.3f Hz measured; edges accepted %u rejected %u; handlers %.0f ns avg over %u calls, budget %u us\n",
+           zc_pll_mains_mhz(&dimmer.pll) / 1000.0, dimmer.pll.accepted, dimmer.pll.rejected,
+           (double) sim.isr_ns / sim.isr_calls, sim.isr_calls, sim.min_gap_us);
+    printf("      fired on the edges, %d Hz build: error rms %6.1f max %4.0f us; power rms error %5.1f permille; "
+           "held over %ld, unfired %ld, extra %ld\n",
+           DIRECT_BUILD_HZ, direct.rms, direct.max_error, direct.power_rms, direct.held, direct.unfired, firings.extra);
+
+    CHECK(pll.started > 0 && pll.started <= 12);
+    CHECK(pll.unfired == 0);
+    if (c->power < DIMMER_POWER_FULL) {
+        // At full power the gate is meant to stay on across crossings
+        CHECK(pll.held == 0);
+        CHECK(extra == 0);
+        CHECK(pll.rms <= direct.rms && pll.power_rms <= direct.power_rms);
+    }
+    CHECK(pll.rms < 50);
+    CHECK(pll.power_rms < 15);
+    CHECK(sim.missed_alarms == 0);
+    CHECK(fabs(zc_pll_mains_mhz(&dimmer.pll) / 1000.0 - c->hz) < 0.05);
+}
+
+// Eight channels on one timer. Powers change every full cycle, randomly,
+// with duplicates, near-equal delays, 0 and full power; each channel has
+// to fire exactly once in every half-cycle it is on, at its table delay
+static struct {
+    bool checking;
+    int32_t expect_us[DIMMER_CHANNELS_MAX];
+    long fired[DIMMER_CHANNELS_MAX];
+    long count;
+    int32_t error_min, error_max;
+} channels;
+
+static void check_firing(void *observer, uint8_t channel, int32_t delay_us)
+{
+    (void) observer;
+    if (!channels.checking) {
+        return;
+    }
+    int32_t error = delay_us - channels.expect_us[channel];
+    channels.count++;
+    channels.fired[channel]++;
+    if (error < channels.error_min) {
+        channels.error_min = error;
+    }
+    if (error > channels.error_max) {
+        channels.error_max = error;
+    }
+}
+
+static void eight_channels(uint32_t hz)
+{
+    dimmer_sim_t sim = { .mains_mhz = hz * 1000, .seed = 5, .on_fire = check_firing };
+    dimmer_t dimmer;
+    double half_us = 500000.0 / hz;
+    uint32_t random = 12345;
+    long wrong = 0, rounds = 0;
+
+    init(&dimmer, &sim, DIMMER_CHANNELS_MAX);
+    channels.count = 0;
+    channels.error_min = INT32_MAX;
+    channels.error_max = INT32_MIN;
+
+    for (int round = 1; round < 20000; round++) {
+        bool warm_up = round < 10;
+
+        for (int c = 0; c < DIMMER_CHANNELS_MAX; c++) {
+            uint32_t kind = host_test_random(&random) % 10;
+            uint16_t before = c > 0 ? dimmer.power[c - 1] : 0;
+            uint16_t power;
+
+            if (kind == 0) {
+                power = 0;
+            } else if (kind == 1) {
+                power = DIMMER_POWER_FULL;
+            } else if (kind == 2 && c > 0) {
+                power = before;
+            } else if (kind == 3 && before > 0 && before < DIMMER_POWER_FULL - 1) {
+                power = before + 1;
+            } else {
+                power = (uint16_t) (host_test_random(&random) % DIMMER_POWER_STEPS);
+            }
+            dimmer.power[c] = power;
+        }
+
+        // Finish the half-cycle under way, which was scheduled with the
+        // old powers, then check the next one whole
+        channels.checking = false;
+        dimmer_sim_run(&sim, &dimmer, (uint64_t) ((2 * round + 1) * half_us) - 1);
+        for (int c = 0; c < DIMMER_CHANNELS_MAX; c++) {
+            channels.expect_us[c] = dimmer.power[c] >= DIMMER_POWER_FULL ? 0 : (int32_t) dimmer_core_delay_us(&dimmer, dimmer.power[c]);
+            channels.fired[c] = 0;
+        }
+        channels.checking = !warm_up;
+        dimmer_sim_run(&sim, &dimmer, (uint64_t) ((2 * round + 2) * half_us) - 1);
+        channels.checking = false;
+
+        // A spurious alarm right after the crossing fires nothing
+        dimmer_sim_run(&sim, &dimmer, (uint64_t) ((2 * round + 2) * half_us) + 2);
+        uint32_t triggers = dimmer.triggers;
+        dimmer_core_timer(&dimmer);
+        if (dimmer.triggers != triggers) {
+            wrong++;
+        }
+        dimmer_sim_run(&sim, &dimmer, (uint64_t) ((2 * round + 3) * half_us) - 300);
+
+        for (int c = 0; c < DIMMER_CHANNELS_MAX && !warm_up; c++) {
+            if (channels.fired[c] != (dimmer.power[c] > 0 ? 1 : 0) && channels.expect_us[c] >= 0) {
+                wrong++;
+            }
+        }
+        rounds++;
+    }
+
+    printf("  %u Hz, 8 channels, %ld full cycles of random powers: %ld firings, error against the table %+d..%+d us, "
+           "%ld wrong firing counts, %u coalesced, %u missed alarms\n",
+           hz, rounds, channels.count, channels.error_min, channels.error_max, wrong, dimmer.coalesced, sim.missed_alarms);
+    CHECK(wrong == 0);
+    CHECK(sim.missed_alarms == 0);
+    CHECK(channels.error_min >= -DIMMER_ALARM_GUARD_US - 2);
+    CHECK(channels.error_max <= 2);
+}
+
+// Detector dead for 1 s at 50 Hz: the gates go off once the loop lets go,
+// and firing resumes once it locks again
+static void dropout(void)
+{
+    dimmer_sim_t sim = { .mains_mhz = 50000, .jitter_us = 50, .seed = 3 };
+    dimmer_t dimmer;
+    uint64_t t = 10000000, last_firing = 0, resumed = 0;
+
+    init(&dimmer, &sim, 1);
+    dimmer.power[0] = 500;
+    dimmer_sim_run(&sim, &dimmer, t);
+    uint32_t before = sim.firings[0];
+
+    sim.miss_permille = 1000;
+    for (; t < 11000000; t += 1000) {
+        uint32_t fired = sim.firings[0];
+        dimmer_sim_run(&sim, &dimmer, t);
+        if (sim.firings[0] != fired) {
+            last_firing = t;
+        }
+    }
+    bool locked_at_end = dimmer.pll.locked;
+    sim.miss_permille = 0;
+    for (; t < 12000000; t += 1000) {
+        uint32_t fired = sim.firings[0];
+        dimmer_sim_run(&sim, &dimmer, t);
+        if (resumed == 0 && sim.firings[0] != fired) {
+            resumed = t;
+        }
+    }
+
+    printf("  Detector dead 10.0-11.0 s at 50 Hz: last firing %.3f s, locked at the end %d, firing again %.3f s; "
+           "locks %u unlocks %u, lock changes reported %u\n",
+           last_firing / 1e6, locked_at_end, resumed / 1e6, dimmer.pll.locks, dimmer.pll.unlocks, sim.lock_changes);
+    CHECK(sim.firings[0] > before);
+    CHECK(last_firing < 10000000 + 10 * 10000);
+    CHECK(!locked_at_end);
+    CHECK(resumed > 11000000 && resumed < 11000000 + 12 * 10000);
+    CHECK(dimmer.pll.locks == 2 && dimmer.pll.unlocks == 1);
+    CHECK(sim.lock_changes == 3);
+}
+
+// A queue and the dimmer task waiting on it, as a thread. The task wakes
+// when something is posted or its report is due, every 5 s as in main.c.
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t posted;
+    pthread_t thread;
+    uint32_t pending;
+    uint32_t wakeups;
+    bool stop;
+} task = { .mutex = PTHREAD_MUTEX_INITIALIZER, .posted = PTHREAD_COND_INITIALIZER };
+
+#define REPORT_NS 5000000000ull
+
+static void *task_main(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&task.mutex);
+    while (!task.stop) {
+        uint64_t due = host_test_ns() + REPORT_NS;
+        struct timespec until;
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += REPORT_NS / 1000000000u;
+        while (task.pending == 0 && !task.stop && host_test_ns() < due) {
+            pthread_cond_timedwait(&task.posted, &task.mutex, &until);
+        }
+        task.pending = 0;
+        task.wakeups++;
+    }
+    pthread_mutex_unlock(&task.mutex);
+    return NULL;
+}
+
+static void task_post(void)
+{
+    pthread_mutex_lock(&task.mutex);
+    task.pending++;
+    pthread_cond_signal(&task.posted);
+    pthread_mutex_unlock(&task.mutex);
+}
+
+// The old handler's extra work: a spinlock around xQueueSendFromISR()
+static pthread_mutex_t old_spinlock = PTHREAD_MUTEX_INITIALIZER;
+
+static void old_edge(void *observer)
+{
+    (void) observer;
+    pthread_mutex_lock(&old_spinlock);
+    task_post();
+    pthread_mutex_unlock(&old_spinlock);
+}
+
+// The handler now: xTaskNotifyFromISR() only when the loop locks or lets go
+static void new_lock(void *observer, bool locked)
+{
+    (void) observer;
+    (void) locked;
+    task_post();
+}
+
+// Runs the mains in real time, so the task sees the edges as they come
+static void isr_path(const char *name, void (*on_edge)(void *), void (*on_lock)(void *, bool))
+{
+    const int seconds = 3;
+    dimmer_sim_t sim = {
+        .mains_mhz = 50000,
+        .jitter_us = 50,
+        .seed = 11,
+        .on_edge = on_edge,
+        .on_lock = on_lock,
+    };
+    dimmer_t dimmer;
+
+    init(&dimmer, &sim, 2);
+    dimmer.power[0] = 350;
+    dimmer.power[1] = 700;
+    task.pending = 0;
+    task.wakeups = 0;
+    task.stop = false;
+    CHECK(pthread_create(&task.thread, NULL, task_main, NULL) == 0);
+
+    uint64_t start = host_test_ns();
+    for (uint64_t t = 5000; t <= seconds * 1000000ull; t += 5000) {
+        dimmer_sim_run(&sim, &dimmer, t);
+        uint64_t due = start + t * 1000;
+        uint64_t now = host_test_ns();
+        if (due > now) {
+            struct timespec pause = { 0, (long) (due - now) };
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    pthread_mutex_lock(&task.mutex);
+    uint32_t wakeups = task.wakeups;
+    task.stop = true;
+    pthread_cond_signal(&task.posted);
+    pthread_mutex_unlock(&task.mutex);
+    pthread_join(task.thread, NULL);
+
+    printf("  %-14s: handlers %4.0f ns avg, %5.0f ns max over %u calls; task woken %5.1f times/s (%u edges, %u lock changes)\n",
+           name, (double) sim.isr_ns / sim.isr_calls, (double) sim.isr_max_ns, sim.isr_calls,
+           (double) wakeups / seconds, sim.edges, sim.lock_changes);
+    CHECK(dimmer.pll.locked);
+    if (on_edge != NULL) {
+        // Every edge is a post; a busy host may let a few run together
+        CHECK(wakeups > sim.edges / 2);
+    } else {
+        CHECK(wakeups <= sim.lock_changes + 1);
+    }
+}
+
+int main(void)
+{
+    puts("Power conducted at each tabulated delay, against its permille:");
+    table_linearity(dimmer_delay_50hz_us, 50);
+    table_linearity(dimmer_delay_60hz_us, 60);
+    printf("One channel, %d s each:\n", RUN_SECONDS);
+    for (size_t i = 0; i < sizeof(mains_cases) / sizeof(mains_cases[0]); i++) {
+        mains(&mains_cases[i]);
+    }
+    puts("Eight channels:");
+    eight_channels(50);
+    eight_channels(60);
+    puts("Dropout:");
+    dropout();
+    puts("Zero-cross handler and the dimmer task, 50 Hz in real time:");
+    isr_path("queue per edge", old_edge, NULL);
+    isr_path("notify on lock", NULL, new_lock);
+    return host_test_result();
+}
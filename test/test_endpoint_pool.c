@@ -0,0 +1,659 @@
+/*
+    Broker failover through the endpoint pool and coreMQTT, against two
+    broker stand-ins forked onto loopback ports: A acknowledges fast, B
+    slowly. Sessions run as in the demo, one connection each with B kept
+    as a warm standby. A is killed with publishes unacknowledged, the
+    sessions move to B, and once A is back and measured faster they move
+    back, resuming A's session.
+
+    Checks that the sessions stay put while nothing fails and nothing is
+    measured faster, that B's clean session keeps the publishes A still
+    owes a PUBACK for, that A resends them when its session resumes, and
+    that every message is acknowledged. Then that the standby on B is kept
+    while it passes its keep-alive check, replaced once B closes it or it
+    reaches ENDPOINT_POOL_WARM_MAX_AGE_MS, and never used once closed.
+*/
+
+// MAP_ANONYMOUS and usleep, beyond the POSIX the other tests use
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "core_mqtt_state.h"
+#include "endpoint_pool.h"
+#include "host_test.h"
+
+#define A_ACK_MS 2
+#define B_ACK_MS 100
+#define PER_SESSION 3           // New messages per session
+#define STORE MQTT_STATE_ARRAY_MAX_COUNT
+#define MESSAGES 256
+#define SESSION_TIMEOUT_MS 3000
+
+// What a broker stand-in shares with the test
+typedef struct {
+    uint32_t ack_ms;
+    volatile bool hold_acks;    // Take publishes without acknowledging them
+    volatile bool session;      // The client's session outlives its connection
+    volatile uint32_t accepts;  // TCP connections, standbys included
+    volatile uint32_t connects;
+    volatile uint32_t resumed;
+    volatile uint8_t received[MESSAGES];
+} broker_state_t;
+
+typedef struct {
+    const char *name;
+    uint16_t port;
+    pid_t pid;
+    broker_state_t *state;
+} broker_t;
+
+struct NetworkContext {
+    int socket;
+};
+
+// A publish awaiting its PUBACK, as outgoingPublishPackets in the demo
+typedef struct {
+    uint16_t packet_id;
+    uint32_t message;
+    uint32_t sent_ms;
+    const Endpoint_t *endpoint;
+    MQTTPublishInfo_t info;
+} stored_publish_t;
+
+static broker_t brokers[2] = { { .name = "A" }, { .name = "B" } };
+static struct NetworkContext contexts[2];
+static EndpointPool_t pool;
+static MQTTContext_t mqtt;
+static uint8_t network_buffer[1024];
+static stored_publish_t store[STORE];
+static uint32_t payloads[STORE];
+static bool acked[MESSAGES];
+static uint32_t next_message;
+
+// Moved ahead by hand to age the standby
+static uint32_t clock_offset_ms;
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t) (host_test_ns() / 1000000u) + clock_offset_ms;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+    usleep(ms * 1000u);
+}
+
+// Broker stand-in
+
+static bool read_all(int fd, uint8_t *buffer, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = read(fd, buffer, length);
+        if (n <= 0) {
+            return false;
+        }
+        buffer += n;
+        length -= (size_t) n;
+    }
+    return true;
+}
+
+static bool read_packet(int fd, uint8_t *header, uint8_t *body, size_t size, size_t *length)
+{
+    uint8_t byte;
+    size_t multiplier = 1;
+
+    *length = 0;
+    if (!read_all(fd, header, 1)) {
+        return false;
+    }
+    do {
+        if (!read_all(fd, &byte, 1) || multiplier > 128u * 128u * 128u) {
+            return false;
+        }
+        *length += (byte & 0x7fu) * multiplier;
+        multiplier *= 128u;
+    } while (byte & 0x80u);
+    return *length <= size && read_all(fd, body, *length);
+}
+
+static void serve_connection(int fd, broker_state_t *state)
+{
+    uint8_t header, body[512];
+    size_t length;
+
+    while (read_packet(fd, &header, body, sizeof(body), &length)) {
+        switch (header >> 4) {
+        case 1: {
+            // CONNECT: the flags follow the protocol name and level
+            bool clean = length > 7 && (body[7] & 0x02u);
+            uint8_t connack[4] = { 0x20, 2, !clean && state->session, 0 };
+
+            state->resumed += connack[2];
+            state->session = !clean;
+            state->connects++;
+            if (write(fd, connack, sizeof(connack)) != sizeof(connack)) {
+                return;
+            }
+            break;
+        }
+        case 3: {
+            size_t topic = (size_t) (body[0] << 8 | body[1]);
+            uint8_t qos = (header >> 1) & 3u;
+            uint32_t message;
+
+            if (length < 2 + topic + 2 + sizeof(message) || qos != 1) {
+                return;
+            }
+            memcpy(&message, &body[2 + topic + 2], sizeof(message));
+            if (message < MESSAGES) {
+                state->received[message]++;
+            }
+            if (!state->hold_acks) {
+                uint8_t puback[4] = { 0x40, 2, body[2 + topic], body[2 + topic + 1] };
+
+                sleep_ms(state->ack_ms);
+                if (write(fd, puback, sizeof(puback)) != sizeof(puback)) {
+                    return;
+                }
+            }
+            break;
+        }
+        case 12: {
+            uint8_t pingresp[2] = { 0xd0, 0 };
+
+            if (write(fd, pingresp, sizeof(pingresp)) != sizeof(pingresp)) {
+                return;
+            }
+            break;
+        }
+        default:
+            // DISCONNECT, or anything the client never sends
+            return;
+        }
+    }
+}
+
+// Fork the broker onto its port, the same one on a restart
+static bool broker_start(broker_t *broker)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(broker->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t length = sizeof(address);
+    int one = 1;
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (listener < 0) {
+        return false;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listener, 4) != 0 ||
+        getsockname(listener, (struct sockaddr *) &address, &length) != 0) {
+        close(listener);
+        return false;
+    }
+
+    broker->port = ntohs(address.sin_port);
+    broker->pid = fork();
+    if (broker->pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        for (;;) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                broker->state->accepts++;
+                serve_connection(fd, broker->state);
+                close(fd);
+            }
+        }
+    }
+    close(listener);
+    return broker->pid > 0;
+}
+
+static void broker_kill(broker_t *broker)
+{
+    if (broker->pid > 0) {
+        kill(broker->pid, SIGKILL);
+        waitpid(broker->pid, NULL, 0);
+        broker->pid = 0;
+    }
+}
+
+// Client side, as the demo drives the pool and coreMQTT
+
+static bool connect_endpoint(Endpoint_t *endpoint)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(endpoint->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    endpoint->pNetworkContext->socket = fd;
+    return true;
+}
+
+static void disconnect_endpoint(Endpoint_t *endpoint)
+{
+    close(endpoint->pNetworkContext->socket);
+    endpoint->pNetworkContext->socket = -1;
+}
+
+// Open unless the broker closed it, as the demo checks its TLS socket
+static bool keep_alive_endpoint(Endpoint_t *endpoint)
+{
+    char byte;
+
+    return recv(endpoint->pNetworkContext->socket, &byte, 1, MSG_PEEK | MSG_DONTWAIT) < 0 &&
+           (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static int32_t transport_send(NetworkContext_t *context, const void *buffer, size_t length)
+{
+    ssize_t n = send(context->socket, buffer, length, MSG_NOSIGNAL);
+
+    return n < 0 ? -1 : (int32_t) n;
+}
+
+// 0 when nothing arrived for a while, as the TLS transport on the device
+static int32_t transport_recv(NetworkContext_t *context, void *buffer, size_t length)
+{
+    struct pollfd ready = { .fd = context->socket, .events = POLLIN };
+    ssize_t n;
+
+    if (poll(&ready, 1, 5) == 0) {
+        return 0;
+    }
+    n = recv(context->socket, buffer, length, 0);
+    return n <= 0 ? -1 : (int32_t) n;
+}
+
+static stored_publish_t *find_stored(uint16_t packet_id)
+{
+    for (size_t i = 0; i < STORE; i++) {
+        if (store[i].packet_id == packet_id) {
+            return &store[i];
+        }
+    }
+    return NULL;
+}
+
+static void event_callback(MQTTContext_t *context, MQTTPacketInfo_t *packet, MQTTDeserializedInfo_t *info)
+{
+    stored_publish_t *stored;
+
+    (void) context;
+    if ((packet->type & 0xf0u) != MQTT_PACKET_TYPE_PUBACK || info->packetIdentifier == MQTT_PACKET_ID_INVALID) {
+        return;
+    }
+    stored = find_stored(info->packetIdentifier);
+    if (stored != NULL) {
+        EndpointPool_RecordPubAck(&pool, now_ms() - stored->sent_ms);
+        acked[stored->message] = true;
+        *stored = (stored_publish_t) { 0 };
+    }
+}
+
+static size_t stored_for(const Endpoint_t *endpoint)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < STORE; i++) {
+        count += store[i].packet_id != MQTT_PACKET_ID_INVALID && store[i].endpoint == endpoint;
+    }
+    return count;
+}
+
+static void drop_stored(const Endpoint_t *endpoint)
+{
+    for (size_t i = 0; i < STORE; i++) {
+        if (store[i].endpoint == endpoint) {
+            store[i] = (stored_publish_t) { 0 };
+        }
+    }
+}
+
+static bool publish(uint32_t message)
+{
+    stored_publish_t *stored = find_stored(MQTT_PACKET_ID_INVALID);
+
+    if (stored == NULL) {
+        // Sessions parked with the broker not in use give way, as in the demo
+        for (size_t i = 0; i < pool.count; i++) {
+            if (&pool.endpoints[i] != pool.pBound && stored_for(&pool.endpoints[i]) > 0) {
+                drop_stored(&pool.endpoints[i]);
+                EndpointPool_ForgetSession(&pool, &pool.endpoints[i]);
+            }
+        }
+        stored = find_stored(MQTT_PACKET_ID_INVALID);
+    }
+    if (stored == NULL) {
+        return false;
+    }
+
+    size_t slot = (size_t) (stored - store);
+    payloads[slot] = message;
+    *stored = (stored_publish_t) {
+        .packet_id = MQTT_GetPacketId(&mqtt),
+        .message = message,
+        .sent_ms = now_ms(),
+        .endpoint = pool.pActive,
+        .info = {
+            .qos = MQTTQoS1,
+            .pTopicName = "t",
+            .topicNameLength = 1,
+            .pPayload = &payloads[slot],
+            .payloadLength = sizeof(payloads[slot]),
+        },
+    };
+    return MQTT_Publish(&mqtt, &stored->info, stored->packet_id) == MQTTSuccess;
+}
+
+static bool resend(void)
+{
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    uint16_t packet_id;
+
+    while ((packet_id = MQTT_PublishToResend(&mqtt, &cursor)) != MQTT_PACKET_ID_INVALID) {
+        stored_publish_t *stored = find_stored(packet_id);
+
+        if (stored == NULL) {
+            return false;
+        }
+        stored->info.dup = true;
+        stored->sent_ms = now_ms();
+        if (MQTT_Publish(&mqtt, &stored->info, packet_id) != MQTTSuccess) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool connect_best(void)
+{
+    uint32_t deadline = now_ms() + SESSION_TIMEOUT_MS;
+
+    while (!EndpointPool_Connect(&pool, EndpointPool_Select(&pool))) {
+        if ((int32_t) (now_ms() - deadline) > 0) {
+            return false;
+        }
+        sleep_ms(50);
+    }
+    mqtt.transportInterface.pNetworkContext = pool.pActive->pNetworkContext;
+    EndpointPool_WarmStandby(&pool);
+    return true;
+}
+
+// One session as subscribePublishLoop() runs it: connect, resend or clean
+// up, publish the unacknowledged messages and new ones, and wait for the
+// PUBACKs. after_publish runs once everything is sent.
+static const Endpoint_t *session(void (*after_publish)(void))
+{
+    MQTTConnectInfo_t connect = {
+        .pClientIdentifier = "device",
+        .clientIdentifierLength = 6,
+        .keepAliveSeconds = 60,
+    };
+    bool present = false;
+    Endpoint_t *endpoint;
+
+    if (!connect_best()) {
+        return NULL;
+    }
+    endpoint = pool.pActive;
+    connect.cleanSession = !EndpointPool_BindSession(&pool, &mqtt);
+    if (MQTT_Connect(&mqtt, &connect, NULL, 1000, &present) != MQTTSuccess) {
+        EndpointPool_RecordFailure(&pool, endpoint);
+        return NULL;
+    }
+    EndpointPool_SessionOpened(&pool);
+
+    bool ok = true;
+    if (present) {
+        ok = resend();
+    } else {
+        // Only this broker's publishes went with its session
+        drop_stored(endpoint);
+    }
+
+    // Messages never acknowledged go again, as the demo's caller retries
+    // its unacknowledged payloads, unless this broker has them in flight;
+    // then the new ones
+    uint32_t last = next_message + PER_SESSION;
+    for (uint32_t message = 0; ok && message < last; message++) {
+        bool in_flight = false;
+
+        for (size_t i = 0; i < STORE; i++) {
+            in_flight |= store[i].packet_id != MQTT_PACKET_ID_INVALID && store[i].message == message &&
+                         store[i].endpoint == endpoint;
+        }
+        if (!acked[message] && !in_flight) {
+            ok = publish(message);
+        }
+    }
+    next_message = last;
+    if (ok && after_publish != NULL) {
+        after_publish();
+    }
+
+    uint32_t deadline = now_ms() + SESSION_TIMEOUT_MS;
+    while (ok && stored_for(endpoint) > 0 && (int32_t) (now_ms() - deadline) < 0) {
+        ok = MQTT_ProcessLoop(&mqtt, 20) == MQTTSuccess;
+    }
+    ok = ok && stored_for(endpoint) == 0;
+
+    if (!ok) {
+        EndpointPool_RecordFailure(&pool, endpoint);
+        return NULL;
+    }
+    (void) MQTT_Disconnect(&mqtt);
+    EndpointPool_Release(&pool);
+    return endpoint;
+}
+
+static uint32_t held_from, held_to;
+
+// Wait until A has the session's publishes, unacknowledged, then kill it
+static void kill_a(void)
+{
+    uint32_t deadline = now_ms() + SESSION_TIMEOUT_MS;
+    bool all = false;
+
+    held_to = next_message;
+    held_from = held_to - PER_SESSION;
+    while (!all && (int32_t) (now_ms() - deadline) < 0) {
+        all = true;
+        for (uint32_t m = held_from; m < held_to; m++) {
+            all &= brokers[0].state->received[m] > 0;
+        }
+        sleep_ms(1);
+    }
+    broker_kill(&brokers[0]);
+}
+
+// Connections B has taken since from; connect() returns before the broker
+// accepts, so wait for the count to settle
+static uint32_t b_accepts_since(uint32_t from)
+{
+    sleep_ms(20);
+    return brokers[1].state->accepts - from;
+}
+
+static uint32_t cost_ms(const Endpoint_t *endpoint)
+{
+    return endpoint->health.pubAckRttMs + endpoint->health.connectRttMs;
+}
+
+int main(void)
+{
+    broker_state_t *states = mmap(NULL, 2 * sizeof(broker_state_t), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    TransportInterface_t transport = { .send = transport_send, .recv = transport_recv };
+    MQTTFixedBuffer_t buffer = { network_buffer, sizeof(network_buffer) };
+    const Endpoint_t *ran_on;
+    int moves = 0;
+
+    CHECK(states != MAP_FAILED);
+    if (states == MAP_FAILED) {
+        return host_test_result();
+    }
+    memset(states, 0, 2 * sizeof(broker_state_t));
+    states[0].ack_ms = A_ACK_MS;
+    states[1].ack_ms = B_ACK_MS;
+    for (int i = 0; i < 2; i++) {
+        brokers[i].state = &states[i];
+        contexts[i].socket = -1;
+        CHECK(broker_start(&brokers[i]));
+    }
+
+    EndpointPool_Init(&pool, connect_endpoint, disconnect_endpoint, keep_alive_endpoint, now_ms);
+    Endpoint_t *a = EndpointPool_Add(&pool, "127.0.0.1", brokers[0].port, &contexts[0]);
+    Endpoint_t *b = EndpointPool_Add(&pool, "127.0.0.1", brokers[1].port, &contexts[1]);
+    transport.pNetworkContext = a->pNetworkContext;
+    CHECK(MQTT_Init(&mqtt, &transport, now_ms, event_callback, &buffer) == MQTTSuccess);
+
+    printf("Two brokers, A %d ms to PUBACK and B %d ms, B kept as a warm standby:\n", A_ACK_MS, B_ACK_MS);
+
+    // A works: the unmeasured standby on B must not draw the sessions away
+    int on_a = 0;
+    for (int i = 0; i < 10; i++) {
+        ran_on = session(NULL);
+        on_a += ran_on == a;
+    }
+    printf("  10 sessions on A, %d stayed there with B connected and unmeasured\n", on_a);
+    CHECK(on_a == 10);
+    CHECK(b->connected && b->health.pubAckRttMs == 0);
+
+    // A dies with the last session's publishes unacknowledged
+    brokers[0].state->hold_acks = true;
+    uint64_t kill_ns = host_test_ns();
+    CHECK(session(kill_a) == NULL);
+    CHECK(!EndpointPool_IsAvailable(&pool, a));
+    brokers[0].state->hold_acks = false;
+    CHECK(broker_start(&brokers[0]));
+
+    ran_on = session(NULL);
+    double failover_ms = (host_test_ns() - kill_ns) / 1e6;
+    moves += ran_on == b;
+    bool kept = stored_for(a) == PER_SESSION;
+    for (uint32_t m = held_from; m < held_to; m++) {
+        kept &= acked[m];
+    }
+    printf("  A killed with %d publishes unacknowledged: a session on B done %.0f ms later, A's %zu kept "
+           "through B's clean session and sent again on B\n",
+           PER_SESSION, failover_ms, stored_for(a));
+    CHECK(ran_on == b);
+    CHECK(kept);
+
+    // Back on A once it is up again and measured faster, resuming its session
+    int on_b = 1;
+    uint32_t a_cost = 0, b_cost = 0;
+    for (int i = 0; i < 40 && ran_on != a; i++) {
+        a_cost = cost_ms(a);
+        b_cost = cost_ms(b);
+        ran_on = session(NULL);
+        on_b += ran_on == b;
+    }
+    moves += ran_on == a;
+    bool resent = ran_on == a && stored_for(a) == 0 && brokers[0].state->resumed > 0;
+    for (uint32_t m = held_from; m < held_to; m++) {
+        resent &= brokers[0].state->received[m] == 2;
+    }
+    printf("  back on A after %d sessions on B (expected cost A %u ms, B %u ms), "
+           "the session resumed and A's %d publishes resent\n",
+           on_b, (unsigned) a_cost, (unsigned) b_cost, PER_SESSION);
+    CHECK(ran_on == a);
+    CHECK(resent);
+
+    // And stays there
+    on_a = 0;
+    for (int i = 0; i < 5; i++) {
+        on_a += session(NULL) == a;
+    }
+    CHECK(on_a == 5);
+
+    uint32_t unacked = 0;
+    for (uint32_t m = 0; m < next_message; m++) {
+        unacked += !acked[m];
+    }
+    printf("  %u messages, %u unacknowledged; the sessions moved %d times\n",
+           (unsigned) next_message, (unsigned) unacked, moves);
+    CHECK(unacked == 0);
+    CHECK(moves == 2);
+
+    // The standby on B is kept while it stays open, long past the 20 s it
+    // used to be replaced after, and replaced once B closes it or it gets
+    // too old
+    uint32_t accepts = brokers[1].state->accepts;
+    on_a = 0;
+    for (int i = 0; i < 5; i++) {
+        clock_offset_ms += 30000;
+        on_a += session(NULL) == a;
+    }
+    uint32_t kept_open = b_accepts_since(accepts);
+    CHECK(on_a == 5);
+    CHECK(kept_open == 0 && b->connected);
+
+    broker_kill(&brokers[1]);
+    CHECK(broker_start(&brokers[1]));
+    sleep_ms(10);
+    CHECK(session(NULL) == a);
+    uint32_t after_close = b_accepts_since(accepts);
+    CHECK(after_close == 1 && b->connected);
+
+    clock_offset_ms += ENDPOINT_POOL_WARM_MAX_AGE_MS;
+    CHECK(session(NULL) == a);
+    uint32_t after_age = b_accepts_since(accepts);
+    CHECK(after_age == 2 && b->connected);
+    printf("  standby on B over 5 sessions 30 s apart: reopened %u times; "
+           "then %u time(s) after B closed it, %u after %u s\n",
+           (unsigned) kept_open, (unsigned) after_close, (unsigned) (after_age - after_close),
+           (unsigned) (ENDPOINT_POOL_WARM_MAX_AGE_MS / 1000u));
+
+    // A failover onto a standby B has closed opens a new connection
+    // instead of failing the session on the dead one
+    broker_kill(&brokers[1]);
+    CHECK(broker_start(&brokers[1]));
+    sleep_ms(10);
+    CHECK(EndpointPool_Connect(&pool, b));
+    CHECK(b_accepts_since(accepts) == 3);
+    CHECK(b->health.consecutiveFailures == 0);
+
+    EndpointPool_Release(&pool);
+    for (size_t i = 0; i < pool.count; i++) {
+        if (pool.endpoints[i].connected) {
+            disconnect_endpoint(&pool.endpoints[i]);
+        }
+    }
+    broker_kill(&brokers[0]);
+    broker_kill(&brokers[1]);
+    return host_test_result();
+}
@@ -0,0 +1,464 @@
+/*
+    coreMQTT through the fault-injecting transport, against a broker
+    stand-in forked onto a loopback port. Every built-in scenario publishes
+    the same QoS1 messages as the demo does under fault injection: a
+    session that fails is reconnected, with back-off, and the message sent
+    again. Prints each scenario's success rate, reconnect time and
+    publish-to-PUBACK latency percentiles.
+
+    Checks that a scenario replays the same faults for the same seed and
+    different ones for another, and that the clean scenario loses nothing.
+
+    The decorator's delays go through Clock_SleepMs(), which here moves the
+    clock on instead of sleeping, so they show in every figure without
+    stretching the run.
+*/
+
+// MAP_ANONYMOUS, beyond the POSIX the other tests use
+#define _DEFAULT_SOURCE
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "clock.h"
+#include "core_mqtt.h"
+#include "fault_transport.h"
+#include "host_test.h"
+
+#define PUBLISHES 100
+#define TRIES 5                 // Sends of one message before it is given up
+#define CONNECT_ATTEMPTS 8
+#define BACKOFF_BASE_MS 500
+#define BACKOFF_MAX_MS 5000
+#define CONNACK_TIMEOUT_MS 1000
+#define ACK_TIMEOUT_MS 5000
+#define SEQUENCE_CALLS 2000
+
+struct NetworkContext {
+    int socket;
+};
+
+static uint16_t broker_port;
+static pid_t broker_pid;
+static struct NetworkContext context = { -1 };
+static FaultTransport_t fault;
+static FaultScenarioReport_t report;
+static MQTTContext_t mqtt;
+static uint8_t network_buffer[1024];
+static uint16_t pending_id;
+static uint32_t sent_ms;
+
+// Clock behind clock.h: real time plus every delay the decorator asked for
+
+static uint32_t skipped_ms;
+
+uint32_t Clock_GetTimeMs(void)
+{
+    return (uint32_t) (host_test_ns() / 1000000u) + skipped_ms;
+}
+
+void Clock_SleepMs(uint32_t sleepTimeMs)
+{
+    skipped_ms += sleepTimeMs;
+}
+
+// Broker stand-in: acknowledges every publish at once
+
+static bool read_all(int fd, uint8_t *buffer, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = read(fd, buffer, length);
+        if (n <= 0) {
+            return false;
+        }
+        buffer += n;
+        length -= (size_t) n;
+    }
+    return true;
+}
+
+static bool read_packet(int fd, uint8_t *header, uint8_t *body, size_t size, size_t *length)
+{
+    uint8_t byte;
+    size_t multiplier = 1;
+
+    *length = 0;
+    if (!read_all(fd, header, 1)) {
+        return false;
+    }
+    do {
+        if (!read_all(fd, &byte, 1) || multiplier > 128u * 128u * 128u) {
+            return false;
+        }
+        *length += (byte & 0x7fu) * multiplier;
+        multiplier *= 128u;
+    } while (byte & 0x80u);
+    return *length <= size && read_all(fd, body, *length);
+}
+
+static void serve_connection(int fd)
+{
+    uint8_t header, body[512];
+    size_t length;
+
+    while (read_packet(fd, &header, body, sizeof(body), &length)) {
+        switch (header >> 4) {
+        case 1: {
+            uint8_t connack[4] = { 0x20, 2, 0, 0 };
+
+            if (write(fd, connack, sizeof(connack)) != sizeof(connack)) {
+                return;
+            }
+            break;
+        }
+        case 3: {
+            size_t topic = (size_t) (body[0] << 8 | body[1]);
+
+            if (length < 2 + topic + 2 || ((header >> 1) & 3u) != 1) {
+                return;
+            }
+            uint8_t puback[4] = { 0x40, 2, body[2 + topic], body[2 + topic + 1] };
+            if (write(fd, puback, sizeof(puback)) != sizeof(puback)) {
+                return;
+            }
+            break;
+        }
+        case 12: {
+            uint8_t pingresp[2] = { 0xd0, 0 };
+
+            if (write(fd, pingresp, sizeof(pingresp)) != sizeof(pingresp)) {
+                return;
+            }
+            break;
+        }
+        default:
+            return;
+        }
+    }
+}
+
+static bool broker_start(void)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t length = sizeof(address);
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (listener < 0) {
+        return false;
+    }
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listener, 4) != 0 ||
+        getsockname(listener, (struct sockaddr *) &address, &length) != 0) {
+        close(listener);
+        return false;
+    }
+
+    broker_port = ntohs(address.sin_port);
+    broker_pid = fork();
+    if (broker_pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        for (;;) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                serve_connection(fd);
+                close(fd);
+            }
+        }
+    }
+    close(listener);
+    return broker_pid > 0;
+}
+
+// Client side
+
+static bool tcp_connect(void)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(broker_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    context.socket = fd;
+    return true;
+}
+
+static void tcp_close(void)
+{
+    if (context.socket >= 0) {
+        close(context.socket);
+        context.socket = -1;
+    }
+}
+
+static int32_t transport_send(NetworkContext_t *network, const void *buffer, size_t length)
+{
+    ssize_t n = send(network->socket, buffer, length, MSG_NOSIGNAL);
+
+    return n < 0 ? -1 : (int32_t) n;
+}
+
+// 0 when nothing arrived for a while, as the TLS transport on the device
+static int32_t transport_recv(NetworkContext_t *network, void *buffer, size_t length)
+{
+    struct pollfd ready = { .fd = network->socket, .events = POLLIN };
+    ssize_t n;
+
+    if (poll(&ready, 1, 5) == 0) {
+        return 0;
+    }
+    n = recv(network->socket, buffer, length, 0);
+    return n <= 0 ? -1 : (int32_t) n;
+}
+
+static void event_callback(MQTTContext_t *mqtt_context, MQTTPacketInfo_t *packet, MQTTDeserializedInfo_t *info)
+{
+    (void) mqtt_context;
+    if ((packet->type & 0xf0u) == MQTT_PACKET_TYPE_PUBACK && info->packetIdentifier == pending_id) {
+        FaultReport_RecordAck(&report, Clock_GetTimeMs() - sent_ms);
+        pending_id = MQTT_PACKET_ID_INVALID;
+    }
+}
+
+// A connection and an MQTT session, as connectToServerWithBackoffRetries()
+// makes them: the decorator may fail the attempt before it reaches the
+// network, and failed attempts back off exponentially
+static bool open_session(void)
+{
+    MQTTConnectInfo_t connect = {
+        .cleanSession = true,
+        .pClientIdentifier = "device",
+        .clientIdentifierLength = 6,
+        .keepAliveSeconds = 60,
+    };
+    uint32_t backoff_ms = BACKOFF_BASE_MS;
+    bool present;
+
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++) {
+        if (!FaultTransport_ShouldFailConnect(&fault) && tcp_connect()) {
+            FaultTransport_Rebind(&fault, &context, &mqtt.transportInterface);
+            FaultTransport_Reconnected(&fault);
+            if (MQTT_Connect(&mqtt, &connect, NULL, CONNACK_TIMEOUT_MS, &present) == MQTTSuccess) {
+                return true;
+            }
+            tcp_close();
+        }
+        Clock_SleepMs(backoff_ms);
+        backoff_ms = backoff_ms * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : backoff_ms * 2;
+    }
+    return false;
+}
+
+// Publish one message and wait for its PUBACK. Returns false, with the
+// connection closed, if the session failed on the way.
+static bool publish(uint32_t message)
+{
+    MQTTPublishInfo_t info = {
+        .qos = MQTTQoS1,
+        .pTopicName = "t",
+        .topicNameLength = 1,
+        .pPayload = &message,
+        .payloadLength = sizeof(message),
+    };
+    MQTTStatus_t status;
+
+    FaultReport_RecordPublish(&report);
+    pending_id = MQTT_GetPacketId(&mqtt);
+    sent_ms = Clock_GetTimeMs();
+    status = MQTT_Publish(&mqtt, &info, pending_id);
+    while (status == MQTTSuccess && pending_id != MQTT_PACKET_ID_INVALID &&
+           Clock_GetTimeMs() - sent_ms < ACK_TIMEOUT_MS) {
+        status = MQTT_ProcessLoop(&mqtt, 20);
+    }
+    if (pending_id != MQTT_PACKET_ID_INVALID) {
+        pending_id = MQTT_PACKET_ID_INVALID;
+        tcp_close();
+        return false;
+    }
+    return true;
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t count, size_t percent)
+{
+    return count > 0 ? sorted[(count * percent) / 100] : 0;
+}
+
+static int compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+static void run(const FaultTransportConfig_t *scenario)
+{
+    uint32_t sorted[FAULT_REPORT_LATENCY_SAMPLES];
+    uint32_t given_up = 0;
+
+    FaultTransport_SetConfig(&fault, scenario);
+    report = (FaultScenarioReport_t) { 0 };
+
+    // The first connection is not a reconnect
+    bool connected = open_session();
+    for (uint32_t message = 0; message < PUBLISHES; message++) {
+        bool acked = false;
+
+        for (int tries = 0; !acked && tries < TRIES; tries++) {
+            if (!connected) {
+                uint32_t start_ms = Clock_GetTimeMs();
+                connected = open_session();
+                FaultReport_RecordReconnect(&report, Clock_GetTimeMs() - start_ms, connected);
+                if (!connected) {
+                    continue;
+                }
+            }
+            acked = publish(message);
+            connected = acked;
+        }
+        given_up += !acked;
+    }
+    if (connected) {
+        (void) MQTT_Disconnect(&mqtt);
+        tcp_close();
+    }
+
+    size_t count = report.latencyCount < FAULT_REPORT_LATENCY_SAMPLES ? report.latencyCount
+                                                                      : FAULT_REPORT_LATENCY_SAMPLES;
+    memcpy(sorted, report.latencyMs, count * sizeof(sorted[0]));
+    qsort(sorted, count, sizeof(sorted[0]), compare);
+
+    printf("  %-9s %3u%% of %3u sends acked, %2u given up; %2u reconnects, avg %5u ms, max %5u ms, %u failed; "
+           "latency p50 %4u, p95 %4u, p99 %4u ms\n",
+           scenario->pName,
+           (unsigned) (report.publishAttempts ? report.publishAcked * 100 / report.publishAttempts : 0),
+           (unsigned) report.publishAttempts, (unsigned) given_up, (unsigned) report.reconnects,
+           (unsigned) (report.reconnects ? report.reconnectTotalMs / report.reconnects : 0),
+           (unsigned) report.reconnectMaxMs, (unsigned) report.reconnectFailures,
+           (unsigned) percentile(sorted, count, 50), (unsigned) percentile(sorted, count, 95),
+           (unsigned) percentile(sorted, count, 99));
+
+    if (strcmp(scenario->pName, "clean") == 0) {
+        CHECK(report.publishAcked == PUBLISHES && report.publishAttempts == PUBLISHES);
+        CHECK(report.reconnects == 0 && report.reconnectFailures == 0);
+    }
+    CHECK(report.publishAcked + given_up >= PUBLISHES);
+}
+
+// Fault sequence: what the decorator answers to a fixed run of calls
+
+static int32_t sink_send(NetworkContext_t *network, const void *buffer, size_t length)
+{
+    (void) network;
+    (void) buffer;
+    return (int32_t) length;
+}
+
+static int32_t sink_recv(NetworkContext_t *network, void *buffer, size_t length)
+{
+    (void) network;
+    (void) buffer;
+    return (int32_t) length;
+}
+
+static void sequence(const FaultTransportConfig_t *scenario, uint32_t seed, int32_t *results)
+{
+    static struct NetworkContext sink_context;
+    static uint8_t buffer[256];
+    FaultTransportConfig_t config = *scenario;
+    TransportInterface_t inner = { .recv = sink_recv, .send = sink_send, .pNetworkContext = &sink_context };
+    TransportInterface_t decorated;
+    FaultTransport_t instance;
+
+    config.seed = seed;
+    CHECK(FaultTransport_Init(&instance, &inner, &config, &decorated));
+    for (int i = 0; i < SEQUENCE_CALLS; i++) {
+        size_t length = 1 + i % sizeof(buffer);
+
+        switch (i % 3) {
+        case 0:
+            results[i] = decorated.send(decorated.pNetworkContext, buffer, length);
+            break;
+        case 1:
+            results[i] = decorated.recv(decorated.pNetworkContext, buffer, length);
+            break;
+        default:
+            results[i] = FaultTransport_ShouldFailConnect(&instance) ? -2 : 1;
+            break;
+        }
+        if (results[i] == -1) {
+            FaultTransport_Reconnected(&instance);
+        }
+    }
+    FaultTransport_Deinit(&instance);
+}
+
+static void same_seed_same_faults(const FaultTransportConfig_t *scenarios, size_t count)
+{
+    static int32_t first[SEQUENCE_CALLS], again[SEQUENCE_CALLS], other[SEQUENCE_CALLS];
+
+    puts("Fault sequences:");
+    for (size_t i = 0; i < count; i++) {
+        sequence(&scenarios[i], scenarios[i].seed, first);
+        sequence(&scenarios[i], scenarios[i].seed, again);
+        sequence(&scenarios[i], scenarios[i].seed + 100, other);
+
+        bool same = memcmp(first, again, sizeof(first)) == 0;
+        bool faulty = false;
+        for (int call = 0; call < SEQUENCE_CALLS; call++) {
+            faulty |= first[call] != 1 + (call % 3 == 2 ? 0 : call % 256);
+        }
+        bool differs = memcmp(first, other, sizeof(first)) != 0;
+
+        printf("  %-9s %s with its seed, %s with another\n", scenarios[i].pName,
+               same ? "replays" : "does not replay", !faulty ? "nothing injected" : differs ? "differs" : "same");
+        CHECK(same);
+        CHECK(!faulty || differs);
+    }
+}
+
+int main(void)
+{
+    TransportInterface_t transport = { .recv = transport_recv, .send = transport_send, .pNetworkContext = &context };
+    MQTTFixedBuffer_t buffer = { network_buffer, sizeof(network_buffer) };
+    size_t count;
+    const FaultTransportConfig_t *scenarios = FaultTransport_Scenarios(&count);
+
+    same_seed_same_faults(scenarios, count);
+
+    CHECK(broker_start());
+    CHECK(FaultTransport_Init(&fault, &transport, &scenarios[0], &transport));
+    CHECK(MQTT_Init(&mqtt, &transport, Clock_GetTimeMs, event_callback, &buffer) == MQTTSuccess);
+
+    printf("%d QoS1 publishes per scenario, each sent up to %d times:\n", PUBLISHES, TRIES);
+    for (size_t i = 0; i < count; i++) {
+        run(&scenarios[i]);
+    }
+
+    FaultTransport_Deinit(&fault);
+    kill(broker_pid, SIGKILL);
+    waitpid(broker_pid, NULL, 0);
+    return host_test_result();
+}
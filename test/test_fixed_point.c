@@ -0,0 +1,293 @@
+/*
+    Readings and the PID in fixed-point tenths: every DHT22 temperature
+    survives a JSON render and parse exactly, the fixed-point PID follows
+    the double-precision one it replaced on a heater model, and the cost of
+    one sample from the sensor's edges to its JSON payload, against
+    rendering the device identity for every sample and against the old
+    float and snprintf path.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ac_dimmer.h"
+#include "dht22_decode.h"
+#include "host_test.h"
+#include "sensor_filter.h"
+#include "telemetry.h"
+
+// Clock behind esp_timer_get_time() in the stand-in esp_timer.h
+int64_t host_esp_time_us;
+
+static volatile int sink;
+
+static void json_round_trip(void)
+{
+    char buffer[TELEMETRY_PAYLOAD_SIZE];
+    int fixed_wrong = 0, float_wrong = 0;
+
+    for (int tenths = -400; tenths <= 1000; tenths++) {
+        telemetry_reading_t reading = {
+            .sensor_ok = true,
+            .temperature_tenths = (int16_t) tenths,
+            .humidity_tenths = (int16_t) (tenths < 0 ? 0 : tenths),
+        };
+        int length = telemetry_encode_json(&reading, buffer, sizeof(buffer));
+        CHECK(length > 0 && length < (int) sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+        buffer[length] = '\0';
+
+        // Exact means even truncating the parsed value gives the tenths back
+        const char *field = strstr(buffer, "\"temperature\":");
+        CHECK(field != NULL);
+        if (field == NULL) {
+            continue;
+        }
+        double parsed = strtod(field + strlen("\"temperature\":"), NULL);
+        if ((int) (parsed * 10) != tenths || (int) lround(parsed * 10) != tenths) {
+            fixed_wrong++;
+        }
+
+        // The old payloads printed a float with %.2f
+        char old[16];
+        snprintf(old, sizeof(old), "%.2f", tenths / 10.f);
+        if ((int) (strtod(old, NULL) * 10) != tenths) {
+            float_wrong++;
+        }
+    }
+
+    printf("  -40.0 to 100.0 C: %d wrong after a round trip, %d with the old %%.2f float\n",
+           fixed_wrong, float_wrong);
+    CHECK(fixed_wrong == 0);
+}
+
+// The double-precision PID as it was before the fixed-point one
+typedef struct {
+    double kp, ki, kd;
+    double setpoint, max_safe;
+    double output_min, output_max;
+    double integral, last_input, output;
+    uint32_t last_time;
+} pid_double_t;
+
+static void pid_double_init(pid_double_t *pid, double kp, double ki, double kd, double setpoint,
+                            double output_min, double output_max, double max_safe)
+{
+    *pid = (pid_double_t) {
+        .kp = kp, .ki = ki, .kd = kd,
+        .setpoint = setpoint, .max_safe = max_safe,
+        .output_min = output_min, .output_max = output_max,
+        .last_time = (uint32_t) (esp_timer_get_time() / 1000),
+    };
+}
+
+static double pid_double_compute(pid_double_t *pid, double input)
+{
+    if (input > pid->max_safe) {
+        return 100;
+    }
+    uint32_t now = (uint32_t) (esp_timer_get_time() / 1000);
+    double time_change = now - pid->last_time;
+    if (time_change < 100) {
+        return pid->output;
+    }
+
+    double error = pid->setpoint - input;
+    pid->integral += pid->ki * error * time_change / 1000.0;
+    pid->integral = fmin(fmax(pid->integral, pid->output_min), pid->output_max);
+    double derivative = (input - pid->last_input) / (time_change / 1000.0);
+    pid->output = pid->kp * error + pid->integral - pid->kd * derivative;
+    pid->output = fmin(fmax(pid->output, pid->output_min), pid->output_max);
+    pid->last_input = input;
+    pid->last_time = now;
+    return pid->output;
+}
+
+// Both PIDs close the loop on their own first-order heater, from 20 C to
+// a 25 C setpoint, for two hours at one step every 2 s
+static void pid_closed_loop(void)
+{
+    pid_controller_t fixed;
+    pid_double_t reference;
+    double temperature = 20, reference_temperature = 20;
+    int max_output_diff = 0;
+    double max_temperature_diff = 0;
+
+    host_esp_time_us = 0;
+    pid_init(&fixed, 8000, 100, 2000, 250, 0, 100, 400);
+    pid_double_init(&reference, 8.0, 0.1, 2.0, 25.0, 0, 100, 40.0);
+
+    for (int step = 1; step <= 3600; step++) {
+        host_esp_time_us = (int64_t) step * 2000000;
+        int16_t tenths = (int16_t) lround(temperature * 10);
+        uint8_t output = pid_compute(&fixed, tenths);
+        double reference_output = pid_double_compute(&reference, lround(reference_temperature * 10) / 10.0);
+
+        int diff = abs(output - (int) lround(reference_output));
+        if (diff > max_output_diff) {
+            max_output_diff = diff;
+        }
+        temperature += (output / 100.0 * 0.05 - (temperature - 20) * 0.002) * 2;
+        reference_temperature += (reference_output / 100.0 * 0.05 - (reference_temperature - 20) * 0.002) * 2;
+        max_temperature_diff = fmax(max_temperature_diff, fabs(temperature - reference_temperature));
+    }
+
+    printf("  2 h closed loop: output at most %d%% and temperature at most %.3f C from the double PID, "
+           "ending at %.2f / %.2f C\n",
+           max_output_diff, max_temperature_diff, temperature, reference_temperature);
+    CHECK(max_output_diff <= 1);
+    CHECK(max_temperature_diff < 0.1);
+
+    const int calls = 2000000;
+    uint64_t start = host_test_ns();
+    for (int i = 0; i < calls; i++) {
+        host_esp_time_us += 2000000;
+        sink += pid_compute(&fixed, (int16_t) (240 + (i & 7)));
+    }
+    uint64_t fixed_ns = host_test_ns() - start;
+    start = host_test_ns();
+    for (int i = 0; i < calls; i++) {
+        host_esp_time_us += 2000000;
+        sink += (int) pid_double_compute(&reference, (240 + (i & 7)) / 10.0);
+    }
+    uint64_t double_ns = host_test_ns() - start;
+    printf("  pid_compute: fixed %.1f ns, double %.1f ns (the host has a double FPU; the ESP32 does not)\n",
+           (double) fixed_ns / calls, (double) double_ns / calls);
+}
+
+// Edges of a DHT22 frame carrying the given readings, as the driver
+// captures them
+static size_t build_frame(Dht22Edge_t *edges, int temperature_tenths, int humidity_tenths)
+{
+    uint16_t t = (uint16_t) (temperature_tenths < 0 ? 0x8000 | -temperature_tenths : temperature_tenths);
+    uint8_t data[DHT22_DATA_BYTES] = {
+        (uint8_t) (humidity_tenths >> 8), (uint8_t) humidity_tenths, (uint8_t) (t >> 8), (uint8_t) t,
+    };
+    uint32_t time = 0;
+    size_t n = 0;
+
+    data[4] = (uint8_t) (data[0] + data[1] + data[2] + data[3]);
+    edges[n++] = (Dht22Edge_t) { time, 1 };
+    time += 30;
+    edges[n++] = (Dht22Edge_t) { time, 0 };
+    time += 80;
+    edges[n++] = (Dht22Edge_t) { time, 1 };
+    time += 80;
+    for (int b = 0; b < 40; b++) {
+        edges[n++] = (Dht22Edge_t) { time, 0 };
+        time += 50;
+        edges[n++] = (Dht22Edge_t) { time, 1 };
+        time += (data[b / 8] & (0x80 >> (b % 8))) ? 70 : 27;
+    }
+    edges[n++] = (Dht22Edge_t) { time, 0 };
+    time += 50;
+    edges[n++] = (Dht22Edge_t) { time, 1 };
+    return n;
+}
+
+// One sample from captured edges to its payload: decode, filter and
+// compose in tenths, against decoding to floats and printing the whole
+// document with snprintf as before
+static void sample_to_payload(void)
+{
+    enum { FRAMES = 8, SAMPLES = 1000000 };
+    Dht22Edge_t edges[FRAMES][DHT22_MAX_EDGES];
+    size_t counts[FRAMES];
+    SensorFilterConfig_t t_config = { SensorFilterHampel, 5, 30, 2, -400, 800, 10, 2, 3 };
+    SensorFilterConfig_t h_config = { SensorFilterHampel, 5, 30, 5, 0, 1000, 20, 5, 3 };
+    SensorFilter_t t_filter, h_filter;
+    telemetry_composer_t composer;
+    char buffer[TELEMETRY_PAYLOAD_SIZE];
+    char old[TELEMETRY_PAYLOAD_SIZE];
+    uint32_t now_ms = 0;
+
+    for (int i = 0; i < FRAMES; i++) {
+        counts[i] = build_frame(edges[i], 215 + i, 480 + 2 * i);
+    }
+    CHECK(SensorFilter_Init(&t_filter, &t_config));
+    CHECK(SensorFilter_Init(&h_filter, &h_config));
+    telemetry_composer_init(&composer, buffer, sizeof(buffer));
+
+    uint64_t start = host_test_ns();
+    for (int i = 0; i < SAMPLES; i++) {
+        uint8_t data[DHT22_DATA_BYTES];
+        telemetry_reading_t reading = {
+            .uptime_ms = now_ms += 2000,
+            .interval_ms = 2000,
+            .sensor_ok = Dht22_DecodeEdges(edges[i % FRAMES], counts[i % FRAMES], data) == Dht22DecodeSuccess,
+            .dimmer_ch1 = 50,
+            .dimmer_enabled = true,
+        };
+        SensorQuality_t t_quality = SensorFilter_Add(&t_filter, Dht22_TemperatureTenths(data), now_ms,
+                                                     &reading.temperature_tenths);
+        SensorQuality_t h_quality = SensorFilter_Add(&h_filter, Dht22_HumidityTenths(data), now_ms,
+                                                     &reading.humidity_tenths);
+        reading.quality = (uint8_t) (t_quality > h_quality ? t_quality : h_quality);
+        sink += telemetry_compose(&composer, &reading, TELEMETRY_FORMAT_JSON);
+    }
+    uint64_t tenths_ns = host_test_ns() - start;
+
+    // Before the prefix was kept: the MAC formatted and the whole document,
+    // identity included, rendered for every sample
+    static const uint8_t mac[6] = { 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    start = host_test_ns();
+    for (int i = 0; i < SAMPLES; i++) {
+        uint8_t data[DHT22_DATA_BYTES];
+        char mac_str[18];
+        telemetry_reading_t reading = {
+            .uptime_ms = now_ms += 2000,
+            .interval_ms = 2000,
+            .sensor_ok = Dht22_DecodeEdges(edges[i % FRAMES], counts[i % FRAMES], data) == Dht22DecodeSuccess,
+            .dimmer_ch1 = 50,
+            .dimmer_enabled = true,
+        };
+        SensorQuality_t t_quality = SensorFilter_Add(&t_filter, Dht22_TemperatureTenths(data), now_ms,
+                                                     &reading.temperature_tenths);
+        SensorQuality_t h_quality = SensorFilter_Add(&h_filter, Dht22_HumidityTenths(data), now_ms,
+                                                     &reading.humidity_tenths);
+        reading.quality = (uint8_t) (t_quality > h_quality ? t_quality : h_quality);
+        snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        telemetry_set_identity(mac_str, "v4.4.4", "client");
+        sink += telemetry_encode_json(&reading, old, sizeof(old));
+    }
+    uint64_t full_ns = host_test_ns() - start;
+
+    start = host_test_ns();
+    for (int i = 0; i < SAMPLES; i++) {
+        uint8_t data[DHT22_DATA_BYTES];
+        char temperature[16], humidity[16];
+
+        now_ms += 2000;
+        Dht22_DecodeEdges(edges[i % FRAMES], counts[i % FRAMES], data);
+        snprintf(temperature, sizeof(temperature), "%.2f", Dht22_TemperatureTenths(data) / 10.f);
+        snprintf(humidity, sizeof(humidity), "%.2f", Dht22_HumidityTenths(data) / 10.f);
+        sink += snprintf(old, sizeof(old),
+                         "{\"client\":\"client\",\"status\":\"online\",\"device\":{\"hardware\":\"aa:bb:cc:dd:ee:ff\","
+                         "\"firmware\":\"v4.4.4\",\"uptime\":%u,\"interval\":2000},\"sensors\":{\"temperature\":\"%s\","
+                         "\"humidity\":\"%s\"},\"dimmer\":{\"channel1\":50,\"channel2\":0,\"enabled\":true}}",
+                         (unsigned) now_ms, temperature, humidity);
+    }
+    uint64_t float_ns = host_test_ns() - start;
+
+    printf("  sample to JSON payload: %.0f ns in tenths (decode, filter, compose after the kept prefix), "
+           "%.0f ns rendering the identity too, %.0f ns as floats through snprintf\n",
+           (double) tenths_ns / SAMPLES, (double) full_ns / SAMPLES, (double) float_ns / SAMPLES);
+    CHECK(t_filter.output >= 215 && t_filter.output <= 222);
+    CHECK(h_filter.output >= 480 && h_filter.output <= 494);
+}
+
+int main(void)
+{
+    telemetry_set_identity("aa:bb:cc:dd:ee:ff", "v4.4.4", "client");
+    puts("JSON round trip:");
+    json_round_trip();
+    puts("PID, fixed point against double:");
+    pid_closed_loop();
+    puts("Sample to payload:");
+    sample_to_payload();
+    return host_test_result();
+}
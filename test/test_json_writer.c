@@ -0,0 +1,352 @@
+/*
+    The streaming JSON writer: string escaping, overflow (Finish must leave
+    an empty string behind), fixed-point numbers down to INT32_MIN, the
+    nesting limit and resuming from a saved prefix. Then the bytes, encode
+    time and heap allocations of one telemetry payload, against the cJSON
+    tree it replaced when cJSON is installed on the host.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "json_writer.h"
+#include "telemetry.h"
+
+#ifdef HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#define ENCODES 200000
+
+static volatile int sink;
+
+// Heap calls, counted through the linker's --wrap of malloc and friends
+
+static unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+// Renders one string value at the top level and compares the document
+static void check_string(const char *value, const char *expected)
+{
+    char buffer[64];
+    JsonWriter_t writer;
+
+    JsonWriter_Init(&writer, buffer, sizeof(buffer));
+    JsonWriter_String(&writer, NULL, value);
+    int length = JsonWriter_Finish(&writer);
+    CHECK(length == (int) strlen(expected));
+    CHECK(strcmp(buffer, expected) == 0);
+}
+
+static void escaping(void)
+{
+    check_string("plain", "\"plain\"");
+    check_string("", "\"\"");
+    check_string("say \"hi\"", "\"say \\\"hi\\\"\"");
+    check_string("C:\\dht", "\"C:\\\\dht\"");
+    check_string("a\nb\rc\td", "\"a\\nb\\rc\\td\"");
+    check_string("\x01\x1f", "\"\\u0001\\u001f\"");
+    check_string("24\xc2\xb0""C", "\"24\xc2\xb0""C\"");
+
+    // Keys go through the same escaping
+    char buffer[64];
+    JsonWriter_t writer;
+    JsonWriter_Init(&writer, buffer, sizeof(buffer));
+    JsonWriter_BeginObject(&writer, NULL);
+    JsonWriter_Bool(&writer, "a\"b", true);
+    JsonWriter_EndObject(&writer);
+    CHECK(JsonWriter_Finish(&writer) > 0);
+    CHECK(strcmp(buffer, "{\"a\\\"b\":true}") == 0);
+}
+
+static int render_object(char *buffer, size_t size)
+{
+    JsonWriter_t writer;
+
+    JsonWriter_Init(&writer, buffer, size);
+    JsonWriter_BeginObject(&writer, NULL);
+    JsonWriter_String(&writer, "client", "esp32");
+    JsonWriter_Uint(&writer, "uptime", 4294967295u);
+    JsonWriter_EndObject(&writer);
+    return JsonWriter_Finish(&writer);
+}
+
+static void overflow(void)
+{
+    static const char expected[] = "{\"client\":\"esp32\",\"uptime\":4294967295}";
+    char buffer[64];
+
+    // Exactly the document and its terminator fits, one byte less does not
+    CHECK(render_object(buffer, sizeof(expected)) == (int) strlen(expected));
+    CHECK(strcmp(buffer, expected) == 0);
+    for (size_t size = 1; size < sizeof(expected); size++) {
+        memset(buffer, 'x', sizeof(buffer));
+        CHECK(render_object(buffer, size) == -1);
+        CHECK(buffer[0] == '\0');
+        // Nothing past the buffer is touched
+        CHECK(buffer[size] == 'x');
+    }
+
+    // Unbalanced nesting fails the same way
+    JsonWriter_t writer;
+    JsonWriter_Init(&writer, buffer, sizeof(buffer));
+    JsonWriter_BeginObject(&writer, NULL);
+    CHECK(JsonWriter_Finish(&writer) == -1);
+    CHECK(buffer[0] == '\0');
+
+    JsonWriter_Init(&writer, buffer, sizeof(buffer));
+    JsonWriter_EndArray(&writer);
+    CHECK(JsonWriter_Finish(&writer) == -1);
+    CHECK(buffer[0] == '\0');
+}
+
+static void check_fixed(int32_t value, uint8_t decimals, const char *expected)
+{
+    char buffer[32];
+    JsonWriter_t writer;
+
+    JsonWriter_Init(&writer, buffer, sizeof(buffer));
+    JsonWriter_Fixed(&writer, NULL, value, decimals);
+    CHECK(JsonWriter_Finish(&writer) == (int) strlen(expected));
+    if (strcmp(buffer, expected) != 0) {
+        fprintf(stderr, "  Fixed(%d, %u): %s, expected %s\n", (int) value, decimals, buffer, expected);
+        CHECK(strcmp(buffer, expected) == 0);
+    }
+}
+
+static void fixed(void)
+{
+    check_fixed(0, 1, "0.0");
+    check_fixed(5, 1, "0.5");
+    check_fixed(-5, 1, "-0.5");
+    check_fixed(-57, 1, "-5.7");
+    check_fixed(-400, 1, "-40.0");
+    check_fixed(1000, 1, "100.0");
+    check_fixed(-7, 3, "-0.007");
+    check_fixed(-42, 0, "-42");
+    check_fixed(INT32_MAX, 1, "214748364.7");
+    check_fixed(INT32_MIN, 0, "-2147483648");
+    check_fixed(INT32_MIN, 1, "-214748364.8");
+    check_fixed(INT32_MIN, 9, "-2.147483648");
+
+    // Every tenth a DHT22 can report parses back to itself
+    int wrong = 0;
+    for (int32_t tenths = -400; tenths <= 1250; tenths++) {
+        char buffer[16];
+        JsonWriter_t writer;
+        JsonWriter_Init(&writer, buffer, sizeof(buffer));
+        JsonWriter_Fixed(&writer, NULL, tenths, 1);
+        CHECK(JsonWriter_Finish(&writer) > 0);
+        if (lround(strtod(buffer, NULL) * 10) != tenths) {
+            wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+// Nests depth arrays and closes them again
+static int nest(int depth, char *buffer, size_t size)
+{
+    JsonWriter_t writer;
+
+    JsonWriter_Init(&writer, buffer, size);
+    for (int i = 0; i < depth; i++) {
+        JsonWriter_BeginArray(&writer, NULL);
+    }
+    JsonWriter_Int(&writer, NULL, -1);
+    for (int i = 0; i < depth; i++) {
+        JsonWriter_EndArray(&writer);
+    }
+    return JsonWriter_Finish(&writer);
+}
+
+static void depth_limit(void)
+{
+    char buffer[256];
+
+    CHECK(nest(JSON_WRITER_MAX_DEPTH, buffer, sizeof(buffer)) == 2 * JSON_WRITER_MAX_DEPTH + 2);
+    CHECK(buffer[JSON_WRITER_MAX_DEPTH - 1] == '[' && buffer[JSON_WRITER_MAX_DEPTH] == '-');
+    CHECK(nest(JSON_WRITER_MAX_DEPTH + 1, buffer, sizeof(buffer)) == -1);
+    CHECK(buffer[0] == '\0');
+
+    // Elements are separated at every level, the deepest one included
+    JsonWriter_t writer;
+    JsonWriter_Init(&writer, buffer, sizeof(buffer));
+    for (unsigned i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+        JsonWriter_BeginArray(&writer, NULL);
+        JsonWriter_Null(&writer, NULL);
+    }
+    for (unsigned i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+        JsonWriter_EndArray(&writer);
+    }
+    CHECK(JsonWriter_Finish(&writer) > 0);
+    CHECK(strncmp(buffer, "[null,[null,[", 13) == 0);
+}
+
+static void resume(void)
+{
+    static char prefix[64];
+    static JsonWriter_t checkpoint;
+    char full[128], resumed[128];
+    JsonWriter_t writer;
+
+    // The constant part, rendered once
+    JsonWriter_Init(&checkpoint, prefix, sizeof(prefix));
+    JsonWriter_BeginObject(&checkpoint, NULL);
+    JsonWriter_String(&checkpoint, "client", "esp32");
+    JsonWriter_BeginObject(&checkpoint, "device");
+    CHECK(!checkpoint.failed);
+
+    for (uint32_t uptime = 0; uptime < 3; uptime++) {
+        JsonWriter_Init(&writer, full, sizeof(full));
+        JsonWriter_BeginObject(&writer, NULL);
+        JsonWriter_String(&writer, "client", "esp32");
+        JsonWriter_BeginObject(&writer, "device");
+        JsonWriter_Uint(&writer, "uptime", uptime);
+        JsonWriter_EndObject(&writer);
+        JsonWriter_EndObject(&writer);
+        int full_length = JsonWriter_Finish(&writer);
+
+        memcpy(resumed, prefix, checkpoint.length);
+        JsonWriter_Resume(&writer, &checkpoint, resumed, sizeof(resumed));
+        JsonWriter_Uint(&writer, "uptime", uptime);
+        JsonWriter_EndObject(&writer);
+        JsonWriter_EndObject(&writer);
+        CHECK(JsonWriter_Finish(&writer) == full_length);
+        CHECK(strcmp(resumed, full) == 0);
+    }
+
+    // A buffer that cannot even hold the prefix fails
+    JsonWriter_Resume(&writer, &checkpoint, resumed, checkpoint.length);
+    JsonWriter_EndObject(&writer);
+    JsonWriter_EndObject(&writer);
+    CHECK(JsonWriter_Finish(&writer) == -1);
+    CHECK(resumed[0] == '\0');
+}
+
+#ifdef HAVE_CJSON
+// A shared libcjson is out of --wrap's reach, so route it through the
+// counted malloc with its hooks
+static void *counted_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+// The payload as DHT_reader_task() built it before the writer: a cJSON tree
+// with the readings as %.2f strings, printed and freed on every sample
+static int cjson_payload(const telemetry_reading_t *reading)
+{
+    char humidity[10], temperature[10];
+
+    snprintf(humidity, sizeof(humidity), "%.2f", reading->humidity_tenths / 10.f);
+    snprintf(temperature, sizeof(temperature), "%.2f", reading->temperature_tenths / 10.f);
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON *device = cJSON_CreateObject();
+    cJSON *sensors = cJSON_CreateObject();
+    cJSON *dimmer = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "device", device);
+    cJSON_AddItemToObject(root, "sensors", sensors);
+    cJSON_AddItemToObject(root, "dimmer", dimmer);
+    cJSON_AddNumberToObject(device, "uptime", reading->uptime_ms);
+    cJSON_AddStringToObject(device, "hardware", "24:0a:c4:12:34:56");
+    cJSON_AddStringToObject(device, "firmware", "v4.4.4");
+    cJSON_AddStringToObject(sensors, "temperature", temperature);
+    cJSON_AddStringToObject(sensors, "humidity", humidity);
+    cJSON_AddNumberToObject(dimmer, "channel1", reading->dimmer_ch1);
+    cJSON_AddNumberToObject(dimmer, "channel2", reading->dimmer_ch2);
+    cJSON_AddBoolToObject(dimmer, "enabled", reading->dimmer_enabled);
+    cJSON_AddStringToObject(root, "client", "esp32-dht22-01");
+    cJSON_AddStringToObject(root, "status", "online");
+
+    char *text = cJSON_Print(root);
+    int length = (int) strlen(text);
+    cJSON_Delete(root);
+    cJSON_free(text);
+    return length;
+}
+#endif
+
+static void payload_cost(void)
+{
+    telemetry_reading_t reading = {
+        .uptime_ms = 86400123,
+        .interval_ms = 5000,
+        .sensor_ok = true,
+        .temperature_tenths = -57,
+        .humidity_tenths = 497,
+        .dimmer_ch1 = 35,
+        .dimmer_ch2 = 100,
+        .dimmer_enabled = true,
+    };
+    char buffer[TELEMETRY_PAYLOAD_SIZE];
+
+    telemetry_set_identity("24:0a:c4:12:34:56", "v4.4.4", "esp32-dht22-01");
+
+    puts("One telemetry payload:");
+    allocations = 0;
+    int length = telemetry_encode_json(&reading, buffer, sizeof(buffer));
+    unsigned long writer_allocations = allocations;
+    uint64_t start = host_test_ns();
+    for (int i = 0; i < ENCODES; i++) {
+        reading.uptime_ms += 5000;
+        sink += telemetry_encode_json(&reading, buffer, sizeof(buffer));
+    }
+    uint64_t writer_ns = host_test_ns() - start;
+    printf("  writer: %3d B, %5.0f ns, %lu allocations\n",
+           length, (double) writer_ns / ENCODES, writer_allocations);
+    CHECK(length > 0);
+    CHECK(writer_allocations == 0);
+
+#ifdef HAVE_CJSON
+    cJSON_Hooks hooks = { counted_malloc, free };
+    cJSON_InitHooks(&hooks);
+    allocations = 0;
+    int cjson_length = cjson_payload(&reading);
+    unsigned long cjson_allocations = allocations;
+    start = host_test_ns();
+    for (int i = 0; i < ENCODES; i++) {
+        reading.uptime_ms += 5000;
+        sink += cjson_payload(&reading);
+    }
+    uint64_t cjson_ns = host_test_ns() - start;
+    printf("  cJSON:  %3d B, %5.0f ns, %lu allocations\n",
+           cjson_length, (double) cjson_ns / ENCODES, cjson_allocations);
+#else
+    puts("  cJSON:  not installed on this host, no comparison");
+#endif
+}
+
+int main(void)
+{
+    escaping();
+    overflow();
+    fixed();
+    depth_limit();
+    resume();
+    payload_cost();
+    return host_test_result();
+}
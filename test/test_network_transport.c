@@ -0,0 +1,360 @@
+/*
+    The TLS transport statistics, through the transport itself against an
+    esp-tls stand-in whose calls take as long on the esp_timer clock as
+    the test says. Checks the latency bucket of every duration from 0 us
+    up to and past 2^22 us, the buckets saturating while the counts go on,
+    the send, receive and connect counters, the JSON rendering and that it
+    fails cleanly into every buffer too short for it.
+
+    Built a second time as test_network_transport_off, with
+    CONFIG_CORE_MQTT_TRANSPORT_STATS unset as it ships: the transport then
+    has no statistics functions, its calls still work, and both builds
+    print what a send costs.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "network_transport.h"
+
+#define SENDS 1000000
+
+int64_t host_esp_time_us;
+
+// The connection behind the esp-tls stand-in: how long the next call
+// takes and what it returns
+static struct {
+    uint32_t us;
+    int result;
+} peer;
+
+static esp_tls_t tls;
+
+esp_tls_t *esp_tls_init(void)
+{
+    return &tls;
+}
+
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *handle)
+{
+    (void) hostname;
+    (void) hostlen;
+    (void) port;
+    (void) cfg;
+    (void) handle;
+    host_esp_time_us += peer.us;
+    return peer.result;
+}
+
+int esp_tls_conn_destroy(esp_tls_t *handle)
+{
+    (void) handle;
+    return 0;
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t *handle, const void *data, size_t length)
+{
+    (void) handle;
+    (void) data;
+    (void) length;
+    host_esp_time_us += peer.us;
+    return peer.result;
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t *handle, void *data, size_t length)
+{
+    (void) handle;
+    (void) data;
+    (void) length;
+    host_esp_time_us += peer.us;
+    return peer.result;
+}
+
+esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t handle, int *code, int *flags)
+{
+    (void) handle;
+    (void) code;
+    (void) flags;
+    return ESP_FAIL;
+}
+
+mbedtls_ssl_context *esp_tls_get_ssl_context(esp_tls_t *handle)
+{
+    (void) handle;
+    return NULL;
+}
+
+const char *mbedtls_ssl_get_ciphersuite(const mbedtls_ssl_context *ssl)
+{
+    (void) ssl;
+    return "TLS-ECDHE-ECDSA-WITH-AES-128-GCM-SHA256";
+}
+
+size_t mbedtls_ssl_get_input_max_frag_len(const mbedtls_ssl_context *ssl)
+{
+    (void) ssl;
+    return 16384;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 0;
+}
+
+static NetworkContext_t context = {
+    .pxTls = &tls,
+    .pcHostname = "broker",
+    .xPort = 8883,
+    .pcServerRootCAPem = "",
+    .pcClientCertPem = "",
+    .pcClientKeyPem = "",
+};
+
+static int32_t send_taking(uint32_t us, int result)
+{
+    static const char data[64];
+
+    peer.us = us;
+    peer.result = result;
+    return espTlsTransportSend(&context, data, sizeof(data));
+}
+
+static int32_t recv_taking(uint32_t us, int result)
+{
+    char data[64];
+
+    peer.us = us;
+    peer.result = result;
+    return espTlsTransportRecv(&context, data, sizeof(data));
+}
+
+// What a send costs with the transport as built, stand-in call included
+static void send_cost(const char *build)
+{
+    uint64_t start = host_test_ns();
+
+    for (int i = 0; i < SENDS; i++)
+        send_taking(0, 64);
+    printf("  %.1f ns a send, %s\n", (double) (host_test_ns() - start) / SENDS, build);
+}
+
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+
+static TlsTransportStats_t take_stats(void)
+{
+    TlsTransportStats_t stats;
+
+    vTlsTransportGetStats(&context, &stats, true);
+    return stats;
+}
+
+// The bucket the histogram doc comment puts a call of us microseconds in
+static int expected_bucket(uint64_t us)
+{
+    int bucket = 0;
+
+    while (bucket < TLS_TRANSPORT_LATENCY_BUCKETS - 1 && us >= (2ull << bucket))
+        bucket++;
+    return bucket;
+}
+
+// One send taking us microseconds must land in the expected bucket alone
+static bool lands_in(uint32_t us, int bucket)
+{
+    send_taking(us, 64);
+    TlsTransportStats_t stats = take_stats();
+    const TlsTransportLatency_t *latency = &stats.xSendLatency;
+    bool ok = latency->ulCount == 1 && latency->ulMaxUs == us && latency->ullTotalUs == us;
+
+    for (int i = 0; i < TLS_TRANSPORT_LATENCY_BUCKETS; i++)
+        ok = ok && latency->usBuckets[i] == (i == bucket);
+    return ok;
+}
+
+static void buckets(void)
+{
+    int wrong = 0;
+
+    puts("Latency buckets:");
+    CHECK(lands_in(0, 0));
+    CHECK(lands_in(1, 0));
+    CHECK(lands_in(2, 1));
+    CHECK(lands_in((1u << 22) - 1, 21));
+    CHECK(lands_in(1u << 22, TLS_TRANSPORT_LATENCY_BUCKETS - 1));
+    CHECK(lands_in(UINT32_MAX, TLS_TRANSPORT_LATENCY_BUCKETS - 1));
+
+    // Both sides of every power of two
+    for (int shift = 1; shift < 32; shift++) {
+        uint32_t edge = 1u << shift;
+
+        wrong += !lands_in(edge - 1, expected_bucket(edge - 1));
+        wrong += !lands_in(edge, expected_bucket(edge));
+        wrong += !lands_in(edge + 1, expected_bucket(edge + 1));
+    }
+    printf("  0 us to 2^32 - 1 us, 93 durations around the powers of two: %d in the wrong bucket\n", wrong);
+    CHECK(wrong == 0);
+}
+
+static void saturation(void)
+{
+    const uint32_t calls = 3 * (uint32_t) UINT16_MAX;
+
+    puts("Saturation:");
+    for (uint32_t i = 0; i < calls; i++)
+        send_taking(5, 64);
+    send_taking(1000, 64);
+    TlsTransportStats_t stats = take_stats();
+    const TlsTransportLatency_t *latency = &stats.xSendLatency;
+
+    printf("  %lu sends of 5 us and one of 1000 us: bucket 2 holds %u, bucket 9 %u, count %lu\n",
+           (unsigned long) calls, latency->usBuckets[2], latency->usBuckets[9], (unsigned long) latency->ulCount);
+    CHECK(latency->usBuckets[2] == UINT16_MAX);
+    CHECK(latency->usBuckets[9] == 1);
+    CHECK(latency->ulCount == calls + 1);
+    CHECK(latency->ullTotalUs == 5ull * calls + 1000);
+    CHECK(latency->ulMaxUs == 1000);
+    CHECK(stats.ulSendCalls == calls + 1);
+    CHECK(stats.ulBytesSent == 64 * (calls + 1));
+}
+
+static void counters(void)
+{
+    puts("Counters:");
+    CHECK(send_taking(3, 64) == 64);
+    CHECK(send_taking(3, 10) == 10);
+    CHECK(send_taking(3, -1) == -1);
+    CHECK(recv_taking(3, 64) == 64);
+    CHECK(recv_taking(3, 20) == 20);
+    CHECK(recv_taking(3, ESP_TLS_ERR_SSL_WANT_READ) == 0);
+    CHECK(recv_taking(3, ESP_TLS_ERR_SSL_WANT_WRITE) == 0);
+    CHECK(recv_taking(3, 0) == -1);
+    CHECK(recv_taking(3, -1) == -1);
+
+    peer.us = 150000;
+    peer.result = 1;
+    CHECK(xTlsConnect(&context) == TLS_TRANSPORT_SUCCESS);
+    peer.us = 3000000;
+    peer.result = -1;
+    CHECK(xTlsConnect(&context) == TLS_TRANSPORT_CONNECT_FAILURE);
+    context.pxTls = &tls;
+
+    TlsTransportStats_t stats = take_stats();
+
+    printf("  sends %lu, partial %lu, failed %lu; receives %lu, partial %lu, WANT_READ %lu, failed or closed %lu; "
+           "connects %lu, failed %lu\n",
+           (unsigned long) stats.ulSendCalls, (unsigned long) stats.ulSendPartial, (unsigned long) stats.ulSendErrors,
+           (unsigned long) stats.ulRecvCalls, (unsigned long) stats.ulRecvPartial, (unsigned long) stats.ulRecvWantRead,
+           (unsigned long) stats.ulRecvErrors, (unsigned long) stats.ulConnects, (unsigned long) stats.ulConnectFailures);
+    CHECK(stats.ulSendCalls == 3 && stats.ulSendPartial == 1 && stats.ulSendErrors == 1);
+    CHECK(stats.ulBytesSent == 74);
+    CHECK(stats.ulRecvCalls == 6 && stats.ulRecvPartial == 1 && stats.ulRecvWantRead == 2);
+    CHECK(stats.ulRecvErrors == 2 && stats.ulBytesReceived == 84);
+    CHECK(stats.ulConnects == 1 && stats.ulConnectFailures == 1);
+    CHECK(stats.xSendLatency.ulCount == 3 && stats.xSendLatency.usBuckets[1] == 3);
+    CHECK(stats.xRecvLatency.ulCount == 6 && stats.xRecvLatency.usBuckets[1] == 6);
+    CHECK(stats.xConnectLatency.usBuckets[17] == 1 && stats.xConnectLatency.usBuckets[21] == 1);
+    CHECK(stats.xConnectLatency.ulMaxUs == 3000000);
+
+    // Reset means reset
+    stats = take_stats();
+    CHECK(stats.ulSendCalls == 0 && stats.xConnectLatency.ulCount == 0);
+}
+
+static void format(void)
+{
+    static const char expected[] =
+        "{\"send\":{\"calls\":2,\"partial\":1,\"errors\":0,\"bytes\":74},"
+        "\"recv\":{\"calls\":0,\"want_read\":0,\"partial\":0,\"errors\":0,\"bytes\":0},"
+        "\"connect\":{\"ok\":1,\"failed\":0},"
+        "\"send_latency\":{\"count\":2,\"max_us\":9,\"avg_us\":5,\"log2_us\":[1,0,0,1]},"
+        "\"recv_latency\":{\"count\":0,\"max_us\":0,\"avg_us\":0,\"log2_us\":[]},"
+        "\"connect_latency\":{\"count\":1,\"max_us\":4194304,\"avg_us\":4194304,"
+        "\"log2_us\":[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1]}}";
+    const size_t length = sizeof(expected) - 1;
+    char buffer[sizeof(expected) + 16];
+    int wrong = 0;
+
+    puts("Formatting:");
+    send_taking(1, 64);
+    send_taking(9, 10);
+    peer.us = 1u << 22;
+    peer.result = 1;
+    xTlsConnect(&context);
+    TlsTransportStats_t stats = take_stats();
+
+    CHECK(lTlsTransportFormatStats(&stats, buffer, sizeof(buffer)) == (int32_t) length);
+    CHECK(strcmp(buffer, expected) == 0);
+
+    // Every buffer from none at all to exactly large enough, with guard
+    // bytes behind it that must survive
+    for (size_t size = 0; size <= length + 1; size++) {
+        memset(buffer, '#', sizeof(buffer));
+        int32_t written = lTlsTransportFormatStats(&stats, buffer, size);
+
+        wrong += written != (size > length ? (int32_t) length : -1);
+        for (size_t i = size; i < sizeof(buffer); i++)
+            wrong += buffer[i] != '#';
+    }
+    printf("  %zu bytes; buffers of 0 to %zu bytes: %d wrong results or writes past the end\n",
+           length, length + 1, wrong);
+    CHECK(wrong == 0);
+
+    // Every counter and bucket at its limit
+    memset(&stats, 0xff, sizeof(stats));
+    int32_t longest = lTlsTransportFormatStats(&stats, NULL, 0);
+    char *full = malloc(4096);
+
+    CHECK(longest == -1);
+    longest = lTlsTransportFormatStats(&stats, full, 4096);
+    printf("  %d bytes with every counter and bucket at its limit\n", (int) longest);
+    CHECK(longest > 0 && (size_t) longest == strlen(full));
+    // Must fit the demo's TRANSPORT_STATS_PAYLOAD_SIZE
+    CHECK(longest < 1024);
+    free(full);
+}
+
+#else
+
+// Declared by network_transport.h only with the statistics on
+__attribute__((weak)) void vTlsTransportGetStats(NetworkContext_t *, void *, bool);
+__attribute__((weak)) int32_t lTlsTransportFormatStats(const void *, char *, size_t);
+
+static void compiled_out(void)
+{
+    puts("Statistics off:");
+    CHECK(vTlsTransportGetStats == NULL);
+    CHECK(lTlsTransportFormatStats == NULL);
+    CHECK(send_taking(3, 64) == 64);
+    CHECK(send_taking(3, -1) == -1);
+    CHECK(recv_taking(3, 20) == 20);
+    CHECK(recv_taking(3, ESP_TLS_ERR_SSL_WANT_READ) == 0);
+    peer.result = 1;
+    CHECK(xTlsConnect(&context) == TLS_TRANSPORT_SUCCESS);
+    printf("  no statistics functions, no counters in the %zu byte NetworkContext_t; calls unchanged\n",
+           sizeof(NetworkContext_t));
+}
+
+#endif
+
+int main(void)
+{
+#if CONFIG_CORE_MQTT_TRANSPORT_STATS
+    buckets();
+    saturation();
+    counters();
+    format();
+    puts("Cost:");
+    send_cost("statistics on");
+#else
+    compiled_out();
+    puts("Cost:");
+    send_cost("statistics off");
+#endif
+    return host_test_result();
+}
@@ -0,0 +1,191 @@
+/*
+    Offline log on the memory-mapped NOR flash backend: order and the read
+    position across reboots, drop accounting when the log wraps, records
+    torn by a reset or corrupted after mount, a record larger than the
+    reader's buffer, and append and drain rates for 200-byte records.
+*/
+
+#include <string.h>
+#include <unistd.h>
+
+#include "host_test.h"
+#include "offline_log.h"
+
+#define SEGMENT_SIZE 4096
+#define LOG_FILE "test_offline_log.bin"
+
+static OfflineLogBackend_t backend;
+static OfflineLog_t offline_log;
+
+static void mount(uint32_t segments, bool fresh)
+{
+    if (fresh) {
+        unlink(LOG_FILE);
+    } else {
+        OfflineLogMmap_Close(&backend);
+    }
+    CHECK(OfflineLogMmap_Open(&backend, LOG_FILE, SEGMENT_SIZE, segments));
+    CHECK(OfflineLog_Init(&offline_log, &backend) == OfflineLogSuccess);
+}
+
+static OfflineLogStatus_t next(OfflineLogCursor_t *cursor, char *buffer, size_t size, uint16_t *length)
+{
+    uint8_t tag;
+
+    return OfflineLog_Next(&offline_log, cursor, buffer, size, length, &tag);
+}
+
+// Clears bits in the last data byte written, as flash decay or a torn
+// write would
+static void corrupt_last_record(void)
+{
+    uint8_t zero = 0;
+
+    backend.write(backend.pContext, offline_log.writeSegment * SEGMENT_SIZE + offline_log.writeOffset - 4, &zero, 1);
+}
+
+static void order_and_reboot(void)
+{
+    OfflineLogCursor_t cursor;
+    char buffer[64], expected[64];
+    uint16_t length;
+    uint8_t tag;
+
+    mount(8, true);
+    CHECK(OfflineLog_Pending(&offline_log) == 0);
+    OfflineLog_Begin(&offline_log, &cursor);
+    CHECK(next(&cursor, buffer, sizeof(buffer), &length) == OfflineLogEmpty);
+
+    for (int i = 0; i < 50; i++) {
+        int n = snprintf(buffer, sizeof(buffer), "record %d", i);
+        CHECK(OfflineLog_Append(&offline_log, buffer, (uint16_t) n, (uint8_t) (i & 1)) == OfflineLogSuccess);
+    }
+    CHECK(OfflineLog_Consume(&offline_log, 10) == OfflineLogSuccess);
+    CHECK(OfflineLog_Pending(&offline_log) == 40);
+
+    mount(8, false);
+    CHECK(OfflineLog_Pending(&offline_log) == 40);
+    OfflineLog_Begin(&offline_log, &cursor);
+    for (int i = 10; i < 50; i++) {
+        CHECK(OfflineLog_Next(&offline_log, &cursor, buffer, sizeof(buffer) - 1, &length, &tag) == OfflineLogSuccess);
+        buffer[length] = '\0';
+        snprintf(expected, sizeof(expected), "record %d", i);
+        CHECK(strcmp(buffer, expected) == 0);
+        CHECK(tag == (i & 1));
+    }
+    CHECK(next(&cursor, buffer, sizeof(buffer), &length) == OfflineLogEmpty);
+    puts("  order, tags and read position kept across a reboot");
+}
+
+// 200-byte records, about 19 to a segment: appending 1000 to 8 segments
+// reuses the oldest ones, and every record is either pending or dropped
+static void wrap(void)
+{
+    OfflineLogCursor_t cursor;
+    char buffer[256];
+    uint16_t length;
+    uint32_t before = OfflineLog_Pending(&offline_log), read = 0;
+    int previous = -1;
+    bool in_order = true;
+
+    memset(buffer, 'a', sizeof(buffer));
+    for (int i = 0; i < 1000; i++) {
+        memcpy(buffer, &i, sizeof(i));
+        CHECK(OfflineLog_Append(&offline_log, buffer, 200, 0) == OfflineLogSuccess);
+    }
+    uint32_t pending = OfflineLog_Pending(&offline_log);
+    uint32_t dropped = OfflineLog_Dropped(&offline_log);
+    CHECK(pending + dropped == before + 1000);
+
+    mount(8, false);
+    CHECK(OfflineLog_Pending(&offline_log) == pending);
+    OfflineLog_Begin(&offline_log, &cursor);
+    while (next(&cursor, buffer, sizeof(buffer), &length) == OfflineLogSuccess) {
+        int value;
+        memcpy(&value, buffer, sizeof(value));
+        in_order &= previous < 0 || value == previous + 1;
+        previous = value;
+        read++;
+    }
+    CHECK(in_order);
+    CHECK(read == pending && previous == 999);
+    printf("  1000 appends to 8 segments: %u pending, %u dropped, max erase count %u\n", pending, dropped,
+           OfflineLog_MaxEraseCount(&offline_log));
+}
+
+// A record torn by a reset is not counted at mount. One corrupted after
+// mount is still counted but never read back: the reader sees Empty with
+// records pending, and consuming drops them from the count. A record
+// larger than the buffer stays put.
+static void unreadable(void)
+{
+    OfflineLogCursor_t cursor;
+    char buffer[256];
+    uint16_t length;
+
+    mount(8, true);
+    CHECK(OfflineLog_Append(&offline_log, "hello", 5, 3) == OfflineLogSuccess);
+    CHECK(OfflineLog_Append(&offline_log, "world", 5, 3) == OfflineLogSuccess);
+    corrupt_last_record();
+    mount(8, false);
+    CHECK(OfflineLog_Pending(&offline_log) == 1);
+
+    CHECK(OfflineLog_Consume(&offline_log, 1) == OfflineLogSuccess);
+    CHECK(OfflineLog_Append(&offline_log, "again", 5, 3) == OfflineLogSuccess);
+    corrupt_last_record();
+    CHECK(OfflineLog_Pending(&offline_log) == 1);
+    OfflineLog_Begin(&offline_log, &cursor);
+    CHECK(next(&cursor, buffer, sizeof(buffer), &length) == OfflineLogEmpty);
+    CHECK(OfflineLog_Consume(&offline_log, 1) == OfflineLogSuccess);
+    CHECK(OfflineLog_Pending(&offline_log) == 0);
+
+    memset(buffer, 'b', 200);
+    CHECK(OfflineLog_Append(&offline_log, buffer, 200, 0) == OfflineLogSuccess);
+    OfflineLog_Begin(&offline_log, &cursor);
+    CHECK(next(&cursor, buffer, 100, &length) == OfflineLogBufferTooSmall);
+    CHECK(OfflineLog_Pending(&offline_log) == 1);
+    OfflineLog_Begin(&offline_log, &cursor);
+    CHECK(next(&cursor, buffer, sizeof(buffer), &length) == OfflineLogSuccess && length == 200);
+    puts("  torn and corrupted records skipped, oversized record kept");
+}
+
+static void rates(void)
+{
+    OfflineLogCursor_t cursor;
+    char buffer[256];
+    uint16_t length;
+    uint32_t drained = 0;
+
+    mount(1024, true);
+    memset(buffer, 'c', sizeof(buffer));
+    uint64_t start = host_test_ns();
+    for (int i = 0; i < 100000; i++) {
+        CHECK(OfflineLog_Append(&offline_log, buffer, 200, 0) == OfflineLogSuccess);
+    }
+    double append_s = (host_test_ns() - start) / 1e9;
+
+    uint32_t pending = OfflineLog_Pending(&offline_log);
+    start = host_test_ns();
+    OfflineLog_Begin(&offline_log, &cursor);
+    while (next(&cursor, buffer, sizeof(buffer), &length) == OfflineLogSuccess) {
+        drained++;
+    }
+    CHECK(OfflineLog_Consume(&offline_log, drained) == OfflineLogSuccess);
+    double drain_s = (host_test_ns() - start) / 1e9;
+
+    printf("  200-byte records, 1024 segments: %.0f appends/s, %u drained at %.0f records/s\n", 100000 / append_s,
+           drained, drained / drain_s);
+    CHECK(drained == pending);
+    CHECK(OfflineLog_Pending(&offline_log) == 0);
+}
+
+int main(void)
+{
+    order_and_reboot();
+    wrap();
+    unreadable();
+    rates();
+    OfflineLogMmap_Close(&backend);
+    unlink(LOG_FILE);
+    return host_test_result();
+}
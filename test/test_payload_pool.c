@@ -0,0 +1,189 @@
+/*
+    Payload pool: store, find and release across the packet ID wrap, full
+    pool accounting, colliding buckets, a random store/release sequence
+    checked against a model, and the cost of one release plus store with
+    1024 payloads in flight, next to the linear scan it replaced.
+*/
+
+#include <string.h>
+
+#include "host_test.h"
+#include "payload_pool.h"
+
+#define SLOTS 1024
+#define SLOT_SIZE 64
+#define MODEL_STEPS 2000000
+#define BENCH_OPS 5000000L
+#define SCAN_OPS 200000L
+
+static PayloadPoolSlot_t slots[SLOTS];
+static uint8_t storage[SLOTS * SLOT_SIZE];
+static uint16_t buckets[SLOTS];
+
+static uint16_t next_id(uint16_t *id)
+{
+    if (*id == 0) {
+        *id = 1;
+    }
+    return (*id)++;
+}
+
+static void basics(PayloadPool_t *pool)
+{
+    uint16_t ids[SLOTS], slot, id = 65000;
+    char text[16];
+
+    CHECK(!PayloadPool_Init(pool, slots, SLOTS, storage, SLOT_SIZE, buckets, 1000));
+    CHECK(PayloadPool_Init(pool, slots, SLOTS, storage, SLOT_SIZE, buckets, SLOTS));
+    CHECK(PayloadPool_Store(pool, 1, text, SLOT_SIZE + 1, &slot) == PayloadPoolTooLarge);
+
+    // Fill it with packet IDs running across the wrap, skipping 0
+    for (int i = 0; i < SLOTS; i++) {
+        ids[i] = next_id(&id);
+        snprintf(text, sizeof(text), "m%u", ids[i]);
+        CHECK(PayloadPool_Store(pool, ids[i], text, (uint16_t) (strlen(text) + 1), &slot) == PayloadPoolSuccess);
+    }
+    CHECK(PayloadPool_Available(pool) == 0);
+    CHECK(PayloadPool_Store(pool, id, text, 1, &slot) == PayloadPoolExhausted);
+    CHECK(PayloadPool_Exhausted(pool) == 1);
+    for (int i = 0; i < SLOTS; i++) {
+        snprintf(text, sizeof(text), "m%u", ids[i]);
+        CHECK(PayloadPool_Find(pool, ids[i], &slot));
+        CHECK(strcmp((const char *) PayloadPool_Data(pool, slot), text) == 0);
+        CHECK(PayloadPool_Length(pool, slot) == strlen(text) + 1);
+    }
+
+    // Release every other one
+    for (int i = 0; i < SLOTS; i += 2) {
+        CHECK(PayloadPool_Release(pool, ids[i], NULL));
+    }
+    CHECK(!PayloadPool_Release(pool, ids[0], NULL));
+    CHECK(PayloadPool_Available(pool) == SLOTS / 2);
+    for (int i = 0; i < SLOTS; i++) {
+        CHECK(PayloadPool_Find(pool, ids[i], &slot) == (i % 2 == 1));
+    }
+
+    // IDs that share a bucket
+    CHECK(PayloadPool_Store(pool, 3, "a", 2, &slot) == PayloadPoolSuccess);
+    CHECK(PayloadPool_Store(pool, 3 + SLOTS, "b", 2, &slot) == PayloadPoolSuccess);
+    CHECK(PayloadPool_Store(pool, 3 + 2 * SLOTS, "c", 2, &slot) == PayloadPoolSuccess);
+    CHECK(PayloadPool_Release(pool, 3 + SLOTS, NULL));
+    CHECK(PayloadPool_Find(pool, 3, &slot) && PayloadPool_Data(pool, slot)[0] == 'a');
+    CHECK(PayloadPool_Find(pool, 3 + 2 * SLOTS, &slot) && PayloadPool_Data(pool, slot)[0] == 'c');
+
+    PayloadPool_Reset(pool);
+    CHECK(PayloadPool_Available(pool) == SLOTS);
+    CHECK(!PayloadPool_Find(pool, 3, &slot));
+    CHECK(PayloadPool_HighWater(pool) == SLOTS);
+    puts("  packet ID wrap, full pool, colliding buckets and reset ok");
+}
+
+// Random stores and releases, including of IDs never stored, against a
+// table of which IDs are live
+static void model(PayloadPool_t *pool)
+{
+    static bool live[65536];
+    uint32_t random = 1;
+    uint16_t id = 1, slot;
+    int used = 0;
+    long disagreements = 0;
+
+    memset(live, 0, sizeof(live));
+    for (int step = 0; step < MODEL_STEPS; step++) {
+        if ((host_test_random(&random) & 1) && used < SLOTS) {
+            while (live[id] || id == 0) {
+                id++;
+            }
+            if (PayloadPool_Store(pool, id, &id, sizeof(id), &slot) != PayloadPoolSuccess) {
+                disagreements++;
+            }
+            live[id++] = true;
+            used++;
+        } else {
+            uint16_t candidate = (uint16_t) host_test_random(&random);
+            bool expected = candidate != 0 && live[candidate];
+            if (PayloadPool_Release(pool, candidate, NULL) != expected) {
+                disagreements++;
+            }
+            if (expected) {
+                live[candidate] = false;
+                used--;
+            }
+        }
+        if (PayloadPool_Available(pool) != SLOTS - used) {
+            disagreements++;
+        }
+    }
+    printf("  %d random stores and releases: %ld disagreements with the model\n", MODEL_STEPS, disagreements);
+    CHECK(disagreements == 0);
+}
+
+static void bench(PayloadPool_t *pool)
+{
+    static uint16_t in_flight[SLOTS];
+    uint8_t payload[48] = { 0 };
+    uint16_t id = 1, oldest = 1, slot;
+    uint32_t random = 12345;
+    long failures = 0;
+
+    // Acknowledged in order
+    CHECK(PayloadPool_Init(pool, slots, SLOTS, storage, SLOT_SIZE, buckets, SLOTS));
+    for (int i = 0; i < SLOTS; i++) {
+        (void) PayloadPool_Store(pool, next_id(&id), payload, sizeof(payload), &slot);
+    }
+    uint64_t start = host_test_ns();
+    for (long i = 0; i < BENCH_OPS; i++) {
+        failures += !PayloadPool_Release(pool, next_id(&oldest), &slot);
+        failures += PayloadPool_Store(pool, next_id(&id), payload, sizeof(payload), &slot) != PayloadPoolSuccess;
+    }
+    double in_order_ns = (double) (host_test_ns() - start) / BENCH_OPS;
+
+    // Acknowledged in random order
+    PayloadPool_Reset(pool);
+    for (int i = 0; i < SLOTS; i++) {
+        in_flight[i] = next_id(&id);
+        (void) PayloadPool_Store(pool, in_flight[i], payload, sizeof(payload), &slot);
+    }
+    start = host_test_ns();
+    for (long i = 0; i < BENCH_OPS; i++) {
+        int k = (int) (host_test_random(&random) % SLOTS);
+        failures += !PayloadPool_Release(pool, in_flight[k], NULL);
+        in_flight[k] = next_id(&id);
+        failures += PayloadPool_Store(pool, in_flight[k], payload, sizeof(payload), &slot) != PayloadPoolSuccess;
+    }
+    double random_ns = (double) (host_test_ns() - start) / BENCH_OPS;
+
+    // The old lookup: scan the array for the packet ID, then for a free entry
+    for (int i = 0; i < SLOTS; i++) {
+        in_flight[i] = (uint16_t) (i + 1);
+    }
+    id = SLOTS + 1;
+    start = host_test_ns();
+    for (long i = 0; i < SCAN_OPS; i++) {
+        uint16_t acked = in_flight[host_test_random(&random) % SLOTS];
+        int j;
+        for (j = 0; j < SLOTS && in_flight[j] != acked; j++) {
+        }
+        in_flight[j] = 0;
+        for (j = 0; j < SLOTS && in_flight[j] != 0; j++) {
+        }
+        in_flight[j] = next_id(&id);
+    }
+    double scan_ns = (double) (host_test_ns() - start) / SCAN_OPS;
+
+    printf("  %d in flight, release + store of %zu bytes: acks in order %.0f ns, in random order %.0f ns; "
+           "linear scan %.0f ns\n",
+           SLOTS, sizeof(payload), in_order_ns, random_ns, scan_ns);
+    CHECK(failures == 0);
+}
+
+int main(void)
+{
+    PayloadPool_t pool;
+
+    puts("Payload pool:");
+    basics(&pool);
+    model(&pool);
+    bench(&pool);
+    return host_test_result();
+}
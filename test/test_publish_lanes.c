@@ -0,0 +1,219 @@
+/*
+    Publish lanes and the alarm monitor: the scheduler's limits and
+    priorities, alarm raising and clearing, and alarm latency behind a
+    backlog. The simulation drains 10k telemetry messages while 200 alarms
+    arrive, with 2 ms per send, PUBACKs 120 ms later and 8 slots, under a
+    single FIFO lane, alarms first over shared slots, and lanes with 2 of
+    the 8 slots kept for alarms.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alarm.h"
+#include "host_test.h"
+#include "publish_lanes.h"
+
+#define SEND_MS 2
+#define RTT_MS 120
+#define SLOTS 8
+#define BACKLOG 10000
+#define ALARMS 200
+
+static void scheduler(void)
+{
+    static const uint16_t limits[3] = { 1, 2, 5 };
+    static const uint16_t starving[2] = { 1, 8 };
+    static const uint16_t closed[2] = { 0, 2 };
+    PublishLanes_t lanes;
+
+    CHECK(!PublishLanes_Init(&lanes, starving, 2, 8));
+    CHECK(!PublishLanes_Init(&lanes, closed, 2, 8));
+    CHECK(PublishLanes_Init(&lanes, limits, 3, 8));
+
+    // The lowest lane stops at its limit; higher lanes still get theirs
+    for (int i = 0; i < 5; i++) {
+        CHECK(PublishLanes_Select(&lanes, 1u << 2) == 2);
+        PublishLanes_Sent(&lanes, 2);
+    }
+    CHECK(PublishLanes_Select(&lanes, 1u << 2) == PUBLISH_LANE_NONE);
+    CHECK(PublishLanes_Throttled(&lanes, 2) == 1);
+    CHECK(PublishLanes_Select(&lanes, (1u << 1) | (1u << 2)) == 1);
+    PublishLanes_Sent(&lanes, 1);
+    PublishLanes_Sent(&lanes, 1);
+    CHECK(PublishLanes_Select(&lanes, 7) == 0);
+    PublishLanes_Sent(&lanes, 0);
+    CHECK(PublishLanes_Select(&lanes, 7) == PUBLISH_LANE_NONE);
+    PublishLanes_Acked(&lanes, 2);
+    CHECK(PublishLanes_Select(&lanes, 7) == 2);
+    CHECK(PublishLanes_SentCount(&lanes, 2) == 5);
+
+    // After a reset a late PUBACK must not underflow
+    PublishLanes_Reset(&lanes);
+    PublishLanes_Acked(&lanes, 1);
+    CHECK(PublishLanes_InFlight(&lanes, 1) == 0);
+    puts("  limits, priorities and reset ok");
+}
+
+static void monitor(void)
+{
+    alarm_config_t config = { 350, 10, 1000 };
+    alarm_monitor_t monitor;
+    alarm_event_t events[ALARM_KIND_COUNT];
+    telemetry_reading_t reading = { .sensor_ok = true, .dimmer_enabled = true, .temperature_tenths = 300 };
+    char json[200];
+
+    alarm_monitor_init(&monitor, &config);
+    CHECK(alarm_monitor_evaluate(&monitor, &reading, 10, events) == 0);
+
+    reading.uptime_ms = 5000;
+    reading.temperature_tenths = 351;
+    CHECK(alarm_monitor_evaluate(&monitor, &reading, 20, events) == 1);
+    CHECK(events[0].kind == ALARM_OVER_TEMPERATURE && events[0].active && events[0].value_tenths == 351);
+    CHECK(alarm_encode_json(&events[0], "dev-1", json, sizeof(json)) > 0);
+    CHECK(strstr(json, "over_temperature") != NULL);
+
+    // Within the hysteresis: still raised
+    reading.uptime_ms = 10000;
+    reading.temperature_tenths = 345;
+    CHECK(alarm_monitor_evaluate(&monitor, &reading, 30, events) == 0);
+
+    // The counter stopped for 5 s with the dimmer on
+    reading.uptime_ms = 15000;
+    reading.sensor_ok = false;
+    CHECK(alarm_monitor_evaluate(&monitor, &reading, 30, events) == 1);
+    CHECK(events[0].kind == ALARM_ZERO_CROSS_LOST && events[0].active);
+
+    reading.uptime_ms = 20000;
+    reading.sensor_ok = true;
+    reading.temperature_tenths = 339;
+    CHECK(alarm_monitor_evaluate(&monitor, &reading, 31, events) == 2);
+    CHECK(!events[0].active && !events[1].active);
+
+    reading.uptime_ms = 25000;
+    reading.dimmer_enabled = false;
+    CHECK(alarm_monitor_evaluate(&monitor, &reading, 31, events) == 0);
+    puts("  raise, hysteresis, zero-cross timeout and clear ok");
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+typedef enum {
+    SINGLE_FIFO,
+    ALARMS_FIRST,
+    ALARM_LANE,
+} schedule_t;
+
+typedef struct {
+    int p50, p99, max;
+    int drained_ms;
+} latency_t;
+
+static latency_t simulate(schedule_t schedule)
+{
+    static const uint16_t shared[1] = { SLOTS };
+    static const uint16_t reserved[2] = { 2, SLOTS - 2 };
+    static int fifo[BACKLOG + ALARMS];
+    int arrival[ALARMS], latency[ALARMS], alarm_queue[ALARMS];
+    int ack_at[SLOTS], ack_lane[SLOTS];
+    int fifo_head = 0, fifo_tail = 0, alarm_head = 0, alarm_tail = 0;
+    int next_alarm = 0, delivered = 0, in_flight = 0, t = 0, busy_until = 0;
+    uint32_t random = 7;
+    PublishLanes_t lanes;
+
+    if (schedule == ALARM_LANE) {
+        CHECK(PublishLanes_Init(&lanes, reserved, 2, SLOTS));
+    } else {
+        CHECK(PublishLanes_Init(&lanes, shared, 1, SLOTS));
+    }
+
+    // Alarms arrive over the first half of the drain
+    for (int i = 0; i < ALARMS; i++) {
+        arrival[i] = (int) (host_test_random(&random) % (BACKLOG * RTT_MS / SLOTS / 2));
+    }
+    qsort(arrival, ALARMS, sizeof(int), compare_int);
+    for (int i = 0; i < BACKLOG; i++) {
+        fifo[fifo_tail++] = -1;
+    }
+
+    while (delivered < ALARMS || fifo_head < fifo_tail || in_flight > 0) {
+        for (; next_alarm < ALARMS && arrival[next_alarm] <= t; next_alarm++) {
+            if (schedule == SINGLE_FIFO) {
+                fifo[fifo_tail++] = next_alarm;
+            } else {
+                alarm_queue[alarm_tail++] = next_alarm;
+            }
+        }
+        for (int i = 0; i < in_flight;) {
+            if (ack_at[i] <= t) {
+                PublishLanes_Acked(&lanes, (uint8_t) ack_lane[i]);
+                in_flight--;
+                ack_at[i] = ack_at[in_flight];
+                ack_lane[i] = ack_lane[in_flight];
+            } else {
+                i++;
+            }
+        }
+
+        if (t >= busy_until) {
+            uint32_t ready = 0;
+
+            if (alarm_head < alarm_tail) {
+                ready |= 1u;
+            }
+            if (fifo_head < fifo_tail) {
+                ready |= schedule == ALARM_LANE ? 2u : 1u;
+            }
+            uint8_t lane = ready != 0 ? PublishLanes_Select(&lanes, ready) : PUBLISH_LANE_NONE;
+            if (lane != PUBLISH_LANE_NONE) {
+                // Lane 0 carries alarms when they have their own queue
+                bool alarm = schedule != SINGLE_FIFO && lane == 0 && alarm_head < alarm_tail;
+                int message = alarm ? alarm_queue[alarm_head++] : fifo[fifo_head++];
+                if (message >= 0) {
+                    latency[message] = t + SEND_MS - arrival[message];
+                    delivered++;
+                }
+                PublishLanes_Sent(&lanes, lane);
+                ack_at[in_flight] = t + SEND_MS + RTT_MS;
+                ack_lane[in_flight++] = lane;
+                busy_until = t + SEND_MS;
+            }
+        }
+        t++;
+    }
+
+    qsort(latency, ALARMS, sizeof(int), compare_int);
+    return (latency_t) { latency[ALARMS / 2], latency[ALARMS * 99 / 100], latency[ALARMS - 1], t };
+}
+
+static void backlog(void)
+{
+    static const char *names[] = { "single FIFO lane", "alarms first, shared slots", "lanes, alarm limit 2 of 8" };
+    latency_t results[3];
+
+    for (int s = SINGLE_FIFO; s <= ALARM_LANE; s++) {
+        results[s] = simulate((schedule_t) s);
+        printf("  %-28s alarm latency p50 %6d ms, p99 %6d ms, max %6d ms; backlog drained at %d ms\n", names[s],
+               results[s].p50, results[s].p99, results[s].max, results[s].drained_ms);
+    }
+
+    // With slots kept for them, an alarm never waits for more than one
+    // round trip of its own lane
+    CHECK(results[ALARM_LANE].max <= RTT_MS + 2 * SEND_MS);
+    CHECK(results[ALARM_LANE].p50 <= results[ALARMS_FIRST].p50);
+    CHECK(results[ALARMS_FIRST].max < results[SINGLE_FIFO].p50);
+}
+
+int main(void)
+{
+    puts("Scheduler:");
+    scheduler();
+    puts("Alarm monitor:");
+    monitor();
+    printf("%d telemetry messages backlogged, %d alarms arriving:\n", BACKLOG, ALARMS);
+    backlog();
+    return host_test_result();
+}
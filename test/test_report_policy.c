@@ -0,0 +1,150 @@
+/*
+    Report policy against a synthetic 24 h DHT22 trace: 5 s samples, a
+    diurnal swing of +-3 C and +-10 %RH, +-0.1 sensor noise and an 8 minute
+    transient. Prints the messages sent and the largest error a consumer of
+    the published values sees, and checks that the error stays under one
+    deadband and silences under one heartbeat. Then the reasons on a short
+    hand-made sequence.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "report_policy.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLES 17280           // 24 h at 5 s
+
+static telemetry_reading_t trace[SAMPLES];
+
+static void make_trace(void)
+{
+    uint32_t random = 1;
+
+    for (int i = 0; i < SAMPLES; i++) {
+        double t = i * 5.0;
+        double temperature = 21 + 3 * sin(2 * M_PI * t / 86400) + ((int) (host_test_random(&random) % 3) - 1) * 0.1;
+        double humidity = 50 - 10 * sin(2 * M_PI * t / 86400) + ((int) (host_test_random(&random) % 3) - 1) * 0.1;
+
+        // A door left open for 8 minutes
+        if (i > 8000 && i < 8100) {
+            double shape = 1 - abs(i - 8050) / 50.0;
+            temperature -= 2 * shape;
+            humidity += 8 * shape;
+        }
+        trace[i] = (telemetry_reading_t) {
+            .uptime_ms = (uint32_t) (t * 1000),
+            .sensor_ok = true,
+            .temperature_tenths = (int16_t) lround(temperature * 10),
+            .humidity_tenths = (int16_t) lround(humidity * 10),
+            .dimmer_ch1 = 35,
+            .dimmer_enabled = true,
+        };
+    }
+}
+
+static void replay(const report_policy_config_t *config)
+{
+    report_policy_t policy;
+    telemetry_reading_t last = { 0 };
+    int max_error_t = 0, max_error_h = 0;
+    uint32_t longest_silence_ms = 0;
+
+    report_policy_init(&policy, config);
+    for (int i = 0; i < SAMPLES; i++) {
+        if (report_policy_evaluate(&policy, &trace[i]) != REPORT_SKIP) {
+            last = trace[i];
+        }
+        int error_t = abs(trace[i].temperature_tenths - last.temperature_tenths);
+        int error_h = abs(trace[i].humidity_tenths - last.humidity_tenths);
+        max_error_t = error_t > max_error_t ? error_t : max_error_t;
+        max_error_h = error_h > max_error_h ? error_h : max_error_h;
+        if (trace[i].uptime_ms - last.uptime_ms > longest_silence_ms) {
+            longest_silence_ms = trace[i].uptime_ms - last.uptime_ms;
+        }
+    }
+
+    printf("  deadband %3.1f C / %3.1f %%, relative %3u permille, heartbeat %4u s: %5u messages (%5.1f%% fewer), "
+           "max error %.1f C / %.1f %%\n",
+           config->temperature_deadband_tenths / 10.0, config->humidity_deadband_tenths / 10.0,
+           config->relative_deadband_permille, (unsigned) (config->heartbeat_ms / 1000), policy.reported,
+           100.0 * (1 - (double) policy.reported / policy.evaluated), max_error_t / 10.0, max_error_h / 10.0);
+
+    CHECK(policy.evaluated == SAMPLES);
+    if (config->temperature_deadband_tenths > 0) {
+        CHECK(max_error_t < config->temperature_deadband_tenths);
+    }
+    if (config->humidity_deadband_tenths > 0) {
+        CHECK(max_error_h < config->humidity_deadband_tenths);
+    }
+    if (config->temperature_deadband_tenths == 0 && config->humidity_deadband_tenths == 0 &&
+        config->relative_deadband_permille == 0) {
+        CHECK(max_error_t == 0 && max_error_h == 0);
+    }
+    if (config->heartbeat_ms > 0) {
+        CHECK(longest_silence_ms < config->heartbeat_ms);
+    } else {
+        CHECK(policy.reported == policy.evaluated);
+    }
+}
+
+static void reasons(void)
+{
+    report_policy_config_t config = { 5, 20, 0, 600000 };
+    report_policy_t policy;
+    telemetry_reading_t reading = trace[0];
+
+    report_policy_init(&policy, &config);
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_FIRST);
+    reading.uptime_ms += 5000;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_SKIP);
+    reading.dimmer_ch1 = 80;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_STATE);
+    reading.uptime_ms += 600000;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_HEARTBEAT);
+    reading.temperature_tenths += 4;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_SKIP);
+    reading.temperature_tenths += 1;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_DEADBAND);
+    reading.quality = 1;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_STATE);
+    reading.sensor_ok = false;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_STATE);
+    reading.temperature_tenths += 100;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_SKIP);
+
+    // The heartbeat runs across the millisecond counter wrap
+    reading.uptime_ms = 0xFFFFF000u;
+    report_policy_init(&policy, &config);
+    (void) report_policy_evaluate(&policy, &reading);
+    reading.uptime_ms += 599000;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_SKIP);
+    reading.uptime_ms += 1000;
+    CHECK(report_policy_evaluate(&policy, &reading) == REPORT_HEARTBEAT);
+    puts("  first, state, deadband and heartbeat reasons ok, heartbeat across the wrap");
+}
+
+int main(void)
+{
+    static const report_policy_config_t configs[] = {
+        { 0, 0, 0, 0 },
+        { 0, 0, 0, 300000 },
+        { 2, 10, 0, 300000 },
+        { 3, 10, 0, 300000 },
+        { 5, 20, 0, 900000 },
+        { 0, 0, 10, 300000 },
+    };
+
+    make_trace();
+    printf("24 h trace, %d samples:\n", SAMPLES);
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        replay(&configs[i]);
+    }
+    puts("Reasons:");
+    reasons();
+    return host_test_result();
+}
@@ -0,0 +1,142 @@
+/*
+    Adaptive sample interval against fixed periods on a simulated room:
+    2 h with the heater switched on and off three times, the DHT22's 0.1
+    quantisation and 0.05 C noise. The error is between linear interpolation
+    of the samples and the true temperature, so it is what a consumer
+    plotting the published values would see. The sampling task samples
+    again as soon as the dimmer changes; the simulation does the same.
+*/
+
+#include <math.h>
+
+#include "host_test.h"
+#include "sample_interval.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define END_S 7200
+#define MAX_SAMPLES (END_S + 2)
+
+static double truth_t[END_S + 1], truth_h[END_S + 1];
+static uint8_t dimmer[END_S + 1];
+static uint32_t random_state;
+
+static double gauss(void)
+{
+    double u = (host_test_random(&random_state) + 1.0) / 4294967297.0;
+    double v = (host_test_random(&random_state) + 1.0) / 4294967297.0;
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// First-order room towards 32 C with the heater on, 22 C off
+static void make_room(double tau_on_s, double tau_off_s)
+{
+    double t = 22;
+
+    for (int s = 0; s <= END_S; s++) {
+        bool on = (s >= 1200 && s < 3600) || (s >= 5400 && s < 5700);
+
+        dimmer[s] = on ? 80 : 0;
+        t += ((on ? 32 : 22) - t) / (on ? tau_on_s : tau_off_s);
+        truth_t[s] = t;
+        truth_h[s] = 50 - (t - 22) * 1.5;
+    }
+}
+
+typedef struct {
+    int messages;
+    double rms, max;
+} result_t;
+
+static result_t run(const char *name, uint32_t fixed_ms, const sample_interval_config_t *config)
+{
+    static int times[MAX_SAMPLES];
+    static double values[MAX_SAMPLES];
+    sample_interval_t sampler;
+    uint32_t shortest = UINT32_MAX, longest = 0;
+    int n = 0, s = 0;
+
+    random_state = 1;
+    if (config != NULL) {
+        sample_interval_init(&sampler, config);
+    }
+    while (s <= END_S) {
+        telemetry_reading_t reading = {
+            .uptime_ms = (uint32_t) s * 1000,
+            .sensor_ok = true,
+            .temperature_tenths = (int16_t) lround((truth_t[s] + gauss() * 0.05) * 10),
+            .humidity_tenths = (int16_t) lround(truth_h[s] * 10 + gauss()),
+            .dimmer_ch1 = dimmer[s],
+            .dimmer_enabled = dimmer[s] > 0,
+        };
+        times[n] = s;
+        values[n++] = reading.temperature_tenths / 10.0;
+
+        uint32_t interval = config != NULL ? sample_interval_update(&sampler, &reading) : fixed_ms;
+        shortest = interval < shortest ? interval : shortest;
+        longest = interval > longest ? interval : longest;
+
+        int next = s + (int) ((interval + 999) / 1000);
+        for (int k = s + 1; config != NULL && k < next && k <= END_S; k++) {
+            if (dimmer[k] != dimmer[k - 1]) {
+                next = k < s + 2 ? s + 2 : k;
+                break;
+            }
+        }
+        s = next;
+    }
+    if (times[n - 1] != END_S) {
+        times[n] = END_S;
+        values[n] = values[n - 1];
+        n++;
+    }
+
+    result_t result = { n, 0, 0 };
+    double sum_sq = 0;
+    for (int t = 0, k = 0; t <= END_S; t++) {
+        while (times[k + 1] < t) {
+            k++;
+        }
+        double share = (double) (t - times[k]) / (times[k + 1] - times[k]);
+        double error = fabs(values[k] + share * (values[k + 1] - values[k]) - truth_t[t]);
+        result.max = error > result.max ? error : result.max;
+        sum_sq += error * error;
+    }
+    result.rms = sqrt(sum_sq / (END_S + 1));
+
+    printf("    %-26s %5d messages, error rms %.3f C, max %.3f C, interval %u-%u ms\n", name, result.messages,
+           result.rms, result.max, shortest, longest);
+    if (config != NULL) {
+        CHECK(shortest >= SAMPLE_INTERVAL_FLOOR_MS && longest <= config->max_ms);
+    }
+    return result;
+}
+
+static void room(double tau_on_s, double tau_off_s)
+{
+    sample_interval_config_t config = { 2000, 60000, 5000, 2, 5 };
+
+    make_room(tau_on_s, tau_off_s);
+    printf("  heating tau %.0f s, cooling tau %.0f s:\n", tau_on_s, tau_off_s);
+    result_t fixed_7 = run("fixed 7 s (5 s + 2 s)", 7000, NULL);
+    result_t adaptive = run("adaptive, tolerance 0.2 C", 0, &config);
+    result_t fixed_30 = run("fixed 30 s", 30000, NULL);
+
+    // Under a third of the messages of the old fixed cadence, with no worse a
+    // peak error than a fixed period sending as many
+    CHECK(adaptive.messages * 3 < fixed_7.messages);
+    CHECK(adaptive.max < 0.35);
+    CHECK(adaptive.max <= fixed_30.max + 0.05);
+    CHECK(adaptive.rms < 0.06);
+}
+
+int main(void)
+{
+    puts("2 h, heater on three times:");
+    room(120, 300);
+    room(40, 120);
+    return host_test_result();
+}
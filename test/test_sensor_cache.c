@@ -0,0 +1,185 @@
+/*
+    Sensor cache: freshness and error accounting on a fake clock, the
+    cadence a background sampler on the simulated DHT22 bus gives readers
+    at arbitrary times, one writer against three reader threads, and the
+    cost of a get.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "dht.h"
+#include "host_test.h"
+#include "sensor_cache.h"
+
+static uint32_t fake_now;
+
+static uint32_t fake_clock(void *context)
+{
+    (void) context;
+    return fake_now;
+}
+
+static uint32_t sim_clock(void *context)
+{
+    return ((dht_sim_t *) context)->now_ms;
+}
+
+static void freshness(void)
+{
+    SensorCache_t cache;
+    SensorCacheSnapshot_t snapshot;
+
+    fake_now = 1000;
+    SensorCache_Init(&cache, fake_clock, NULL);
+    CHECK(!SensorCache_Get(&cache, &snapshot) && snapshot.attempts == 0);
+
+    // No snapshot before the first good read, but the failure is counted
+    SensorCache_Update(&cache, -2, 0, 0);
+    CHECK(!SensorCache_Get(&cache, &snapshot) && snapshot.consecutiveErrors == 1 && snapshot.lastStatus == -2);
+
+    fake_now = 3000;
+    SensorCache_Update(&cache, 0, 215, 480);
+    fake_now = 3700;
+    CHECK(SensorCache_Get(&cache, &snapshot) && snapshot.ageMs == 700 && snapshot.temperatureTenths == 215 &&
+          snapshot.humidityTenths == 480 && snapshot.consecutiveErrors == 0);
+
+    // A failure keeps the good values and ages them
+    fake_now = 5000;
+    SensorCache_Update(&cache, -1, 999, 999);
+    fake_now = 5200;
+    CHECK(SensorCache_Get(&cache, &snapshot) && snapshot.ageMs == 2200 && snapshot.temperatureTenths == 215 &&
+          snapshot.consecutiveErrors == 1 && snapshot.errors == 2 && snapshot.attempts == 3 &&
+          snapshot.lastStatus == -1);
+
+    // Age across the clock wrap
+    fake_now = UINT32_MAX - 100;
+    SensorCache_Update(&cache, 0, 1, 2);
+    fake_now = 400;
+    CHECK(SensorCache_Get(&cache, &snapshot) && snapshot.ageMs == 501);
+    puts("  age, failures and clock wrap ok");
+}
+
+// A sampler reads as often as the DHT22 allows for a simulated hour, the
+// sensor's temperature stepping after every read; readers poll every 137 ms
+// in between and must always see the latest value, at most one period old
+static void cadence(void)
+{
+    dht_sim_sensor_t sensor = { .gpio = 21, .temperature_tenths = 200, .humidity_tenths = 500, .jitter_us = 10 };
+    dht_sim_t sim = { .sensors = &sensor, .count = 1, .seed = 9 };
+    dht_bus_t bus;
+    dht_handle_t dht;
+    dht_schedule_t schedule;
+    SensorCache_t cache;
+    SensorCacheSnapshot_t snapshot;
+    uint32_t max_age = 0, gets = 0, stale = 0, next_get = 1;
+
+    dht_bus_sim_init(&bus, &sim);
+    dht_init(&dht, 21, &bus);
+    dht_schedule_init(&schedule, &dht, 1, DHT_MIN_INTERVAL_MS);
+    SensorCache_Init(&cache, sim_clock, &sim);
+
+    while (sim.now_ms < 3600000) {
+        uint32_t wait_ms;
+        dht_handle_t *due = dht_schedule_due(&schedule, sim.now_ms, &wait_ms);
+
+        if (due != NULL) {
+            int status = dht_read(due);
+            SensorCache_Update(&cache, status, due->temperature_tenths, due->humidity_tenths);
+            sensor.temperature_tenths++;
+            continue;
+        }
+        if (next_get < sim.now_ms) {
+            next_get = sim.now_ms;
+        }
+        for (uint32_t now = sim.now_ms; next_get < now + wait_ms; next_get += 137) {
+            sim.now_ms = next_get;
+            if (SensorCache_Get(&cache, &snapshot)) {
+                gets++;
+                max_age = snapshot.ageMs > max_age ? snapshot.ageMs : max_age;
+                stale += snapshot.temperatureTenths != sensor.temperature_tenths - 1;
+            }
+            sim.now_ms = now;
+        }
+        sim.now_ms += wait_ms;
+    }
+
+    printf("  1 h: %u reads, %u started too soon; %u gets, %u stale, oldest %u ms\n", dht.reads, sensor.too_soon,
+           gets, stale, max_age);
+    CHECK(sensor.too_soon == 0);
+    CHECK(dht.reads >= 1790);
+    CHECK(stale == 0);
+    CHECK(max_age <= DHT_MIN_INTERVAL_MS);
+}
+
+static SensorCache_t shared;
+static atomic_bool stop;
+
+static void *writer(void *argument)
+{
+    int16_t value = 0;
+
+    (void) argument;
+    while (!atomic_load(&stop)) {
+        value++;
+        SensorCache_Update(&shared, value % 7 ? 0 : -2, value, (int16_t) -value);
+    }
+    return NULL;
+}
+
+// Counts snapshots whose fields do not belong to one update
+static void *reader(void *argument)
+{
+    long *torn = argument;
+    SensorCacheSnapshot_t snapshot;
+
+    while (!atomic_load(&stop)) {
+        if (SensorCache_Get(&shared, &snapshot) &&
+            (snapshot.temperatureTenths != -snapshot.humidityTenths || snapshot.errors > snapshot.attempts)) {
+            (*torn)++;
+        }
+    }
+    return NULL;
+}
+
+static void concurrency(void)
+{
+    pthread_t writer_thread, reader_threads[3];
+    long torn[3] = { 0 };
+    SensorCacheSnapshot_t snapshot;
+
+    SensorCache_Init(&shared, fake_clock, NULL);
+    atomic_store(&stop, false);
+    CHECK(pthread_create(&writer_thread, NULL, writer, NULL) == 0);
+    for (int i = 0; i < 3; i++) {
+        CHECK(pthread_create(&reader_threads[i], NULL, reader, &torn[i]) == 0);
+    }
+    nanosleep(&(struct timespec) { 0, 500000000 }, NULL);
+    atomic_store(&stop, true);
+    pthread_join(writer_thread, NULL);
+    for (int i = 0; i < 3; i++) {
+        pthread_join(reader_threads[i], NULL);
+    }
+
+    (void) SensorCache_Get(&shared, &snapshot);
+    printf("  1 writer, 3 readers for 0.5 s: %u writes, %ld torn snapshots\n", snapshot.attempts,
+           torn[0] + torn[1] + torn[2]);
+    CHECK(torn[0] + torn[1] + torn[2] == 0);
+
+    uint64_t start = host_test_ns();
+    for (int i = 0; i < 10000000; i++) {
+        (void) SensorCache_Get(&shared, &snapshot);
+    }
+    printf("  get: %.1f ns\n", (host_test_ns() - start) / 1e7);
+}
+
+int main(void)
+{
+    puts("Fake clock:");
+    freshness();
+    puts("Cadence on the simulated bus:");
+    cadence();
+    puts("Threads:");
+    concurrency();
+    return host_test_result();
+}
@@ -0,0 +1,251 @@
+/*
+    Sensor filter: quality tags on a short hand-made sequence, then false
+    readings over a 24 h synthetic trace replayed through the DHT22 frame
+    decoder. The failure mix is 3% timeouts, 5% single bit flips, 0.5% each
+    of all-zero frames, frames shifted by a bit, and two compensating bit
+    errors that pass the checksum. A false reading is a published value
+    more than 1.0 C or 3% RH from the truth; the trace has a heater step
+    and a humidity surge, which the filters must follow, not reject.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dht22_decode.h"
+#include "host_test.h"
+#include "sensor_filter.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define FALSE_T_TENTHS 10
+#define FALSE_H_TENTHS 30
+
+static void tags(void)
+{
+    SensorFilterConfig_t config = { SensorFilterHampel, 5, 30, 2, -400, 800, 10, 2, 3 };
+    SensorFilterConfig_t even = config;
+    SensorFilter_t filter;
+    int16_t value = -1;
+
+    even.window = 4;
+    CHECK(!SensorFilter_Init(&filter, &even));
+    CHECK(SensorFilter_Init(&filter, &config));
+
+    // Out of range before anything was accepted: nothing to report
+    CHECK(SensorFilter_Add(&filter, 900, 0, &value) == SensorQualityFailed && value == -1);
+    for (int i = 0; i < 5; i++) {
+        CHECK(SensorFilter_Add(&filter, (int16_t) (200 + (i & 1)), (uint32_t) i * 2000, &value) == SensorQualityGood);
+    }
+
+    // A small spike is an outlier in the window; a jump past the rate limit
+    // is implausible and the last value is held
+    CHECK(SensorFilter_Add(&filter, 208, 10000, &value) == SensorQualityFiltered && value == 201);
+    CHECK(SensorFilter_Add(&filter, 0, 12000, &value) == SensorQualityHeld && value == 201);
+
+    // Three agreeing implausible samples are a real step
+    SensorQuality_t quality = SensorQualityFailed;
+    for (int i = 0; i < 3; i++) {
+        quality = SensorFilter_Add(&filter, (int16_t) (300 + i), 14000 + (uint32_t) i * 2000, &value);
+    }
+    CHECK(quality == SensorQualityGood && value == 302);
+    CHECK(SensorFilter_Count(&filter, SensorQualityHeld) == 3);
+    CHECK(SensorFilter_Missed(&filter) == SensorQualityFailed);
+    puts("  good, filtered, held, failed and re-anchoring ok");
+}
+
+typedef enum {
+    FRAME_OK,
+    FRAME_TIMEOUT,
+    FRAME_BIT_FLIP,
+    FRAME_ZERO,
+    FRAME_SHIFTED,
+    FRAME_PAIRED_FLIPS,
+    FRAME_KINDS
+} frame_kind_t;
+
+static const double frame_odds[FRAME_KINDS] = { 0, 0.03, 0.05, 0.005, 0.005, 0.005 };
+static uint32_t random_state;
+
+// Simulates one read of the true values. Returns 0 for a frame that passes
+// the checksum, -1 for no frame and -2 for a checksum error.
+static int read_frame(int temperature, int humidity, int16_t *pTemperature, int16_t *pHumidity)
+{
+    uint16_t magnitude = (uint16_t) (temperature < 0 ? 0x8000 | -temperature : temperature);
+    uint8_t data[DHT22_DATA_BYTES] = {
+        (uint8_t) (humidity >> 8), (uint8_t) humidity, (uint8_t) (magnitude >> 8), (uint8_t) magnitude, 0,
+    };
+    double draw = (host_test_random(&random_state) & 0xFFFFFF) / 16777216.0, odds = 0;
+    frame_kind_t kind = FRAME_OK;
+
+    data[4] = (uint8_t) (data[0] + data[1] + data[2] + data[3]);
+    for (int k = FRAME_TIMEOUT; k < FRAME_KINDS; k++) {
+        odds += frame_odds[k];
+        if (draw < odds) {
+            kind = (frame_kind_t) k;
+            break;
+        }
+    }
+
+    switch (kind) {
+    case FRAME_TIMEOUT:
+        return -1;
+    case FRAME_BIT_FLIP:
+        data[host_test_random(&random_state) % 4] ^= (uint8_t) (1u << (host_test_random(&random_state) % 8));
+        break;
+    case FRAME_ZERO:
+        memset(data, 0, sizeof(data));
+        break;
+    case FRAME_SHIFTED:
+        // The first bit missed: each byte takes the next one's top bit
+        for (unsigned i = 0; i < DHT22_DATA_BYTES; i++) {
+            data[i] = (uint8_t) ((data[i] << 1) | (i < 4 ? data[i + 1] >> 7 : 1));
+        }
+        break;
+    case FRAME_PAIRED_FLIPS: {
+        // A value and the checksum off by the same amount
+        int byte = host_test_random(&random_state) % 2 ? 1 : 3;
+        uint8_t flip = (uint8_t) (1u << (3 + host_test_random(&random_state) % 4));
+        data[4] = (uint8_t) ((data[byte] & flip) ? data[4] - flip : data[4] + flip);
+        data[byte] ^= flip;
+        break;
+    }
+    default:
+        break;
+    }
+
+    if ((uint8_t) (data[0] + data[1] + data[2] + data[3]) != data[4]) {
+        return -2;
+    }
+    *pTemperature = Dht22_TemperatureTenths(data);
+    *pHumidity = Dht22_HumidityTenths(data);
+    return 0;
+}
+
+// Hourly swing, a 6 C heater step at 2 h undone at 4 h, and a 20 %RH
+// shower surge at 8.3 h
+static void truth(double s, int *temperature, int *humidity)
+{
+    double t = 220 + 10 * sin(s / 3600 * 2 * M_PI);
+    double h = 500 + 30 * sin(s / 5400 * 2 * M_PI);
+    double heating = s - 7200, surge = s - 30000;
+
+    if (heating > 0) {
+        t += heating < 120 ? 60 * heating / 120 : 60;
+    }
+    if (s > 14400) {
+        t -= 60 * fmin(1, (s - 14400) / 600);
+    }
+    if (surge > 0 && surge < 1800) {
+        h += surge < 60 ? 200 * surge / 60 : 200 * (1 - (surge - 60) / 1740);
+    }
+    *temperature = (int) lround(t);
+    *humidity = (int) lround(h);
+}
+
+typedef struct {
+    const char *name;
+    int retries;
+    bool gate;
+    SensorFilterMode_t mode;
+    uint8_t window;
+} pipeline_t;
+
+typedef struct {
+    double null_percent, false_t_percent, false_h_percent, false_good_percent;
+} outcome_t;
+
+static outcome_t replay(const pipeline_t *pipeline, int interval_ms)
+{
+    SensorFilterConfig_t t_config = { pipeline->mode, pipeline->window, 30, 2, -400, 800, 10, 2, 3 };
+    SensorFilterConfig_t h_config = { pipeline->mode, pipeline->window, 30, 5, 0, 1000, 20, 5, 3 };
+    SensorFilter_t t_filter, h_filter;
+    long reads = 0, published = 0, nulls = 0, false_t = 0, false_h = 0, false_good = 0;
+
+    if (!pipeline->gate) {
+        t_config.minimum = h_config.minimum = INT16_MIN;
+        t_config.maximum = h_config.maximum = INT16_MAX;
+        t_config.maxStep = h_config.maxStep = INT16_MAX;
+    }
+    CHECK(SensorFilter_Init(&t_filter, &t_config));
+    CHECK(SensorFilter_Init(&h_filter, &h_config));
+    random_state = 12345;
+
+    for (double s = 0; s < 86400; s += interval_ms / 1000.0) {
+        int t, h, status, tries = 0;
+        int16_t read_t = 0, read_h = 0, out_t = 0, out_h = 0;
+        SensorQuality_t quality_t, quality_h;
+
+        // Each retry waits the DHT22's 2 s
+        do {
+            truth(s + tries * 2.0, &t, &h);
+            int noise_t = (int) (host_test_random(&random_state) % 3) - 1;
+            int noise_h = (int) (host_test_random(&random_state) % 3) - 1;
+            status = read_frame(t + noise_t, h + noise_h, &read_t, &read_h);
+        } while (status != 0 && tries++ < pipeline->retries);
+        reads++;
+
+        uint32_t now_ms = (uint32_t) (s * 1000) + (uint32_t) tries * 2000;
+        if (status != 0) {
+            quality_t = SensorFilter_Missed(&t_filter);
+            quality_h = SensorFilter_Missed(&h_filter);
+        } else {
+            quality_t = SensorFilter_Add(&t_filter, read_t, now_ms, &out_t);
+            quality_h = SensorFilter_Add(&h_filter, read_h, now_ms, &out_h);
+        }
+        SensorQuality_t quality = quality_t > quality_h ? quality_t : quality_h;
+        if (quality == SensorQualityFailed) {
+            nulls++;
+            continue;
+        }
+        published++;
+        bool bad_t = abs(out_t - t) > FALSE_T_TENTHS;
+        bool bad_h = abs(out_h - h) > FALSE_H_TENTHS;
+        false_t += bad_t;
+        false_h += bad_h;
+        false_good += (bad_t || bad_h) && quality == SensorQualityGood;
+    }
+
+    outcome_t outcome = {
+        100.0 * nulls / reads,
+        100.0 * false_t / published,
+        100.0 * false_h / published,
+        100.0 * false_good / published,
+    };
+    printf("  %2d s  %-20s null %5.2f%%  false T %5.2f%% RH %5.2f%%  false and tagged good %5.2f%%\n",
+           interval_ms / 1000, pipeline->name, outcome.null_percent, outcome.false_t_percent,
+           outcome.false_h_percent, outcome.false_good_percent);
+    return outcome;
+}
+
+int main(void)
+{
+    static const pipeline_t checksum_only = { "checksum only", 0, false, SensorFilterMedian, 1 };
+    static const pipeline_t retry = { "retry", 1, false, SensorFilterMedian, 1 };
+    static const pipeline_t gate = { "retry+gate", 1, true, SensorFilterMedian, 1 };
+    static const pipeline_t median = { "retry+gate+median5", 1, true, SensorFilterMedian, 5 };
+    static const pipeline_t hampel = { "retry+gate+hampel5", 1, true, SensorFilterHampel, 5 };
+
+    puts("Quality tags:");
+    tags();
+    puts("24 h trace with recorded failure modes:");
+    outcome_t raw = replay(&checksum_only, 2000);
+    outcome_t retried = replay(&retry, 2000);
+    outcome_t gated = replay(&gate, 2000);
+    outcome_t median_2s = replay(&median, 2000);
+    outcome_t hampel_2s = replay(&hampel, 2000);
+    outcome_t median_60s = replay(&median, 60000);
+    outcome_t hampel_60s = replay(&hampel, 60000);
+
+    CHECK(retried.null_percent < raw.null_percent / 5);
+    CHECK(gated.false_t_percent < retried.false_t_percent / 10);
+    CHECK(median_2s.false_t_percent == 0 && median_2s.false_h_percent == 0);
+    CHECK(hampel_2s.false_t_percent == 0 && hampel_2s.false_h_percent == 0);
+
+    // At 60 s what is left are the first samples of real steps, and those
+    // are published as filtered, never as good
+    CHECK(median_60s.false_good_percent == 0 && hampel_60s.false_good_percent == 0);
+    return host_test_result();
+}
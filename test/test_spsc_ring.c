@@ -0,0 +1,140 @@
+/*
+    SPSC ring: element order and accounting when full, batches across the
+    end of the storage and across the 32-bit index wrap, and a producer and
+    consumer thread moving 20 M elements, which must all arrive in order.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "host_test.h"
+#include "spsc_ring.h"
+
+#define THREAD_ELEMENTS 20000000u
+
+static void single_thread(void)
+{
+    SpscRing_t ring;
+    uint32_t storage[8];
+    uint32_t value, batch[16];
+
+    CHECK(!SpscRing_Init(&ring, storage, sizeof(uint32_t), 0));
+    CHECK(!SpscRing_Init(&ring, storage, sizeof(uint32_t), 6));
+    CHECK(SpscRing_Init(&ring, storage, sizeof(uint32_t), 8));
+    CHECK(SpscRing_Capacity(&ring) == 8);
+    CHECK(!SpscRing_Pop(&ring, &value));
+    CHECK(SpscRing_PopBatch(&ring, batch, 16) == 0);
+
+    // Every slot is usable; the ninth push is refused and counted
+    for (value = 0; value < 8; value++) {
+        CHECK(SpscRing_Push(&ring, &value));
+    }
+    value = 100;
+    CHECK(!SpscRing_Push(&ring, &value));
+    CHECK(!SpscRing_Push(&ring, &value));
+    CHECK(SpscRing_Count(&ring) == 8);
+    CHECK(SpscRing_Drops(&ring) == 2);
+    CHECK(SpscRing_HighWater(&ring) == 8);
+
+    CHECK(SpscRing_Pop(&ring, &value) && value == 0);
+    CHECK(SpscRing_PopBatch(&ring, batch, 3) == 3);
+    CHECK(batch[0] == 1 && batch[1] == 2 && batch[2] == 3);
+
+    // Refill past the end of the storage, then take it all in one batch
+    for (value = 8; value < 12; value++) {
+        CHECK(SpscRing_Push(&ring, &value));
+    }
+    CHECK(SpscRing_PopBatch(&ring, batch, 16) == 8);
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(batch[i] == 4 + i);
+    }
+    CHECK(SpscRing_Count(&ring) == 0);
+    CHECK(SpscRing_HighWater(&ring) == 8);
+    CHECK(SpscRing_Drops(&ring) == 2);
+
+    // The free-running indices wrap at 2^32
+    atomic_store(&ring.head, UINT32_MAX - 2);
+    atomic_store(&ring.tail, UINT32_MAX - 2);
+    for (value = 0; value < 8; value++) {
+        CHECK(SpscRing_Push(&ring, &value));
+    }
+    CHECK(!SpscRing_Push(&ring, &value));
+    CHECK(SpscRing_Count(&ring) == 8);
+    CHECK(SpscRing_PopBatch(&ring, batch, 5) == 5);
+    CHECK(SpscRing_PopBatch(&ring, &batch[5], 5) == 3);
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(batch[i] == i);
+    }
+    CHECK(SpscRing_Count(&ring) == 0);
+
+    // Elements of any size are copied whole
+    struct {
+        uint16_t a;
+        uint8_t b[5];
+    } wide[4], in = { 7, { 1, 2, 3, 4, 5 } }, out;
+    CHECK(SpscRing_Init(&ring, wide, sizeof(wide[0]), 4));
+    for (int i = 0; i < 6; i++) {
+        in.a = (uint16_t) i;
+        CHECK(SpscRing_Push(&ring, &in));
+        CHECK(SpscRing_Pop(&ring, &out));
+        CHECK(out.a == i && out.b[4] == 5);
+    }
+    puts("  order, full ring, batches and index wrap ok");
+}
+
+static SpscRing_t shared;
+static uint32_t shared_storage[64];
+
+static void *producer(void *argument)
+{
+    (void) argument;
+    for (uint32_t i = 0; i < THREAD_ELEMENTS;) {
+        if (SpscRing_Push(&shared, &i)) {
+            i++;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void two_threads(void)
+{
+    pthread_t thread;
+    uint32_t expect = 0, out_of_order = 0, batch[16];
+
+    CHECK(SpscRing_Init(&shared, shared_storage, sizeof(uint32_t), 64));
+    uint64_t start = host_test_ns();
+    CHECK(pthread_create(&thread, NULL, producer, NULL) == 0);
+    while (expect < THREAD_ELEMENTS) {
+        size_t count = SpscRing_PopBatch(&shared, batch, 16);
+
+        if (count == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i] != expect) {
+                out_of_order++;
+            }
+            expect++;
+        }
+    }
+    pthread_join(thread, NULL);
+    double seconds = (host_test_ns() - start) / 1e9;
+
+    printf("  %u elements through 64 slots, batches of 16: %.1f M elements/s, %u out of order, "
+           "%u refused pushes, high water %u\n",
+           THREAD_ELEMENTS, THREAD_ELEMENTS / seconds / 1e6, out_of_order, SpscRing_Drops(&shared),
+           SpscRing_HighWater(&shared));
+    CHECK(out_of_order == 0);
+    CHECK(SpscRing_Count(&shared) == 0);
+}
+
+int main(void)
+{
+    puts("One thread:");
+    single_thread();
+    puts("Producer and consumer threads:");
+    two_threads();
+    return host_test_result();
+}
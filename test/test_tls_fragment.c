@@ -0,0 +1,188 @@
+/*
+    TLS Maximum Fragment Length (CORE_MQTT_TLS_MAX_FRAGMENT_LEN): for each
+    length the client asks for, whether the server keeps its records to it,
+    the heap the client holds and peaks at, and the throughput up in
+    MQTT-sized writes and down in bulk. TLS 1.2 with ECDHE-ECDSA-AES128-GCM,
+    as the device negotiates with its P-256 key.
+
+    The device uses mbedtls; this runs OpenSSL, which sizes its send buffer
+    to the negotiated length but always reads into a 16 KB buffer, so the
+    heap shows the send side only. On the device xTlsConnect() logs the heap
+    of each connect.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+
+#include "host_test.h"
+#include "tls_peer.h"
+
+#define UP_BYTES (1u << 20)
+#define DOWN_BYTES (4u << 20)
+#define PUBLISH_SIZE 256        // An MQTT publish of one telemetry payload
+#define READ_SIZE 1024          // MQTT_NETWORK_BUFFER_SIZE on the device
+
+// AES-GCM record overhead: header, explicit nonce and tag
+#define RECORD_OVERHEAD (5u + 8u + 16u)
+
+typedef struct {
+    const char *name;
+    uint16_t length;
+    uint8_t code;               // TLSEXT_max_fragment_length_*, 0 to leave it out
+} fragment_case_t;
+
+static const fragment_case_t fragment_cases[] = {
+    { "off", 0, 0 },
+    { "512", 512, TLSEXT_max_fragment_length_512 },
+    { "1024", 1024, TLSEXT_max_fragment_length_1024 },
+    { "2048", 2048, TLSEXT_max_fragment_length_2048 },
+    { "4096", 4096, TLSEXT_max_fragment_length_4096 },
+};
+
+// Server: take UP_BYTES, then send DOWN_BYTES back in large writes
+static void bulk_session(SSL *ssl, void *arg)
+{
+    static char buffer[16384];
+    size_t received = 0, sent = 0;
+
+    (void) arg;
+    while (received < UP_BYTES) {
+        int n = SSL_read(ssl, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return;
+        }
+        received += (size_t) n;
+    }
+    memset(buffer, 'd', sizeof(buffer));
+    while (sent < DOWN_BYTES) {
+        int n = SSL_write(ssl, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return;
+        }
+        sent += (size_t) n;
+    }
+}
+
+// Largest record that reached the client
+static void record_callback(int write_p, int version, int content_type, const void *buf,
+                            size_t len, SSL *ssl, void *arg)
+{
+    const uint8_t *header = buf;
+    size_t *largest = arg;
+
+    (void) version;
+    (void) ssl;
+    if (!write_p && content_type == SSL3_RT_HEADER && len == SSL3_RT_HEADER_LENGTH) {
+        size_t record = SSL3_RT_HEADER_LENGTH + (size_t) (header[3] << 8 | header[4]);
+        if (record > *largest) {
+            *largest = record;
+        }
+    }
+}
+
+static void fragment(SSL_CTX *ctx, const tls_peer_server_t *server, const fragment_case_t *c)
+{
+    static char buffer[READ_SIZE];
+    size_t largest = 0, up = 0, down = 0;
+    size_t before = tls_peer_heap_in_use();
+    int fd = tls_peer_connect(server);
+    SSL *ssl = SSL_new(ctx);
+
+    CHECK(fd >= 0 && ssl != NULL);
+    if (fd < 0 || ssl == NULL) {
+        SSL_free(ssl);
+        return;
+    }
+    SSL_set_fd(ssl, fd);
+    SSL_set_msg_callback(ssl, record_callback);
+    SSL_set_msg_callback_arg(ssl, &largest);
+    if (c->code != 0) {
+        CHECK(SSL_set_tlsext_max_fragment_length(ssl, c->code) == 1);
+    }
+
+    tls_peer_heap_reset_peak();
+    CHECK(SSL_connect(ssl) == 1);
+    size_t handshake_peak = tls_peer_heap_peak() - before;
+    size_t held = tls_peer_heap_in_use() - before;
+    uint8_t negotiated = SSL_SESSION_get_max_fragment_length(SSL_get_session(ssl));
+
+    tls_peer_heap_reset_peak();
+    memset(buffer, 'u', sizeof(buffer));
+    uint64_t start = host_test_ns();
+    while (up < UP_BYTES && SSL_write(ssl, buffer, PUBLISH_SIZE) == PUBLISH_SIZE) {
+        up += PUBLISH_SIZE;
+    }
+    uint64_t up_ns = host_test_ns() - start;
+
+    start = host_test_ns();
+    while (down < DOWN_BYTES) {
+        int n = SSL_read(ssl, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        down += (size_t) n;
+    }
+    uint64_t down_ns = host_test_ns() - start;
+    size_t transfer_peak = tls_peer_heap_peak() - before;
+
+    printf("  %-5s  largest record in %5zu B  heap: handshake peak %6zu B, held %5zu B, "
+           "transfer peak %6zu B  up %6.1f MB/s  down %6.1f MB/s\n",
+           c->name, largest, handshake_peak, held, transfer_peak,
+           up * 1e3 / up_ns, down * 1e3 / down_ns);
+
+    CHECK(up == UP_BYTES && down == DOWN_BYTES);
+    CHECK(negotiated == c->code);
+    if (c->length != 0) {
+        CHECK(largest <= c->length + RECORD_OVERHEAD);
+    } else {
+        CHECK(largest > 4096u + RECORD_OVERHEAD);
+    }
+
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+}
+
+int main(void)
+{
+    CHECK(tls_peer_heap_track());
+
+    EVP_PKEY *ca_key = tls_peer_key(false);
+    X509 *ca = tls_peer_cert(ca_key, "Test CA", NULL, NULL);
+    EVP_PKEY *server_key = tls_peer_key(false);
+    X509 *server_cert = tls_peer_cert(server_key, "broker", ca, ca_key);
+    SSL_CTX *server_ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX *client_ctx = SSL_CTX_new(TLS_client_method());
+    tls_peer_server_t server;
+
+    CHECK(ca != NULL && server_cert != NULL && server_ctx != NULL && client_ctx != NULL);
+    CHECK(SSL_CTX_use_certificate(server_ctx, server_cert) == 1);
+    CHECK(SSL_CTX_use_PrivateKey(server_ctx, server_key) == 1);
+    CHECK(X509_STORE_add_cert(SSL_CTX_get_cert_store(client_ctx), ca) == 1);
+    SSL_CTX_set_verify(client_ctx, SSL_VERIFY_PEER, NULL);
+    CHECK(SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION) == 1);
+    CHECK(SSL_CTX_set_cipher_list(client_ctx, "ECDHE-ECDSA-AES128-GCM-SHA256") == 1);
+    // Buffers are let go between records, as mbedtls resizes its own
+    SSL_CTX_set_mode(client_ctx, SSL_MODE_RELEASE_BUFFERS);
+    SSL_CTX_set_session_cache_mode(client_ctx, SSL_SESS_CACHE_OFF);
+
+    CHECK(tls_peer_start(&server, server_ctx, bulk_session, NULL));
+    printf("Maximum fragment length, %u KB up in %d byte writes, %u KB down in %d byte reads:\n",
+           UP_BYTES / 1024, PUBLISH_SIZE, DOWN_BYTES / 1024, READ_SIZE);
+    for (size_t i = 0; i < sizeof(fragment_cases) / sizeof(fragment_cases[0]); i++) {
+        fragment(client_ctx, &server, &fragment_cases[i]);
+    }
+    tls_peer_stop(&server);
+    ERR_print_errors_fp(stderr);
+
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+    X509_free(server_cert);
+    X509_free(ca);
+    EVP_PKEY_free(server_key);
+    EVP_PKEY_free(ca_key);
+    return host_test_result();
+}
@@ -0,0 +1,212 @@
+/*
+    Mutual-auth TLS 1.2 handshake cost with an RSA-2048 or a P-256 client
+    key (CORE_MQTT_TLS_PREFER_ECDHE_ECDSA), as CPU time of the client alone,
+    and the curve list the option offers: P-256 first, then the defaults, so
+    a broker without P-256 still connects.
+
+    The device uses mbedtls; this runs OpenSSL, whose RSA and ECDSA are far
+    faster than the ESP32's, so only the ratios carry over.
+*/
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+
+#include "host_test.h"
+#include "tls_peer.h"
+
+#define HANDSHAKES 100
+
+// pxTlsEcdheEcdsaCipherSuites, in OpenSSL's names
+#define ECDSA_FIRST_SUITES \
+    "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES128-SHA256:" \
+    "ECDHE-RSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-SHA256"
+
+// pxTlsP256Curves with every curve mbedtls has enabled, and the list it
+// replaced
+#define P256_FIRST_CURVES \
+    "P-256:P-521:brainpoolP512r1:P-384:brainpoolP384r1:secp256k1:brainpoolP256r1:" \
+    "P-224:secp224k1:P-192:secp192k1:X25519:X448"
+#define P256_ONLY_CURVES "P-256"
+
+typedef struct {
+    EVP_PKEY *ca_key;
+    X509 *ca;
+} test_ca_t;
+
+// Process CPU time: the server runs in its own process
+static uint64_t cpu_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+// A context for one side with a fresh key of the given type, trusting ca
+// and requiring a certificate from the other side
+static SSL_CTX *make_ctx(const test_ca_t *ca, bool server, bool rsa, EVP_PKEY **key, X509 **cert)
+{
+    SSL_CTX *ctx = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+
+    *key = tls_peer_key(rsa);
+    *cert = tls_peer_cert(*key, server ? "broker" : "device", ca->ca, ca->ca_key);
+    CHECK(ctx != NULL && *key != NULL && *cert != NULL);
+    CHECK(SSL_CTX_use_certificate(ctx, *cert) == 1);
+    CHECK(SSL_CTX_use_PrivateKey(ctx, *key) == 1);
+    CHECK(X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx), ca->ca) == 1);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    CHECK(SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION) == 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    return ctx;
+}
+
+typedef struct {
+    int ok;
+    uint64_t cpu_ns;
+    unsigned long bytes;        // Both directions, per handshake
+    char suite[64];
+    char group[32];
+} handshake_result_t;
+
+static void handshakes(SSL_CTX *ctx, const tls_peer_server_t *server, int count, handshake_result_t *result)
+{
+    *result = (handshake_result_t) { 0 };
+    for (int i = 0; i < count; i++) {
+        int fd = tls_peer_connect(server);
+        SSL *ssl = SSL_new(ctx);
+
+        if (fd < 0 || ssl == NULL) {
+            SSL_free(ssl);
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+        SSL_set_fd(ssl, fd);
+
+        uint64_t start = cpu_ns();
+        int connected = SSL_connect(ssl) == 1;
+        result->cpu_ns += cpu_ns() - start;
+
+        if (connected) {
+            result->ok++;
+            result->bytes = BIO_number_read(SSL_get_rbio(ssl)) + BIO_number_written(SSL_get_wbio(ssl));
+            snprintf(result->suite, sizeof(result->suite), "%s", SSL_get_cipher_name(ssl));
+            snprintf(result->group, sizeof(result->group), "%s",
+                     SSL_group_to_name(ssl, SSL_get_negotiated_group(ssl)));
+            SSL_shutdown(ssl);
+        }
+        SSL_free(ssl);
+        close(fd);
+    }
+    ERR_clear_error();
+}
+
+typedef struct {
+    const char *name;
+    bool server_rsa;
+    bool client_rsa;
+    const char *suites;         // NULL for OpenSSL's default list
+    const char *expect_suite;
+} key_case_t;
+
+static const key_case_t key_cases[] = {
+    { "RSA broker, RSA-2048 client key, default suites", true, true, NULL, "ECDHE-RSA-AES256-GCM-SHA384" },
+    { "RSA broker, P-256 client key, ECDSA first", true, false, ECDSA_FIRST_SUITES, "ECDHE-RSA-AES128-GCM-SHA256" },
+    { "P-256 broker, P-256 client key, ECDSA first", false, false, ECDSA_FIRST_SUITES, "ECDHE-ECDSA-AES128-GCM-SHA256" },
+};
+
+static double key_case(const test_ca_t *ca, const key_case_t *c)
+{
+    EVP_PKEY *server_key, *client_key;
+    X509 *server_cert, *client_cert;
+    SSL_CTX *server_ctx = make_ctx(ca, true, c->server_rsa, &server_key, &server_cert);
+    SSL_CTX *client_ctx = make_ctx(ca, false, c->client_rsa, &client_key, &client_cert);
+    tls_peer_server_t server;
+    handshake_result_t result;
+
+    CHECK(SSL_CTX_set1_groups_list(client_ctx, P256_FIRST_CURVES) == 1);
+    if (c->suites != NULL) {
+        CHECK(SSL_CTX_set_cipher_list(client_ctx, c->suites) == 1);
+    }
+    CHECK(tls_peer_start(&server, server_ctx, NULL, NULL));
+    handshakes(client_ctx, &server, HANDSHAKES, &result);
+    tls_peer_stop(&server);
+
+    double ms = result.ok ? result.cpu_ns / 1e6 / result.ok : 0;
+    printf("  %-48s %6.3f ms client CPU, %5lu bytes, %s on %s\n",
+           c->name, ms, result.bytes, result.suite, result.group);
+    CHECK(result.ok == HANDSHAKES);
+    CHECK(strcmp(result.suite, c->expect_suite) == 0);
+    CHECK(strcmp(result.group, "secp256r1") == 0);
+
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+    X509_free(client_cert);
+    X509_free(server_cert);
+    EVP_PKEY_free(client_key);
+    EVP_PKEY_free(server_key);
+    return ms;
+}
+
+// A broker that only does P-384 for the key exchange. Both keys are RSA,
+// since OpenSSL does not accept a P-256 certificate on either side without
+// P-256 in its own curve list.
+static void curves(const test_ca_t *ca)
+{
+    EVP_PKEY *server_key, *client_key;
+    X509 *server_cert, *client_cert;
+    SSL_CTX *server_ctx = make_ctx(ca, true, true, &server_key, &server_cert);
+    SSL_CTX *client_ctx = make_ctx(ca, false, true, &client_key, &client_cert);
+    tls_peer_server_t server;
+    handshake_result_t only, first;
+
+    CHECK(SSL_CTX_set1_groups_list(server_ctx, "P-384") == 1);
+    CHECK(SSL_CTX_set_cipher_list(client_ctx, ECDSA_FIRST_SUITES) == 1);
+    CHECK(tls_peer_start(&server, server_ctx, NULL, NULL));
+
+    CHECK(SSL_CTX_set1_groups_list(client_ctx, P256_ONLY_CURVES) == 1);
+    handshakes(client_ctx, &server, 10, &only);
+    CHECK(SSL_CTX_set1_groups_list(client_ctx, P256_FIRST_CURVES) == 1);
+    handshakes(client_ctx, &server, 10, &first);
+    tls_peer_stop(&server);
+
+    printf("  P-384 broker: %d of 10 connect offering P-256 only, %d of 10 offering P-256 then the defaults (%s)\n",
+           only.ok, first.ok, first.ok ? first.group : "-");
+    CHECK(only.ok == 0);
+    CHECK(first.ok == 10 && strcmp(first.group, "secp384r1") == 0);
+
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+    X509_free(client_cert);
+    X509_free(server_cert);
+    EVP_PKEY_free(client_key);
+    EVP_PKEY_free(server_key);
+}
+
+int main(void)
+{
+    test_ca_t ca;
+    double ms[sizeof(key_cases) / sizeof(key_cases[0])];
+
+    ca.ca_key = tls_peer_key(false);
+    ca.ca = tls_peer_cert(ca.ca_key, "Test CA", NULL, NULL);
+    CHECK(ca.ca != NULL);
+
+    printf("Mutual-auth handshakes, %d each:\n", HANDSHAKES);
+    for (size_t i = 0; i < sizeof(key_cases) / sizeof(key_cases[0]); i++) {
+        ms[i] = key_case(&ca, &key_cases[i]);
+    }
+    printf("  P-256 client key: %.1fx less client CPU than RSA-2048 against the same broker\n",
+           ms[1] > 0 ? ms[0] / ms[1] : 0);
+    puts("Curves:");
+    curves(&ca);
+
+    X509_free(ca.ca);
+    EVP_PKEY_free(ca.ca_key);
+    return host_test_result();
+}
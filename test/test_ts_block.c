@@ -0,0 +1,190 @@
+/*
+    Time-series blocks over 24 h of 5-channel samples at 5 s: bytes per
+    sample against JSON and CBOR payloads of the same readings, encode and
+    decode rates, exact round trips including the timestamp wrap and INT32
+    extremes, and blocks that do not fit or arrive truncated.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "telemetry.h"
+#include "ts_block.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLES 17280
+#define CHANNELS 5
+#define RATE_REPEATS 20
+
+static uint32_t timestamps[SAMPLES];
+static int32_t values[SAMPLES][CHANNELS];
+
+static void make_trace(bool jitter, bool noise)
+{
+    uint32_t random = 2;
+    uint32_t t = 0xFFFF0000u;       // crosses the wrap
+
+    for (int i = 0; i < SAMPLES; i++) {
+        double phase = 2 * M_PI * i * 5 / 86400.0;
+
+        t += 5000 + (jitter ? (int32_t) (host_test_random(&random) % 21) - 10 : 0);
+        timestamps[i] = t;
+        values[i][0] = lround((21 + 3 * sin(phase)) * 10) + (noise ? (int32_t) (host_test_random(&random) % 3) - 1 : 0);
+        values[i][1] = lround((50 - 10 * sin(phase)) * 10) + (noise ? (int32_t) (host_test_random(&random) % 3) - 1 : 0);
+        values[i][2] = 35;
+        values[i][3] = 0;
+        values[i][4] = 3;
+    }
+}
+
+// JSON and CBOR bytes per reading, for comparison
+static void per_reading_sizes(int *json, int *cbor)
+{
+    telemetry_reading_t reading = {
+        .uptime_ms = 86400000,
+        .interval_ms = 5000,
+        .sensor_ok = true,
+        .temperature_tenths = 213,
+        .humidity_tenths = 497,
+        .dimmer_ch1 = 35,
+        .dimmer_enabled = true,
+    };
+    char buffer[TELEMETRY_PAYLOAD_SIZE];
+
+    telemetry_set_identity("24:0a:c4:12:34:56", "v4.4.4", "esp32-dht22-01");
+    *json = telemetry_encode_json(&reading, buffer, sizeof(buffer));
+    *cbor = telemetry_encode_cbor(&reading, (uint8_t *) buffer, sizeof(buffer));
+}
+
+static void blocks(const char *name, int block_samples, int json, int cbor)
+{
+    static uint8_t encoded[SAMPLES / 16 + 1][2048];
+    static int32_t lengths[SAMPLES / 16 + 1];
+    int count = (SAMPLES + block_samples - 1) / block_samples;
+    size_t total = 0;
+    long mismatches = 0;
+
+    for (int b = 0; b < count; b++) {
+        TsBlockEncoder_t encoder;
+        int first = b * block_samples;
+        int n = SAMPLES - first < block_samples ? SAMPLES - first : block_samples;
+
+        TsBlock_EncoderInit(&encoder, encoded[b], sizeof(encoded[b]), CHANNELS);
+        for (int i = first; i < first + n; i++) {
+            CHECK(TsBlock_Append(&encoder, timestamps[i], values[i]));
+        }
+        lengths[b] = TsBlock_EncoderFinish(&encoder);
+        CHECK(lengths[b] > 0);
+        total += (size_t) lengths[b];
+
+        TsBlockDecoder_t decoder;
+        uint32_t timestamp;
+        int32_t out[CHANNELS];
+        int decoded = 0;
+        CHECK(TsBlock_DecoderInit(&decoder, encoded[b], (size_t) lengths[b]));
+        while (TsBlock_Next(&decoder, &timestamp, out)) {
+            if (timestamp != timestamps[first + decoded] || memcmp(out, values[first + decoded], sizeof(out)) != 0) {
+                mismatches++;
+            }
+            decoded++;
+        }
+        CHECK(decoded == n);
+    }
+
+    // Rates over the already encoded blocks
+    volatile int32_t sink = 0;
+    uint64_t start = host_test_ns();
+    for (int r = 0; r < RATE_REPEATS; r++) {
+        for (int b = 0; b < count; b++) {
+            TsBlockEncoder_t encoder;
+            int first = b * block_samples;
+            TsBlock_EncoderInit(&encoder, encoded[b], sizeof(encoded[b]), CHANNELS);
+            for (int i = first; i < SAMPLES && i < first + block_samples; i++) {
+                (void) TsBlock_Append(&encoder, timestamps[i], values[i]);
+            }
+            sink += TsBlock_EncoderFinish(&encoder);
+        }
+    }
+    uint64_t middle = host_test_ns();
+    for (int r = 0; r < RATE_REPEATS; r++) {
+        for (int b = 0; b < count; b++) {
+            TsBlockDecoder_t decoder;
+            uint32_t timestamp;
+            int32_t out[CHANNELS];
+            (void) TsBlock_DecoderInit(&decoder, encoded[b], (size_t) lengths[b]);
+            while (TsBlock_Next(&decoder, &timestamp, out)) {
+                sink += out[0];
+            }
+        }
+    }
+    uint64_t end = host_test_ns();
+
+    double per_sample = (double) total / SAMPLES;
+    printf("  %-28s block %2d: %5.2f bytes/sample (JSON %d, CBOR %d), encode %4.1f M samples/s, "
+           "decode %4.1f M samples/s\n",
+           name, block_samples, per_sample, json, cbor, (double) RATE_REPEATS * SAMPLES / (middle - start) * 1e3,
+           (double) RATE_REPEATS * SAMPLES / (end - middle) * 1e3);
+    CHECK(mismatches == 0);
+    CHECK(per_sample < cbor / 20.0);
+}
+
+static void edges(void)
+{
+    static const int32_t low_high[2] = { INT32_MIN, INT32_MAX };
+    static const int32_t high_low[2] = { INT32_MAX, INT32_MIN };
+    TsBlockEncoder_t encoder;
+    TsBlockDecoder_t decoder;
+    uint8_t buffer[256];
+    uint32_t timestamp;
+    int32_t out[2];
+
+    TsBlock_EncoderInit(&encoder, buffer, sizeof(buffer), 2);
+    CHECK(TsBlock_Append(&encoder, 0, low_high));
+    CHECK(TsBlock_Append(&encoder, 0xFFFFFFFFu, high_low));
+    CHECK(TsBlock_Append(&encoder, 5, low_high));
+    int32_t length = TsBlock_EncoderFinish(&encoder);
+    CHECK(TsBlock_DecoderInit(&decoder, buffer, (size_t) length));
+    CHECK(TsBlock_Next(&decoder, &timestamp, out) && timestamp == 0 && out[0] == INT32_MIN && out[1] == INT32_MAX);
+    CHECK(TsBlock_Next(&decoder, &timestamp, out) && timestamp == 0xFFFFFFFFu && out[0] == INT32_MAX && out[1] == INT32_MIN);
+    CHECK(TsBlock_Next(&decoder, &timestamp, out) && timestamp == 5 && out[0] == INT32_MIN && out[1] == INT32_MAX);
+    CHECK(!TsBlock_Next(&decoder, &timestamp, out));
+
+    // A truncated block yields only the samples it still holds whole
+    CHECK(TsBlock_DecoderInit(&decoder, buffer, (size_t) length - 3));
+    int decoded = 0;
+    while (TsBlock_Next(&decoder, &timestamp, out)) {
+        decoded++;
+    }
+    CHECK(decoded < 3);
+    CHECK(!TsBlock_DecoderInit(&decoder, buffer, TS_BLOCK_HEADER_SIZE - 1));
+
+    // A sample that does not fit is refused and the block still finishes
+    TsBlock_EncoderInit(&encoder, buffer, 8, 2);
+    CHECK(!TsBlock_Append(&encoder, 0, low_high));
+    CHECK(TsBlock_EncoderFinish(&encoder) == TS_BLOCK_HEADER_SIZE);
+    TsBlock_EncoderInit(&encoder, buffer, 2, 2);
+    CHECK(TsBlock_EncoderFinish(&encoder) == -1);
+    puts("  timestamp wrap, INT32 extremes, truncation and overflow ok");
+}
+
+int main(void)
+{
+    int json, cbor;
+
+    per_reading_sizes(&json, &cbor);
+    CHECK(json > 0 && cbor > 0 && cbor < json);
+    printf("24 h at 5 s, %d channels:\n", CHANNELS);
+    make_trace(false, false);
+    blocks("steady timing, smooth", 16, json, cbor);
+    blocks("steady timing, smooth", 64, json, cbor);
+    make_trace(true, true);
+    blocks("+-10 ms jitter, +-0.1 noise", 16, json, cbor);
+    blocks("+-10 ms jitter, +-0.1 noise", 64, json, cbor);
+    puts("Edge cases:");
+    edges();
+    return host_test_result();
+}
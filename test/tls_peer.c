@@ -0,0 +1,214 @@
+/*
+    See tls_peer.h.
+*/
+
+#include "tls_peer.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+
+EVP_PKEY *tls_peer_key(bool rsa)
+{
+    return rsa ? EVP_PKEY_Q_keygen(NULL, NULL, "RSA", (size_t) 2048)
+               : EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256");
+}
+
+X509 *tls_peer_cert(EVP_PKEY *key, const char *name, X509 *issuer, EVP_PKEY *issuer_key)
+{
+    static long serial = 1;
+    X509 *cert = X509_new();
+    X509V3_CTX ext_ctx;
+    X509_EXTENSION *ext;
+    bool ok;
+
+    if (cert == NULL) {
+        return NULL;
+    }
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), serial++);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                               (const unsigned char *) name, -1, -1, 0);
+    X509_set_issuer_name(cert, X509_get_subject_name(issuer != NULL ? issuer : cert));
+    X509_set_pubkey(cert, key);
+
+    X509V3_set_ctx(&ext_ctx, issuer != NULL ? issuer : cert, cert, NULL, NULL, 0);
+    ext = X509V3_EXT_nconf_nid(NULL, &ext_ctx, NID_basic_constraints,
+                               issuer == NULL ? "critical,CA:TRUE" : "critical,CA:FALSE");
+    ok = ext != NULL && X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+
+    if (!ok || X509_sign(cert, issuer_key != NULL ? issuer_key : key, EVP_sha256()) == 0) {
+        X509_free(cert);
+        return NULL;
+    }
+    return cert;
+}
+
+static void serve(int listener, SSL_CTX *ctx, tls_peer_session_t session, void *arg)
+{
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        SSL *ssl = SSL_new(ctx);
+        if (ssl != NULL && SSL_set_fd(ssl, fd) == 1 && SSL_accept(ssl) == 1) {
+            if (session != NULL) {
+                session(ssl, arg);
+            }
+            SSL_shutdown(ssl);
+        }
+        SSL_free(ssl);
+        close(fd);
+    }
+}
+
+bool tls_peer_start(tls_peer_server_t *server, SSL_CTX *ctx, tls_peer_session_t session, void *arg)
+{
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t length = sizeof(address);
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (listener < 0) {
+        return false;
+    }
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listener, 16) != 0 ||
+        getsockname(listener, (struct sockaddr *) &address, &length) != 0) {
+        close(listener);
+        return false;
+    }
+
+    server->port = ntohs(address.sin_port);
+    server->pid = fork();
+    if (server->pid == 0) {
+        // Go with the test if it dies before stopping the server
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        serve(listener, ctx, session, arg);
+        _exit(0);
+    }
+    close(listener);
+    return server->pid > 0;
+}
+
+void tls_peer_stop(tls_peer_server_t *server)
+{
+    if (server->pid > 0) {
+        kill(server->pid, SIGTERM);
+        waitpid(server->pid, NULL, 0);
+        server->pid = 0;
+    }
+}
+
+int tls_peer_connect(const tls_peer_server_t *server)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(server->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Each block starts with its size, padded to keep the alignment malloc gives
+typedef union {
+    size_t size;
+    max_align_t align;
+} heap_header_t;
+
+static size_t heap_in_use;
+static size_t heap_peak;
+
+static void *heap_malloc(size_t size, const char *file, int line)
+{
+    heap_header_t *header = malloc(sizeof(*header) + size);
+
+    (void) file;
+    (void) line;
+    if (header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+    heap_in_use += size;
+    if (heap_in_use > heap_peak) {
+        heap_peak = heap_in_use;
+    }
+    return header + 1;
+}
+
+static void heap_free(void *block, const char *file, int line)
+{
+    (void) file;
+    (void) line;
+    if (block != NULL) {
+        heap_header_t *header = (heap_header_t *) block - 1;
+        heap_in_use -= header->size;
+        free(header);
+    }
+}
+
+static void *heap_realloc(void *block, size_t size, const char *file, int line)
+{
+    void *moved;
+
+    if (block == NULL) {
+        return heap_malloc(size, file, line);
+    }
+    if (size == 0) {
+        heap_free(block, file, line);
+        return NULL;
+    }
+    moved = heap_malloc(size, file, line);
+    if (moved != NULL) {
+        size_t old_size = ((heap_header_t *) block - 1)->size;
+        memcpy(moved, block, old_size < size ? old_size : size);
+        heap_free(block, file, line);
+    }
+    return moved;
+}
+
+bool tls_peer_heap_track(void)
+{
+    return CRYPTO_set_mem_functions(heap_malloc, heap_realloc, heap_free) == 1;
+}
+
+size_t tls_peer_heap_in_use(void)
+{
+    return heap_in_use;
+}
+
+size_t tls_peer_heap_peak(void)
+{
+    return heap_peak;
+}
+
+void tls_peer_heap_reset_peak(void)
+{
+    heap_peak = heap_in_use;
+}
@@ -0,0 +1,51 @@
+/*
+    TLS on the host for the transport benchmarks, through OpenSSL since the
+    ESP-IDF mbedtls port does not build here: keys and certificates made at
+    start-up, a server forked onto a loopback port, and a count of the heap
+    OpenSSL holds in this process.
+*/
+
+#ifndef TLS_PEER_H_
+#define TLS_PEER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// RSA-2048 or EC P-256 key
+EVP_PKEY *tls_peer_key(bool rsa);
+
+// Certificate for key named name, signed by issuer, or a self-signed CA
+// when issuer is NULL
+X509 *tls_peer_cert(EVP_PKEY *key, const char *name, X509 *issuer, EVP_PKEY *issuer_key);
+
+// Runs in the server process on each connection once its handshake is done
+typedef void (*tls_peer_session_t)(SSL *ssl, void *arg);
+
+typedef struct {
+    pid_t pid;
+    uint16_t port;
+} tls_peer_server_t;
+
+// Fork a server that accepts connections on 127.0.0.1 with ctx until
+// stopped. Failed handshakes are dropped and the server goes on.
+bool tls_peer_start(tls_peer_server_t *server, SSL_CTX *ctx, tls_peer_session_t session, void *arg);
+void tls_peer_stop(tls_peer_server_t *server);
+
+// TCP connection to the server, with Nagle off as on the device; -1 on error
+int tls_peer_connect(const tls_peer_server_t *server);
+
+// Count what OpenSSL allocates in this process. Call before any other
+// OpenSSL function.
+bool tls_peer_heap_track(void);
+size_t tls_peer_heap_in_use(void);
+
+// Highest tls_peer_heap_in_use() since the last reset
+size_t tls_peer_heap_peak(void);
+void tls_peer_heap_reset_peak(void);
+
+#endif
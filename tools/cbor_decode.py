@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Decode CBOR telemetry payloads into the JSON document the device sends
+on its JSON topic.
+
+Handles the subset produced by components/cbor_writer: unsigned and negative
+integers, text strings, definite-length arrays and maps, booleans, null and
+decimal fractions (tag 4), which are rendered as plain JSON numbers.
+
+    tools/cbor_decode.py payload.cbor
+    mosquitto_sub -t 'clients/+/sensor/dth11/cbor' -N | tools/cbor_decode.py
+    tools/cbor_decode.py --check payload.cbor payload.json
+"""
+
+import argparse
+import decimal
+import json
+import sys
+
+
+class DecodeError(ValueError):
+    pass
+
+
+def _argument(data, pos, info):
+    if info < 24:
+        return info, pos
+    sizes = {24: 1, 25: 2, 26: 4, 27: 8}
+    if info not in sizes:
+        raise DecodeError("unsupported additional info %d at %d" % (info, pos - 1))
+    size = sizes[info]
+    if pos + size > len(data):
+        raise DecodeError("truncated argument at %d" % pos)
+    return int.from_bytes(data[pos:pos + size], "big"), pos + size
+
+
+def decode_item(data, pos=0):
+    """Decode one item at pos; returns (value, next position)."""
+    if pos >= len(data):
+        raise DecodeError("truncated input at %d" % pos)
+    head = data[pos]
+    major, info = head >> 5, head & 0x1F
+    pos += 1
+
+    if major == 7:
+        simple = {20: False, 21: True, 22: None}
+        if info not in simple:
+            raise DecodeError("unsupported simple value %d" % info)
+        return simple[info], pos
+
+    value, pos = _argument(data, pos, info)
+
+    if major == 0:
+        return value, pos
+    if major == 1:
+        return -1 - value, pos
+    if major in (2, 3):
+        if pos + value > len(data):
+            raise DecodeError("truncated string at %d" % pos)
+        raw = bytes(data[pos:pos + value])
+        return (raw if major == 2 else raw.decode("utf-8")), pos + value
+    if major == 4:
+        items = []
+        for _ in range(value):
+            item, pos = decode_item(data, pos)
+            items.append(item)
+        return items, pos
+    if major == 5:
+        result = {}
+        for _ in range(value):
+            key, pos = decode_item(data, pos)
+            result[key], pos = decode_item(data, pos)
+        return result, pos
+    if major == 6:
+        content, pos = decode_item(data, pos)
+        if value == 4 and isinstance(content, list) and len(content) == 2:
+            exponent, mantissa = content
+            # Through Decimal so 234e-1 becomes the float that prints as 23.4.
+            return float(decimal.Decimal(mantissa).scaleb(exponent)), pos
+        raise DecodeError("unsupported tag %d" % value)
+
+    raise DecodeError("unsupported major type %d" % major)
+
+
+def decode(data):
+    value, pos = decode_item(data)
+    if pos != len(data):
+        raise DecodeError("%d trailing bytes" % (len(data) - pos))
+    return value
+
+
+def _to_json(value):
+    if isinstance(value, dict):
+        return {k: _to_json(v) for k, v in value.items()}
+    if isinstance(value, list):
+        return [_to_json(v) for v in value]
+    if isinstance(value, bytes):
+        return value.hex()
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("payload", nargs="?", help="CBOR file (default: stdin)")
+    parser.add_argument("--check", metavar="JSON",
+                        help="exit non-zero unless the payload decodes to this JSON document")
+    args = parser.parse_args()
+
+    if args.payload:
+        with open(args.payload, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    value = _to_json(decode(data))
+
+    if args.check:
+        with open(args.check) as f:
+            expected = json.load(f)
+        if value != expected:
+            print("mismatch:\n  cbor: %s\n  json: %s" % (json.dumps(value), json.dumps(expected)),
+                  file=sys.stderr)
+            return 1
+
+    print(json.dumps(value, separators=(",", ":")))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
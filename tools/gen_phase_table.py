@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Generate the power-linear firing delay tables of components/dimmer_core.
+
+For a resistive load fired at angle a (radians) into each half-cycle, the
+fraction of full power delivered is
+
+    P(a) = 1 - a/pi + sin(2a) / (2 pi)
+
+Each table maps a power in permille to the delay, in microseconds after the
+zero crossing, that delivers it: P is inverted by bisection and the angle
+scaled to the half-cycle. Delays are clamped to DIMMER_MIN_DELAY_US from
+either zero crossing, except full power, which fires at the crossing, and
+0, which never fires.
+
+    tools/gen_phase_table.py > components/dimmer_core/dimmer_phase_table.c
+"""
+
+import math
+
+STEPS = 1001
+MIN_DELAY_US = 500
+FREQUENCIES = (50, 60)
+
+
+def power(angle):
+    return 1 - angle / math.pi + math.sin(2 * angle) / (2 * math.pi)
+
+
+def angle_for(fraction):
+    # P falls monotonically from 1 at angle 0 to 0 at pi
+    low, high = 0.0, math.pi
+    for _ in range(60):
+        middle = (low + high) / 2
+        if power(middle) > fraction:
+            low = middle
+        else:
+            high = middle
+    return (low + high) / 2
+
+
+def delays(frequency):
+    half_cycle_us = 1e6 / (2 * frequency)
+    table = []
+    for permille in range(STEPS):
+        if permille == 0:
+            delay = round(half_cycle_us)
+        elif permille == STEPS - 1:
+            delay = 0
+        else:
+            delay = round(angle_for(permille / 1000) / math.pi * half_cycle_us)
+            delay = min(max(delay, MIN_DELAY_US), math.floor(half_cycle_us) - MIN_DELAY_US)
+        table.append(delay)
+    return table
+
+
+def main():
+    print("/*")
+    print("    Power-linear firing delays; see dimmer_core.h.")
+    print("")
+    print("    Generated by tools/gen_phase_table.py. Do not edit.")
+    print("*/")
+    print("")
+    print('#include "dimmer_core.h"')
+    for frequency in FREQUENCIES:
+        table = delays(frequency)
+        print("")
+        print("const uint16_t DIMMER_DATA_ATTR dimmer_delay_%dhz_us[DIMMER_POWER_STEPS] = {" % frequency)
+        for start in range(0, STEPS, 10):
+            print("    " + " ".join("%d," % delay for delay in table[start:start + 10]))
+        print("};")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Decode time-series block telemetry payloads into a JSON list of readings.
+
+Reads the format written by components/ts_block (see ts_block.h) with the
+channel layout of telemetry_encode_block(): temperature and humidity in
+tenths, the two dimmer levels and a flags channel.
+
+    tools/ts_block_decode.py payload.bin
+    mosquitto_sub -t 'clients/+/sensor/dth11/block' -N -C 1 | tools/ts_block_decode.py
+"""
+
+import argparse
+import json
+import sys
+
+VERSION = 1
+HEADER_SIZE = 4
+TIMESTAMP_WIDTHS = (7, 9, 12, 32)
+VALUE_WIDTHS = (4, 8, 16, 32)
+# SensorQuality_t, see sensor_filter.h
+QUALITIES = ("good", "filtered", "held", "failed")
+
+
+class DecodeError(ValueError):
+    pass
+
+
+class BitReader:
+    def __init__(self, data, pos):
+        self.data = data
+        self.bit = pos * 8
+
+    def read(self, count):
+        if self.bit + count > len(self.data) * 8:
+            raise DecodeError("truncated block at bit %d" % self.bit)
+        value = 0
+        for _ in range(count):
+            byte = self.data[self.bit >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.bit & 7))) & 1)
+            self.bit += 1
+        return value
+
+    def bucketed(self, widths):
+        ones = 0
+        while ones < 4 and self.read(1):
+            ones += 1
+        return 0 if ones == 0 else self.read(widths[ones - 1])
+
+
+def _unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def _wrap32(value):
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def decode(data):
+    """Return (timestamp, [values]) for every sample in a block."""
+    if len(data) < HEADER_SIZE or data[0] != VERSION:
+        raise DecodeError("not a version %d block" % VERSION)
+    channels = data[1]
+    count = data[2] | (data[3] << 8)
+    reader = BitReader(data, HEADER_SIZE)
+    samples = []
+    timestamp, delta = 0, 0
+    values = [0] * channels
+
+    for index in range(count):
+        if index == 0:
+            timestamp = reader.read(32)
+        else:
+            delta = _wrap32(delta + _unzigzag(reader.bucketed(TIMESTAMP_WIDTHS)))
+            timestamp = (timestamp + delta) & 0xFFFFFFFF
+        for channel in range(channels):
+            values[channel] = _wrap32(values[channel] + _unzigzag(reader.bucketed(VALUE_WIDTHS)))
+        samples.append((timestamp, list(values)))
+
+    return samples
+
+
+def to_readings(samples):
+    readings = []
+    for timestamp, (temperature, humidity, channel1, channel2, flags) in samples:
+        sensor_ok = bool(flags & 1)
+        readings.append({
+            "uptime": timestamp,
+            "temperature": temperature / 10 if sensor_ok else None,
+            "humidity": humidity / 10 if sensor_ok else None,
+            "quality": QUALITIES[(flags >> 2) & 3],
+            "dimmer": {"channel1": channel1, "channel2": channel2, "enabled": bool(flags & 2)},
+        })
+    return readings
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("payload", nargs="?", help="block file (default: stdin)")
+    args = parser.parse_args()
+
+    if args.payload:
+        with open(args.payload, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    print(json.dumps(to_readings(decode(data)), separators=(",", ":")))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())